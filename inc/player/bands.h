@@ -0,0 +1,83 @@
+/**
+ * @file bands.h
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief aggregation of the bins of a spectrum in frequency bands
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * A band is the weighted mean of the bins it overlaps, each bin weighing
+ * the part of its width inside the band. The weights are computed once per
+ * layout, so a spectrum of thousands of bins becomes tens or hundreds of
+ * bands at the cost of a product per bin. Bands narrower than a bin, at low
+ * frequencies on a log scale, are the bin they fall in, or the mean of the
+ * two they straddle.
+ */
+#ifndef BANDS_H_
+#define BANDS_H_
+
+#define BANDS_MAX 512 /**< Max no. bands. */
+
+/**
+ * @brief	Spacing of the bands in frequency.
+ */
+typedef enum
+{
+	BANDS_LINEAR,		/**< Bands of the same width. */
+	BANDS_THIRD_OCTAVE, /**< Standard third octave bands, centered on
+							1 kHz * 10^(k/10), as many as in the range. */
+	BANDS_LOG,			/**< Bands of the same ratio. */
+	BANDS_MEL,			/**< Bands of the same width on the mel scale. */
+	BANDS_NSCALE		/**< No. scales. */
+} bands_scale_t;
+
+typedef struct bands bands_t;
+
+/**
+ * @brief compute the layout of the bands
+ *
+ * @param scale spacing of the bands
+ * @param nbar no. bands, at most BANDS_MAX, the max for third octaves
+ * @param nbin no. bins of the spectra, the bin k centered on k * spacing
+ * @param spacing frequency spacing of the bins in Hz
+ * @param fmin lower edge of the first band in Hz, above 0 but for a linear
+ * scale
+ * @param fmax upper edge of the last band in Hz
+ * @return bands_t* the layout, NULL on error
+ */
+bands_t *bands_new(bands_scale_t scale, int nbar, int nbin, float spacing,
+				   float fmin, float fmax);
+
+/**
+ * @brief destroy a layout
+ *
+ * @param b the layout, can be NULL
+ */
+void bands_delete(bands_t *b);
+
+/**
+ * @brief get the no. bands
+ *
+ * @param b the layout
+ * @return int no. bands
+ */
+int bands_nbar(const bands_t *b);
+
+/**
+ * @brief get the center of a band
+ *
+ * @param b the layout
+ * @param i the band
+ * @return float center frequency in Hz, geometric but for a linear scale
+ */
+float bands_freq(const bands_t *b, int i);
+
+/**
+ * @brief aggregate the bins of a spectrum
+ *
+ * @param b the layout
+ * @param bin nbin values
+ * @param bar[out] a value per band, the mean of its bins
+ */
+void bands_apply(const bands_t *b, const float bin[], float bar[]);
+
+#endif /* BANDS_H_ */
@@ -0,0 +1,94 @@
+/**
+ * @file biquad.h
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief cascade of biquad sections processed in a single pass
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * A cascade filters a buffer through all its second order sections in one
+ * pass over the data. Sections use the transposed direct form II, which
+ * only needs two state variables per section and is numerically well
+ * behaved in single precision. All the channels of a track go through the
+ * same sections, each with its own state.
+ */
+#ifndef BIQUAD_H_
+#define BIQUAD_H_
+
+#define CASCADE_LANES 4		 /**< Sections processed together by SIMD. */
+#define CASCADE_MAX_SECT 32 /**< Max no. sections, multiple of the lanes. */
+#define CASCADE_MAX_NCH 8	 /**< Max no. channels. */
+
+/**
+ * @brief	Coefficients of a section, normalized so that a0 = 1.
+ *
+ * y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2] - a1 y[n-1] - a2 y[n-2]
+ */
+typedef struct
+{
+	float b0, b1, b2;
+	float a1, a2;
+} biquad_coef_t;
+
+/**
+ * @brief	Cascade of biquad sections.
+ *
+ * Coefficients and states are stored as arrays of sections, so that
+ * CASCADE_LANES adjacent sections fill a SIMD register. Unused sections are
+ * identities. Coefficients are shared by the channels, states are not.
+ */
+typedef struct
+{
+	int nsect;									   /**< No. sections. */
+	int nch;									   /**< No. channels. */
+	float b0[CASCADE_MAX_SECT] __attribute__((aligned(16))); /**< b0 coef. */
+	float b1[CASCADE_MAX_SECT] __attribute__((aligned(16))); /**< b1 coef. */
+	float b2[CASCADE_MAX_SECT] __attribute__((aligned(16))); /**< b2 coef. */
+	float a1[CASCADE_MAX_SECT] __attribute__((aligned(16))); /**< a1 coef. */
+	float a2[CASCADE_MAX_SECT] __attribute__((aligned(16))); /**< a2 coef. */
+	float z1[CASCADE_MAX_NCH][CASCADE_MAX_SECT]
+		__attribute__((aligned(16))); /**< 1st state of each channel. */
+	float z2[CASCADE_MAX_NCH][CASCADE_MAX_SECT]
+		__attribute__((aligned(16))); /**< 2nd state of each channel. */
+} cascade_t;
+
+/**
+ * @brief initialize a cascade of identity sections with a zero state
+ *
+ * @param c[out] the cascade
+ * @param nsect no. sections, at most CASCADE_MAX_SECT
+ * @param nch no. channels, at most CASCADE_MAX_NCH
+ * @return int 0 on success, -1 on error
+ */
+int cascade_init(cascade_t *c, int nsect, int nch);
+
+/**
+ * @brief set the coefficients of a section, the state is kept
+ *
+ * @param c[inout] the cascade
+ * @param i index of the section
+ * @param coef coefficients
+ */
+void cascade_set(cascade_t *c, int i, const biquad_coef_t *coef);
+
+/**
+ * @brief zero the state of a section, in all the channels
+ *
+ * @param c[inout] the cascade
+ * @param i index of the section, -1 for all the sections
+ */
+void cascade_reset(cascade_t *c, int i);
+
+/**
+ * @brief filter the buffers of the channels through all the sections
+ *
+ * Denormal numbers are flushed to zero while filtering on x86 and arm64,
+ * so that decaying tails of silence don't slow the processing down.
+ * Elsewhere the states are flushed at the end of each buffer.
+ *
+ * @param c[inout] the cascade
+ * @param buf[inout] time-data samples of each channel, c->nch buffers
+ * @param count no. samples in each buffer
+ */
+void cascade_process(cascade_t *c, float *const buf[], unsigned int count);
+
+#endif /* BIQUAD_H_ */
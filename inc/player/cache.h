@@ -0,0 +1,130 @@
+/**
+ * @file cache.h
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief spectra of whole tracks, computed once and kept in files
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * The STFT of a track is computed once, by as many threads as CPUs, and
+ * written to a file named after a hash of the track and the parameters of
+ * the analysis. Magnitudes are stored in dB below full scale, quantized to
+ * 8 or 16 bits. The file is mapped in memory when the track is opened again,
+ * so any spectrum can be read at any time at no FFT cost.
+ */
+#ifndef CACHE_H_
+#define CACHE_H_
+
+#include <stdint.h>
+
+#include "player/window.h"
+
+#ifndef CACHE_DIR
+#define CACHE_DIR "./spectra/" /**< Default directory of the cache files. */
+#endif
+
+#define CACHE_FULL_SCALE 32768.0f /**< Magnitude of a full scale sine. */
+#define CACHE_FLOOR_DB (-120.0f)  /**< Lowest level stored, in dBFS. */
+#define CACHE_MEM_BUDGET (4 << 20) /**< Max bytes of a track read ahead, when
+						it cannot be mapped. */
+#define CACHE_BLOCK 64 /**< Spectra computed by a thread at once. */
+#define CACHE_MAX_WORKER 64 /**< Max no. threads computing spectra. */
+
+/**
+ * @brief	Parameters of the analysis, part of the name of the file.
+ */
+typedef struct
+{
+	int nfft;			 /**< Samples of a transform. */
+	int size;			 /**< Samples of the window, at most nfft. */
+	int hop;			 /**< Samples between two spectra. */
+	int nbin;			 /**< Bins stored, at most nfft / 2 + 1. */
+	window_type_t win;	 /**< Window function. */
+	float beta;			 /**< Shape of the window, WIN_KAISER only. */
+	int bits;			 /**< Bits of a stored magnitude, 8 or 16. */
+} cache_key_t;
+
+typedef struct cache cache_t;
+
+/**
+ * @brief	Counters of the spectra built and mapped.
+ */
+typedef struct
+{
+	unsigned long nbuild; /**< No. tracks analysed. */
+	long nframe;		  /**< Spectra computed. */
+	double build_s;		  /**< Total time spent computing them in s. */
+	unsigned long nopen;  /**< No. tracks mapped from a file. */
+} cache_stats_t;
+
+/**
+ * @brief hash of the content of a file, 64 bits FNV-1a
+ *
+ * @param path the file
+ * @param hash[out] the hash
+ * @return int 0 on success, -1 on error
+ */
+int cache_hash(const char *path, uint64_t *hash);
+
+/**
+ * @brief map the spectra of a track computed before
+ *
+ * @param path the track
+ * @param key parameters of the analysis
+ * @return cache_t* the spectra, NULL if there are none
+ */
+cache_t *cache_open(const char *path, const cache_key_t *key);
+
+/**
+ * @brief compute the spectra of a track, write and map them
+ *
+ * Spectrum i is centered on the frame i * hop, frames out of the track
+ * being silence. The signal analysed is a weighted sum of the channels. The
+ * file is written under another name and renamed once complete, so a file
+ * found by cache_open() is never partial. The transform of nfft samples
+ * must have been planned with fft_plan().
+ *
+ * @param path the track
+ * @param key parameters of the analysis
+ * @param w weight of each channel of the track
+ * @param nworker no. threads, 0 or less for one per online CPU
+ * @param stop polled by the threads, when not zero they stop and nothing
+ * is written, can be NULL
+ * @return cache_t* the spectra, NULL on error or when stopped
+ */
+cache_t *cache_build(const char *path, const cache_key_t *key,
+					 const float w[], int nworker, volatile const int *stop);
+
+/**
+ * @brief unmap the spectra
+ *
+ * @param c the spectra, can be NULL
+ */
+void cache_close(cache_t *c);
+
+/**
+ * @brief get the no. spectra
+ *
+ * @param c the spectra
+ * @return long no. spectra, len / hop + 1
+ */
+long cache_nframe(const cache_t *c);
+
+/**
+ * @brief get the spectrum centered on a frame of the track
+ *
+ * @param c the spectra
+ * @param pos frame of the track, the nearest spectrum is read
+ * @param mag[out] nbin magnitudes, corrected by the coherent gain of the
+ * window, 0 below CACHE_FLOOR_DB
+ * @return int 0 on success, -1 if pos is out of the track
+ */
+int cache_read(const cache_t *c, long pos, float mag[]);
+
+/**
+ * @brief get a copy of the counters of the spectra built and mapped
+ *
+ * @param dst[out] where the counters are copied
+ */
+void cache_get_stats(cache_stats_t *dst);
+
+#endif /* CACHE_H_ */
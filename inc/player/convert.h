@@ -0,0 +1,123 @@
+/**
+ * @file convert.h
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief sample format conversion kernels
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * Conversion between little endian sample formats and machine floats: the
+ * Allegro SAMPLE data format (unsigned) and the formats of WAV files, signed
+ * integers of 8 to 32 bits and IEEE floats, so that PCM data can be read in
+ * place. Every format has a scalar reference
+ * kernel and, on x86, SSE2 and AVX2 kernels that are bit-exact with the
+ * reference. The best variant is selected once, at load time, by
+ * convert_select().
+ * Frames of more channels are interleaved in files and in the output, while
+ * the channels are filtered and analysed one by one: interleave kernels move
+ * floats between the two layouts.
+ */
+#ifndef CONVERT_H_
+#define CONVERT_H_
+
+#define CONVERT_MAX_NCH 8 /**< Max no. channels of interleaved frames. */
+
+/**
+ * @brief	Sample format.
+ */
+typedef enum
+{
+	CONVERT_U8,	  /**< 8 bits unsigned, Allegro and WAV. */
+	CONVERT_U16,  /**< 16 bits unsigned, Allegro. */
+	CONVERT_S16,  /**< 16 bits signed, WAV. */
+	CONVERT_S24,  /**< 24 bits signed, packed in 3 bytes, WAV. */
+	CONVERT_S32,  /**< 32 bits signed, WAV. */
+	CONVERT_F32,  /**< 32 bits float, full scale is 1, WAV. */
+	CONVERT_NFMT  /**< No. formats. */
+} convert_fmt_t;
+
+/**
+ * @brief	Instruction set of a kernel.
+ */
+typedef enum
+{
+	CONVERT_SCALAR, /**< Portable C. */
+	CONVERT_SSE2,	/**< x86 SSE2. */
+	CONVERT_AVX2,	/**< x86 AVX2. */
+	CONVERT_NISA	/**< No. instruction sets. */
+} convert_isa_t;
+
+/**
+ * @brief	Conversion kernels for a sample format.
+ *
+ * Floats are in the signed integer range of 8 bits samples, [-128, 127], for
+ * 8 bits formats, and of 16 bits samples, [-32768, 32767], for all the
+ * others: samples of more bits keep the extra bits as a fraction, so they
+ * are played at 16 bits with no further scaling. Float to integer sample
+ * conversion rounds to nearest (ties to even) and saturates the values out
+ * of range, float samples are only scaled.
+ */
+typedef struct
+{
+	const char *name;	/**< Kernel name, for logs and benchmarks. */
+	convert_fmt_t fmt;	/**< Sample format. */
+	int bits;			/**< Bits per sample. */
+	convert_isa_t isa;	/**< Instruction set. */
+	void (*to_float)(const void *src, float *dst, unsigned int count);
+	/**< Convert count samples to floats. */
+	void (*from_float)(const float *src, void *dst, unsigned int count);
+	/**< Convert count floats to samples. */
+} convert_t;
+
+/**
+ * @brief select the fastest kernels supported by the running CPU
+ *
+ * @param fmt sample format
+ * @return const convert_t* the kernels, NULL if the format is not supported
+ */
+const convert_t *convert_select(convert_fmt_t fmt);
+
+/**
+ * @brief get the kernels of a given instruction set
+ *
+ * @param fmt sample format
+ * @param isa instruction set
+ * @return const convert_t* the kernels, NULL if the format is not supported
+ * or the CPU does not support the instruction set
+ */
+const convert_t *convert_get(convert_fmt_t fmt, convert_isa_t isa);
+
+/**
+ * @brief	Kernels between interleaved frames and a buffer per channel.
+ */
+typedef struct
+{
+	const char *name;	   /**< Kernel name, for logs and benchmarks. */
+	unsigned int nch_mask; /**< Bit n set if it works with n channels. */
+	convert_isa_t isa;	   /**< Instruction set. */
+	void (*split)(const float *src, float *const dst[], int nch,
+				  unsigned int count);
+	/**< Deinterleave count frames of nch channels. */
+	void (*merge)(const float *const src[], float *dst, int nch,
+				  unsigned int count);
+	/**< Interleave count frames of nch channels. */
+} convert_ilv_t;
+
+/**
+ * @brief select the fastest interleave kernels supported by the running CPU
+ *
+ * @param nch no. channels, at most CONVERT_MAX_NCH
+ * @return const convert_ilv_t* the kernels, NULL if nch is not supported
+ */
+const convert_ilv_t *convert_ilv_select(int nch);
+
+/**
+ * @brief get the interleave kernels of a given instruction set
+ *
+ * @param nch no. channels, at most CONVERT_MAX_NCH
+ * @param isa instruction set
+ * @return const convert_ilv_t* the kernels, NULL if nch is not supported
+ * or the CPU does not support the instruction set
+ */
+const convert_ilv_t *convert_ilv_get(int nch, convert_isa_t isa);
+
+#endif /* CONVERT_H_ */
@@ -1,46 +1,263 @@
 /**
  * @file equalizer.c
  * @author Stefano Fiori (fioristefano.90@gmail.com)
- * @brief Audio equalizer interface. 
+ * @brief Audio equalizer interface.
  * @version 0.1
  * @date 2019-03-19
- * 
+ *
+ * The equalizer is a cascade of second order filters (bands). By default it
+ * has the EQ_NFILT peaking bands of the player, but the layout can be changed
+ * at runtime: ISO graphic presets or fully parametric bands. All the channels
+ * of a track go through the same bands, each channel with its own state.
+ * Instead of the bands, a long FIR filter can be selected, e.g. a measured
+ * correction curve, convolved block by block through the FFT, or a linear
+ * phase FIR with the magnitude response of the bands, that doesn't smear
+ * transients at the cost of a latency.
  */
 
 #ifndef EQUALIZER_H
 #define EQUALIZER_H
 
 #define EQ_NFILT 4              /**< Number of the filters of the equalizer*/
+#define EQ_MAX_NFILT 32         /**< Max number of bands of a layout. */
+#define EQ_MAX_NCH 8            /**< Max number of channels. */
 #define EQ_FILT_MAX_GAIN 20.0f  /**< Maximum deciBel gain of filters. */
 #define EQ_FILT_BW 1.0f         /**< bandwidth of filters in octaves. */
+#define EQ_RAMP_LEN 1024        /**< samples to move to new coefficients. */
+#define EQ_RAMP_STEP 32         /**< samples filtered with the same
+                                     coefficients while ramping. */
+#define EQ_LIN_SIZE 4096        /**< samples of the linear phase design,
+                                     up to EQ_LIN_FREQ. */
+#define EQ_LIN_FREQ 48000       /**< highest rate of EQ_LIN_SIZE, the size
+                                     doubles above it. */
+#define EQ_LIN_PART 256         /**< partition of the linear phase FIR. */
 
-extern const int equalizer_freq[EQ_NFILT]; /**< center frequency of each 
+extern const int equalizer_freq[EQ_NFILT]; /**< center frequency of each
                                                 band of the EQ. */
 
+/**
+ * @brief type of the filter of a band
+ */
+typedef enum
+{
+    EQ_PEAK,       /**< Peaking, boost or cut around freq. */
+    EQ_LOW_SHELF,  /**< Boost or cut below freq. */
+    EQ_HIGH_SHELF, /**< Boost or cut above freq. */
+    EQ_LOW_PASS,   /**< Remove above freq, gain is ignored. */
+    EQ_HIGH_PASS,  /**< Remove below freq, gain is ignored. */
+    EQ_NOTCH,      /**< Remove around freq, gain is ignored. */
+    EQ_NTYPE       /**< Number of band types. */
+} eq_band_type_t;
+
+/**
+ * @brief band layout presets
+ */
+typedef enum
+{
+    EQ_PRESET_PLAYER, /**< The EQ_NFILT bands at equalizer_freq. */
+    EQ_PRESET_ISO10,  /**< 10 bands, octave spaced ISO graphic EQ. */
+    EQ_PRESET_ISO31,  /**< 31 bands, 1/3 octave spaced ISO graphic EQ. */
+    EQ_NPRESET,       /**< Number of presets. */
+} eq_preset_t;
+
+/**
+ * @brief processing modes
+ */
+typedef enum
+{
+    EQ_MODE_BANDS,  /**< The cascade of bands. */
+    EQ_MODE_FIR,    /**< The FIR set by equalizer_set_fir. */
+    EQ_MODE_LINEAR, /**< Linear phase FIR, designed from the bands. */
+    EQ_NMODE        /**< Number of modes. */
+} eq_mode_t;
+
+/**
+ * @brief parameters of a band
+ */
+typedef struct
+{
+    eq_band_type_t type; /**< Filter type. */
+    float freq;          /**< Center/corner frequency in Hz. */
+    float q;             /**< Quality factor. */
+    float gain;          /**< Gain in dB, for peaking and shelving bands. */
+} eq_band_t;
+
 /**
  * @brief initialize the equalizer
- * 
+ *
+ * The layout is reset to EQ_PRESET_PLAYER, with all gains to 0, for a
+ * single channel.
+ *
  * @param frequency sampling frequency of the audio file to equalize
  * @return int 0 on success, -1 on fail.
  */
 void equalizer_init(int frequency);
 
+/**
+ * @brief set the number of channels equalized
+ *
+ * The state of all the channels restarts from zero, so it must not be
+ * called while equalizing.
+ *
+ * @param nch number of channels, at most EQ_MAX_NCH
+ * @return int 0 on success, -1 on error
+ */
+int equalizer_set_nch(int nch);
+
 /**
  * @brief equalize a stream of sample
- * 
+ *
  * @param buf buffer containing stream data
  * @param count number of sample in the buffer
- * @return int number of sample equalized, -1 on error
+ * @return int number of sample equalized, -1 on error, also when the
+ * equalizer has more than one channel
  */
 int equalizer_equalize(float buf[], unsigned int count);
 
+/**
+ * @brief equalize a block of each channel
+ *
+ * Channels are filtered together, sharing the coefficients.
+ *
+ * @param buf buffers of each channel, as many as set by equalizer_set_nch
+ * @param count number of samples in each buffer
+ * @return int number of samples equalized, -1 on error
+ */
+int equalizer_equalize_ch(float *const buf[], unsigned int count);
+
 /**
  * @brief set the gain of a filter in the equalizer
- * 
+ *
+ * The filter keeps its state and moves to the new gain over the next
+ * EQ_RAMP_LEN samples, so that the change doesn't click. The linear phase
+ * FIR follows at the next equalizer_update.
+ *
  * @param filt index of the filter whom set the gain
- * @param gain gain value
- * @return int the new gain of the filter, -1 on error.
+ * @param gain gain value, clamped to +-EQ_FILT_MAX_GAIN
+ * @param set[out] the gain set, may be NULL
+ * @return int 0 on success, -1 if there is no such filter
+ */
+int equalizer_set_gain(int filt, float gain, float *set);
+
+/**
+ * @brief change the band layout to a preset, all gains to 0
+ *
+ * Bands above the Nyquist frequency of the audio are left flat.
+ *
+ * @param preset the preset
+ * @return int the number of bands, -1 on error
+ */
+int equalizer_set_preset(eq_preset_t preset);
+
+/**
+ * @brief change the whole band layout
+ *
+ * All the bands restart from a zero state.
+ *
+ * @param bands parameters of each band
+ * @param nband number of bands, at most EQ_MAX_NFILT
+ * @return int 0 on success, -1 on error
+ */
+int equalizer_set_layout(const eq_band_t bands[], int nband);
+
+/**
+ * @brief change all the parameters of a band
+ *
+ * Changes of frequency, Q and gain are smooth as in equalizer_set_gain, a
+ * change of type restarts the band from a zero state.
+ *
+ * @param filt index of the band
+ * @param band new parameters, the gain is clamped as in equalizer_set_gain
+ * @return int 0 on success, -1 on error
+ */
+int equalizer_set_band(int filt, const eq_band_t *band);
+
+/**
+ * @brief get the parameters of a band
+ *
+ * @param filt index of the band
+ * @param band[out] where the parameters are copied
+ * @return int 0 on success, -1 on error
+ */
+int equalizer_get_band(int filt, eq_band_t *band);
+
+/**
+ * @brief get the number of bands of the current layout
+ *
+ * @return int number of bands
+ */
+int equalizer_get_nband();
+
+/**
+ * @brief set the impulse response of the FIR mode
+ *
+ * The filter is designed and its transforms planned by the caller, the
+ * audio path takes it at the start of the next block, with a zero state.
+ * Partitions of part samples delay the output as much: smaller ones lower
+ * the latency, larger ones the CPU cost.
+ *
+ * @param taps impulse response
+ * @param ntaps length of the impulse response, at most FIR_MAX_TAPS
+ * @param part samples of a partition, a power of 2 in [FIR_MIN_PART,
+ * FIR_MAX_PART]
+ * @return int 0 on success, -1 on error
+ */
+int equalizer_set_fir(const float taps[], int ntaps, int part);
+
+/**
+ * @brief select the processing mode
+ *
+ * The mode selected starts from a zero state at the next block, so the
+ * switch is not smooth. Selecting EQ_MODE_LINEAR the first time plans and
+ * designs its FIR, from then on it is designed again by equalizer_update
+ * after the changes of the bands, and crossfaded in a partition.
+ *
+ * @param mode the mode, EQ_MODE_FIR needs a FIR set
+ * @return int 0 on success, -1 on error
+ */
+int equalizer_set_mode(eq_mode_t mode);
+
+/**
+ * @brief design the linear phase FIR again if the bands changed
+ *
+ * The setters of the bands can be called by the audio path, so they leave
+ * the design, an inverse transform and the transforms of the partitions, to
+ * this. It must be called by a thread that is not the audio path, e.g.
+ * periodically; the audio path takes the new kernel at its next block.
+ *
+ * @return int 1 if a new FIR was designed, 0 if there was nothing to do, -1
+ * on error
+ */
+int equalizer_update();
+
+/**
+ * @brief get the processing mode selected
+ *
+ * @return eq_mode_t the mode
+ */
+eq_mode_t equalizer_get_mode();
+
+/**
+ * @brief get the delay of the output in the mode selected
+ *
+ * The linear phase FIR is late by half its design plus a partition.
+ *
+ * @return int delay in samples, 0 for the bands
+ */
+int equalizer_get_latency();
+
+/**
+ * @brief samples needed for a wrong state of the bands to fade out
+ *
+ * Filtering the same signal from two different states, the difference of
+ * the outputs decays as the largest radius of the poles of the bands to the
+ * power of the samples filtered. Bands started in the middle of a track are
+ * warmed up for as long.
+ *
+ * @param err ratio of the initial difference left, in (0, 1)
+ * @return long no. samples, -1 if the bands never settle or in FIR mode,
+ * whose output is late
  */
-float equalizer_set_gain(int filt, float gain);
+long equalizer_settle(float err);
 
-#endif //EQUALIZER_H
\ No newline at end of file
+#endif //EQUALIZER_H
@@ -0,0 +1,75 @@
+/**
+ * @file evq.h
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief bounded queue of events, many producers and one consumer, no lock
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * Each slot of the ring has a sequence telling whether it is free or full
+ * for the current lap, so producers claim a slot by a compare and swap of
+ * the tail and the consumer never waits for them. Events are copied in and
+ * out, all of the same size.
+ */
+#ifndef EVQ_H_
+#define EVQ_H_
+
+#include <stddef.h>
+
+/**
+ * @brief	Queue of events.
+ */
+typedef struct
+{
+	int len;			 /**< Slots, a power of 2. */
+	size_t size;		 /**< Bytes of an event. */
+	unsigned long *seq;	 /**< Sequence of each slot. */
+	unsigned char *data; /**< Events, size bytes each. */
+	unsigned long head;	 /**< Next slot popped, by the consumer only. */
+	unsigned long tail;	 /**< Next slot pushed. */
+	unsigned long nfull; /**< Pushes failed since the queue was full. */
+} evq_t;
+
+/**
+ * @brief initialize a queue
+ *
+ * @param q the queue
+ * @param len no. events, a power of 2
+ * @param size bytes of an event
+ * @return int 0 on success, -1 on error
+ */
+int evq_init(evq_t *q, int len, size_t size);
+
+/**
+ * @brief release a queue
+ *
+ * @param q the queue
+ */
+void evq_destroy(evq_t *q);
+
+/**
+ * @brief append an event, by any thread
+ *
+ * @param q the queue
+ * @param evt the event, copied
+ * @return int 0 on success, -1 if the queue is full
+ */
+int evq_push(evq_t *q, const void *evt);
+
+/**
+ * @brief remove the oldest event, by one thread only
+ *
+ * @param q the queue
+ * @param evt[out] the event
+ * @return int 0 on success, -1 if the queue is empty
+ */
+int evq_pop(evq_t *q, void *evt);
+
+/**
+ * @brief get the no. pushes failed since the queue was full
+ *
+ * @param q the queue
+ * @return unsigned long pushes failed
+ */
+unsigned long evq_get_nfull(const evq_t *q);
+
+#endif /* EVQ_H_ */
@@ -0,0 +1,119 @@
+/**
+ * @file fft.h
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief persistent FFTW plans and wisdom cache
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * Plans are created once per transform size, at initialization time, and
+ * then executed on any buffer allocated with fft_alloc_real() and
+ * fft_alloc_cpx(), so the real-time threads never pay for FFTW planning.
+ * Wisdom is loaded from and saved to a file, so expensive planner flags
+ * (FFTW_MEASURE, FFTW_PATIENT) only slow down the very first start.
+ */
+#ifndef FFT_H_
+#define FFT_H_
+
+#include <fftw3.h>
+
+#ifndef FFT_WISDOM_PATH
+#define FFT_WISDOM_PATH "./fftw.wisdom" /**< Default wisdom file. */
+#endif
+
+#ifndef FFT_PLAN_FLAGS
+#define FFT_PLAN_FLAGS FFTW_MEASURE /**< Planner rigor. */
+#endif
+
+#define FFT_MAX_PLANS 8 /**< Max no. of different transform sizes. */
+
+/**
+ * @brief	Planning and execution time counters.
+ */
+typedef struct
+{
+	unsigned long nplan;   /**< No. plans created. */
+	long long plan_ns;	   /**< Total time spent planning in ns. */
+	unsigned long nexec;   /**< No. transforms executed. */
+	long long exec_ns;	   /**< Total time spent executing in ns. */
+	long long exec_max_ns; /**< Slowest transform in ns. */
+} fft_stats_t;
+
+/**
+ * @brief initialize the fft module and load the wisdom file
+ *
+ * @param wisdom path of the wisdom file, NULL for FFT_WISDOM_PATH
+ */
+void fft_init(const char *wisdom);
+
+/**
+ * @brief create the plans for the real transforms of the given size
+ *
+ * Calling it again with an already planned size does nothing. It can be
+ * called from any thread, the planner is serialized. The wisdom file is
+ * updated every time a new plan is created.
+ *
+ * @param size number of real samples of the transform
+ * @return int 0 on success, -1 on error
+ */
+int fft_plan(int size);
+
+/**
+ * @brief compute a real to complex transform with a persistent plan
+ *
+ * @param size number of real samples, it must have been planned
+ * @param in[in] real input, allocated with fft_alloc_real()
+ * @param out[out] size / 2 + 1 complex terms, allocated with fft_alloc_cpx()
+ */
+void fft_r2c(int size, float *in, fftwf_complex *out);
+
+/**
+ * @brief compute a complex to real inverse transform with a persistent plan
+ *
+ * The transform is not normalized: a round trip scales by size.
+ *
+ * @param size number of real samples, it must have been planned
+ * @param in[in] size / 2 + 1 complex terms, allocated with fft_alloc_cpx(),
+ * overwritten by the transform
+ * @param out[out] real output, allocated with fft_alloc_real()
+ */
+void fft_c2r(int size, fftwf_complex *in, float *out);
+
+/**
+ * @brief allocate a real buffer aligned as the plans expect
+ *
+ * @param n no. floats
+ * @return float* the buffer, to be released with fft_free()
+ */
+float *fft_alloc_real(int n);
+
+/**
+ * @brief allocate a complex buffer aligned as the plans expect
+ *
+ * @param n no. complex terms
+ * @return fftwf_complex* the buffer, to be released with fft_free()
+ */
+fftwf_complex *fft_alloc_cpx(int n);
+
+/**
+ * @brief release a buffer allocated by the fft module
+ *
+ * @param p buffer to release
+ */
+void fft_free(void *p);
+
+/**
+ * @brief get a copy of the planning and execution counters
+ *
+ * Each counter is read atomically, a transform running meanwhile may be
+ * counted in some of them only.
+ *
+ * @param dst[out] where the counters are copied
+ */
+void fft_get_stats(fft_stats_t *dst);
+
+/**
+ * @brief destroy all the plans and save the wisdom
+ */
+void fft_xtor();
+
+#endif /* FFT_H_ */
@@ -0,0 +1,130 @@
+/**
+ * @file fir.h
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief long FIR filters by uniformly partitioned overlap-save convolution
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * The impulse response is cut in partitions of the same size, each one
+ * transformed once. Every time a partition worth of input is collected, its
+ * spectrum enters a delay line and the output block is the inverse
+ * transform of the sum of the products of the delay line with the
+ * partitions. A block costs two transforms of twice the partition plus a
+ * product per partition, whatever the length of the filter.
+ *
+ * The output is late by a partition: small partitions give low latency,
+ * large ones cost less CPU per sample. The impulse response can be replaced
+ * while filtering, with a kernel designed out of the real-time path.
+ */
+#ifndef FIR_H_
+#define FIR_H_
+
+#define FIR_MIN_PART 16		 /**< Min samples of a partition. */
+#define FIR_MAX_PART 16384	 /**< Max samples of a partition. */
+#define FIR_MAX_TAPS (1 << 20) /**< Max length of a filter. */
+#define FIR_MAX_NCH 8		 /**< Max no. channels. */
+
+typedef struct fir fir_t;
+typedef struct fir_kernel fir_kernel_t; /**< Transformed impulse response. */
+
+/**
+ * @brief transform an impulse response for a filter
+ *
+ * The transforms of twice the partition are planned here, so it must not
+ * be called by a real-time thread.
+ *
+ * @param taps impulse response
+ * @param ntaps length of the impulse response, at most FIR_MAX_TAPS
+ * @param part samples of a partition, a power of two between FIR_MIN_PART
+ * and FIR_MAX_PART
+ * @return fir_kernel_t* the kernel, NULL on error
+ */
+fir_kernel_t *fir_kernel_new(const float taps[], int ntaps, int part);
+
+/**
+ * @brief destroy a kernel
+ *
+ * @param k the kernel, can be NULL
+ */
+void fir_kernel_delete(fir_kernel_t *k);
+
+/**
+ * @brief create a filter, with a zero state
+ *
+ * The transforms of twice the partition are planned here, so it must not
+ * be called by a real-time thread.
+ *
+ * @param taps impulse response
+ * @param ntaps length of the impulse response, at most FIR_MAX_TAPS
+ * @param part samples of a partition, a power of two between FIR_MIN_PART
+ * and FIR_MAX_PART
+ * @param nch no. channels, at most FIR_MAX_NCH
+ * @return fir_t* the filter, NULL on error
+ */
+fir_t *fir_new(const float taps[], int ntaps, int part, int nch);
+
+/**
+ * @brief destroy a filter
+ *
+ * @param f the filter, can be NULL
+ */
+void fir_delete(fir_t *f);
+
+/**
+ * @brief replace the impulse response, keeping the state
+ *
+ * The next block is crossfaded from the response heard to the new one.
+ * Nothing is allocated or transformed, it can be called while filtering.
+ *
+ * @param f[inout] the filter
+ * @param k kernel of the same partition size, no longer than the first
+ * kernel of the filter, owned by the filter from now on
+ * @return fir_kernel_t* a kernel no more used, to be released by the caller,
+ * NULL if none, k itself if it does not fit
+ */
+fir_kernel_t *fir_set_kernel(fir_t *f, fir_kernel_t *k);
+
+/**
+ * @brief zero the state of all the channels
+ *
+ * @param f[inout] the filter
+ */
+void fir_reset(fir_t *f);
+
+/**
+ * @brief filter a block of each channel, in place
+ *
+ * Blocks can be of any size: the output is the input filtered and delayed
+ * by fir_latency() samples.
+ *
+ * @param f[inout] the filter
+ * @param buf buffers of each channel, as many as the filter has
+ * @param count no. samples in each buffer
+ */
+void fir_process(fir_t *f, float *const buf[], unsigned int count);
+
+/**
+ * @brief get the delay of the output
+ *
+ * @param f the filter
+ * @return int delay in samples, the partition size
+ */
+int fir_latency(const fir_t *f);
+
+/**
+ * @brief get the length of the impulse response
+ *
+ * @param f the filter
+ * @return int no. taps
+ */
+int fir_ntaps(const fir_t *f);
+
+/**
+ * @brief get the no. channels
+ *
+ * @param f the filter
+ * @return int no. channels
+ */
+int fir_nch(const fir_t *f);
+
+#endif /* FIR_H_ */
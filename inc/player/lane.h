@@ -0,0 +1,80 @@
+/**
+ * @file lane.h
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief automation lane, values of a parameter along a track
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * A lane is a list of points, each a track frame and a value, sorted by
+ * frame. The value at a frame is the one of the last point at or before
+ * it, so it only depends on the position and not on how it was reached.
+ * Points are kept in arrays allocated once, adding one never allocates.
+ */
+#ifndef LANE_H_
+#define LANE_H_
+
+/**
+ * @brief	Automation lane.
+ */
+typedef struct
+{
+	long *frame; /**< Frame of each point, increasing. */
+	float *val;	 /**< Value of each point. */
+	int len;	 /**< No. points. */
+	int cap;	 /**< Max no. points. */
+} lane_t;
+
+/**
+ * @brief initialize an empty lane
+ *
+ * @param l the lane
+ * @param cap max no. points
+ * @return int 0 on success, -1 on error
+ */
+int lane_init(lane_t *l, int cap);
+
+/**
+ * @brief release a lane
+ *
+ * @param l the lane
+ */
+void lane_destroy(lane_t *l);
+
+/**
+ * @brief add a point, replacing the one at the same frame
+ *
+ * @param l the lane
+ * @param frame frame of the point, 0 or more
+ * @param val value from the frame on
+ * @return int 0 on success, -1 if the lane is full or frame negative
+ */
+int lane_add(lane_t *l, long frame, float val);
+
+/**
+ * @brief remove all the points
+ *
+ * @param l the lane
+ */
+void lane_clear(lane_t *l);
+
+/**
+ * @brief get the point setting the value at a frame
+ *
+ * @param l the lane
+ * @param frame the frame
+ * @return int index of the last point at or before frame, -1 if none
+ */
+int lane_find(const lane_t *l, long frame);
+
+/**
+ * @brief get the frames the value stays the same for, from a frame
+ *
+ * @param l the lane
+ * @param frame the first frame
+ * @param dir 1 going forward, -1 backward
+ * @return long frames up to the next change of point, frame included,
+ * LONG_MAX if there are none
+ */
+long lane_span(const lane_t *l, long frame, int dir);
+
+#endif /* LANE_H_ */
@@ -12,18 +12,51 @@
 #define PLAYER_H_
 
 #include <pthread.h>
+#include <stddef.h>
 
+#include "player/bands.h"
+#include "player/equalizer.h"
+#include "player/window.h"
 #include "ptask.h"
 
-#define PLAYER_MAX_FREQ (44100)   /**< Max sample per seconds. */
-#define PLAYER_MAX_SMPL_SIZE (2)  /**< Max no. Byte per sample. */
-#define PLAYER_MAX_NCH (1)		  /**< Max no. Channels. */
+#define PLAYER_MAX_FREQ (192000)  /**< Max sample per seconds. */
+#define PLAYER_MAX_SMPL_SIZE (4)  /**< Max no. Byte per sample. */
+#define PLAYER_MAX_NCH (8)		  /**< Max no. Channels. */
 #define PLAYER_WINDOW_SIZE (8192) /**< Size of the Windows for spectogram \
-				  computation. */
+				  computation, up to 48 kHz. */
 #define PLAYER_WINDOW_SIZE_CPX ((PLAYER_WINDOW_SIZE / 2) + 1)
+#define PLAYER_WINDOW_FREQ (48000) /**< Max sample per seconds analysed \
+				with a window of PLAYER_WINDOW_SIZE, the window is \
+				doubled as long as the rate is higher. */
 
-#define PLAYER_EQ_NFILT (4)		/**< No. Filters implementig EQ. */
+#define PLAYER_STFT_HOP (PLAYER_WINDOW_SIZE / 4) /**< Default frames \
+				between two spectra, up to 48 kHz. */
+#define PLAYER_STFT_FRAMES (256) /**< Last spectra kept by the analysis. */
+#define PLAYER_MAX_BARS (256) /**< Max no. bands of a spectogram. */
+#define PLAYER_BANDS_NBAR (70) /**< Default no. bands, linear. */
+#define PLAYER_BANDS_FMIN (20.0f) /**< Lower edge of the bands, but linear. */
+#define PLAYER_BANDS_FMAX (20000.0f) /**< Upper edge of the bands, but linear. */
+
+#define PLAYER_EQ_MAX_NFILT (EQ_MAX_NFILT) /**< Max no. bands of the EQ, \
+				those of the layout are Player_t.nband. */
 #define PLAYER_EQ_MAX_GAIN (15) /**< max gain in deciBel. */
+#define PLAYER_STREAM_LEN(freq) ((freq) / 32) /**< Frames of each buffer \
+						of the output stream, 1/32 s: a gain change is \
+						heard after the buffers already queued. */
+#define PLAYER_FILT_BLOCK (4096) /**< Max frames filtered at once. */
+#define PLAYER_EVQ_LEN (256) /**< Max events dispatched in a period, far
+				more than the controller can in a player period. */
+#define PLAYER_NOW (-1L) /**< Frame of an event applied as soon as possible. */
+#define PLAYER_NLANE (PLAYER_EQ_MAX_NFILT + 2) /**< Automation lanes: volume, \
+				gains and jumps. */
+#define PLAYER_LANE_LEN (1024) /**< Max points of an automation lane. */
+#define PLAYER_MAX_SPLICE (8) /**< Max jumps scheduled filtered and not \
+				heard yet. */
+
+#ifndef PLAYER_MEM_BUDGET
+#define PLAYER_MEM_BUDGET (4 << 20) /**< Default max bytes of the track kept \
+						in memory. */
+#endif
 
 /**
  * @brief	Signals by means of interact with the Player_t.
@@ -46,10 +79,15 @@ typedef enum
 			 		*	@param	value	volume value;
 			 		*/
 	JUMP_SIG,		/**< Jump to a specific play time. */
-	FILTLOW_SIG,	/**< Filter low frequencies (20Hz - 500Hz). */
-	FILTMED_SIG,	/**< Filter medium frequencies (500Hz - 2000Hz). */
-	FILTMEDHIG_SIG, /**< Filter medium-high frequencies (2000Hz - 8000Hz).*/
-	FILTHIG_SIG		/**< Filter high frequencies (8000Hz - 16000Hz). */
+	PRESET_SIG,		/**< Change the band layout of the EQ, all gains to 0. */
+	FILTLOW_SIG,	/**< Gain of the first band, FILTLOW_SIG + i of the
+					band i of the layout. With EQ_PRESET_PLAYER the first
+					band filters low frequencies (20Hz - 500Hz). */
+	FILTMED_SIG,	/**< Gain of the second band (500Hz - 2000Hz). */
+	FILTMEDHIG_SIG, /**< Gain of the third band (2000Hz - 8000Hz).*/
+	FILTHIG_SIG,	/**< Gain of the fourth band (8000Hz - 16000Hz). */
+	FILT_LAST_SIG = FILTLOW_SIG + PLAYER_EQ_MAX_NFILT - 1 /**< Gain of the
+					last band a layout can have. */
 } player_signal_t;
 
 /**
@@ -65,6 +103,7 @@ typedef struct
 	float val;			 /**< Volume value, in case sig = VOL_SIG;
 			 **< Frequencies gain value, in case sig = FILT*_SIG;
 			 **< Time to start play, in case sig = JUMP_SIG;
+			 **< An eq_preset_t, in case sig = PRESET_SIG;
 			 */
 } player_event_t;
 
@@ -83,6 +122,21 @@ typedef enum
 	FORWARD, /**< Reproducing faster. */
 } player_state_t;
 
+/**
+ * @brief	Signal whose spectograms are computed.
+ *
+ * Tracks of more than two channels are heard as a stereo downmix: the even
+ * channels to the left, the odd ones to the right. Mid and side are computed
+ * on that downmix, so that they match what is heard.
+ */
+typedef enum
+{
+	PLAYER_SPECT_MID,	  /**< (left + right) / 2, the only channel of a mono
+							track. */
+	PLAYER_SPECT_SIDE,	  /**< (left - right) / 2. */
+	PLAYER_SPECT_CHANNEL, /**< A single channel of the track. */
+} player_spect_t;
+
 typedef struct
 {
 	player_state_t state; /**< The player State. */
@@ -90,16 +144,27 @@ typedef struct
 	float time;			  /**< Actual reproducing time in sec. */
 	float duration;		  /**< Total track duration in sec. */
 	float time_data;	  /**< Timedata. */
-	int bits;			  /**< Bit depth of samples. */
-	float orig_spect[PLAYER_WINDOW_SIZE_CPX];
-	/**< Spectrogram of the original window. (not filtered song) */
-	float filt_spect[PLAYER_WINDOW_SIZE_CPX];
+	int bits;			  /**< Bit depth of samples, of the file. Samples of
+							more than 16 bits are played at 16 bits. */
+	int nch;			  /**< No. channels of the track. */
+	player_spect_t spect; /**< Signal of the spectograms. */
+	int spect_ch;		  /**< Channel, if spect is PLAYER_SPECT_CHANNEL. */
+	float orig_spect[PLAYER_MAX_BARS];
+	/**< Spectrogram of the original window. (not filtered song), a value
+	 * per band. At rates above PLAYER_WINDOW_FREQ only the bins up to about
+	 * 24 kHz are banded, with the same spacing as at lower rates. */
+	float filt_spect[PLAYER_MAX_BARS];
 	/**< Spectrogram of the reproducing window. (i.e. the filtered song) */
+	int nbar;			  /**< No. bands of the spectograms. */
+	bands_scale_t scale;  /**< Spacing of the bands. */
 	float dynamic_range;			/**< Decibel range of each spect. term.*/
 	float freq_spacing;				/**< Frequency spacing between each spect. 
 										term */
 	unsigned int volume;			/**< Reproducing volume [0-100]. */
-	float eq_gain[PLAYER_EQ_NFILT]; /**< gain at each frequency. */
+	int nband;						/**< No. bands of the EQ layout. */
+	eq_preset_t preset;				/**< Preset of the EQ layout. */
+	float eq_freq[PLAYER_EQ_MAX_NFILT]; /**< center frequency of each band. */
+	float eq_gain[PLAYER_EQ_MAX_NFILT]; /**< gain of each band. */
 } Player_t;
 
 /**
@@ -109,6 +174,38 @@ typedef struct
  */
 void player_init(const char *path) __attribute__((nonnull(1)));
 
+/**
+ * @brief set the memory budget of the track, before player_init
+ *
+ * WAV tracks are read from file in chunks, only the frames around the
+ * playhead are kept in memory, up to this budget. Other formats are loaded
+ * as a whole.
+ *
+ * @param bytes max bytes of the track in memory, PLAYER_MEM_BUDGET if never
+ * set
+ * @return int 0 on success, -1 on error
+ */
+int player_set_mem_budget(size_t bytes);
+
+/**
+ * @brief pin the player task to some CPUs, before player_start
+ *
+ * The audio is filtered and fed by the player task, so a CPU of its own,
+ * e.g. one isolated from the scheduler, keeps the other tasks from
+ * delaying it.
+ *
+ * @param cpus a bit for each CPU, 0 for any
+ */
+void player_set_affinity(unsigned long cpus);
+
+/**
+ * @brief set what the player task does after an overrun, before
+ * player_start
+ *
+ * @param overrun the policy, TASK_SKIP if never set
+ */
+void player_set_overrun(task_overrun_t overrun);
+
 /**
  * @brief start the player thread
  * 
@@ -117,12 +214,142 @@ void player_init(const char *path) __attribute__((nonnull(1)));
  */
 pthread_t *player_start(task_par_t *task_par);
 
+/**
+ * @brief start the spectrum analysis thread
+ *
+ * The analysis runs in its own periodic task, so it can be given a lower
+ * priority or a longer period than the player. It is stopped by player_exit.
+ *
+ * @param task_par    pointer to a struct definig task parameters(not mandatory)
+ * @return pthread_t* pointer to the thread identificator
+ */
+pthread_t *player_analysis_start(task_par_t *task_par);
+
+/**
+ * @brief select the window function used for the spectograms
+ *
+ * The table is computed the first time a window is selected, so it is
+ * better to call this out of the time critical threads. Spectrum levels are
+ * corrected by the coherent gain of the window.
+ *
+ * @param type window function
+ * @param beta shape parameter, used only by WIN_KAISER
+ * @return int 0 on success, -1 on error
+ */
+int player_set_window(window_type_t type, float beta);
+
+/**
+ * @brief set the analysis window and the hop between two spectra
+ *
+ * The track is analysed as it plays: a spectrum is computed every hop
+ * frames over the last size frames, zero padded to PLAYER_WINDOW_SIZE, so
+ * the bins are as many and as spaced whatever the size. Both are in frames
+ * up to PLAYER_WINDOW_FREQ, and scaled as the window at higher rates.
+ *
+ * @param size frames of the window, a power of 2 up to PLAYER_WINDOW_SIZE
+ * @param hop frames between two spectra, from 1 up to size
+ * @return int 0 on success, -1 on error
+ */
+int player_set_stft(int size, int hop);
+
+/**
+ * @brief set the bands the spectograms are made of
+ *
+ * The bins of each spectrum are averaged in bands by the analysis, through
+ * a table computed here once per layout, so the spectograms published and
+ * kept are a value per band. Linear bands span all the bins, the others
+ * PLAYER_BANDS_FMIN to PLAYER_BANDS_FMAX. The layout is taken by the
+ * analysis at its next period.
+ *
+ * @param scale spacing of the bands
+ * @param nbar no. bands, up to PLAYER_MAX_BARS, the max for third octaves
+ * @return int no. bands of the layout, -1 on error
+ */
+int player_set_bands(bands_scale_t scale, int nbar);
+
+/**
+ * @brief select the processing mode of the equalizer
+ *
+ * The linear phase mode is planned and designed the first time it is
+ * selected, so it is better to call this out of the time critical threads.
+ * The position played and the spectogram of the original track are moved
+ * back by the latency of the mode, so they stay in step with what is heard.
+ *
+ * @param mode the mode
+ * @return int 0 on success, -1 on error
+ */
+int player_set_eq_mode(eq_mode_t mode);
+
+/**
+ * @brief select the signal of the spectograms
+ *
+ * Only one spectogram of the original and one of the filtered track are
+ * computed, whatever the number of channels.
+ *
+ * @param spect signal, PLAYER_SPECT_MID by default
+ * @param ch channel, only if spect is PLAYER_SPECT_CHANNEL
+ * @return int 0 on success, -1 on error
+ */
+int player_set_spect(player_spect_t spect, int ch);
+
 /**
  * @brief dispatch an event to the player
+ *
+ * Events are queued with no lock, from any thread, and all of them are
+ * applied in order by the player at its next period. Consecutive events
+ * setting the volume, a gain or the time are merged into the last one.
+ * The caller never waits: when PLAYER_EVQ_LEN events are already queued in
+ * a period, the event is not queued and counted, the caller may dispatch it
+ * again later.
  * 
  * @param evt event to dispatch
+ * @return int 0 on success, -1 if the queue is full and the event dropped
  */
-void player_dispatch(player_event_t evt);
+int player_dispatch(player_event_t evt);
+
+/**
+ * @brief dispatch an event at a frame of the track
+ *
+ * The volume, the gains and the time are automated: the event is kept in
+ * the lane of its signal and applied at the exact frame, the blocks being
+ * filtered split there. Values are in effect from their frame on, going
+ * forward or backward, and jumps are done when the frame is played forward.
+ * Before the first point of a lane, or once it is cleared, the value is the
+ * last one set by player_dispatch(), or the default.
+ * The frames already filtered, about a stream buffer, are not filtered
+ * again, so the frame must be scheduled ahead of it to be exact.
+ *
+ * @param evt event to dispatch, VOL_SIG, JUMP_SIG or a FILT*_SIG
+ * @param frame frame of the track, PLAYER_NOW as player_dispatch()
+ * @return int 0 on success, -1 if the queue is full and the event dropped
+ */
+int player_dispatch_at(player_event_t evt, long frame);
+
+/**
+ * @brief replace the changes scheduled for a parameter
+ *
+ * The points are sorted by the caller in a staging lane allocated by
+ * player_init(), and handed over to the player in a single event, which
+ * swaps it with the lane at its next period. No memory is allocated. A
+ * point at the frame of another replaces it.
+ *
+ * @param sig VOL_SIG, JUMP_SIG or a FILT*_SIG
+ * @param frame frame of each point, in the track
+ * @param val value of each point, as the value of the event
+ * @param n no. points, up to PLAYER_LANE_LEN
+ * @return int 0 on success, -1 on error, when the queue is full or the
+ * last points given for the parameter are not taken by the player yet
+ */
+int player_automate_lane(player_signal_t sig, const long frame[],
+						 const float val[], int n);
+
+/**
+ * @brief remove all the points scheduled for a parameter
+ *
+ * @param sig VOL_SIG, JUMP_SIG or a FILT*_SIG
+ * @return int 0 on success, -1 if the signal is not automated
+ */
+int player_clear_lane(player_signal_t sig);
 
 /**
  * @brief shortcut for player_dispatch EXIT_SIG
@@ -185,6 +412,42 @@ void player_get_orig_spect(float *dst);
  */
 void player_get_filt_spect(float *dst);
 
+/**
+ * @brief get the no. spectograms computed since the start
+ *
+ * A spectogram of both the original and the equalized song is computed
+ * every hop frames played, and the last PLAYER_STFT_FRAMES are kept.
+ *
+ * @return long no. spectograms, the index of the next one
+ */
+long player_get_spect_count();
+
+/**
+ * @brief get a spectogram kept in the history
+ *
+ * @param filtered the spectogram of the equalized song, not the original
+ * @param i index of the spectogram, player_get_spect_count() - 1 the newest
+ * @param dst[out] PLAYER_MAX_BARS bands in the [0-100] range
+ * @return int no. bands of the spectogram, -1 if it is not kept
+ */
+int player_get_spect_frame(int filtered, long i, unsigned char dst[]);
+
+/**
+ * @brief get the spectogram of the unequalized song at any time
+ *
+ * The spectra of the mid of the whole song are computed in background the
+ * first time it is played, with the current window and hop, and kept in
+ * files read at no cost the next times. Levels are below full scale, not
+ * normalized as the spectograms. Not thread safe, called by the view only.
+ *
+ * @param t time in seconds
+ * @param dst[out] PLAYER_MAX_BARS bands in the [0-100] range, as the
+ * spectograms
+ * @return int no. bands, -1 if the spectra are not ready yet or t is
+ * out of the song
+ */
+int player_get_overview(float t, unsigned char dst[]);
+
 /**
  * @brief get the dynamic range
  * 
@@ -209,15 +472,45 @@ unsigned int player_get_volume();
 /**
  * @brief get the gains of the filters of the equalizer
  * 
- * @param dst 
+ * @param dst a gain per band, PLAYER_EQ_MAX_NFILT: those past the layout
+ * are 0
  */
 void player_get_eq_gain(float dst[]);
 
+/**
+ * @brief get the number of bands of the layout of the equalizer
+ *
+ * It changes with PRESET_SIG.
+ *
+ * @return int
+ */
+int player_get_nband();
+
+/**
+ * @brief get the preset of the layout of the equalizer
+ *
+ * @return eq_preset_t
+ */
+eq_preset_t player_get_preset();
+
 /**
  * @brief get a full copy of the player
- * 
+ *
+ * Getters take no lock: scalars are loaded atomically and the spectograms
+ * copied again when the analysis wrote them meanwhile, so the player never
+ * waits for the readers and a copy is never torn.
+ *
  * @param dst 
  */
 void player_get_player(Player_t *dst);
 
+/**
+ * @brief get the contention of the readers of the spectograms
+ *
+ * @param nread[out] copies of spectograms, can be NULL
+ * @param nretry[out] copies made again since the analysis was writing, can
+ * be NULL
+ */
+void player_get_contention(unsigned long *nread, unsigned long *nretry);
+
 #endif /* PLAYER_H_ */
@@ -0,0 +1,97 @@
+/**
+ * @file render.h
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief headless rendering of equalized tracks to WAV files
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * Tracks are read, equalized and written as fast as the CPU allows, with no
+ * audio device and no window. The output has the format, channels and rate
+ * of the track; tracks loaded by Allegro are written as 8 or 16 bits WAV.
+ * The equalizer is a single instance per process, so a batch runs a process
+ * per worker, each taking the next file of the list until none is left.
+ * A single long track can be split in chunks rendered by a process each.
+ * The state of the bands at the start of a chunk is not known, so each
+ * chunk is warmed up by equalizing the frames before it, until the wrong
+ * state has faded out, and the error left at each stitch is measured.
+ */
+#ifndef RENDER_H_
+#define RENDER_H_
+
+#include <stddef.h>
+
+#include "player/equalizer.h"
+
+#define RENDER_BLOCK (16384) /**< Frames equalized at once. */
+#define RENDER_MEM_BUDGET (16 << 20) /**< Bytes of a track read ahead. */
+#define RENDER_SPLIT_ERR (1.0f / 1024) /**< Max difference between a split \
+				and a whole render at a stitch, relative to the peak there: \
+				the rounding of the bands alone leaves about 1e-4. */
+#define RENDER_VERIFY (4096) /**< Frames compared at each stitch. */
+
+/**
+ * @brief	Settings of a render.
+ */
+typedef struct
+{
+	float gain[EQ_NFILT]; /**< Gain of each band of the player, in dB. */
+	size_t budget;		  /**< Bytes of each track read ahead. */
+	int nsplit;			  /**< Chunks each track is split in, 1 or less to
+							render it whole. */
+} render_opts_t;
+
+/**
+ * @brief	Outcome of the render of a track.
+ */
+typedef struct
+{
+	int status;	  /**< 0 if rendered, -1 on error. */
+	long frames;  /**< Frames rendered. */
+	double audio; /**< Seconds of audio rendered. */
+	double wall;  /**< Seconds taken. */
+	int nsplit;	  /**< Chunks rendered in parallel. */
+	double speedup; /**< Speedup of the chunks, over the time the whole
+						track takes at the speed of each chunk. */
+	float err;	  /**< Max difference at the stitches, relative to their
+						peak, measured against the previous chunk
+						equalized past its end. */
+} render_stats_t;
+
+/**
+ * @brief render a track to a WAV file
+ *
+ * The file is written next to its final path and renamed at the end, so a
+ * failed or interrupted render leaves no partial output. With more than one
+ * chunk, fewer are used if the track is too short for them to be worth the
+ * warm up, and the render fails if a stitch differs more than
+ * RENDER_SPLIT_ERR.
+ *
+ * @param in path of the track
+ * @param out path of the WAV file to write
+ * @param opts settings
+ * @param st[out] outcome, NULL if not needed
+ * @return int 0 on success, -1 on error
+ */
+int render_file(const char *in, const char *out, const render_opts_t *opts,
+				render_stats_t *st);
+
+/**
+ * @brief render a list of tracks in a directory, in parallel
+ *
+ * Each track is written in the directory with its name and a .wav
+ * extension, and a line of statistics is printed for each one. Tracks that
+ * are split are rendered one at a time, their chunks in parallel. Nothing
+ * is rendered if two tracks have the same name, e.g. from two directories.
+ *
+ * @param in paths of the tracks
+ * @param n no. tracks
+ * @param dir output directory
+ * @param opts settings
+ * @param nworker no. tracks rendered at once, 0 for one per online CPU
+ * @param st[out] outcome of each track, n entries, NULL if not needed
+ * @return int no. tracks not rendered, -1 if the batch could not start
+ */
+int render_batch(const char *const in[], int n, const char *dir,
+				 const render_opts_t *opts, int nworker, render_stats_t st[]);
+
+#endif /* RENDER_H_ */
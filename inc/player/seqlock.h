@@ -0,0 +1,90 @@
+/**
+ * @file seqlock.h
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief publication of data by one writer to many readers, with no lock
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * The data is kept in two copies, and the sequence tells the readers which
+ * one to copy: the writer moves them to the other copy before writing one,
+ * so the copy they read is never written while the writer is preempted. A
+ * reader copies the data again only if the sequence changed meanwhile, and
+ * never waits for the writer, whatever their priorities. Retries are
+ * counted, a measure of the contention.
+ *
+ *	for (int k = 0; k < 2; k++)
+ *	{
+ *		i = seqlock_write_begin(&s);
+ *		...update copy i...
+ *		seqlock_write_end(&s);
+ *	}
+ *
+ *	do
+ *		seq = seqlock_read_begin(&s, &i);
+ *		...copy copy i...
+ *	while (seqlock_read_retry(&s, seq));
+ */
+#ifndef SEQLOCK_H_
+#define SEQLOCK_H_
+
+#define SEQLOCK_LINE 64 /**< Bytes of a cache line. */
+
+typedef struct
+{
+	unsigned int seq __attribute__((aligned(SEQLOCK_LINE)));
+	/**< Written by the writer only, copy seq & 1 is read. */
+	unsigned long nread __attribute__((aligned(SEQLOCK_LINE)));
+	/**< Copies completed, on a line of the readers. */
+	unsigned long nretry; /**< Copies started again. */
+} seqlock_t;
+
+#define SEQLOCK_INITIALIZER {0, 0, 0}
+
+/**
+ * @brief start writing a copy of the data, by one thread only
+ *
+ * The readers are moved to the other copy, which must be whole: both
+ * copies are written in turn.
+ *
+ * @param s the lock
+ * @return int the copy to write, 0 or 1
+ */
+int seqlock_write_begin(seqlock_t *s);
+
+/**
+ * @brief end writing a copy of the data
+ *
+ * @param s the lock
+ */
+void seqlock_write_end(seqlock_t *s);
+
+/**
+ * @brief start copying the data
+ *
+ * @param s the lock
+ * @param copy[out] the copy to read, 0 or 1
+ * @return unsigned int the sequence to pass to seqlock_read_retry()
+ */
+unsigned int seqlock_read_begin(seqlock_t *s, int *copy);
+
+/**
+ * @brief check a copy of the data
+ *
+ * @param s the lock
+ * @param seq the sequence returned by seqlock_read_begin()
+ * @return int 1 if the copy read may have been written during the copy,
+ * which must be done again, 0 if the copy is whole
+ */
+int seqlock_read_retry(seqlock_t *s, unsigned int seq);
+
+/**
+ * @brief get the counters of the readers
+ *
+ * @param s the lock
+ * @param nread[out] copies completed, can be NULL
+ * @param nretry[out] copies started again, can be NULL
+ */
+void seqlock_get_stats(const seqlock_t *s, unsigned long *nread,
+					   unsigned long *nretry);
+
+#endif /* SEQLOCK_H_ */
@@ -0,0 +1,148 @@
+/**
+ * @file source.h
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief audio track mapped from file, or read in chunks into a bounded ring
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * WAV files are never loaded as a whole. They are mapped in memory and the
+ * PCM data are converted to floats in place, so opening does not depend on
+ * the length of the track and the page cache is shared with any other
+ * process playing the same file. The kernel is told which frames are going
+ * to be read around the playhead, within a window set by a memory budget.
+ * When the file cannot be mapped, the same window is read into a ring.
+ * Other formats are loaded by Allegro and kept all in memory.
+ * Frames are kept in the format of the file, with their conversion kernels.
+ */
+#ifndef SOURCE_H_
+#define SOURCE_H_
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "player/convert.h"
+
+#define SOURCE_CHUNK (64 * 1024) /**< Min bytes read from the file, or
+										advised, at once. */
+
+/**
+ * @brief	Audio track.
+ *
+ * The window [lo, hi) holds at most cap frames. For a ring, these are the
+ * frames that can be read, frame f being in the slot f % cap. For a track
+ * in memory or mapped, every frame can be read from pcm and the window is
+ * the one advised to the kernel. Only one thread may prefetch, any thread
+ * may read.
+ */
+typedef struct
+{
+	int bits;			   /**< Bits per sample. */
+	int nch;			   /**< No. channels. */
+	int freq;			   /**< Sampling frequency. */
+	long len;			   /**< No. frames of the track. */
+	int fsize;			   /**< Bytes per frame. */
+	int fd;				   /**< WAV file, -1 if the track is in memory. */
+	off_t data;			   /**< Offset of the PCM data in the file. */
+	uint8_t *map;		   /**< Mapping of the file, NULL if not mapped. */
+	size_t map_len;		   /**< Bytes mapped. */
+	const uint8_t *pcm;	   /**< All the frames, NULL if read in the ring. */
+	uint8_t *ring;		   /**< Frames of the window, if read from file. */
+	long cap;			   /**< Max frames of the window. */
+	long lo, hi;		   /**< Frames of the track in the window. */
+	int random;			   /**< Last access was a jump. */
+	long seek;			   /**< Frame of a jump not advised yet, or -1. */
+	int async;			   /**< Hints of a mapping left to source_advise(). */
+	long adv_lo, adv_hi;   /**< Window advised to the kernel. */
+	int adv_random;		   /**< Random access advised to the kernel. */
+	void *smpl;			   /**< Allegro SAMPLE, for a track in memory. */
+	const convert_t *conv; /**< Conversion kernels of the format. */
+	pthread_mutex_t mutex; /**< Protects lo, hi, random and seek, priority
+								inheriting. */
+} source_t;
+
+/**
+ * @brief open a track
+ *
+ * @param s[out] the track
+ * @param path path of the audio file
+ * @param budget max bytes of the window, WAV files only
+ * @return int 0 on success, -1 on error
+ */
+int source_open(source_t *s, const char *path, size_t budget);
+
+/**
+ * @brief leave the hints of a mapping to source_advise()
+ *
+ * madvise() and posix_fadvise() can block, so a real time thread that
+ * prefetches has another thread give them, and fault the pages ahead.
+ *
+ * @param s[inout] the track
+ * @param async 1 to leave them to source_advise(), 0 to give them at once
+ */
+void source_set_async(source_t *s, int async);
+
+/**
+ * @brief give the kernel the hints of the last prefetches and seek
+ *
+ * The pages the window left are released, the ones it entered are read
+ * ahead and touched, so that the thread that prefetches does not fault on
+ * them. Called periodically by one thread, not the one that prefetches,
+ * when the hints are asynchronous; it does nothing for a ring.
+ *
+ * @param s[inout] the track
+ */
+void source_advise(source_t *s);
+
+/**
+ * @brief make sure that some frames are in the window
+ *
+ * The window is extended by at least SOURCE_CHUNK bytes in the direction it
+ * moves, and frames on the other side are dropped to make room. A ring reads
+ * the new frames from file, a mapping asks the kernel to read them ahead and
+ * releases the pages dropped, at once or by source_advise().
+ *
+ * @param s[inout] the track
+ * @param from first frame needed
+ * @param to one past the last frame needed, to - from <= cap
+ * @return int 0 on success, -1 on error
+ */
+int source_prefetch(source_t *s, long from, long to);
+
+/**
+ * @brief tell that the track is going to be read from another position
+ *
+ * Readahead of the mapping is disabled, as the pages around the old position
+ * are not going to be read, and the frames from the new position are asked
+ * at once, or by source_advise(). The next prefetch restores sequential
+ * readahead.
+ *
+ * @param s[inout] the track
+ * @param frame new position
+ */
+void source_seek(source_t *s, long frame);
+
+/**
+ * @brief convert frames of the track to floats
+ *
+ * Frames outside the track, or not in the ring, are read as silence. Frames
+ * of a mapping are always read, waiting for the disk if they are not in the
+ * page cache yet.
+ *
+ * @param s[in] the track
+ * @param off first frame
+ * @param count no. frames
+ * @param buf[out] count floats
+ * @return int no. frames read from the track
+ */
+int source_read(source_t *s, long off, unsigned int count, float *buf);
+
+/**
+ * @brief close the track and free its memory
+ *
+ * @param s[inout] the track
+ */
+void source_close(source_t *s);
+
+#endif /* SOURCE_H_ */
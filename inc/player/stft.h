@@ -0,0 +1,93 @@
+/**
+ * @file stft.h
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief streaming short time Fourier transform
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * Samples are pushed as they come, in blocks of any size, and a frame is
+ * transformed every hop samples over the last window of samples. Each
+ * sample is stored once and windowed once for each frame it is in, never
+ * converted again. Frames are kept in a ring, as magnitudes corrected by
+ * the coherent gain of the window, with the position they end at.
+ */
+#ifndef STFT_H_
+#define STFT_H_
+
+#include <fftw3.h>
+
+#include "player/window.h"
+
+/**
+ * @brief	Streaming STFT of a signal.
+ */
+typedef struct
+{
+	int nfft;			 /**< Samples of a transform, the window zero padded. */
+	int size;			 /**< Samples of the window. */
+	int hop;			 /**< Samples between two frames. */
+	int nbin;			 /**< Bins of a frame, nfft / 2 + 1. */
+	const window_t *win; /**< Window function, of size samples. */
+	float corr;			 /**< Coherent gain correction of the magnitudes. */
+	float *in;			 /**< Last samples pushed, up to size. */
+	int fill;			 /**< Samples in in. */
+	float *tmp;			 /**< Windowed frame, zero padded. */
+	fftwf_complex *cpx;	 /**< Spectrum of the frame. */
+	int nframe;			 /**< Frames in the ring. */
+	float *ring;		 /**< Magnitudes of the frames, nbin each. */
+	long *end;			 /**< Position after the last sample of each frame. */
+	long pos;			 /**< Position of the next sample pushed. */
+	long count;			 /**< Frames computed since the last reset. */
+} stft_t;
+
+/**
+ * @brief initialize a STFT
+ *
+ * The transform of nfft samples must have been planned with fft_plan().
+ *
+ * @param s[out] the STFT
+ * @param nfft samples of a transform
+ * @param win window function, its size is the window, at most nfft
+ * @param hop samples between two frames, at most the window
+ * @param nframe frames kept in the ring
+ * @return int 0 on success, -1 on error
+ */
+int stft_init(stft_t *s, int nfft, const window_t *win, int hop, int nframe);
+
+/**
+ * @brief release the buffers of a STFT
+ *
+ * @param s the STFT
+ */
+void stft_destroy(stft_t *s);
+
+/**
+ * @brief drop the samples pushed and the frames, restart from a position
+ *
+ * @param s[inout] the STFT
+ * @param pos position of the next sample pushed
+ */
+void stft_reset(stft_t *s, long pos);
+
+/**
+ * @brief push samples, computing the frames they complete
+ *
+ * @param s[inout] the STFT
+ * @param x samples
+ * @param count no. samples
+ * @return int no. frames computed
+ */
+int stft_push(stft_t *s, const float x[], int count);
+
+/**
+ * @brief get a frame from the ring
+ *
+ * @param s the STFT
+ * @param i index of the frame since the last reset, count - 1 the newest
+ * @param end[out] position after its last sample, NULL if not needed
+ * @return const float* nbin magnitudes, NULL if the frame is not in the
+ * ring
+ */
+const float *stft_frame(const stft_t *s, long i, long *end);
+
+#endif /* STFT_H_ */
@@ -0,0 +1,73 @@
+/**
+ * @file window.h
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief precomputed window functions for the spectrum analysis
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * Window tables are computed once per (type, size, beta) and kept for the
+ * whole program life, so they can be switched at runtime and applied with
+ * a single multiplication per sample.
+ */
+#ifndef WINDOW_H_
+#define WINDOW_H_
+
+#define WINDOW_ALIGN 64		  /**< Tables alignment in bytes (cache line). */
+#define WINDOW_MAX_TABLES 16 /**< Max no. different tables. */
+
+/**
+ * @brief	Available window functions.
+ */
+typedef enum
+{
+	WIN_HANN,			 /**< Hann (raised cosine). */
+	WIN_HAMMING,		 /**< Hamming. */
+	WIN_BLACKMAN_HARRIS, /**< 4-term Blackman-Harris. */
+	WIN_FLATTOP,		 /**< 5-term flat-top, accurate amplitudes. */
+	WIN_KAISER,			 /**< Kaiser, shaped by beta. */
+	WIN_NTYPE			 /**< No. window types. */
+} window_type_t;
+
+/**
+ * @brief	A precomputed window table and its corrections.
+ *
+ * The coherent gain is the mean of the window: dividing the magnitude of a
+ * bin by size * cg / 2 gives the amplitude of a sinusoid, whatever the
+ * window. The equivalent noise bandwidth, in bins, is the correction for
+ * broadband (noise) power measurements.
+ */
+typedef struct
+{
+	window_type_t type; /**< Window function. */
+	int size;			/**< No. samples. */
+	float beta;			/**< Kaiser shape parameter, 0 for the others. */
+	float *w;			/**< Coefficients, WINDOW_ALIGN aligned. */
+	float cg;			/**< Coherent gain. */
+	float enbw;			/**< Equivalent noise bandwidth in bins. */
+} window_t;
+
+/**
+ * @brief get the window table of the given kind, computing it only the
+ * first time it is requested
+ *
+ * @param type window function
+ * @param size no. samples of the window
+ * @param beta Kaiser shape parameter, ignored by the other windows
+ * @return const window_t* the table, NULL on error
+ */
+const window_t *window_get(window_type_t type, int size, float beta);
+
+/**
+ * @brief multiply a buffer by a window
+ *
+ * @param win window table
+ * @param buf[inout] win->size samples of time data
+ */
+void window_apply(const window_t *win, float buf[]);
+
+/**
+ * @brief release all the computed tables
+ */
+void window_xtor();
+
+#endif /* WINDOW_H_ */
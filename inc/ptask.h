@@ -23,12 +23,83 @@
  *		wait_for_period(tp);
  *	}
  * }
+ *
+ * task_start() runs this scheme for a body called at each activation, in a
+ * thread scheduled by SCHED_FIFO at the priority of the task, on its CPUs.
+ * Under SCHED_DEADLINE instead, the kernel reserves the task wcet every
+ * period, and throttles it past that, so an overrunning task cannot starve
+ * the others.
  */
 #ifndef PTASK_H_
 #define PTASK_H_
 
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include <stdio.h>
 #include <time.h>
 
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE 6 /**< Policy of sched_setattr(), missing in older C
+							libraries. */
+#endif
+
+#define TASK_STACK (256 * 1024) /**< Default stack bytes of a task. */
+#define TASK_HIST_SUB 8			/**< Buckets per power of 2, 12.5% wide. */
+#define TASK_HIST_LEN 184 /**< Buckets, the last from 2^24 us, 16 s, up. */
+
+/**
+ * @brief	Histogram of times in us, written by a thread at once and read by
+ *		any with no lock.
+ *
+ * Times below TASK_HIST_SUB us have a bucket each, the others TASK_HIST_SUB
+ * buckets per power of 2, so a percentile is known within 12.5%.
+ */
+typedef struct
+{
+	unsigned long count;				 /**< No. times. */
+	long min;							 /**< Shortest time. */
+	long max;							 /**< Longest time. */
+	unsigned long bucket[TASK_HIST_LEN]; /**< No. times of each bucket. */
+} task_hist_t;
+
+/**
+ * @brief	Summary of a histogram, percentiles rounded up to their bucket.
+ */
+typedef struct
+{
+	unsigned long count; /**< No. times. */
+	long min;			 /**< Shortest time in us. */
+	long p50;			 /**< Median in us. */
+	long p99;			 /**< 99th percentile in us. */
+	long p999;			 /**< 99.9th percentile in us. */
+	long max;			 /**< Longest time in us. */
+} task_summary_t;
+
+/**
+ * @brief	What a task does after an overrun, when an activation is due
+ *		before the previous one ends.
+ */
+typedef enum
+{
+	TASK_SKIP,	   /**< The activations missed are skipped, the next one is
+						at the same phase. */
+	TASK_CATCH_UP, /**< The activations missed run back to back. */
+	TASK_REPHASE   /**< The next activation is now, and the following ones
+						a period apart from it. */
+} task_overrun_t;
+
+/**
+ * @brief	Scheduling policy of a task.
+ */
+typedef enum
+{
+	TASK_SCHED_DEFAULT, /**< The one set by task_set_sched(). */
+	TASK_FIFO,			/**< SCHED_FIFO at the priority of the task. */
+	TASK_DEADLINE		/**< SCHED_DEADLINE, a runtime of wcet every period
+							by the deadline. */
+} task_sched_t;
+
 /**
  * @brief 	It provides all variable need for periodic tasks
  *
@@ -37,16 +108,29 @@
  * defined in this library to obtain a periodic task behaviour.
  * NOTE: A structure for each thread is required.
  */
-typedef struct
+typedef struct task_par
 {
 	int arg;			/**< Task argument. */
-	long int wcet;		/**< Worst case execution time in us. */
+	long int wcet;		/**< Worst case execution time in us, the runtime
+							reserved under TASK_DEADLINE. The longest
+							observed is exec.max. */
 	int period;			/**< Period in ms. */
 	int deadline;		/**< Relative deadline in ms. */
 	int priority;		/**< Task priority in [0; 99]. */
 	int dmiss;			/**< No. of deadline misses. */
 	struct timespec at; /**< next activation time. */
 	struct timespec dl; /**< absolute deadline. */
+	const char *name;	/**< Name in the messages, NULL for none. */
+	unsigned long cpus; /**< CPUs the task runs on, a bit each, 0 for any. */
+	size_t stack;		/**< Stack bytes, 0 for TASK_STACK. */
+	task_overrun_t overrun; /**< Activations after an overrun. */
+	long skipped;		/**< No. of activations skipped. */
+	task_sched_t sched; /**< Policy, set to the one obtained once started. */
+	task_hist_t jitter; /**< Start of each activation after its release. */
+	task_hist_t response; /**< End of each activation after its release. */
+	task_hist_t exec;	/**< CPU time of each activation. */
+	int (*body)(struct task_par *tp); /**< Body of an activation, it returns
+						not 0 to end the task. */
 } task_par_t;
 
 /**
@@ -68,4 +152,58 @@ int deadline_miss(task_par_t *tp);
  */
 void wait_for_period(task_par_t *tp);
 
+/**
+ * @brief	set the policy of the tasks started afterwards with no policy of
+ *		their own, TASK_FIFO until set.
+ * @param[in]	sched	the policy, TASK_FIFO or TASK_DEADLINE.
+ */
+void task_set_sched(task_sched_t sched);
+
+/**
+ * @brief	set how often the statistics of every task are printed.
+ * @param[in]	ms	period of the print in ms, 0 for none, the default.
+ */
+void task_set_dump(int ms);
+
+/**
+ * @brief	add a time to a histogram, by its only writer.
+ * @param[inout]	h	the histogram.
+ * @param[in]	us	the time in us, 0 if negative.
+ */
+void task_hist_add(task_hist_t *h, long us);
+
+/**
+ * @brief	summarize a histogram, while it is written too.
+ * @param[in]	h	the histogram.
+ * @param[out]	s	the summary, all 0 for no time.
+ */
+void task_hist_summary(const task_hist_t *h, task_summary_t *s);
+
+/**
+ * @brief	print the statistics of a task, while it runs too.
+ * @param[in]	tp	the task.
+ * @param[in]	f	the stream.
+ */
+void task_dump(const task_par_t *tp, FILE *f);
+
+/**
+ * @brief	start a periodic task.
+ *
+ * The stack is allocated with the size of the task, as small as it can be:
+ * when the memory is locked every page of it is resident. It is touched
+ * before the first activation, so the body never faults on it. Without the
+ * privilege of real time scheduling the task runs at normal priority.
+ * A task under SCHED_DEADLINE is started under SCHED_FIFO, and stays there
+ * when the kernel does not admit it: for lack of bandwidth, of privilege,
+ * when pinned to some CPUs only or with no wcet.
+ * Every activation, the jitter, response and execution times are added to
+ * the statistics of the task, printed when it ends if it has a name.
+ *
+ * @param[out]	tid	identifier of the thread.
+ * @param[in]	body	body of each activation, until it returns not 0.
+ * @param[inout]	tp	parameters of the task, kept by the thread.
+ * @ret		0 on success, -1 on error.
+ */
+int task_start(pthread_t *tid, int (*body)(task_par_t *tp), task_par_t *tp);
+
 #endif
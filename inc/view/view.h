@@ -22,6 +22,18 @@
  */
 void view_init();
 
+/**
+ * @brief show the spectograms as time-frequency color maps
+ *
+ * Each spectogram computed by the player is a column of its panel, the
+ * newest on the right, higher frequencies on top and louder bins brighter.
+ * Instead, by default, the panels show the last spectogram as bars.
+ * It must be called before view_init().
+ *
+ * @param on 1 for the color maps, 0 for the bars
+ */
+void view_set_spect_map(int on);
+
 /**
  * @brief start the view thread
  * 
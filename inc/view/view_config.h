@@ -88,7 +88,9 @@ extern int nodes_size[NPANEL];
 #define EQLZP_COL WHITE
 #define EQLZP_BGCOL BLACK
 
-#define EQLZP_NNOD 23
+#define EQLZP_NNOD 24
+#define EQLZP_NBAR 4 /**< Bars of the gains, the bar b has the signal \
+				FILTLOW_SIG + b and sets a group of bands of the layout. */
 
 #define EQLZP_FRAME 0
 #define EQLZP_SEP1 1
@@ -113,6 +115,7 @@ extern int nodes_size[NPANEL];
 #define MHFRQ_GAIN_LBL 20
 #define HFRQ_GAIN_LBL 21
 #define VOL_VAL_LBL 22
+#define EQ_PRESET_LBL 23
 
 /*******************************************************************************
  *			TITLE PANEL
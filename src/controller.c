@@ -34,10 +34,12 @@
 
 static task_par_t tp = {
 	arg : 0,
+	wcet : 5000,
 	period : 50,
 	deadline : 50,
 	priority : 99,
-	dmiss : 0
+	dmiss : 0,
+	name : "CONTROLLER",
 }; /**< default controller task parameters. */
 
 static pthread_t tid; /**< thread identifier of the controller. */
@@ -47,7 +49,12 @@ static char _controller_exit = 0; /**< variable to notice the thread that
 static pthread_mutex_t _controller_exit_mutex =
 	PTHREAD_MUTEX_INITIALIZER; /**< mutex for the _player_exit variable*/
 
-static void *controller_run(void *arg);
+static player_event_t pending[FILT_LAST_SIG + 1]; /**< Events the player
+				had no room for, dispatched again the next period: the last one
+				of each parameter, and of the transport, EMPTY_SIG for none. */
+static int npending; /**< No. events pending. */
+
+static int controller_run(task_par_t *arg);
 static void controller_xtor();
 
 /**
@@ -60,6 +67,44 @@ static void controller_xtor();
  */
 static void control(Node *n, int x, int y);
 
+/**
+ * @brief dispatch an event to the player, or keep it for the next period
+ *
+ * While some events are pending the new ones wait too, not to overtake
+ * them. A pending event is replaced by the next one of the same parameter,
+ * and the transport buttons by the last one pressed, as the player would.
+ *
+ * @param evt the event
+ */
+static void controller_dispatch(player_event_t evt)
+{
+	int k = (evt.sig >= STOP_SIG && evt.sig <= FRWD_SIG) ? STOP_SIG : evt.sig;
+
+	if (evt.sig == EMPTY_SIG)
+		return;
+	if (npending == 0 && player_dispatch(evt) == 0)
+		return;
+	if (pending[k].sig == EMPTY_SIG)
+		npending++;
+	pending[k] = evt;
+}
+
+/**
+ * @brief dispatch again the events pending, as long as the player has room
+ */
+static void controller_retry()
+{
+	for (int k = 0; k <= FILT_LAST_SIG && npending > 0; k++)
+	{
+		if (pending[k].sig == EMPTY_SIG)
+			continue;
+		if (player_dispatch(pending[k]) < 0)
+			return;
+		pending[k].sig = EMPTY_SIG;
+		npending--;
+	}
+}
+
 /**
  * @brief manage the event raised by a click
  * 
@@ -70,18 +115,29 @@ static void control(Node *n, int x, int y);
 static void control(Node *n, int x, int y)
 {
 	player_event_t evt;
+	int b, nband;
+
 	switch (n->evt)
 	{
 	case JUMP_SIG:
 		evt.val = player_get_duration() * ((float)(x - n->x)) / (float)n->w;
 		break;
 	case FILTLOW_SIG:
-	case FILTMED_SIG:
-	case FILTMEDHIG_SIG:
-	case FILTHIG_SIG:
+	case FILTLOW_SIG + 1:
+	case FILTLOW_SIG + 2:
+	case FILTLOW_SIG + 3:
 		evt.val = -(PLAYER_EQ_MAX_GAIN * 2) *
 					  ((float)(y - n->y)) / (float)n->h +
 				  PLAYER_EQ_MAX_GAIN;
+		// a bar sets its group of bands, as many as the layout has
+		b = n->evt - FILTLOW_SIG;
+		nband = player_get_nband();
+		for (int i = b * nband / EQLZP_NBAR; i < (b + 1) * nband / EQLZP_NBAR;
+			 i++)
+			controller_dispatch((player_event_t){FILTLOW_SIG + i, evt.val});
+		return;
+	case PRESET_SIG:
+		evt.val = (player_get_preset() + 1) % EQ_NPRESET;
 		break;
 	case VOL_SIG:
 		evt.val = 100 * ((float)(n->y + n->h - y)) / (float)n->h;
@@ -90,7 +146,7 @@ static void control(Node *n, int x, int y)
 		break;
 	}
 	evt.sig = n->evt;
-	player_dispatch(evt);
+	controller_dispatch(evt);
 }
 
 /**
@@ -122,85 +178,68 @@ void controller_init()
  */
 pthread_t *controller_start(task_par_t *task_par)
 {
-	struct sched_param mypar;
-	pthread_attr_t attr;
-
 	if (task_par != NULL)
 		tp = *task_par;
 
-	pthread_attr_init(&attr);
-	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
-	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
-	mypar.sched_priority = tp.priority;
-	pthread_attr_setschedparam(&attr, &mypar);
-	pthread_create(&tid, &attr, controller_run, &tp);
+	task_start(&tid, controller_run, &tp);
 
 	return &tid;
 }
 
 /**
- * @brief controller thread routine
+ * @brief controller task body, a period
  * 
- * @param arg pointer to the argument passed to the routine(actually task 
- * paramenters)
- * @return void* pointer to the returned variable of the routine
+ * @param arg parameters of the task
+ * @return int 0 to go on, 1 once the controller has exited
  */
-static void *controller_run(void *arg)
+static int controller_run(task_par_t *arg)
 {
 	int pos, x, y; /**< coordinates of user click. */
 	int i, j;	  /**<array indexes. */
 	char found;
 	/**< bool value, true when the clicked graphic object has been found. */
 
-	set_period(&tp);
-
-	while (1)
-	{
-		{ // exit
-			char local_control_exit;
-			pthread_mutex_lock(&_controller_exit_mutex);
-			local_control_exit = _controller_exit;
-			pthread_mutex_unlock(&_controller_exit_mutex);
-			if (_controller_exit)
-			{
-				pthread_exit(NULL);
-				controller_xtor();
-			}
+	{ // exit
+		char local_control_exit;
+		pthread_mutex_lock(&_controller_exit_mutex);
+		local_control_exit = _controller_exit;
+		pthread_mutex_unlock(&_controller_exit_mutex);
+		if (local_control_exit)
+		{
+			controller_xtor();
+			return 1;
 		}
+	}
 
-		if (mouse_needs_poll())
-			poll_mouse();
-		//check for user clicks
-		if (mouse_b & 1)
+	// the events the player had no room for, before the new ones
+	controller_retry();
+	if (mouse_needs_poll())
+		poll_mouse();
+	//check for user clicks
+	if (mouse_b & 1)
+	{
+		pos = mouse_pos;
+		x = pos >> 16;
+		y = pos & 0x0000ffff;
+		found = FALSE;
+		for (i = 0; i < NPANEL && !found; i++)
 		{
-			pos = mouse_pos;
-			x = pos >> 16;
-			y = pos & 0x0000ffff;
-			found = FALSE;
-			for (i = 0; i < NPANEL && !found; i++)
+			if (is_inside(&(nodes[i][0]), x, y))
 			{
-				if (is_inside(&(nodes[i][0]), x, y))
+				for (j = 1; j < nodes_size[i] && !found; j++)
 				{
-					for (j = 1; j < nodes_size[i] && !found; j++)
+					if (is_inside(&nodes[i][j], x, y))
 					{
-						if (is_inside(&nodes[i][j], x, y))
-						{
-							control(&nodes[i][j], x, y);
-							found = TRUE;
-						}
+						control(&nodes[i][j], x, y);
+						found = TRUE;
 					}
 				}
 			}
-			mouse_b = 0;
-		}
-
-		if (deadline_miss(&tp))
-		{
-			printf("VIEW MISS");
 		}
-		wait_for_period(&tp);
+		mouse_b = 0;
 	}
-	return NULL;
+
+	return 0;
 }
 
 /**
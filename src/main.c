@@ -1,15 +1,183 @@
+#include <errno.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
 #include <unistd.h>
 
 #include <allegro.h>
 
 #include "controller.h"
 #include "player/player.h"
+#include "ptask.h"
+#include "player/render.h"
 #include "view/view.h"
 
+#define RENDER_MAX_PARALLEL 1024 /**< Max workers or chunks of a render. */
+
 #define NULL ((void *)0)
 
+static void usage()
+{
+    printf("usage ./player [-m] [-e] [-s] [-c <cpu>,...] "
+           "[-o skip|catch|rephase] <song_file_path> [memory_budget_MiB]\n"
+           "      ./player -r <output_dir> [-g <gain_dB>,...] [-j <workers>] "
+           "[-k <chunks>] <song_file_path>...\n");
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief parse a whole number in a range, print the usage otherwise
+ */
+static int parse_int(const char *s, int min, int max)
+{
+    char *end;
+    long n;
+
+    errno = 0;
+    n = strtol(s, &end, 10);
+    if (end == s || *end != '\0' || errno != 0 || n < min || n > max)
+        usage();
+    return n;
+}
+
+/**
+ * @brief render the tracks with no audio device and no window
+ *
+ * @return int exit status, failure if any track is not rendered
+ */
+static int render_main(int argc, char **argv)
+{
+    render_opts_t opts = {.budget = RENDER_MEM_BUDGET};
+    const char *dir = NULL;
+    char *s, *end;
+    int opt, nworker = 0;
+
+    while ((opt = getopt(argc, argv, "r:g:j:k:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'r':
+            dir = optarg;
+            break;
+        case 'g':
+            s = optarg;
+            for (int i = 0; i < EQ_NFILT && *s != '\0'; i++)
+            {
+                opts.gain[i] = strtof(s, &end);
+                if (end == s || (*end != ',' && *end != '\0'))
+                    usage();
+                s = (*end == ',') ? end + 1 : end;
+            }
+            break;
+        case 'j':
+            nworker = parse_int(optarg, 1, RENDER_MAX_PARALLEL);
+            break;
+        case 'k':
+            // 0 for a chunk per online CPU
+            opts.nsplit = parse_int(optarg, 0, RENDER_MAX_PARALLEL);
+            if (opts.nsplit == 0)
+                opts.nsplit = sysconf(_SC_NPROCESSORS_ONLN);
+            break;
+        default:
+            usage();
+        }
+    }
+    if (dir == NULL || optind >= argc)
+        usage();
+    // no driver is installed, only file loading works
+    install_allegro(SYSTEM_NONE, &errno, atexit);
+    return (render_batch((const char *const *)&argv[optind], argc - optind,
+                         dir, &opts, nworker, NULL) == 0)
+               ? EXIT_SUCCESS
+               : EXIT_FAILURE;
+}
+
+/**
+ * @brief parse a list of CPUs, e.g. "2,3"
+ *
+ * @return unsigned long a bit for each CPU
+ */
+static unsigned long parse_cpus(const char *s)
+{
+    unsigned long cpus = 0;
+    char *end;
+    long cpu;
+
+    do
+    {
+        cpu = strtol(s, &end, 10);
+        if (end == s || cpu < 0 || cpu >= (long)sizeof(cpus) * 8 ||
+            (*end != ',' && *end != '\0'))
+            usage();
+        cpus |= 1UL << cpu;
+        s = end + 1;
+    } while (*end == ',');
+    return cpus;
+}
+
+/**
+ * @brief parse a memory budget in MiB, e.g. "64"
+ *
+ * @return size_t the budget in bytes
+ */
+static size_t parse_budget(const char *s)
+{
+    char *end;
+    long mib;
+
+    errno = 0;
+    mib = strtol(s, &end, 10);
+    if (end == s || *end != '\0' || errno != 0 || mib <= 0 ||
+        (unsigned long)mib > SIZE_MAX >> 20)
+        usage();
+    return (size_t)mib << 20;
+}
+
+/**
+ * @brief parse the policy of the player task after an overrun
+ */
+static task_overrun_t parse_overrun(const char *s)
+{
+    if (strcmp(s, "skip") == 0)
+        return TASK_SKIP;
+    if (strcmp(s, "catch") == 0)
+        return TASK_CATCH_UP;
+    if (strcmp(s, "rephase") == 0)
+        return TASK_REPHASE;
+    usage();
+    return TASK_SKIP;
+}
+
+/**
+ * @brief lock the memory of the process, so that the tasks never fault
+ *
+ * Only when nothing can be refused for it, as root or with no limit of
+ * locked memory, since mappings past the limit would fail once locked.
+ * Pages are locked as they are touched where the kernel can, so the track
+ * mapped is not read whole at once.
+ */
+static void lock_memory()
+{
+    struct rlimit rl;
+    int flags = MCL_CURRENT | MCL_FUTURE;
+
+#ifdef MCL_ONFAULT
+    flags |= MCL_ONFAULT;
+#endif
+    if (geteuid() != 0 &&
+        (getrlimit(RLIMIT_MEMLOCK, &rl) < 0 || rl.rlim_cur != RLIM_INFINITY))
+    {
+        printf("memory not locked, it needs root or no limit of locked "
+               "memory\n");
+        return;
+    }
+    if (mlockall(flags) < 0)
+        printf("memory not locked: %s\n", strerror(errno));
+}
+
 void init()
 {
     allegro_init();
@@ -24,17 +192,53 @@ int main(int argc, char **argv)
         *view_thread,
         *controller_thread;
 
-    if (argc != 2)
+    if (argc > 1 && strcmp(argv[1], "-r") == 0)
+        return render_main(argc, argv);
+    while (argc > 1 && argv[1][0] == '-')
+    {
+        // spectograms as scrolling color maps instead of bars
+        if (strcmp(argv[1], "-m") == 0)
+            view_set_spect_map(1);
+        // a reserved bandwidth for each task
+        else if (strcmp(argv[1], "-e") == 0)
+            task_set_sched(TASK_DEADLINE);
+        // the timing statistics of the tasks every second
+        else if (strcmp(argv[1], "-s") == 0)
+            task_set_dump(1000);
+        // the player task on its own CPUs, e.g. an isolated one
+        else if (strcmp(argv[1], "-c") == 0 && argc > 2)
+        {
+            player_set_affinity(parse_cpus(argv[2]));
+            argv++;
+            argc--;
+        }
+        // what the player task does after an overrun
+        else if (strcmp(argv[1], "-o") == 0 && argc > 2)
+        {
+            player_set_overrun(parse_overrun(argv[2]));
+            argv++;
+            argc--;
+        }
+        else
+            usage();
+        argv++;
+        argc--;
+    }
+    if (argc != 2 && argc != 3)
+        usage();
+    if (argc == 3 && player_set_mem_budget(parse_budget(argv[2])) < 0)
     {
-        printf("usage ./player <song_file_path>\n");
+        printf("invalid memory budget: %s\n", argv[2]);
         exit(EXIT_FAILURE);
     }
+    lock_memory();
     init();
 
     player_init(argv[1]);
     view_init();
     controller_init();
     player_thread = player_start(NULL);
+    player_analysis_start(NULL);
     view_thread = view_start(NULL);
     controller_thread = controller_start(NULL);
 
@@ -0,0 +1,179 @@
+/**
+ * @file bands.c
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief aggregation of the bins of a spectrum in frequency bands
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * The bin k covers [k - 1/2, k + 1/2) in units of the spacing. The weights
+ * of all the bands are kept in one array, each band a run of consecutive
+ * bins from its first one, so applying a layout reads it once in order.
+ */
+#include "player/bands.h"
+
+#include <stdlib.h>
+
+#include <error.h>
+#include <math.h>
+
+struct bands
+{
+	int nbar;			  /**< No. bands. */
+	int nbin;			  /**< No. bins of the spectra. */
+	float fc[BANDS_MAX];  /**< Center of each band. */
+	int first[BANDS_MAX]; /**< First bin of each band. */
+	int count[BANDS_MAX]; /**< No. bins of each band. */
+	float *w;			  /**< Weights of the bins of all the bands. */
+};
+
+static float mel(float f) { return 2595 * log10f(1 + f / 700); }
+
+static float mel_inv(float m) { return 700 * (powf(10, m / 2595) - 1); }
+
+/**
+ * @brief	Edges of the bands of a scale.
+ * @param[out]	lo, hi	lower and upper edge of each band in Hz.
+ * @return	no. bands.
+ */
+static int bands_edges(bands_scale_t scale, int nbar, float fmin, float fmax,
+					   float lo[], float hi[])
+{
+	float fc;
+	int n = 0;
+
+	switch (scale)
+	{
+	case BANDS_THIRD_OCTAVE:
+		// base 10 bands whose center is in the range, 19.95 Hz to 19.95 kHz
+		// for the audio range
+		for (int k = -30; k <= 30 && n < nbar; k++)
+		{
+			fc = 1000 * powf(10, k / 10.0f);
+			if (fc < fmin * 0.99f || fc > fmax * 1.01f)
+				continue;
+			lo[n] = fc * powf(10, -1 / 20.0f);
+			hi[n++] = fc * powf(10, 1 / 20.0f);
+		}
+		return n;
+	case BANDS_LOG:
+		for (n = 0; n < nbar; n++)
+		{
+			lo[n] = fmin * powf(fmax / fmin, (float)n / nbar);
+			hi[n] = fmin * powf(fmax / fmin, (float)(n + 1) / nbar);
+		}
+		return n;
+	case BANDS_MEL:
+		for (n = 0; n < nbar; n++)
+		{
+			lo[n] = mel_inv(mel(fmin) + (mel(fmax) - mel(fmin)) * n / nbar);
+			hi[n] =
+				mel_inv(mel(fmin) + (mel(fmax) - mel(fmin)) * (n + 1) / nbar);
+		}
+		return n;
+	default:
+		for (n = 0; n < nbar; n++)
+		{
+			lo[n] = fmin + (fmax - fmin) * n / nbar;
+			hi[n] = fmin + (fmax - fmin) * (n + 1) / nbar;
+		}
+		return n;
+	}
+}
+
+bands_t *bands_new(bands_scale_t scale, int nbar, int nbin, float spacing,
+				   float fmin, float fmax)
+{
+	float lo[BANDS_MAX], hi[BANDS_MAX], a, b, sum;
+	int first, last, nw = 0;
+	bands_t *bd;
+
+	if (scale < BANDS_LINEAR || scale >= BANDS_NSCALE || nbar < 1 ||
+		nbar > BANDS_MAX || nbin < 1 || spacing <= 0 || fmin < 0 ||
+		fmax <= fmin || (scale != BANDS_LINEAR && fmin == 0))
+	{
+		error_at_line(0, 0, __FILE__, __LINE__,
+					  "%d bands of scale %d in [%g, %g] Hz, %d bins of %g Hz",
+					  nbar, scale, fmin, fmax, nbin, spacing);
+		return NULL;
+	}
+	bd = malloc(sizeof(bands_t));
+	if (bd == NULL)
+		return NULL;
+	bd->nbin = nbin;
+	bd->nbar = bands_edges(scale, nbar, fmin, fmax, lo, hi);
+	// the bins overlapped by each band, at least one
+	for (int i = 0; i < bd->nbar; i++)
+	{
+		a = lo[i] / spacing;
+		b = hi[i] / spacing;
+		first = floorf(a + 0.5f);
+		last = ceilf(b - 0.5f);
+		if (first > nbin - 1)
+			first = nbin - 1;
+		if (last < first)
+			last = first;
+		if (last > nbin - 1)
+			last = nbin - 1;
+		bd->first[i] = first;
+		bd->count[i] = last - first + 1;
+		bd->fc[i] = (scale == BANDS_LINEAR) ? (lo[i] + hi[i]) / 2
+											: sqrtf(lo[i] * hi[i]);
+		nw += bd->count[i];
+	}
+	bd->w = malloc(sizeof(float) * (nw > 0 ? nw : 1));
+	if (bd->w == NULL)
+	{
+		free(bd);
+		return NULL;
+	}
+	nw = 0;
+	for (int i = 0; i < bd->nbar; i++)
+	{
+		a = lo[i] / spacing;
+		b = hi[i] / spacing;
+		sum = 0;
+		for (int k = 0; k < bd->count[i]; k++)
+		{
+			float l = bd->first[i] + k - 0.5f, h = l + 1;
+
+			// overlap of the band with the bin
+			l = (a > l) ? a : l;
+			h = (b < h) ? b : h;
+			bd->w[nw + k] = (h > l) ? h - l : 0;
+			sum += bd->w[nw + k];
+		}
+		for (int k = 0; k < bd->count[i]; k++)
+			bd->w[nw + k] =
+				(sum > 0) ? bd->w[nw + k] / sum : 1.0f / bd->count[i];
+		nw += bd->count[i];
+	}
+	return bd;
+}
+
+void bands_delete(bands_t *b)
+{
+	if (b == NULL)
+		return;
+	free(b->w);
+	free(b);
+}
+
+int bands_nbar(const bands_t *b) { return b->nbar; }
+
+float bands_freq(const bands_t *b, int i) { return b->fc[i]; }
+
+void bands_apply(const bands_t *b, const float bin[], float bar[])
+{
+	const float *w = b->w;
+
+	for (int i = 0; i < b->nbar; i++)
+	{
+		const float *x = bin + b->first[i];
+		float acc = 0;
+
+		for (int k = 0; k < b->count[i]; k++)
+			acc += w[k] * x[k];
+		bar[i] = acc;
+		w += b->count[i];
+	}
+}
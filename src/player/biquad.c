@@ -0,0 +1,280 @@
+/**
+ * @file biquad.c
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief cascade of biquad sections processed in a single pass
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * A cascade is sequential by nature: each section needs the output of the
+ * previous one. The SIMD version pipelines the sections instead: at step t
+ * the lane k of a group of CASCADE_LANES sections filters the sample t - k,
+ * with the input of lane k being the output of lane k - 1 at step t - 1. So
+ * a group of four sections costs roughly as much as a single section. The
+ * first and the last CASCADE_LANES - 1 steps of a buffer have some lanes
+ * idle; their state is left untouched, so the result is the same as
+ * filtering sample by sample, with no added latency.
+ * Each step depends on the previous one, so a pipeline is bound by the
+ * latency of the arithmetic, not by its throughput. Channels are pipelined
+ * in pairs in the same loop: the two chains are independent, so a stereo
+ * track costs little more than a mono one.
+ */
+#include "player/biquad.h"
+
+#include <stdio.h>
+
+#include <error.h>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define CASCADE_SSE
+#include <immintrin.h>
+#endif
+
+int cascade_init(cascade_t *c, int nsect, int nch)
+{
+	if (nsect < 0 || nsect > CASCADE_MAX_SECT)
+	{
+		error_at_line(0, 0, __FILE__, __LINE__,
+					  "cascade of %d sections, max is %d",
+					  nsect, CASCADE_MAX_SECT);
+		return -1;
+	}
+	if (nch < 1 || nch > CASCADE_MAX_NCH)
+	{
+		error_at_line(0, 0, __FILE__, __LINE__,
+					  "cascade of %d channels, max is %d",
+					  nch, CASCADE_MAX_NCH);
+		return -1;
+	}
+	memset(c, 0, sizeof(*c));
+	c->nsect = nsect;
+	c->nch = nch;
+	for (int i = 0; i < CASCADE_MAX_SECT; i++)
+		c->b0[i] = 1.0f;
+	return 0;
+}
+
+void cascade_set(cascade_t *c, int i, const biquad_coef_t *coef)
+{
+	c->b0[i] = coef->b0;
+	c->b1[i] = coef->b1;
+	c->b2[i] = coef->b2;
+	c->a1[i] = coef->a1;
+	c->a2[i] = coef->a2;
+}
+
+void cascade_reset(cascade_t *c, int i)
+{
+	if (i < 0)
+	{
+		memset(c->z1, 0, sizeof(c->z1));
+		memset(c->z2, 0, sizeof(c->z2));
+		return;
+	}
+	for (int ch = 0; ch < CASCADE_MAX_NCH; ch++)
+	{
+		c->z1[ch][i] = 0.0f;
+		c->z2[ch][i] = 0.0f;
+	}
+}
+
+#ifdef CASCADE_SSE
+/**
+ * @brief	Step of the pipeline with only some lanes active.
+ *
+ * Lane k is active when it has a sample to filter in the buffer, i.e. when
+ * 0 <= t - k < count.
+ */
+static inline __m128 cascade_mask(unsigned int t, unsigned int count)
+{
+	int m[CASCADE_LANES];
+
+	for (unsigned int k = 0; k < CASCADE_LANES; k++)
+		m[k] = (k <= t && t - k < count) ? -1 : 0;
+	return _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)m));
+}
+
+/**
+ * @brief	Coefficients of a group of sections.
+ */
+typedef struct
+{
+	__m128 b0, b1, b2, a1, a2;
+} cascade_coef_t;
+
+/**
+ * @brief	Step of the pipeline of a channel.
+ *
+ * @param[in]	k	coefficients of the group.
+ * @param[in]	in	new sample for lane 0.
+ * @param[inout]	y	outputs of the lanes.
+ * @param[inout]	z1	1st states.
+ * @param[inout]	z2	2nd states.
+ * @param[in]	m	lanes whose state is updated, NULL for all.
+ */
+static inline __attribute__((always_inline)) void
+cascade_step(const cascade_coef_t *k, float in, __m128 *y, __m128 *z1,
+			 __m128 *z2, const __m128 *m)
+{
+	__m128 x, nz1, nz2;
+
+	// lane 0 takes the new sample, lane k the output of lane k - 1
+	x = _mm_shuffle_ps(*y, *y, _MM_SHUFFLE(2, 1, 0, 0));
+	x = _mm_move_ss(x, _mm_set_ss(in));
+	*y = _mm_add_ps(_mm_mul_ps(k->b0, x), *z1);
+	// the feedback term last, it is on the critical path
+	nz1 = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(k->b1, x), *z2),
+					 _mm_mul_ps(k->a1, *y));
+	nz2 = _mm_sub_ps(_mm_mul_ps(k->b2, x), _mm_mul_ps(k->a2, *y));
+	if (m == NULL)
+	{
+		*z1 = nz1;
+		*z2 = nz2;
+		return;
+	}
+	*z1 = _mm_or_ps(_mm_and_ps(*m, nz1), _mm_andnot_ps(*m, *z1));
+	*z2 = _mm_or_ps(_mm_and_ps(*m, nz2), _mm_andnot_ps(*m, *z2));
+}
+
+/**
+ * @brief	Output of the last lane, the sample that left the group.
+ */
+static inline float cascade_out(__m128 y)
+{
+	return _mm_cvtss_f32(_mm_shuffle_ps(y, y, _MM_SHUFFLE(3, 3, 3, 3)));
+}
+
+/**
+ * @brief	Filter the buffers of some channels through a group of
+ *		CASCADE_LANES sections.
+ *
+ * Always inlined with a constant two, so that the chains are unrolled and
+ * their states stay in registers. The steady part of the buffer, where all
+ * the lanes are active, has no branch.
+ *
+ * @param[inout]	c	the cascade.
+ * @param[in]	g	index of the first section of the group.
+ * @param[inout]	buf	time-data samples of each channel.
+ * @param[in]	ch	first channel.
+ * @param[in]	two	filter the channels ch and ch + 1, not only ch.
+ * @param[in]	count	no. samples in each buffer.
+ */
+static inline __attribute__((always_inline)) void
+cascade_group(cascade_t *c, int g, float *const buf[], int ch, int two,
+			  unsigned int count)
+{
+	const cascade_coef_t k = {
+		_mm_load_ps(&c->b0[g]), _mm_load_ps(&c->b1[g]),
+		_mm_load_ps(&c->b2[g]), _mm_load_ps(&c->a1[g]),
+		_mm_load_ps(&c->a2[g])};
+	const unsigned int lag = CASCADE_LANES - 1;
+	float *a = buf[ch], *b = two ? buf[ch + 1] : NULL;
+	__m128 za1, za2, ya, zb1, zb2, yb, m;
+	unsigned int t, last;
+
+	za1 = _mm_load_ps(&c->z1[ch][g]);
+	za2 = _mm_load_ps(&c->z2[ch][g]);
+	ya = _mm_setzero_ps();
+	zb1 = two ? _mm_load_ps(&c->z1[ch + 1][g]) : ya;
+	zb2 = two ? _mm_load_ps(&c->z2[ch + 1][g]) : ya;
+	yb = ya;
+	last = count + lag;
+	// the pipeline fills up
+	for (t = 0; t < lag; t++)
+	{
+		m = cascade_mask(t, count);
+		cascade_step(&k, (t < count) ? a[t] : 0.0f, &ya, &za1, &za2, &m);
+		if (two)
+			cascade_step(&k, (t < count) ? b[t] : 0.0f, &yb, &zb1, &zb2, &m);
+	}
+	// all the lanes at work, the last one completes the sample t - lag
+	for (; t < count; t++)
+	{
+		cascade_step(&k, a[t], &ya, &za1, &za2, NULL);
+		if (two)
+			cascade_step(&k, b[t], &yb, &zb1, &zb2, NULL);
+		a[t - lag] = cascade_out(ya);
+		if (two)
+			b[t - lag] = cascade_out(yb);
+	}
+	// the pipeline drains
+	for (; t < last; t++)
+	{
+		m = cascade_mask(t, count);
+		cascade_step(&k, 0.0f, &ya, &za1, &za2, &m);
+		a[t - lag] = cascade_out(ya);
+		if (two)
+		{
+			cascade_step(&k, 0.0f, &yb, &zb1, &zb2, &m);
+			b[t - lag] = cascade_out(yb);
+		}
+	}
+	_mm_store_ps(&c->z1[ch][g], za1);
+	_mm_store_ps(&c->z2[ch][g], za2);
+	if (two)
+	{
+		_mm_store_ps(&c->z1[ch + 1][g], zb1);
+		_mm_store_ps(&c->z2[ch + 1][g], zb2);
+	}
+}
+
+void cascade_process(cascade_t *c, float *const buf[], unsigned int count)
+{
+	unsigned int csr;
+	int ch;
+
+	// flush to zero and denormals are zero, restored at the end
+	csr = _mm_getcsr();
+	_mm_setcsr(csr | 0x8040);
+	for (int g = 0; g < c->nsect; g += CASCADE_LANES)
+	{
+		for (ch = 0; ch + 2 <= c->nch; ch += 2)
+			cascade_group(c, g, buf, ch, 1, count);
+		if (ch < c->nch)
+			cascade_group(c, g, buf, ch, 0, count);
+	}
+	_mm_setcsr(csr);
+}
+#else
+void cascade_process(cascade_t *c, float *const buf[], unsigned int count)
+{
+	float x, y, *z1, *z2;
+#ifdef __aarch64__
+	unsigned long fpcr;
+
+	// flush to zero, restored at the end
+	__asm__ volatile("mrs %0, fpcr" : "=r"(fpcr));
+	__asm__ volatile("msr fpcr, %0" : : "r"(fpcr | (1UL << 24)));
+#endif
+	for (int ch = 0; ch < c->nch; ch++)
+	{
+		z1 = c->z1[ch];
+		z2 = c->z2[ch];
+		for (unsigned int j = 0; j < count; j++)
+		{
+			x = buf[ch][j];
+			for (int i = 0; i < c->nsect; i++)
+			{
+				y = c->b0[i] * x + z1[i];
+				z1[i] = c->b1[i] * x - c->a1[i] * y + z2[i];
+				z2[i] = c->b2[i] * x - c->a2[i] * y;
+				x = y;
+			}
+			buf[ch][j] = x;
+		}
+		// states decayed to denormals are flushed, whatever the target
+		for (int i = 0; i < c->nsect; i++)
+		{
+			if (fabsf(z1[i]) < FLT_MIN)
+				z1[i] = 0.0f;
+			if (fabsf(z2[i]) < FLT_MIN)
+				z2[i] = 0.0f;
+		}
+	}
+#ifdef __aarch64__
+	__asm__ volatile("msr fpcr, %0" : : "r"(fpcr));
+#endif
+}
+#endif /* CASCADE_SSE */
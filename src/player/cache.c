@@ -0,0 +1,440 @@
+/**
+ * @file cache.c
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief spectra of whole tracks, computed once and kept in files
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * A file is a header followed by the spectra, nbin magnitudes each. The
+ * threads building it take blocks of CACHE_BLOCK spectra in turn and write
+ * them straight in a shared mapping of the file. Threads rather than forked
+ * processes, as the render does, since the player calling this runs other
+ * threads holding locks. A track that cannot be mapped is read ahead by a
+ * single thread.
+ */
+#include "player/cache.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <errno.h>
+#include <error.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "player/fft.h"
+#include "player/source.h"
+
+#define CACHE_MAGIC "EQSPECT1" /**< First bytes of a file. */
+
+/**
+ * @brief	Header of a file.
+ */
+typedef struct
+{
+	char magic[8];	 /**< CACHE_MAGIC. */
+	uint64_t hash;	 /**< Hash of the track. */
+	int32_t nfft;	 /**< Samples of a transform. */
+	int32_t size;	 /**< Samples of the window. */
+	int32_t hop;	 /**< Samples between two spectra. */
+	int32_t nbin;	 /**< Bins of a spectrum. */
+	int32_t win;	 /**< Window function. */
+	float beta;		 /**< Shape of the window. */
+	int32_t bits;	 /**< Bits of a magnitude. */
+	int32_t freq;	 /**< Sampling frequency of the track. */
+	int64_t len;	 /**< Frames of the track. */
+	int64_t nframe;	 /**< No. spectra. */
+} cache_header_t;
+
+static cache_stats_t stats; /**< Counters of the spectra. */
+static pthread_mutex_t stats_mutex =
+	PTHREAD_MUTEX_INITIALIZER; /**< mutex for the counters. */
+
+struct cache
+{
+	cache_header_t *h;	 /**< Mapping of the file. */
+	size_t map_len;		 /**< Bytes mapped. */
+	const uint8_t *data; /**< Spectra. */
+	float *lut;			 /**< Magnitude of each stored value. */
+};
+
+/**
+ * @brief	Shared by the threads building a file.
+ */
+typedef struct
+{
+	source_t *src;			 /**< The track. */
+	const cache_key_t *key;	 /**< Parameters of the analysis. */
+	const window_t *win;	 /**< Window function. */
+	const float *w;			 /**< Weight of each channel. */
+	uint8_t *data;			 /**< Spectra. */
+	long nframe;			 /**< No. spectra. */
+	long next;				 /**< First spectrum of the next block. */
+	volatile const int *stop; /**< Stop request. */
+} job_t;
+
+int cache_hash(const char *path, uint64_t *hash)
+{
+	struct stat st;
+	const uint8_t *b;
+	uint64_t h = 0xcbf29ce484222325ULL;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) < 0)
+	{
+		error_at_line(0, errno, __FILE__, __LINE__, "%s", path);
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+	if (st.st_size > 0)
+	{
+		b = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (b == MAP_FAILED)
+		{
+			error_at_line(0, errno, __FILE__, __LINE__, "%s", path);
+			close(fd);
+			return -1;
+		}
+		madvise((void *)b, st.st_size, MADV_SEQUENTIAL);
+		for (off_t i = 0; i < st.st_size; i++)
+			h = (h ^ b[i]) * 0x100000001b3ULL;
+		munmap((void *)b, st.st_size);
+	}
+	close(fd);
+	*hash = h;
+	return 0;
+}
+
+/**
+ * @brief	Name of the file of the spectra of a track.
+ */
+static void cache_name(char *dst, uint64_t hash, const cache_key_t *key)
+{
+	snprintf(dst, PATH_MAX, "%s%016llx-%d-%d-%d-%d-%d-%g-%d.spc", CACHE_DIR,
+			 (unsigned long long)hash, key->nfft, key->size, key->hop,
+			 key->nbin, key->win, key->beta, key->bits);
+}
+
+static int key_check(const cache_key_t *key)
+{
+	if (key->size < 2 || key->size > key->nfft || key->hop < 1 ||
+		key->nbin < 1 || key->nbin > key->nfft / 2 + 1 ||
+		(key->bits != 8 && key->bits != 16))
+	{
+		error_at_line(0, 0, __FILE__, __LINE__,
+					  "spectra of %d bins of %d, window of %d, hop of %d, "
+					  "%d bits",
+					  key->nbin, key->nfft, key->size, key->hop, key->bits);
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief	Map a file, if its header matches.
+ */
+static cache_t *cache_map(const char *name, uint64_t hash,
+						  const cache_key_t *key)
+{
+	cache_header_t h;
+	struct stat st;
+	cache_t *c;
+	size_t len;
+	int fd, nval = 1 << key->bits;
+
+	fd = open(name, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st) < 0 || pread(fd, &h, sizeof(h), 0) != sizeof(h) ||
+		memcmp(h.magic, CACHE_MAGIC, 8) || h.hash != hash ||
+		h.nfft != key->nfft || h.size != key->size || h.hop != key->hop ||
+		h.nbin != key->nbin || h.win != key->win || h.beta != key->beta ||
+		h.bits != key->bits)
+	{
+		close(fd);
+		return NULL;
+	}
+	len = sizeof(h) + (size_t)h.nframe * h.nbin * (h.bits / 8);
+	if ((size_t)st.st_size < len || (c = malloc(sizeof(cache_t))) == NULL)
+	{
+		close(fd);
+		return NULL;
+	}
+	c->h = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	c->lut = malloc(sizeof(float) * nval);
+	if (c->h == MAP_FAILED || c->lut == NULL)
+	{
+		if (c->h != MAP_FAILED)
+			munmap(c->h, len);
+		free(c->lut);
+		free(c);
+		return NULL;
+	}
+	c->map_len = len;
+	c->data = (const uint8_t *)c->h + sizeof(h);
+	c->lut[0] = 0;
+	for (int q = 1; q < nval; q++)
+		c->lut[q] = CACHE_FULL_SCALE *
+					powf(10, (CACHE_FLOOR_DB * (1 - (float)q / (nval - 1))) /
+								 20);
+	return c;
+}
+
+cache_t *cache_open(const char *path, const cache_key_t *key)
+{
+	char name[PATH_MAX];
+	uint64_t hash;
+	cache_t *c;
+
+	if (key_check(key) < 0 || cache_hash(path, &hash) < 0)
+		return NULL;
+	cache_name(name, hash, key);
+	c = cache_map(name, hash, key);
+	if (c != NULL)
+	{
+		pthread_mutex_lock(&stats_mutex);
+		stats.nopen++;
+		pthread_mutex_unlock(&stats_mutex);
+	}
+	return c;
+}
+
+/**
+ * @brief	Compute a spectrum and store it quantized.
+ *
+ * @param	frames	size interleaved frames, overwritten.
+ * @param	ch	buffer of each channel, size frames.
+ * @param	tmp	windowed frames, zero padded to nfft.
+ */
+static void job_frame(job_t *j, long i, float *frames, float *const ch[],
+					  float *tmp, fftwf_complex *cpx)
+{
+	const cache_key_t *key = j->key;
+	int nch = j->src->nch, qmax = (1 << key->bits) - 1;
+	long from = i * key->hop - key->size / 2;
+	float corr = 2.0f / (key->size * j->win->cg), db, q;
+	uint8_t *dst = j->data + i * key->nbin * (key->bits / 8);
+
+	if (j->src->pcm == NULL)
+		source_prefetch(j->src, (from > 0) ? from : 0,
+						(from + key->size > 0) ? from + key->size : 0);
+	source_read(j->src, from, key->size, frames);
+	convert_ilv_select(nch)->split(frames, ch, nch, key->size);
+	for (int k = 0; k < key->size; k++)
+	{
+		tmp[k] = 0;
+		for (int c = 0; c < nch; c++)
+			tmp[k] += j->w[c] * ch[c][k];
+		tmp[k] *= j->win->w[k];
+	}
+	fft_r2c(key->nfft, tmp, cpx);
+	for (int k = 0; k < key->nbin; k++)
+	{
+		db = 20 * log10f(sqrtf(cpx[k][0] * cpx[k][0] + cpx[k][1] * cpx[k][1]) *
+							 corr / CACHE_FULL_SCALE +
+						 1e-30f);
+		q = (1 - db / CACHE_FLOOR_DB) * qmax;
+		q = (q < 0) ? 0 : (q > qmax) ? qmax : q + 0.5f;
+		if (key->bits == 8)
+			dst[k] = q;
+		else
+			((uint16_t *)dst)[k] = q;
+	}
+}
+
+/**
+ * @brief	Thread building the spectra, a block at a time.
+ */
+static void *job_run(void *arg)
+{
+	job_t *j = arg;
+	const cache_key_t *key = j->key;
+	int nch = j->src->nch;
+	float *frames, *ch[CONVERT_MAX_NCH], *tmp;
+	fftwf_complex *cpx;
+	long i, end;
+
+	frames = malloc(sizeof(float) * key->size * nch * 2);
+	tmp = fft_alloc_real(key->nfft);
+	cpx = fft_alloc_cpx(key->nfft / 2 + 1);
+	if (frames == NULL || tmp == NULL || cpx == NULL)
+	{
+		free(frames);
+		fft_free(tmp);
+		fft_free(cpx);
+		return (void *)-1;
+	}
+	for (int c = 0; c < nch; c++)
+		ch[c] = frames + (nch + c) * key->size;
+	// the padding stays zero, real to complex transforms keep their input
+	memset(tmp, 0, sizeof(float) * key->nfft);
+	while (j->stop == NULL || !*j->stop)
+	{
+		i = __atomic_fetch_add(&j->next, CACHE_BLOCK, __ATOMIC_RELAXED);
+		if (i >= j->nframe)
+			break;
+		end = (i + CACHE_BLOCK < j->nframe) ? i + CACHE_BLOCK : j->nframe;
+		for (; i < end; i++)
+			job_frame(j, i, frames, ch, tmp, cpx);
+	}
+	free(frames);
+	fft_free(tmp);
+	fft_free(cpx);
+	return NULL;
+}
+
+cache_t *cache_build(const char *path, const cache_key_t *key,
+					 const float w[], int nworker, volatile const int *stop)
+{
+	char name[PATH_MAX], tmp[PATH_MAX + 8];
+	pthread_t tid[CACHE_MAX_WORKER];
+	struct timespec t1, t2;
+	cache_header_t *h;
+	source_t src;
+	job_t j = {.src = &src, .key = key, .w = w, .stop = stop};
+	size_t len;
+	int fd, n, fail = 0;
+	uint64_t hash;
+
+	if (key_check(key) < 0 || cache_hash(path, &hash) < 0)
+		return NULL;
+	j.win = window_get(key->win, key->size, key->beta);
+	if (j.win == NULL || fft_plan(key->nfft) < 0)
+		return NULL;
+	if (source_open(&src, path, CACHE_MEM_BUDGET) < 0)
+		return NULL;
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	cache_name(name, hash, key);
+	snprintf(tmp, sizeof(tmp), "%s.%d", name, getpid());
+	mkdir(CACHE_DIR, 0755);
+	j.nframe = src.len / key->hop + 1;
+	len = sizeof(cache_header_t) + (size_t)j.nframe * key->nbin * (key->bits / 8);
+	fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0 || ftruncate(fd, len) < 0)
+	{
+		error_at_line(0, errno, __FILE__, __LINE__, "%s", tmp);
+		if (fd >= 0)
+		{
+			close(fd);
+			unlink(tmp);
+		}
+		source_close(&src);
+		return NULL;
+	}
+	h = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (h == MAP_FAILED)
+	{
+		error_at_line(0, errno, __FILE__, __LINE__, "%s", tmp);
+		unlink(tmp);
+		source_close(&src);
+		return NULL;
+	}
+	j.data = (uint8_t *)h + sizeof(cache_header_t);
+	// a ring is read ahead by one thread only
+	if (nworker <= 0)
+		nworker = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nworker > CACHE_MAX_WORKER)
+		nworker = CACHE_MAX_WORKER;
+	if (src.pcm == NULL || nworker < 1)
+		nworker = 1;
+	for (n = 0; n < nworker; n++)
+		if (pthread_create(&tid[n], NULL, job_run, &j) != 0)
+			break;
+	for (int i = 0; i < n; i++)
+	{
+		void *ret;
+
+		pthread_join(tid[i], &ret);
+		fail |= (ret != NULL);
+	}
+	if (n == 0 || fail || (stop != NULL && *stop))
+	{
+		source_close(&src);
+		munmap(h, len);
+		unlink(tmp);
+		return NULL;
+	}
+	// the header last, a file is complete once named
+	memcpy(h->magic, CACHE_MAGIC, 8);
+	h->hash = hash;
+	h->nfft = key->nfft;
+	h->size = key->size;
+	h->hop = key->hop;
+	h->nbin = key->nbin;
+	h->win = key->win;
+	h->beta = key->beta;
+	h->bits = key->bits;
+	h->freq = src.freq;
+	h->len = src.len;
+	h->nframe = j.nframe;
+	source_close(&src);
+	msync(h, len, MS_SYNC);
+	munmap(h, len);
+	if (rename(tmp, name) < 0)
+	{
+		error_at_line(0, errno, __FILE__, __LINE__, "%s", name);
+		unlink(tmp);
+		return NULL;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+	pthread_mutex_lock(&stats_mutex);
+	stats.nbuild++;
+	stats.nframe += j.nframe;
+	stats.build_s +=
+		(t2.tv_sec - t1.tv_sec) + (t2.tv_nsec - t1.tv_nsec) / 1e9;
+	pthread_mutex_unlock(&stats_mutex);
+	return cache_map(name, hash, key);
+}
+
+void cache_close(cache_t *c)
+{
+	if (c == NULL)
+		return;
+	munmap(c->h, c->map_len);
+	free(c->lut);
+	free(c);
+}
+
+long cache_nframe(const cache_t *c) { return c->h->nframe; }
+
+int cache_read(const cache_t *c, long pos, float mag[])
+{
+	long i;
+
+	if (pos < 0 || pos >= c->h->len)
+		return -1;
+	i = (pos + c->h->hop / 2) / c->h->hop;
+	if (c->h->bits == 8)
+	{
+		const uint8_t *q = c->data + i * c->h->nbin;
+
+		for (int k = 0; k < c->h->nbin; k++)
+			mag[k] = c->lut[q[k]];
+	}
+	else
+	{
+		const uint16_t *q = (const uint16_t *)c->data + i * c->h->nbin;
+
+		for (int k = 0; k < c->h->nbin; k++)
+			mag[k] = c->lut[q[k]];
+	}
+	return 0;
+}
+
+void cache_get_stats(cache_stats_t *dst)
+{
+	pthread_mutex_lock(&stats_mutex);
+	*dst = stats;
+	pthread_mutex_unlock(&stats_mutex);
+}
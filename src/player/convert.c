@@ -0,0 +1,978 @@
+/**
+ * @file convert.c
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief sample format conversion kernels
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * Allegro sample data are always unsigned: signed values are obtained by
+ * XORing the sign bit. Signed formats share the kernels of the unsigned ones,
+ * with no bit to flip. Samples of more than 16 bits are scaled by powers of
+ * two, which are exact, so that they land in the 16 bits range. SIMD kernels are compiled with the target attribute,
+ * so the rest of the program does not need any special compiler flag, and
+ * they are only called when the running CPU supports them. They clamp in
+ * the float domain before the conversion, as the reference does, so that
+ * NaN and out of range values give the same result everywhere.
+ * Interleave kernels only move floats, so any variant gives the same result.
+ */
+#include "player/convert.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <endian.h>
+#include <math.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CONVERT_X86
+#include <immintrin.h>
+#endif
+
+/*******************************************************************************
+ *				SCALAR
+ ******************************************************************************/
+
+/**
+ * @brief	Round to nearest and saturate to [lo, hi].
+ */
+static inline long clamp_round(float x, float lo, float hi)
+{
+	return lrintf(fminf(fmaxf(x, lo), hi));
+}
+
+static void u8_to_float_scalar(const void *src, float *dst, unsigned int count)
+{
+	const uint8_t *s = src;
+	unsigned int j;
+
+	for (j = 0; j < count; j++)
+		dst[j] = (float)(int8_t)(s[j] ^ 0x80);
+}
+
+static void float_to_u8_scalar(const float *src, void *dst, unsigned int count)
+{
+	uint8_t *d = dst;
+	unsigned int j;
+
+	for (j = 0; j < count; j++)
+		d[j] = ((uint8_t)clamp_round(src[j], -128.0f, 127.0f)) ^ 0x80;
+}
+
+/**
+ * @brief	16 bits to float, flip is XORed to the samples first.
+ */
+static inline void x16_to_float_scalar(const void *src, float *dst,
+									   unsigned int count, uint16_t flip)
+{
+	const uint16_t *s = src;
+	unsigned int j;
+
+	for (j = 0; j < count; j++)
+		dst[j] = (float)(int16_t)(le16toh(s[j]) ^ flip);
+}
+
+static inline void float_to_x16_scalar(const float *src, void *dst,
+									   unsigned int count, uint16_t flip)
+{
+	uint16_t *d = dst;
+	unsigned int j;
+
+	for (j = 0; j < count; j++)
+		d[j] = htole16(((uint16_t)clamp_round(src[j], -32768.0f, 32767.0f)) ^
+					   flip);
+}
+
+static void u16_to_float_scalar(const void *src, float *dst,
+								unsigned int count)
+{
+	x16_to_float_scalar(src, dst, count, 0x8000);
+}
+
+static void float_to_u16_scalar(const float *src, void *dst,
+								unsigned int count)
+{
+	float_to_x16_scalar(src, dst, count, 0x8000);
+}
+
+static void s16_to_float_scalar(const void *src, float *dst,
+								unsigned int count)
+{
+	x16_to_float_scalar(src, dst, count, 0);
+}
+
+static void float_to_s16_scalar(const float *src, void *dst,
+								unsigned int count)
+{
+	float_to_x16_scalar(src, dst, count, 0);
+}
+
+#define S24_SCALE (1.0f / 65536) /**< 24 bits in the upper bytes of an int32,
+									to the 16 bits range. */
+#define S32_SCALE (1.0f / 65536) /**< 32 bits to the 16 bits range. */
+#define S32_LIM 2147483648.0f	 /**< 2^31, the first float out of range. */
+#define F32_SCALE 32768.0f		 /**< Full scale float to the 16 bits range. */
+
+static void s24_to_float_scalar(const void *src, float *dst,
+								unsigned int count)
+{
+	const uint8_t *s = src;
+	unsigned int j;
+
+	for (j = 0; j < count; j++, s += 3)
+		dst[j] = (float)(int32_t)(((uint32_t)s[0] << 8) |
+								  ((uint32_t)s[1] << 16) |
+								  ((uint32_t)s[2] << 24)) *
+				 S24_SCALE;
+}
+
+static void float_to_s24_scalar(const float *src, void *dst,
+								unsigned int count)
+{
+	uint8_t *d = dst;
+	unsigned int j;
+	uint32_t x;
+
+	for (j = 0; j < count; j++, d += 3)
+	{
+		x = clamp_round(src[j] * 256.0f, -8388608.0f, 8388607.0f);
+		d[0] = x;
+		d[1] = x >> 8;
+		d[2] = x >> 16;
+	}
+}
+
+/*
+ * Samples of 32 bits are not aligned to 4 bytes in a mapped file, they are
+ * copied out, which the compiler turns into plain loads.
+ */
+static void s32_to_float_scalar(const void *src, float *dst,
+								unsigned int count)
+{
+	const uint8_t *s = src;
+	unsigned int j;
+	uint32_t x;
+
+	for (j = 0; j < count; j++)
+	{
+		memcpy(&x, &s[j * 4], 4);
+		dst[j] = (float)(int32_t)le32toh(x) * S32_SCALE;
+	}
+}
+
+static void float_to_s32_scalar(const float *src, void *dst,
+								unsigned int count)
+{
+	uint8_t *d = dst;
+	unsigned int j;
+	uint32_t x;
+	long v;
+
+	for (j = 0; j < count; j++)
+	{
+		v = clamp_round(src[j] * 65536.0f, -S32_LIM, S32_LIM);
+		// 2^31 is a float, but not an int32
+		x = htole32((v <= INT32_MAX) ? (uint32_t)v : INT32_MAX);
+		memcpy(&d[j * 4], &x, 4);
+	}
+}
+
+static void f32_to_float_scalar(const void *src, float *dst,
+								unsigned int count)
+{
+	const uint8_t *s = src;
+	unsigned int j;
+	uint32_t x;
+	float f;
+
+	for (j = 0; j < count; j++)
+	{
+		memcpy(&x, &s[j * 4], 4);
+		x = le32toh(x);
+		memcpy(&f, &x, 4);
+		dst[j] = f * F32_SCALE;
+	}
+}
+
+static void float_to_f32_scalar(const float *src, void *dst,
+								unsigned int count)
+{
+	uint8_t *d = dst;
+	unsigned int j;
+	uint32_t x;
+	float f;
+
+	for (j = 0; j < count; j++)
+	{
+		f = src[j] * (1.0f / F32_SCALE);
+		memcpy(&x, &f, 4);
+		x = htole32(x);
+		memcpy(&d[j * 4], &x, 4);
+	}
+}
+
+#ifdef CONVERT_X86
+/*******************************************************************************
+ *				SSE2
+ ******************************************************************************/
+
+__attribute__((target("sse2"))) static void
+u8_to_float_sse2(const void *src, float *dst, unsigned int count)
+{
+	const uint8_t *s = src;
+	const __m128i sign = _mm_set1_epi8((char)0x80);
+	__m128i x, lo, hi;
+	unsigned int j;
+
+	for (j = 0; j + 16 <= count; j += 16)
+	{
+		x = _mm_xor_si128(_mm_loadu_si128((const __m128i *)&s[j]), sign);
+		// sign extension: duplicate each byte and shift back arithmetically
+		lo = _mm_srai_epi16(_mm_unpacklo_epi8(x, x), 8);
+		hi = _mm_srai_epi16(_mm_unpackhi_epi8(x, x), 8);
+		_mm_storeu_ps(&dst[j],
+					  _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 16)));
+		_mm_storeu_ps(&dst[j + 4],
+					  _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 16)));
+		_mm_storeu_ps(&dst[j + 8],
+					  _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 16)));
+		_mm_storeu_ps(&dst[j + 12],
+					  _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 16)));
+	}
+	u8_to_float_scalar(&s[j], &dst[j], count - j);
+}
+
+__attribute__((target("sse2"))) static void
+float_to_u8_sse2(const float *src, void *dst, unsigned int count)
+{
+	uint8_t *d = dst;
+	const __m128 lo = _mm_set1_ps(-128.0f), hi = _mm_set1_ps(127.0f);
+	const __m128i sign = _mm_set1_epi8((char)0x80);
+	__m128i a, b, c, e;
+	unsigned int j;
+
+	for (j = 0; j + 16 <= count; j += 16)
+	{
+		// max first: it returns the second operand on NaN, like fmaxf
+		a = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(&src[j]), lo), hi));
+		b = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(&src[j + 4]), lo), hi));
+		c = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(&src[j + 8]), lo), hi));
+		e = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(&src[j + 12]), lo), hi));
+		a = _mm_packs_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, e));
+		_mm_storeu_si128((__m128i *)&d[j], _mm_xor_si128(a, sign));
+	}
+	float_to_u8_scalar(&src[j], &d[j], count - j);
+}
+
+__attribute__((target("sse2"))) static inline void
+x16_to_float_sse2(const void *src, float *dst, unsigned int count,
+				  uint16_t flip)
+{
+	const uint16_t *s = src;
+	const __m128i sign = _mm_set1_epi16((short)flip);
+	__m128i x;
+	unsigned int j;
+
+	for (j = 0; j + 8 <= count; j += 8)
+	{
+		x = _mm_xor_si128(_mm_loadu_si128((const __m128i *)&s[j]), sign);
+		_mm_storeu_ps(&dst[j],
+					  _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16)));
+		_mm_storeu_ps(&dst[j + 4],
+					  _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16)));
+	}
+	x16_to_float_scalar(&s[j], &dst[j], count - j, flip);
+}
+
+__attribute__((target("sse2"))) static inline void
+float_to_x16_sse2(const float *src, void *dst, unsigned int count,
+				  uint16_t flip)
+{
+	uint16_t *d = dst;
+	const __m128 lo = _mm_set1_ps(-32768.0f), hi = _mm_set1_ps(32767.0f);
+	const __m128i sign = _mm_set1_epi16((short)flip);
+	__m128i a, b;
+	unsigned int j;
+
+	for (j = 0; j + 8 <= count; j += 8)
+	{
+		a = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(&src[j]), lo), hi));
+		b = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(&src[j + 4]), lo), hi));
+		_mm_storeu_si128((__m128i *)&d[j],
+						 _mm_xor_si128(_mm_packs_epi32(a, b), sign));
+	}
+	float_to_x16_scalar(&src[j], &d[j], count - j, flip);
+}
+
+__attribute__((target("sse2"))) static void
+u16_to_float_sse2(const void *src, float *dst, unsigned int count)
+{
+	x16_to_float_sse2(src, dst, count, 0x8000);
+}
+
+__attribute__((target("sse2"))) static void
+float_to_u16_sse2(const float *src, void *dst, unsigned int count)
+{
+	float_to_x16_sse2(src, dst, count, 0x8000);
+}
+
+__attribute__((target("sse2"))) static void
+s16_to_float_sse2(const void *src, float *dst, unsigned int count)
+{
+	x16_to_float_sse2(src, dst, count, 0);
+}
+
+__attribute__((target("sse2"))) static void
+float_to_s16_sse2(const float *src, void *dst, unsigned int count)
+{
+	float_to_x16_sse2(src, dst, count, 0);
+}
+
+/**
+ * @brief	24 bits to float, 4 samples at a time.
+ *
+ * Each sample is moved to the upper 3 bytes of its doubleword by a shift of
+ * the whole register, the other bytes are masked off. A load reads 4 bytes
+ * past the 4 samples, so the last 2 samples are left to the scalar tail.
+ */
+__attribute__((target("sse2"))) static void
+s24_to_float_sse2(const void *src, float *dst, unsigned int count)
+{
+	const uint8_t *s = src;
+	const __m128i m0 = _mm_set_epi32(0, 0, 0, 0xFFFFFF00),
+				  m1 = _mm_set_epi32(0, 0, 0xFFFFFF00, 0),
+				  m2 = _mm_set_epi32(0, 0xFFFFFF00, 0, 0),
+				  m3 = _mm_set_epi32(0xFFFFFF00, 0, 0, 0);
+	const __m128 scale = _mm_set1_ps(S24_SCALE);
+	__m128i x;
+	unsigned int j;
+
+	for (j = 0; j + 6 <= count; j += 4)
+	{
+		x = _mm_loadu_si128((const __m128i *)&s[j * 3]);
+		x = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_slli_epi32(x, 8), m0),
+									  _mm_and_si128(_mm_slli_si128(x, 2), m1)),
+						 _mm_or_si128(_mm_and_si128(_mm_slli_si128(x, 3), m2),
+									  _mm_and_si128(_mm_slli_si128(x, 4), m3)));
+		_mm_storeu_ps(&dst[j], _mm_mul_ps(_mm_cvtepi32_ps(x), scale));
+	}
+	s24_to_float_scalar(&s[j * 3], &dst[j], count - j);
+}
+
+/**
+ * @brief	Float to 24 bits, 4 samples at a time.
+ *
+ * The lower 3 bytes of each doubleword are packed by shifts of the whole
+ * register. A store writes 4 bytes past the 4 samples, which the next
+ * iteration overwrites, so the last 2 samples are left to the scalar tail.
+ */
+__attribute__((target("sse2"))) static void
+float_to_s24_sse2(const float *src, void *dst, unsigned int count)
+{
+	uint8_t *d = dst;
+	const __m128 lo = _mm_set1_ps(-8388608.0f), hi = _mm_set1_ps(8388607.0f),
+				 scale = _mm_set1_ps(256.0f);
+	const __m128i m0 = _mm_set_epi32(0, 0, 0, 0xFFFFFF),
+				  m1 = _mm_set_epi32(0, 0, 0xFFFFFF, 0),
+				  m2 = _mm_set_epi32(0, 0xFFFFFF, 0, 0),
+				  m3 = _mm_set_epi32(0xFFFFFF, 0, 0, 0);
+	__m128i x;
+	unsigned int j;
+
+	for (j = 0; j + 6 <= count; j += 4)
+	{
+		x = _mm_cvtps_epi32(_mm_min_ps(
+			_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(&src[j]), scale), lo), hi));
+		x = _mm_or_si128(_mm_or_si128(_mm_and_si128(x, m0),
+									  _mm_srli_si128(_mm_and_si128(x, m1), 1)),
+						 _mm_or_si128(_mm_srli_si128(_mm_and_si128(x, m2), 2),
+									  _mm_srli_si128(_mm_and_si128(x, m3), 3)));
+		_mm_storeu_si128((__m128i *)&d[j * 3], x);
+	}
+	float_to_s24_scalar(&src[j], &d[j * 3], count - j);
+}
+
+__attribute__((target("sse2"))) static void
+s32_to_float_sse2(const void *src, float *dst, unsigned int count)
+{
+	const uint8_t *s = src;
+	const __m128 scale = _mm_set1_ps(S32_SCALE);
+	unsigned int j;
+
+	for (j = 0; j + 4 <= count; j += 4)
+		_mm_storeu_ps(&dst[j], _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128(
+											  (const __m128i *)&s[j * 4])),
+										  scale));
+	s32_to_float_scalar(&s[j * 4], &dst[j], count - j);
+}
+
+/**
+ * @brief	Float to 32 bits, 4 samples at a time.
+ *
+ * 2^31 converts to 0x80000000, the value of any out of range conversion:
+ * flipping all its bits saturates it to 0x7fffffff.
+ */
+__attribute__((target("sse2"))) static void
+float_to_s32_sse2(const float *src, void *dst, unsigned int count)
+{
+	uint8_t *d = dst;
+	const __m128 lo = _mm_set1_ps(-S32_LIM), hi = _mm_set1_ps(S32_LIM),
+				 scale = _mm_set1_ps(65536.0f);
+	__m128 x;
+	unsigned int j;
+
+	for (j = 0; j + 4 <= count; j += 4)
+	{
+		x = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(&src[j]), scale), lo),
+					   hi);
+		_mm_storeu_si128((__m128i *)&d[j * 4],
+						 _mm_xor_si128(_mm_cvtps_epi32(x),
+									   _mm_castps_si128(_mm_cmpge_ps(x, hi))));
+	}
+	float_to_s32_scalar(&src[j], &d[j * 4], count - j);
+}
+
+__attribute__((target("sse2"))) static void
+f32_to_float_sse2(const void *src, float *dst, unsigned int count)
+{
+	const uint8_t *s = src;
+	const __m128 scale = _mm_set1_ps(F32_SCALE);
+	unsigned int j;
+
+	for (j = 0; j + 4 <= count; j += 4)
+		_mm_storeu_ps(&dst[j], _mm_mul_ps(_mm_loadu_ps((const float *)&s[j * 4]),
+										  scale));
+	f32_to_float_scalar(&s[j * 4], &dst[j], count - j);
+}
+
+__attribute__((target("sse2"))) static void
+float_to_f32_sse2(const float *src, void *dst, unsigned int count)
+{
+	uint8_t *d = dst;
+	const __m128 scale = _mm_set1_ps(1.0f / F32_SCALE);
+	unsigned int j;
+
+	for (j = 0; j + 4 <= count; j += 4)
+		_mm_storeu_ps((float *)&d[j * 4],
+					  _mm_mul_ps(_mm_loadu_ps(&src[j]), scale));
+	float_to_f32_scalar(&src[j], &d[j * 4], count - j);
+}
+
+/*******************************************************************************
+ *				AVX2
+ ******************************************************************************/
+
+__attribute__((target("avx2"))) static void
+u8_to_float_avx2(const void *src, float *dst, unsigned int count)
+{
+	const uint8_t *s = src;
+	const __m128i sign = _mm_set1_epi8((char)0x80);
+	__m128i x;
+	unsigned int j;
+
+	for (j = 0; j + 16 <= count; j += 16)
+	{
+		x = _mm_xor_si128(_mm_loadu_si128((const __m128i *)&s[j]), sign);
+		_mm256_storeu_ps(&dst[j], _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(x)));
+		_mm256_storeu_ps(&dst[j + 8], _mm256_cvtepi32_ps(
+										  _mm256_cvtepi8_epi32(_mm_srli_si128(x, 8))));
+	}
+	u8_to_float_scalar(&s[j], &dst[j], count - j);
+}
+
+__attribute__((target("avx2"))) static void
+float_to_u8_avx2(const float *src, void *dst, unsigned int count)
+{
+	uint8_t *d = dst;
+	const __m256 lo = _mm256_set1_ps(-128.0f), hi = _mm256_set1_ps(127.0f);
+	const __m128i sign = _mm_set1_epi8((char)0x80);
+	__m256i a, b;
+	unsigned int j;
+
+	for (j = 0; j + 16 <= count; j += 16)
+	{
+		a = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(&src[j]), lo), hi));
+		b = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(&src[j + 8]), lo), hi));
+		// packs works on 128 bit lanes: restore the order of the quadwords
+		a = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8);
+		_mm_storeu_si128((__m128i *)&d[j],
+						 _mm_xor_si128(_mm_packs_epi16(_mm256_castsi256_si128(a),
+													   _mm256_extracti128_si256(a, 1)),
+									   sign));
+	}
+	float_to_u8_scalar(&src[j], &d[j], count - j);
+}
+
+__attribute__((target("avx2"))) static inline void
+x16_to_float_avx2(const void *src, float *dst, unsigned int count,
+				  uint16_t flip)
+{
+	const uint16_t *s = src;
+	const __m256i sign = _mm256_set1_epi16((short)flip);
+	__m256i x;
+	unsigned int j;
+
+	for (j = 0; j + 16 <= count; j += 16)
+	{
+		x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)&s[j]), sign);
+		_mm256_storeu_ps(&dst[j], _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(
+									  _mm256_castsi256_si128(x))));
+		_mm256_storeu_ps(&dst[j + 8], _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(
+										  _mm256_extracti128_si256(x, 1))));
+	}
+	x16_to_float_scalar(&s[j], &dst[j], count - j, flip);
+}
+
+__attribute__((target("avx2"))) static inline void
+float_to_x16_avx2(const float *src, void *dst, unsigned int count,
+				  uint16_t flip)
+{
+	uint16_t *d = dst;
+	const __m256 lo = _mm256_set1_ps(-32768.0f), hi = _mm256_set1_ps(32767.0f);
+	const __m256i sign = _mm256_set1_epi16((short)flip);
+	__m256i a, b;
+	unsigned int j;
+
+	for (j = 0; j + 16 <= count; j += 16)
+	{
+		a = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(&src[j]), lo), hi));
+		b = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(&src[j + 8]), lo), hi));
+		a = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8);
+		_mm256_storeu_si256((__m256i *)&d[j], _mm256_xor_si256(a, sign));
+	}
+	float_to_x16_scalar(&src[j], &d[j], count - j, flip);
+}
+
+__attribute__((target("avx2"))) static void
+u16_to_float_avx2(const void *src, float *dst, unsigned int count)
+{
+	x16_to_float_avx2(src, dst, count, 0x8000);
+}
+
+__attribute__((target("avx2"))) static void
+float_to_u16_avx2(const float *src, void *dst, unsigned int count)
+{
+	float_to_x16_avx2(src, dst, count, 0x8000);
+}
+
+__attribute__((target("avx2"))) static void
+s16_to_float_avx2(const void *src, float *dst, unsigned int count)
+{
+	x16_to_float_avx2(src, dst, count, 0);
+}
+
+__attribute__((target("avx2"))) static void
+float_to_s16_avx2(const float *src, void *dst, unsigned int count)
+{
+	float_to_x16_avx2(src, dst, count, 0);
+}
+
+/**
+ * @brief	24 bits to float, 8 samples at a time.
+ *
+ * The 24 bytes are spread to the two lanes, 12 each, then a byte shuffle
+ * moves each sample to the upper bytes of its doubleword. A load reads 8
+ * bytes past the 8 samples, so the last 3 samples are left to the scalar
+ * tail.
+ */
+__attribute__((target("avx2"))) static void
+s24_to_float_avx2(const void *src, float *dst, unsigned int count)
+{
+	const uint8_t *s = src;
+	const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+	const __m256i shuf = _mm256_setr_epi8(
+		-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+		-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+	const __m256 scale = _mm256_set1_ps(S24_SCALE);
+	__m256i x;
+	unsigned int j;
+
+	for (j = 0; j + 11 <= count; j += 8)
+	{
+		x = _mm256_loadu_si256((const __m256i *)&s[j * 3]);
+		x = _mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(x, lanes), shuf);
+		_mm256_storeu_ps(&dst[j], _mm256_mul_ps(_mm256_cvtepi32_ps(x), scale));
+	}
+	s24_to_float_sse2(&s[j * 3], &dst[j], count - j);
+}
+
+/**
+ * @brief	Float to 24 bits, 8 samples at a time.
+ *
+ * The reverse of s24_to_float_avx2(). A store writes 8 bytes past the 8
+ * samples, so the last 3 samples are left to the scalar tail.
+ */
+__attribute__((target("avx2"))) static void
+float_to_s24_avx2(const float *src, void *dst, unsigned int count)
+{
+	uint8_t *d = dst;
+	const __m256 lo = _mm256_set1_ps(-8388608.0f),
+				 hi = _mm256_set1_ps(8388607.0f), scale = _mm256_set1_ps(256.0f);
+	const __m256i shuf = _mm256_setr_epi8(
+		0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+		0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+	const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+	__m256i x;
+	unsigned int j;
+
+	for (j = 0; j + 11 <= count; j += 8)
+	{
+		x = _mm256_cvtps_epi32(_mm256_min_ps(
+			_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(&src[j]), scale), lo),
+			hi));
+		x = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(x, shuf), lanes);
+		_mm256_storeu_si256((__m256i *)&d[j * 3], x);
+	}
+	float_to_s24_sse2(&src[j], &d[j * 3], count - j);
+}
+
+__attribute__((target("avx2"))) static void
+s32_to_float_avx2(const void *src, float *dst, unsigned int count)
+{
+	const uint8_t *s = src;
+	const __m256 scale = _mm256_set1_ps(S32_SCALE);
+	unsigned int j;
+
+	for (j = 0; j + 8 <= count; j += 8)
+		_mm256_storeu_ps(&dst[j],
+						 _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256(
+										   (const __m256i *)&s[j * 4])),
+									   scale));
+	s32_to_float_scalar(&s[j * 4], &dst[j], count - j);
+}
+
+__attribute__((target("avx2"))) static void
+float_to_s32_avx2(const float *src, void *dst, unsigned int count)
+{
+	uint8_t *d = dst;
+	const __m256 lo = _mm256_set1_ps(-S32_LIM), hi = _mm256_set1_ps(S32_LIM),
+				 scale = _mm256_set1_ps(65536.0f);
+	__m256 x;
+	unsigned int j;
+
+	// saturated as in float_to_s32_sse2()
+	for (j = 0; j + 8 <= count; j += 8)
+	{
+		x = _mm256_min_ps(
+			_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(&src[j]), scale), lo),
+			hi);
+		_mm256_storeu_si256(
+			(__m256i *)&d[j * 4],
+			_mm256_xor_si256(_mm256_cvtps_epi32(x),
+							 _mm256_castps_si256(_mm256_cmp_ps(x, hi, _CMP_GE_OQ))));
+	}
+	float_to_s32_scalar(&src[j], &d[j * 4], count - j);
+}
+
+__attribute__((target("avx2"))) static void
+f32_to_float_avx2(const void *src, float *dst, unsigned int count)
+{
+	const uint8_t *s = src;
+	const __m256 scale = _mm256_set1_ps(F32_SCALE);
+	unsigned int j;
+
+	for (j = 0; j + 8 <= count; j += 8)
+		_mm256_storeu_ps(&dst[j], _mm256_mul_ps(
+									  _mm256_loadu_ps((const float *)&s[j * 4]),
+									  scale));
+	f32_to_float_scalar(&s[j * 4], &dst[j], count - j);
+}
+
+__attribute__((target("avx2"))) static void
+float_to_f32_avx2(const float *src, void *dst, unsigned int count)
+{
+	uint8_t *d = dst;
+	const __m256 scale = _mm256_set1_ps(1.0f / F32_SCALE);
+	unsigned int j;
+
+	for (j = 0; j + 8 <= count; j += 8)
+		_mm256_storeu_ps((float *)&d[j * 4],
+						 _mm256_mul_ps(_mm256_loadu_ps(&src[j]), scale));
+	float_to_f32_scalar(&src[j], &d[j * 4], count - j);
+}
+#endif /* CONVERT_X86 */
+
+/*******************************************************************************
+ *				INTERLEAVE
+ ******************************************************************************/
+
+static void split_scalar(const float *src, float *const dst[], int nch,
+						 unsigned int count)
+{
+	unsigned int j;
+	int c;
+
+	for (c = 0; c < nch; c++)
+		for (j = 0; j < count; j++)
+			dst[c][j] = src[j * nch + c];
+}
+
+static void merge_scalar(const float *const src[], float *dst, int nch,
+						 unsigned int count)
+{
+	unsigned int j;
+	int c;
+
+	for (c = 0; c < nch; c++)
+		for (j = 0; j < count; j++)
+			dst[j * nch + c] = src[c][j];
+}
+
+#ifdef CONVERT_X86
+/**
+ * @brief	Any even no. channels, one pair of channels at a time.
+ *
+ * The pair of 4 frames is loaded with two 64 bit loads per register, then
+ * the even and the odd floats are the two channels.
+ */
+__attribute__((target("sse2"))) static void
+split_pairs_sse2(const float *src, float *const dst[], int nch,
+				 unsigned int count)
+{
+	__m128 x, y;
+	unsigned int j;
+	int c;
+
+	for (c = 0; c < nch; c += 2)
+	{
+		for (j = 0; j + 4 <= count; j += 4)
+		{
+			x = _mm_loadh_pi(_mm_castpd_ps(_mm_load_sd(
+								 (const double *)&src[j * nch + c])),
+							 (const __m64 *)&src[(j + 1) * nch + c]);
+			y = _mm_loadh_pi(_mm_castpd_ps(_mm_load_sd(
+								 (const double *)&src[(j + 2) * nch + c])),
+							 (const __m64 *)&src[(j + 3) * nch + c]);
+			_mm_storeu_ps(&dst[c][j], _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_storeu_ps(&dst[c + 1][j],
+						  _mm_shuffle_ps(x, y, _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+		for (; j < count; j++)
+		{
+			dst[c][j] = src[j * nch + c];
+			dst[c + 1][j] = src[j * nch + c + 1];
+		}
+	}
+}
+
+__attribute__((target("sse2"))) static void
+merge_pairs_sse2(const float *const src[], float *dst, int nch,
+				 unsigned int count)
+{
+	__m128 x, y, lo, hi;
+	unsigned int j;
+	int c;
+
+	for (c = 0; c < nch; c += 2)
+	{
+		for (j = 0; j + 4 <= count; j += 4)
+		{
+			x = _mm_loadu_ps(&src[c][j]);
+			y = _mm_loadu_ps(&src[c + 1][j]);
+			lo = _mm_unpacklo_ps(x, y);
+			hi = _mm_unpackhi_ps(x, y);
+			_mm_storel_pi((__m64 *)&dst[j * nch + c], lo);
+			_mm_storeh_pi((__m64 *)&dst[(j + 1) * nch + c], lo);
+			_mm_storel_pi((__m64 *)&dst[(j + 2) * nch + c], hi);
+			_mm_storeh_pi((__m64 *)&dst[(j + 3) * nch + c], hi);
+		}
+		for (; j < count; j++)
+		{
+			dst[j * nch + c] = src[c][j];
+			dst[j * nch + c + 1] = src[c + 1][j];
+		}
+	}
+}
+
+/**
+ * @brief	Stereo, 8 frames at a time.
+ *
+ * Shuffles work within the 128 bit lanes, so the quadwords are put back in
+ * order with a permutation.
+ */
+__attribute__((target("avx2"))) static void
+split_stereo_avx2(const float *src, float *const dst[], int nch,
+				  unsigned int count)
+{
+	__m256 x, y;
+	unsigned int j;
+
+	for (j = 0; j + 8 <= count; j += 8)
+	{
+		x = _mm256_loadu_ps(&src[j * 2]);
+		y = _mm256_loadu_ps(&src[j * 2 + 8]);
+		_mm256_storeu_ps(&dst[0][j], _mm256_castpd_ps(_mm256_permute4x64_pd(
+										 _mm256_castps_pd(_mm256_shuffle_ps(
+											 x, y, _MM_SHUFFLE(2, 0, 2, 0))),
+										 0xD8)));
+		_mm256_storeu_ps(&dst[1][j], _mm256_castpd_ps(_mm256_permute4x64_pd(
+										 _mm256_castps_pd(_mm256_shuffle_ps(
+											 x, y, _MM_SHUFFLE(3, 1, 3, 1))),
+										 0xD8)));
+	}
+	split_scalar(&src[j * 2], (float *const[]){&dst[0][j], &dst[1][j]}, nch,
+				 count - j);
+}
+
+__attribute__((target("avx2"))) static void
+merge_stereo_avx2(const float *const src[], float *dst, int nch,
+				  unsigned int count)
+{
+	__m256 x, y, lo, hi;
+	unsigned int j;
+
+	for (j = 0; j + 8 <= count; j += 8)
+	{
+		x = _mm256_loadu_ps(&src[0][j]);
+		y = _mm256_loadu_ps(&src[1][j]);
+		// frames 0, 1, 4, 5 and 2, 3, 6, 7
+		lo = _mm256_unpacklo_ps(x, y);
+		hi = _mm256_unpackhi_ps(x, y);
+		_mm256_storeu_ps(&dst[j * 2], _mm256_permute2f128_ps(lo, hi, 0x20));
+		_mm256_storeu_ps(&dst[j * 2 + 8], _mm256_permute2f128_ps(lo, hi, 0x31));
+	}
+	merge_scalar((const float *const[]){&src[0][j], &src[1][j]}, &dst[j * 2],
+				 nch, count - j);
+}
+#endif /* CONVERT_X86 */
+
+/*******************************************************************************
+ *				DISPATCH
+ ******************************************************************************/
+
+static const convert_t kernels[] = {
+	{"u8 scalar", CONVERT_U8, 8, CONVERT_SCALAR, u8_to_float_scalar,
+	 float_to_u8_scalar},
+	{"u16 scalar", CONVERT_U16, 16, CONVERT_SCALAR, u16_to_float_scalar,
+	 float_to_u16_scalar},
+	{"s16 scalar", CONVERT_S16, 16, CONVERT_SCALAR, s16_to_float_scalar,
+	 float_to_s16_scalar},
+	{"s24 scalar", CONVERT_S24, 24, CONVERT_SCALAR, s24_to_float_scalar,
+	 float_to_s24_scalar},
+	{"s32 scalar", CONVERT_S32, 32, CONVERT_SCALAR, s32_to_float_scalar,
+	 float_to_s32_scalar},
+	{"f32 scalar", CONVERT_F32, 32, CONVERT_SCALAR, f32_to_float_scalar,
+	 float_to_f32_scalar},
+#ifdef CONVERT_X86
+	{"u8 sse2", CONVERT_U8, 8, CONVERT_SSE2, u8_to_float_sse2,
+	 float_to_u8_sse2},
+	{"u16 sse2", CONVERT_U16, 16, CONVERT_SSE2, u16_to_float_sse2,
+	 float_to_u16_sse2},
+	{"s16 sse2", CONVERT_S16, 16, CONVERT_SSE2, s16_to_float_sse2,
+	 float_to_s16_sse2},
+	{"s24 sse2", CONVERT_S24, 24, CONVERT_SSE2, s24_to_float_sse2,
+	 float_to_s24_sse2},
+	{"s32 sse2", CONVERT_S32, 32, CONVERT_SSE2, s32_to_float_sse2,
+	 float_to_s32_sse2},
+	{"f32 sse2", CONVERT_F32, 32, CONVERT_SSE2, f32_to_float_sse2,
+	 float_to_f32_sse2},
+	{"u8 avx2", CONVERT_U8, 8, CONVERT_AVX2, u8_to_float_avx2,
+	 float_to_u8_avx2},
+	{"u16 avx2", CONVERT_U16, 16, CONVERT_AVX2, u16_to_float_avx2,
+	 float_to_u16_avx2},
+	{"s16 avx2", CONVERT_S16, 16, CONVERT_AVX2, s16_to_float_avx2,
+	 float_to_s16_avx2},
+	{"s24 avx2", CONVERT_S24, 24, CONVERT_AVX2, s24_to_float_avx2,
+	 float_to_s24_avx2},
+	{"s32 avx2", CONVERT_S32, 32, CONVERT_AVX2, s32_to_float_avx2,
+	 float_to_s32_avx2},
+	{"f32 avx2", CONVERT_F32, 32, CONVERT_AVX2, f32_to_float_avx2,
+	 float_to_f32_avx2},
+#endif
+}; /**< all the kernels, ordered from the slowest to the fastest. */
+
+#define NKERNELS (sizeof(kernels) / sizeof(kernels[0]))
+
+#define CH(n) (1u << (n))							/**< A no. channels. */
+#define CH_ANY (~0u << 1)							/**< Any no. channels. */
+#define CH_EVEN (CH(2) | CH(4) | CH(6) | CH(8)) /**< Even no. channels. */
+
+static const convert_ilv_t ilv_kernels[] = {
+	{"ilv scalar", CH_ANY, CONVERT_SCALAR, split_scalar, merge_scalar},
+#ifdef CONVERT_X86
+	{"ilv pairs sse2", CH_EVEN, CONVERT_SSE2, split_pairs_sse2,
+	 merge_pairs_sse2},
+	{"ilv stereo avx2", CH(2), CONVERT_AVX2, split_stereo_avx2,
+	 merge_stereo_avx2},
+#endif
+}; /**< all the interleave kernels, from the slowest to the fastest. */
+
+#define NILV_KERNELS (sizeof(ilv_kernels) / sizeof(ilv_kernels[0]))
+
+/**
+ * @brief	Check if the running CPU supports an instruction set.
+ */
+static int convert_isa_supported(convert_isa_t isa)
+{
+	switch (isa)
+	{
+	case CONVERT_SCALAR:
+		return 1;
+#ifdef CONVERT_X86
+	case CONVERT_SSE2:
+		return __builtin_cpu_supports("sse2");
+	case CONVERT_AVX2:
+		return __builtin_cpu_supports("avx2");
+#endif
+	default:
+		return 0;
+	}
+}
+
+const convert_t *convert_get(convert_fmt_t fmt, convert_isa_t isa)
+{
+	unsigned int i;
+
+	if (!convert_isa_supported(isa))
+		return NULL;
+	for (i = 0; i < NKERNELS; i++)
+	{
+		if (kernels[i].fmt == fmt && kernels[i].isa == isa)
+			return &kernels[i];
+	}
+	return NULL;
+}
+
+const convert_t *convert_select(convert_fmt_t fmt)
+{
+	const convert_t *best, *k;
+	int isa;
+
+	best = NULL;
+	for (isa = CONVERT_SCALAR; isa < CONVERT_NISA; isa++)
+	{
+		k = convert_get(fmt, isa);
+		if (k != NULL)
+			best = k;
+	}
+	return best;
+}
+
+const convert_ilv_t *convert_ilv_get(int nch, convert_isa_t isa)
+{
+	unsigned int i;
+
+	if (nch < 1 || nch > CONVERT_MAX_NCH || !convert_isa_supported(isa))
+		return NULL;
+	for (i = 0; i < NILV_KERNELS; i++)
+	{
+		if ((ilv_kernels[i].nch_mask & CH(nch)) && ilv_kernels[i].isa == isa)
+			return &ilv_kernels[i];
+	}
+	return NULL;
+}
+
+const convert_ilv_t *convert_ilv_select(int nch)
+{
+	const convert_ilv_t *best, *k;
+	int isa;
+
+	best = NULL;
+	for (isa = CONVERT_SCALAR; isa < CONVERT_NISA; isa++)
+	{
+		k = convert_ilv_get(nch, isa);
+		if (k != NULL)
+			best = k;
+	}
+	return best;
+}
@@ -6,20 +6,54 @@
  * @date 2019-03-19
  * 
  * This file contains the implementation of an audio equalizer
- * by means of four parallel peakingEQ filters
+ * by means of cascaded filters: the four peakingEQ filters of the player,
+ * ISO graphic presets or parametric bands. Filters are designed here,
+ * the filtering itself is done by a biquad cascade in a single pass.
+ * A long FIR can take the place of the bands, see fir.c.
  */
 #include "player/equalizer.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 
+#include <errno.h>
 #include <error.h>
 #include <math.h>
+#include <pthread.h>
+#include <string.h>
 
-static int audio_frequency; /**< sampling frequency of the input signal. */
+#include "player/biquad.h"
+#include "player/fft.h"
+#include "player/fir.h"
+#include "player/window.h"
+
+#if EQ_MAX_NFILT > CASCADE_MAX_SECT
+#error "EQ_MAX_NFILT must fit in a cascade"
+#endif
+#if EQ_MAX_NCH > CASCADE_MAX_NCH
+#error "EQ_MAX_NCH must fit in a cascade"
+#endif
+#if EQ_MAX_NCH > FIR_MAX_NCH
+#error "EQ_MAX_NCH must fit in a FIR"
+#endif
+
+static int audio_frequency = -1; /**< sampling frequency of the input
+                                      signal. */
 
 const int equalizer_freq[EQ_NFILT] = {250, 2000, 5000, 10000};
 /**< center frequencies of filters*/
 
+static const float eq_iso10_freq[] = {31.5f, 63, 125, 250, 500, 1000, 2000,
+                                      4000, 8000, 16000};
+/**< center frequencies of the ISO octave bands. */
+
+static const float eq_iso31_freq[] = {20, 25, 31.5f, 40, 50, 63, 80, 100, 125,
+                                      160, 200, 250, 315, 400, 500, 630, 800,
+                                      1000, 1250, 1600, 2000, 2500, 3150, 4000,
+                                      5000, 6300, 8000, 10000, 12500, 16000,
+                                      20000};
+/**< center frequencies of the ISO 1/3 octave bands. */
+
 /**
  * @brief contains all coefficients needed to filter a sample.
  * 
@@ -30,100 +64,337 @@ const int equalizer_freq[EQ_NFILT] = {250, 2000, 5000, 10000};
 typedef struct filter filter_t;
 struct filter
 {
-    float g;
-    float S_BW;
+    eq_band_t band;
     float w0;
     float s, c;
     float a1, a2;
     float b0, b1, b2;
-    float xmem1, xmem2;
-    float ymem1, ymem2;
     void (*calc_coef)(filter_t *);
 };
 
+static filter_t eq_filt[EQ_MAX_NFILT]; /**< coefficients for each band. */
+static int eq_nfilt;                   /**< no. bands of the layout. */
+static cascade_t eq_cascade; /**< filters state, processed in one pass. */
+
 /**
- * @brief set the gain of the filter
+ * Coefficients are designed by the threads that change the layout, under
+ * eq_mutex, and left here. The audio path takes them at the start of the
+ * next block only if the mutex is free, so it never waits for a design.
+ */
+static biquad_coef_t eq_pending[EQ_MAX_NFILT]; /**< designed coefficients. */
+static unsigned int eq_pending_mask; /**< bands with new coefficients. */
+static unsigned int eq_reset_mask;   /**< new bands, their state is reset. */
+static int eq_pending_nfilt;         /**< no. bands of the new layout. */
+static pthread_mutex_t eq_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * A band whose response changes keeps its state, and its coefficients are
+ * interpolated from the old to the new ones in EQ_RAMP_LEN / EQ_RAMP_STEP
+ * steps. These are used only by the audio path.
+ */
+static biquad_coef_t eq_from[EQ_MAX_NFILT]; /**< coefficients at ramp start. */
+static biquad_coef_t eq_to[EQ_MAX_NFILT];   /**< coefficients at ramp end. */
+static unsigned int eq_ramp_mask; /**< bands being ramped. */
+static unsigned int eq_ramp_pos;  /**< samples filtered since ramp start. */
+static char eq_running;           /**< samples filtered since init. */
+
+/**
+ * FIRs, one per mode that needs it, are built and planned by the thread
+ * that sets them, and handed to the audio path as the coefficients are.
+ * What the audio path replaces is freed at the next change, never by the
+ * audio path itself.
+ */
+static fir_t *eq_fir[EQ_NMODE];         /**< FIRs of the audio path. */
+static fir_t *eq_fir_pending[EQ_NMODE]; /**< new FIRs, not taken yet. */
+static fir_t *eq_fir_old[EQ_NMODE];     /**< FIRs replaced. */
+static float *eq_fir_taps;    /**< impulse response of EQ_MODE_FIR, to build
+                                   it again for another no. channels. */
+static int eq_fir_ntaps;      /**< length of the impulse response. */
+static int eq_fir_part;       /**< samples of a partition. */
+static eq_mode_t eq_mode;         /**< mode of the audio path. */
+static eq_mode_t eq_pending_mode; /**< mode selected. */
+
+/**
+ * The linear phase FIR has the magnitude response of the bands. A change
+ * of the bands only marks the design stale, as it can come from the audio
+ * path: equalizer_update designs it again, one design at a time under
+ * eq_lin_mutex, and only its kernel is handed to the audio path: the state
+ * is kept and the change crossfaded.
+ */
+static fir_kernel_t *eq_lin_pending; /**< new kernel, not taken yet. */
+static fir_kernel_t *eq_lin_old;     /**< kernel replaced. */
+static char eq_lin_on;               /**< linear phase selected once. */
+static int eq_lin_size;              /**< samples of the design transform. */
+static float *eq_lin_taps;           /**< impulse response designed. */
+static fftwf_complex *eq_lin_spect;  /**< response designed. */
+static const window_t *eq_lin_win;   /**< window of the response. */
+static char eq_lin_dirty;            /**< bands changed since the design,
+                                          under eq_mutex. */
+static pthread_mutex_t eq_lin_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief publish the coefficients of a filter to the audio path
  * 
- * @param f[inout] pointer to the filter
- * @param gain[in] value of the gain in dB
+ * Must be called with eq_mutex held.
+ * 
+ * @param i[in] index of the filter
+ * @param reset[in] zero the state of the filter, as a new filter would have,
+ *                  instead of moving smoothly to the new coefficients
  */
-static void filt_set_gain(filter_t *f, float gain)
+static void eq_publish(int i, int reset)
 {
-    f->g = gain;
-    f->calc_coef(f);
+    eq_pending[i].b0 = eq_filt[i].b0;
+    eq_pending[i].b1 = eq_filt[i].b1;
+    eq_pending[i].b2 = eq_filt[i].b2;
+    eq_pending[i].a1 = eq_filt[i].a1;
+    eq_pending[i].a2 = eq_filt[i].a2;
+    eq_pending_mask |= 1u << i;
+    if (reset)
+        eq_reset_mask |= 1u << i;
+}
+
+/**
+ * @brief current coefficients of a section of the cascade
+ */
+static biquad_coef_t eq_current(int i)
+{
+    biquad_coef_t coef = {
+        .b0 = eq_cascade.b0[i],
+        .b1 = eq_cascade.b1[i],
+        .b2 = eq_cascade.b2[i],
+        .a1 = eq_cascade.a1[i],
+        .a2 = eq_cascade.a2[i],
+    };
+
+    return coef;
 }
 
 /**
- * @brief filter a single sample if time data
+ * @brief load the published coefficients in the cascade
  * 
- * @param[in] i 	index of the filter to use for filtering
- * @param[in] x 	sample of time data
- * @return float 	resulting filtered sample
+ * Before the first sample is filtered there is nothing to be smooth with,
+ * so all the changes are immediate. Must be called with eq_mutex held.
  */
-static float filter_filt(filter_t *f, float x)
+static void eq_load()
 {
-    double y;
+    unsigned int bit;
 
-    y = f->b0 * x +
-        f->b1 * f->xmem1 +
-        f->b2 * f->xmem2 -
-        f->a1 * f->ymem1 -
-        f->a2 * f->ymem2;
+    eq_cascade.nsect = eq_pending_nfilt;
+    for (int i = 0; i < EQ_MAX_NFILT; i++)
+    {
+        bit = 1u << i;
+        if (eq_pending_mask & bit)
+        {
+            if (!eq_running || (eq_reset_mask & bit))
+            {
+                cascade_set(&eq_cascade, i, &eq_pending[i]);
+                cascade_reset(&eq_cascade, i);
+                eq_ramp_mask &= ~bit;
+            }
+            else
+            {
+                eq_to[i] = eq_pending[i];
+                eq_ramp_mask |= bit;
+            }
+        }
+    }
+    // bands halfway through a ramp start again from where they are
+    for (int i = 0; i < EQ_MAX_NFILT; i++)
+    {
+        if (eq_ramp_mask & (1u << i))
+            eq_from[i] = eq_current(i);
+    }
+    eq_ramp_pos = 0;
+    eq_pending_mask = 0;
+    eq_reset_mask = 0;
+}
 
-    f->xmem2 = f->xmem1;
-    f->xmem1 = x;
-    f->ymem2 = f->ymem1;
-    f->ymem1 = y;
+/**
+ * @brief take the FIR and the mode selected
+ * 
+ * A mode starts from a zero state. Must be called with eq_mutex held.
+ */
+static void eq_load_mode()
+{
+    for (int m = 0; m < EQ_NMODE; m++)
+    {
+        if (eq_fir_pending[m] != NULL)
+        {
+            eq_fir_old[m] = eq_fir[m];
+            eq_fir[m] = eq_fir_pending[m];
+            eq_fir_pending[m] = NULL;
+        }
+    }
+    if (eq_lin_pending != NULL && eq_fir[EQ_MODE_LINEAR] != NULL)
+    {
+        eq_lin_old = fir_set_kernel(eq_fir[EQ_MODE_LINEAR], eq_lin_pending);
+        eq_lin_pending = NULL;
+    }
+    if (eq_mode != eq_pending_mode)
+    {
+        eq_mode = eq_pending_mode;
+        if (eq_mode != EQ_MODE_BANDS)
+            fir_reset(eq_fir[eq_mode]);
+        else
+            cascade_reset(&eq_cascade, -1);
+    }
+}
 
-    return y;
+/**
+ * @brief hand a new FIR of a mode to the audio path
+ * 
+ * Must be called with eq_mutex held.
+ */
+static void eq_fir_publish(eq_mode_t mode, fir_t *fir)
+{
+    // the audio path leaves at most one FIR behind between two changes
+    fir_delete(eq_fir_old[mode]);
+    eq_fir_old[mode] = NULL;
+    fir_delete(eq_fir_pending[mode]);
+    eq_fir_pending[mode] = fir;
 }
 
 /**
- * @brief filter a buffer(stream) of time data
+ * @brief free all the FIRs, nobody must be equalizing
+ */
+static void eq_fir_drop()
+{
+    for (int m = 0; m < EQ_NMODE; m++)
+    {
+        fir_delete(eq_fir[m]);
+        fir_delete(eq_fir_pending[m]);
+        fir_delete(eq_fir_old[m]);
+        eq_fir[m] = eq_fir_pending[m] = eq_fir_old[m] = NULL;
+    }
+    fir_kernel_delete(eq_lin_pending);
+    fir_kernel_delete(eq_lin_old);
+    eq_lin_pending = eq_lin_old = NULL;
+}
+
+/**
+ * @brief design the linear phase response of the bands
  * 
- * @param[in] i			index of the filter to use for filtering
- * @param[inout] buf	time-data samples 
- * @param count 		number of samples in buf
+ * The magnitude of the cascade is sampled at eq_lin_size / 2 + 1
+ * frequencies, with the phase of a delay of half the transform, and
+ * transformed back. The response is windowed to its symmetric part, one
+ * sample shorter than the transform. Must be called with eq_lin_mutex held.
  */
-static void filter_filtb(filter_t *f, float buf[], unsigned int count)
+static void eq_lin_design()
 {
-    int j;
+    biquad_coef_t coef[EQ_MAX_NFILT];
+    double w, c1, s1, c2, s2, nr, ni, dr, di, mag;
+    int n = eq_lin_size, nfilt;
 
-    for (j = 0; j < count; j++)
+    pthread_mutex_lock(&eq_mutex);
+    eq_lin_dirty = 0;
+    nfilt = eq_nfilt;
+    for (int i = 0; i < nfilt; i++)
     {
-        buf[j] = filter_filt(f, buf[j]);
+        coef[i].b0 = eq_filt[i].b0;
+        coef[i].b1 = eq_filt[i].b1;
+        coef[i].b2 = eq_filt[i].b2;
+        coef[i].a1 = eq_filt[i].a1;
+        coef[i].a2 = eq_filt[i].a2;
     }
+    pthread_mutex_unlock(&eq_mutex);
+    for (int k = 0; k <= n / 2; k++)
+    {
+        w = 2 * M_PI * k / n;
+        c1 = cos(w);
+        s1 = sin(w);
+        c2 = cos(2 * w);
+        s2 = sin(2 * w);
+        mag = 1;
+        for (int i = 0; i < nfilt; i++)
+        {
+            nr = coef[i].b0 + coef[i].b1 * c1 + coef[i].b2 * c2;
+            ni = coef[i].b1 * s1 + coef[i].b2 * s2;
+            dr = 1 + coef[i].a1 * c1 + coef[i].a2 * c2;
+            di = coef[i].a1 * s1 + coef[i].a2 * s2;
+            mag *= sqrt((nr * nr + ni * ni) / (dr * dr + di * di));
+        }
+        // a delay of n / 2 turns the phase by pi every bin
+        eq_lin_spect[k][0] = (k % 2) ? -mag / n : mag / n;
+        eq_lin_spect[k][1] = 0;
+    }
+    fft_c2r(n, eq_lin_spect, eq_lin_taps);
+    // symmetric around n / 2, the first sample has no pair
+    for (int i = 0; i < n - 1; i++)
+        eq_lin_taps[i] = eq_lin_taps[i + 1] * eq_lin_win->w[i];
 }
 
 /**
- * @brief calculate coefficients, of a filter, that depends only from gain
+ * @brief build the linear phase FIR for a no. channels
  * 
- * @param f[inout] pointer to the filter
+ * @return fir_t* the filter, NULL on error
  */
-static void low_shelf_filter_calc_coef(filter_t *f)
+static fir_t *eq_lin_build(int nch)
 {
-    float a0, a1, a2;
-    float b0, b1, b2;
-    float A, a, S_BW;
-    float cosW0, sinW0;
+    fir_t *fir;
 
-    A = powf(10, f->g / 40);
-    S_BW = f->S_BW;
-    sinW0 = f->s;
-    cosW0 = f->c;
+    pthread_mutex_lock(&eq_lin_mutex);
+    if (!eq_lin_on)
+    {
+        // the design is as long at any rate, as the analysis window
+        for (eq_lin_size = EQ_LIN_SIZE;
+             audio_frequency > EQ_LIN_FREQ * (eq_lin_size / EQ_LIN_SIZE);
+             eq_lin_size *= 2)
+            ;
+        eq_lin_win = window_get(WIN_HANN, eq_lin_size - 1, 0);
+        if (eq_lin_win == NULL || fft_plan(eq_lin_size) < 0)
+        {
+            pthread_mutex_unlock(&eq_lin_mutex);
+            return NULL;
+        }
+        eq_lin_taps = fft_alloc_real(eq_lin_size);
+        eq_lin_spect = fft_alloc_cpx(eq_lin_size / 2 + 1);
+        eq_lin_on = 1;
+    }
+    eq_lin_design();
+    fir = fir_new(eq_lin_taps, eq_lin_size - 1, EQ_LIN_PART, nch);
+    pthread_mutex_unlock(&eq_lin_mutex);
+    return fir;
+}
 
-    a = sinW0 * sqrtf((A + (1.0f / A)) * ((1.0f / S_BW) - 1.0f) + 2.0f);
-    a0 = (A + 1.0f) + (A - 1.0f) * cosW0 + 2.0f * sqrtf(A) * a;
-    a1 = -2.0f * ((A - 1.0f) + (A + 1.0f) * cosW0);
-    a2 = (A + 1.0f) + (A - 1.0f) * cosW0 - 2.0f * sqrtf(A) * a;
-    b0 = A * ((A + 1.0f) - (A - 1.0f) * cosW0 + 2.0f * sqrt(A) * a);
-    b1 = 2.0f * A * ((A - 1.0f) - (A + 1.0f) * cosW0);
-    b2 = A * ((A + 1.0f) - (A - 1.0f) * cosW0 - 2.0f * sqrtf(A) * a);
-    f->xmem1 = 0.0f;
-    f->xmem2 = 0.0f;
-    f->ymem1 = 0.0f;
-    f->ymem2 = 0.0f;
+/**
+ * @brief set the coefficients of the ramping bands for the next step
+ * 
+ * The set of stable biquads is convex in (a1, a2), so each step is stable.
+ * 
+ * @param step[in] index of the step, from 0
+ */
+static void eq_ramp_step(unsigned int step)
+{
+    const unsigned int nstep = EQ_RAMP_LEN / EQ_RAMP_STEP;
+    float t = (float)(step + 1) / nstep;
+    biquad_coef_t coef;
+
+    for (int i = 0; i < EQ_MAX_NFILT; i++)
+    {
+        if (!(eq_ramp_mask & (1u << i)))
+            continue;
+        if (step + 1 == nstep)
+        {
+            cascade_set(&eq_cascade, i, &eq_to[i]);
+            continue;
+        }
+        coef.b0 = eq_from[i].b0 + t * (eq_to[i].b0 - eq_from[i].b0);
+        coef.b1 = eq_from[i].b1 + t * (eq_to[i].b1 - eq_from[i].b1);
+        coef.b2 = eq_from[i].b2 + t * (eq_to[i].b2 - eq_from[i].b2);
+        coef.a1 = eq_from[i].a1 + t * (eq_to[i].a1 - eq_from[i].a1);
+        coef.a2 = eq_from[i].a2 + t * (eq_to[i].a2 - eq_from[i].a2);
+        cascade_set(&eq_cascade, i, &coef);
+    }
+}
 
+/**
+ * @brief normalize the coefficients by a0 and store them in the filter
+ * 
+ * @param f[inout] pointer to the filter
+ */
+static void filt_store_coef(filter_t *f, float a0, float a1, float a2,
+                            float b0, float b1, float b2)
+{
     f->a1 = a1 / a0;
     f->a2 = a2 / a0;
     f->b0 = b0 / a0;
@@ -132,21 +403,14 @@ static void low_shelf_filter_calc_coef(filter_t *f)
 }
 
 /**
- * @brief initializes the coefficients that depend only from audio frequency
+ * @brief set the gain of the filter
  * 
  * @param f[inout] pointer to the filter
- * @param frequency[in] frequency of the track that will be filt
+ * @param gain[in] value of the gain in dB
  */
-static void low_shelf_filter_init(filter_t *f, int frequency)
+static void filt_set_gain(filter_t *f, float gain)
 {
-    f->g = 0;
-    f->S_BW = 1;
-
-    f->w0 = 2.0f * M_PI * ((float)frequency) / ((float)audio_frequency);
-    f->c = cos(f->w0);
-    f->s = sin(f->w0);
-
-    f->calc_coef = low_shelf_filter_calc_coef;
+    f->band.gain = gain;
     f->calc_coef(f);
 }
 
@@ -155,54 +419,49 @@ static void low_shelf_filter_init(filter_t *f, int frequency)
  * 
  * @param f[inout] pointer to the filter
  */
-static void high_shelf_filter_calc_coef(filter_t *f)
+static void low_shelf_filter_calc_coef(filter_t *f)
 {
-    float a0, a1, a2;
-    float b0, b1, b2;
-    float A, a, S_BW;
+    float A, a, sqA;
     float cosW0, sinW0;
 
-    A = powf(10, f->g / 40);
-    S_BW = f->S_BW;
-    cosW0 = f->c;
+    A = powf(10, f->band.gain / 40);
+    sqA = sqrtf(A);
     sinW0 = f->s;
+    cosW0 = f->c;
 
-    a = sinW0 * sqrtf((A + (1.0f / A)) * ((1.0f / S_BW) - 1.0f) + 2.0f);
-    b0 = A * ((A + 1.0f) + (A - 1.0f) * cosW0 + 2.0f * sqrtf(A) * a);
-    b1 = -2.0f * A * ((A - 1.0f) + (A + 1.0f) * cosW0);
-    b2 = A * ((A + 1.0f) + (A - 1.0f) * cosW0 - 2.0f * sqrtf(A) * a);
-    a0 = (A + 1.0f) - (A - 1.0f) * cosW0 + 2.0f * sqrtf(A) * a;
-    a1 = 2.0f * ((A - 1.0f) - (A + 1.0f) * cosW0);
-    a2 = (A + 1.0f) - (A - 1.0f) * cosW0 - 2.0f * sqrtf(A) * a;
-    f->xmem1 = 0.0f;
-    f->xmem2 = 0.0f;
-    f->ymem1 = 0.0f;
-    f->ymem2 = 0.0f;
-
-    f->a1 = a1 / a0;
-    f->a2 = a2 / a0;
-    f->b0 = b0 / a0;
-    f->b1 = b1 / a0;
-    f->b2 = b2 / a0;
+    a = sinW0 / (2.0f * f->band.q);
+    filt_store_coef(f,
+                    (A + 1.0f) + (A - 1.0f) * cosW0 + 2.0f * sqA * a,
+                    -2.0f * ((A - 1.0f) + (A + 1.0f) * cosW0),
+                    (A + 1.0f) + (A - 1.0f) * cosW0 - 2.0f * sqA * a,
+                    A * ((A + 1.0f) - (A - 1.0f) * cosW0 + 2.0f * sqA * a),
+                    2.0f * A * ((A - 1.0f) - (A + 1.0f) * cosW0),
+                    A * ((A + 1.0f) - (A - 1.0f) * cosW0 - 2.0f * sqA * a));
 }
 
 /**
- * @brief initializes the coefficients that depend only from audio frequency
+ * @brief calculate coefficients, of a filter, that depends only from gain
  * 
  * @param f[inout] pointer to the filter
- * @param frequency[in] frequency of the track that will be filt
  */
-static void high_shelf_filter_init(filter_t *f, int frequency)
+static void high_shelf_filter_calc_coef(filter_t *f)
 {
-    f->g = 0;
-    f->S_BW = 1;
+    float A, a, sqA;
+    float cosW0, sinW0;
 
-    f->w0 = 2.0f * M_PI * ((float)frequency) / ((float)audio_frequency);
-    f->c = cos(f->w0);
-    f->s = sin(f->w0);
+    A = powf(10, f->band.gain / 40);
+    sqA = sqrtf(A);
+    cosW0 = f->c;
+    sinW0 = f->s;
 
-    f->calc_coef = high_shelf_filter_calc_coef;
-    f->calc_coef(f);
+    a = sinW0 / (2.0f * f->band.q);
+    filt_store_coef(f,
+                    (A + 1.0f) - (A - 1.0f) * cosW0 + 2.0f * sqA * a,
+                    2.0f * ((A - 1.0f) - (A + 1.0f) * cosW0),
+                    (A + 1.0f) - (A - 1.0f) * cosW0 - 2.0f * sqA * a,
+                    A * ((A + 1.0f) + (A - 1.0f) * cosW0 + 2.0f * sqA * a),
+                    -2.0f * A * ((A - 1.0f) + (A + 1.0f) * cosW0),
+                    A * ((A + 1.0f) + (A - 1.0f) * cosW0 - 2.0f * sqA * a));
 }
 
 /**
@@ -212,57 +471,153 @@ static void high_shelf_filter_init(filter_t *f, int frequency)
  */
 static void peakingEQ_filter_calc_coef(filter_t *f)
 {
-    float a0, a1, a2;
-    float b0, b1, b2;
-    float A, a, S_BW;
-    float w0, cosW0, sinW0;
+    float A, a;
+    float cosW0, sinW0;
 
-    A = powf(10, f->g / 40);
-    S_BW = f->S_BW;
-    w0 = f->w0;
+    A = powf(10, f->band.gain / 40);
     cosW0 = f->c;
     sinW0 = f->s;
 
-    a = sinW0 * sinhf((logf(2.0f) / 2.0f) * S_BW * w0 / sinW0);
-    a0 = 1.0f + a / A;
-    a1 = -2.0f * cosW0;
-    a2 = 1.0f - a / A;
-    b0 = 1.0f + a * A;
-    b1 = -2.0f * cosW0;
-    b2 = 1.0f - a * A;
-    f->xmem1 = 0.0f;
-    f->xmem2 = 0.0f;
-    f->ymem1 = 0.0f;
-    f->ymem2 = 0.0f;
+    a = sinW0 / (2.0f * f->band.q);
+    filt_store_coef(f, 1.0f + a / A, -2.0f * cosW0, 1.0f - a / A,
+                    1.0f + a * A, -2.0f * cosW0, 1.0f - a * A);
+}
 
-    f->a1 = a1 / a0;
-    f->a2 = a2 / a0;
-    f->b0 = b0 / a0;
-    f->b1 = b1 / a0;
-    f->b2 = b2 / a0;
+/**
+ * @brief calculate coefficients of a low pass filter, gain is ignored
+ * 
+ * @param f[inout] pointer to the filter
+ */
+static void low_pass_filter_calc_coef(filter_t *f)
+{
+    float a = f->s / (2.0f * f->band.q);
+    float cosW0 = f->c;
+
+    filt_store_coef(f, 1.0f + a, -2.0f * cosW0, 1.0f - a,
+                    (1.0f - cosW0) / 2.0f, 1.0f - cosW0, (1.0f - cosW0) / 2.0f);
 }
 
 /**
- * @brief initializes the coefficients that depend only from audio frequency
+ * @brief calculate coefficients of a high pass filter, gain is ignored
  * 
  * @param f[inout] pointer to the filter
- * @param frequency[in] frequency of the track that will be filt
  */
-static void peakingEQ_filter_init(filter_t *f, int frequency)
+static void high_pass_filter_calc_coef(filter_t *f)
+{
+    float a = f->s / (2.0f * f->band.q);
+    float cosW0 = f->c;
+
+    filt_store_coef(f, 1.0f + a, -2.0f * cosW0, 1.0f - a,
+                    (1.0f + cosW0) / 2.0f, -(1.0f + cosW0),
+                    (1.0f + cosW0) / 2.0f);
+}
+
+/**
+ * @brief calculate coefficients of a notch filter, gain is ignored
+ * 
+ * @param f[inout] pointer to the filter
+ */
+static void notch_filter_calc_coef(filter_t *f)
+{
+    float a = f->s / (2.0f * f->band.q);
+    float cosW0 = f->c;
+
+    filt_store_coef(f, 1.0f + a, -2.0f * cosW0, 1.0f - a,
+                    1.0f, -2.0f * cosW0, 1.0f);
+}
+
+/**
+ * @brief identity, for bands that can't be represented at audio frequency
+ * 
+ * @param f[inout] pointer to the filter
+ */
+static void flat_filter_calc_coef(filter_t *f)
+{
+    filt_store_coef(f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f);
+}
+
+static void (*const filter_calc_coef[EQ_NTYPE])(filter_t *) = {
+    [EQ_PEAK] = peakingEQ_filter_calc_coef,
+    [EQ_LOW_SHELF] = low_shelf_filter_calc_coef,
+    [EQ_HIGH_SHELF] = high_shelf_filter_calc_coef,
+    [EQ_LOW_PASS] = low_pass_filter_calc_coef,
+    [EQ_HIGH_PASS] = high_pass_filter_calc_coef,
+    [EQ_NOTCH] = notch_filter_calc_coef,
+};
+/**< coefficient design of each band type. */
+
+/**
+ * @brief Q of a peaking filter with the given bandwidth in octaves
+ * 
+ * The bandwidth is measured between the midpoint gain frequencies, with the
+ * bilinear transform warping, as in the cookbook.
+ * 
+ * @param w0[in] normalized angular frequency of the band
+ * @param bw[in] bandwidth in octaves
+ * @return float the quality factor
+ */
+static float bw_to_q(float w0, float bw)
 {
-    f->g = 0;
-    f->S_BW = 1;
+    return 1.0f / (2.0f * sinhf((logf(2.0f) / 2.0f) * bw * w0 / sinf(w0)));
+}
 
-    f->w0 = 2.0f * M_PI * ((float)frequency) / ((float)audio_frequency);
+/**
+ * @brief initializes the coefficients that depend only from audio frequency
+ * 
+ * Bands outside ]0, Nyquist[ are left flat.
+ * 
+ * @param f[inout] pointer to the filter
+ * @param band[in] parameters of the band
+ */
+static void filter_init(filter_t *f, const eq_band_t *band)
+{
+    f->band = *band;
+    f->w0 = 2.0f * M_PI * band->freq / ((float)audio_frequency);
     f->c = cos(f->w0);
     f->s = sin(f->w0);
 
-    f->calc_coef = peakingEQ_filter_calc_coef;
+    if (band->freq <= 0 || 2.0f * band->freq >= audio_frequency)
+        f->calc_coef = flat_filter_calc_coef;
+    else
+        f->calc_coef = filter_calc_coef[band->type];
     f->calc_coef(f);
 }
 
-static filter_t eq_filt[EQ_NFILT]; /**< coefficients for each filter 
-                                        of the player. */
+/**
+ * @brief check the parameters of a band
+ * 
+ * @param band[in] parameters of the band
+ * @return int 0 if valid, -1 otherwise
+ */
+static int band_check(const eq_band_t *band)
+{
+    if (band->type < 0 || band->type >= EQ_NTYPE)
+    {
+        error_at_line(0, 0, __FILE__, __LINE__,
+                      "invalid band type %d", band->type);
+        return -1;
+    }
+    if (!(band->q > 0) || !(band->freq > 0))
+    {
+        error_at_line(0, 0, __FILE__, __LINE__,
+                      "invalid band, freq %f and Q %f must be positive",
+                      band->freq, band->q);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief clamp a gain to +-EQ_FILT_MAX_GAIN
+ */
+static float gain_clamp(float gain)
+{
+    if (fabs(gain) > EQ_FILT_MAX_GAIN)
+    {
+        gain = (gain < 0) ? -EQ_FILT_MAX_GAIN : EQ_FILT_MAX_GAIN;
+    }
+    return gain;
+}
 
 /**
  * @brief initialize the equalizer
@@ -277,10 +632,59 @@ void equalizer_init(int freq)
                       "audio frequency can't be negative: %d", freq);
     }
     audio_frequency = freq;
-    for (int i = 0; i < EQ_NFILT; i++)
+    cascade_init(&eq_cascade, 0, 1);
+    eq_ramp_mask = 0;
+    eq_running = 0;
+    eq_fir_drop();
+    free(eq_fir_taps);
+    eq_fir_taps = NULL;
+    eq_mode = eq_pending_mode = EQ_MODE_BANDS;
+    // the design depends on the rate, it is done again when selected
+    fft_free(eq_lin_taps);
+    fft_free(eq_lin_spect);
+    eq_lin_taps = NULL;
+    eq_lin_spect = NULL;
+    eq_lin_on = 0;
+    equalizer_set_preset(EQ_PRESET_PLAYER);
+    // nobody can be equalizing yet, start with the new layout
+    pthread_mutex_lock(&eq_mutex);
+    eq_load();
+    pthread_mutex_unlock(&eq_mutex);
+}
+
+/**
+ * @brief set the number of channels equalized
+ * 
+ * @param nch number of channels
+ * @return int 0 on success, -1 on error
+ */
+int equalizer_set_nch(int nch)
+{
+    if (nch < 1 || nch > EQ_MAX_NCH)
     {
-        peakingEQ_filter_init(&(eq_filt[i]), equalizer_freq[i]);
+        error_at_line(0, 0, __FILE__, __LINE__,
+                      "%d channels, min is 1, max is %d", nch, EQ_MAX_NCH);
+        return -1;
     }
+    // a FIR has a state per channel, they are built again
+    fir_t *fir = NULL, *lin = NULL;
+
+    if (eq_fir_taps != NULL)
+        fir = fir_new(eq_fir_taps, eq_fir_ntaps, eq_fir_part, nch);
+    if (eq_lin_on)
+        lin = eq_lin_build(nch);
+    if ((eq_fir_taps != NULL && fir == NULL) || (eq_lin_on && lin == NULL))
+    {
+        fir_delete(fir);
+        fir_delete(lin);
+        return -1;
+    }
+    eq_fir_drop();
+    eq_fir[EQ_MODE_FIR] = fir;
+    eq_fir[EQ_MODE_LINEAR] = lin;
+    eq_cascade.nch = nch;
+    cascade_reset(&eq_cascade, -1);
+    return 0;
 }
 
 /**
@@ -292,12 +696,67 @@ void equalizer_init(int freq)
  */
 int equalizer_equalize(float buf[], unsigned int count)
 {
+    if (eq_cascade.nch != 1)
+    {
+        error_at_line(0, 0, __FILE__, __LINE__,
+                      "%d channels to equalize, not a mono buffer",
+                      eq_cascade.nch);
+        return -1;
+    }
+    return equalizer_equalize_ch(&buf, count);
+}
+
+/**
+ * @brief equalize a block of each channel
+ * 
+ * @param buf buffers of each channel
+ * @param count number of samples in each buffer
+ * @return int number of samples equalized, -1 on error
+ */
+int equalizer_equalize_ch(float *const buf[], unsigned int count)
+{
+    float *at[EQ_MAX_NCH]; /**< where each channel is at. */
+
     if (audio_frequency < 0)
     { // equalizer init not called
         return -1;
     }
-    for (int i = 0; i < EQ_NFILT; i++)
-        filter_filtb(&eq_filt[i], buf, count);
+    // new coefficients are taken now or at the next block, never waited
+    if (pthread_mutex_trylock(&eq_mutex) == 0)
+    {
+        if (eq_pending_mask != 0)
+            eq_load();
+        eq_load_mode();
+        pthread_mutex_unlock(&eq_mutex);
+    }
+    if (eq_mode != EQ_MODE_BANDS)
+    {
+        fir_process(eq_fir[eq_mode], buf, count);
+        if (count > 0)
+            eq_running = 1;
+        return count;
+    }
+    // ramp steps are counted in samples, so that they don't depend on how
+    // the stream is split in blocks
+    for (unsigned int off = 0, n; off < count; off += n)
+    {
+        n = count - off;
+        if (eq_ramp_mask != 0)
+        {
+            if (eq_ramp_pos % EQ_RAMP_STEP == 0)
+                eq_ramp_step(eq_ramp_pos / EQ_RAMP_STEP);
+            if (n > EQ_RAMP_STEP - eq_ramp_pos % EQ_RAMP_STEP)
+                n = EQ_RAMP_STEP - eq_ramp_pos % EQ_RAMP_STEP;
+            eq_ramp_pos += n;
+            if (eq_ramp_pos == EQ_RAMP_LEN)
+                eq_ramp_mask = 0;
+        }
+        for (int ch = 0; ch < eq_cascade.nch; ch++)
+            at[ch] = &buf[ch][off];
+        cascade_process(&eq_cascade, at, n);
+    }
+    if (count > 0)
+        eq_running = 1;
     return count;
 }
 
@@ -308,19 +767,304 @@ int equalizer_equalize(float buf[], unsigned int count)
  * @param gain gain value
  * @return int the new gain of the filter, -1 on error.
  */
-float equalizer_set_gain(int filt, float gain)
+int equalizer_set_gain(int filt, float gain, float *set)
 {
-    if (filt < 0 || filt >= EQ_NFILT)
+    pthread_mutex_lock(&eq_mutex);
+    if (filt < 0 || filt >= eq_nfilt)
     {
         error_at_line(0, 0, __FILE__, __LINE__,
                       "filter index out of bound %d, min is %d, max is %d",
-                      filt, 0, EQ_NFILT - 1);
-        return -EQ_FILT_MAX_GAIN - 1;
+                      filt, 0, eq_nfilt - 1);
+        pthread_mutex_unlock(&eq_mutex);
+        return -1;
     }
-    if (fabs(gain) > EQ_FILT_MAX_GAIN)
+    filt_set_gain(&eq_filt[filt], gain_clamp(gain));
+    eq_publish(filt, 0);
+    eq_lin_dirty = 1;
+    if (set != NULL)
+        *set = eq_filt[filt].band.gain;
+    pthread_mutex_unlock(&eq_mutex);
+    return 0;
+}
+
+int equalizer_set_preset(eq_preset_t preset)
+{
+    eq_band_t bands[EQ_MAX_NFILT];
+    const float *freq;
+    float bw;
+    int n;
+
+    switch (preset)
     {
-        gain = (gain < 0) ? -EQ_FILT_MAX_GAIN : EQ_FILT_MAX_GAIN;
+    case EQ_PRESET_PLAYER:
+        for (n = 0; n < EQ_NFILT; n++)
+            bands[n].freq = equalizer_freq[n];
+        bw = EQ_FILT_BW;
+        freq = NULL;
+        break;
+    case EQ_PRESET_ISO10:
+        freq = eq_iso10_freq;
+        n = sizeof(eq_iso10_freq) / sizeof(eq_iso10_freq[0]);
+        bw = 1.0f;
+        break;
+    case EQ_PRESET_ISO31:
+        freq = eq_iso31_freq;
+        n = sizeof(eq_iso31_freq) / sizeof(eq_iso31_freq[0]);
+        bw = 1.0f / 3.0f;
+        break;
+    default:
+        error_at_line(0, 0, __FILE__, __LINE__, "unknown preset %d", preset);
+        return -1;
+    }
+    for (int i = 0; i < n; i++)
+    {
+        if (freq != NULL)
+            bands[i].freq = freq[i];
+        bands[i].type = EQ_PEAK;
+        bands[i].gain = 0;
+        // Q from the bandwidth, flat bands don't use it
+        if (2.0f * bands[i].freq < audio_frequency)
+            bands[i].q = bw_to_q(2.0f * M_PI * bands[i].freq / audio_frequency,
+                                 bw);
+        else
+            bands[i].q = M_SQRT1_2;
+    }
+    if (equalizer_set_layout(bands, n) < 0)
+        return -1;
+    return n;
+}
+
+int equalizer_set_layout(const eq_band_t bands[], int nband)
+{
+    if (nband < 0 || nband > EQ_MAX_NFILT)
+    {
+        error_at_line(0, 0, __FILE__, __LINE__,
+                      "%d bands, min is %d, max is %d", nband, 0, EQ_MAX_NFILT);
+        return -1;
+    }
+    for (int i = 0; i < nband; i++)
+    {
+        if (band_check(&bands[i]) < 0)
+            return -1;
+    }
+
+    pthread_mutex_lock(&eq_mutex);
+    for (int i = 0; i < nband; i++)
+    {
+        eq_band_t b = bands[i];
+
+        b.gain = gain_clamp(b.gain);
+        filter_init(&eq_filt[i], &b);
+        eq_publish(i, 1);
+    }
+    // a group of sections is processed as a whole, unused ones must be flat
+    for (int i = nband; i < EQ_MAX_NFILT; i++)
+    {
+        eq_filt[i].calc_coef = flat_filter_calc_coef;
+        eq_filt[i].calc_coef(&eq_filt[i]);
+        eq_publish(i, 1);
+    }
+    eq_nfilt = nband;
+    eq_pending_nfilt = nband;
+    eq_lin_dirty = 1;
+    pthread_mutex_unlock(&eq_mutex);
+    return 0;
+}
+
+int equalizer_set_band(int filt, const eq_band_t *band)
+{
+    eq_band_t b;
+    int reset;
+
+    if (band_check(band) < 0)
+        return -1;
+    pthread_mutex_lock(&eq_mutex);
+    if (filt < 0 || filt >= eq_nfilt)
+    {
+        error_at_line(0, 0, __FILE__, __LINE__,
+                      "filter index out of bound %d, min is %d, max is %d",
+                      filt, 0, eq_nfilt - 1);
+        pthread_mutex_unlock(&eq_mutex);
+        return -1;
+    }
+    b = *band;
+    b.gain = gain_clamp(b.gain);
+    // moving a band is smooth, changing its type is a new filter
+    reset = (b.type != eq_filt[filt].band.type);
+    filter_init(&eq_filt[filt], &b);
+    eq_publish(filt, reset);
+    eq_lin_dirty = 1;
+    pthread_mutex_unlock(&eq_mutex);
+    return 0;
+}
+
+int equalizer_get_band(int filt, eq_band_t *band)
+{
+    int ret = -1;
+
+    pthread_mutex_lock(&eq_mutex);
+    if (filt >= 0 && filt < eq_nfilt)
+    {
+        *band = eq_filt[filt].band;
+        ret = 0;
+    }
+    pthread_mutex_unlock(&eq_mutex);
+    return ret;
+}
+
+int equalizer_get_nband()
+{
+    int n;
+
+    pthread_mutex_lock(&eq_mutex);
+    n = eq_nfilt;
+    pthread_mutex_unlock(&eq_mutex);
+    return n;
+}
+
+int equalizer_set_fir(const float taps[], int ntaps, int part)
+{
+    fir_t *fir;
+    float *copy;
+
+    // planning can take long, it must not hold the audio path
+    fir = fir_new(taps, ntaps, part, eq_cascade.nch);
+    if (fir == NULL)
+        return -1;
+    copy = malloc(sizeof(float) * ntaps);
+    if (copy == NULL)
+    {
+        error_at_line(0, errno, __FILE__, __LINE__, "%d taps", ntaps);
+        fir_delete(fir);
+        return -1;
     }
-    filt_set_gain(&eq_filt[filt], gain);
-    return eq_filt[filt].g;
-}
\ No newline at end of file
+    memcpy(copy, taps, sizeof(float) * ntaps);
+    pthread_mutex_lock(&eq_mutex);
+    eq_fir_publish(EQ_MODE_FIR, fir);
+    free(eq_fir_taps);
+    eq_fir_taps = copy;
+    eq_fir_ntaps = ntaps;
+    eq_fir_part = part;
+    pthread_mutex_unlock(&eq_mutex);
+    return 0;
+}
+
+int equalizer_set_mode(eq_mode_t mode)
+{
+    fir_t *lin = NULL;
+    int ret = 0;
+
+    if (mode < EQ_MODE_BANDS || mode >= EQ_NMODE)
+    {
+        error_at_line(0, 0, __FILE__, __LINE__, "unknown mode %d", mode);
+        return -1;
+    }
+    // the first time, the linear phase FIR is planned and designed here
+    if (mode == EQ_MODE_LINEAR && !eq_lin_on)
+    {
+        lin = eq_lin_build(eq_cascade.nch);
+        if (lin == NULL)
+            return -1;
+    }
+    pthread_mutex_lock(&eq_mutex);
+    if (lin != NULL)
+        eq_fir_publish(EQ_MODE_LINEAR, lin);
+    if (mode == EQ_MODE_FIR && eq_fir_taps == NULL)
+    {
+        error_at_line(0, 0, __FILE__, __LINE__, "no FIR set");
+        ret = -1;
+    }
+    else
+        eq_pending_mode = mode;
+    pthread_mutex_unlock(&eq_mutex);
+    return ret;
+}
+
+int equalizer_update()
+{
+    fir_kernel_t *k;
+    char dirty;
+    int ret = 0;
+
+    pthread_mutex_lock(&eq_lin_mutex);
+    pthread_mutex_lock(&eq_mutex);
+    dirty = eq_lin_dirty;
+    pthread_mutex_unlock(&eq_mutex);
+    if (eq_lin_on && dirty)
+    {
+        eq_lin_design();
+        k = fir_kernel_new(eq_lin_taps, eq_lin_size - 1, EQ_LIN_PART);
+        if (k == NULL)
+            ret = -1;
+        else
+        {
+            pthread_mutex_lock(&eq_mutex);
+            fir_kernel_delete(eq_lin_old);
+            eq_lin_old = NULL;
+            fir_kernel_delete(eq_lin_pending);
+            eq_lin_pending = k;
+            pthread_mutex_unlock(&eq_mutex);
+            ret = 1;
+        }
+    }
+    pthread_mutex_unlock(&eq_lin_mutex);
+    return ret;
+}
+
+eq_mode_t equalizer_get_mode()
+{
+    eq_mode_t mode;
+
+    pthread_mutex_lock(&eq_mutex);
+    mode = eq_pending_mode;
+    pthread_mutex_unlock(&eq_mutex);
+    return mode;
+}
+
+int equalizer_get_latency()
+{
+    int n;
+
+    pthread_mutex_lock(&eq_mutex);
+    if (eq_pending_mode == EQ_MODE_FIR)
+        n = eq_fir_part;
+    else if (eq_pending_mode == EQ_MODE_LINEAR)
+        n = eq_lin_size / 2 - 1 + EQ_LIN_PART;
+    else
+        n = 0;
+    pthread_mutex_unlock(&eq_mutex);
+    return n;
+}
+
+/**
+ * @brief samples needed for a wrong state of the bands to fade out
+ * 
+ * The poles of a band are the roots of z^2 + a1 z + a2: complex conjugate
+ * with radius sqrt(a2), or real.
+ * 
+ * @param err ratio of the initial difference left
+ * @return long no. samples, -1 if the bands never settle
+ */
+long equalizer_settle(float err)
+{
+    double a1, a2, d, r, rmax = 0;
+
+    pthread_mutex_lock(&eq_mutex);
+    if (eq_pending_mode != EQ_MODE_BANDS)
+        rmax = 1;
+    for (int i = 0; i < eq_nfilt; i++)
+    {
+        a1 = eq_filt[i].a1;
+        a2 = eq_filt[i].a2;
+        d = a1 * a1 - 4 * a2;
+        r = (d < 0) ? sqrt(a2) : (fabs(a1) + sqrt(d)) / 2;
+        if (r > rmax)
+            rmax = r;
+    }
+    pthread_mutex_unlock(&eq_mutex);
+    if (rmax >= 1 || !(err > 0))
+        return -1;
+    if (rmax == 0 || err >= 1)
+        return 0;
+    return (long)ceil(log(err) / log(rmax));
+}
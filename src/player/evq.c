@@ -0,0 +1,103 @@
+/**
+ * @file evq.c
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief bounded queue of events, many producers and one consumer, no lock
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * The slot i is free for the push of position p when its sequence is p,
+ * and full for the pop of position p when it is p + 1. Popping it makes it
+ * free for the next lap, p + len.
+ */
+#include "player/evq.h"
+
+#include <stdlib.h>
+
+#include <error.h>
+#include <string.h>
+
+int evq_init(evq_t *q, int len, size_t size)
+{
+	if (len < 1 || (len & (len - 1)) || size == 0)
+	{
+		error_at_line(0, 0, __FILE__, __LINE__,
+					  "queue of %d events of %zu bytes", len, size);
+		return -1;
+	}
+	q->len = len;
+	q->size = size;
+	q->seq = malloc(sizeof(unsigned long) * len);
+	q->data = malloc(size * len);
+	if (q->seq == NULL || q->data == NULL)
+	{
+		error_at_line(0, 0, __FILE__, __LINE__, "queue of %d events", len);
+		free(q->seq);
+		free(q->data);
+		return -1;
+	}
+	for (int i = 0; i < len; i++)
+		q->seq[i] = i;
+	q->head = q->tail = 0;
+	q->nfull = 0;
+	return 0;
+}
+
+void evq_destroy(evq_t *q)
+{
+	free(q->seq);
+	free(q->data);
+	q->seq = NULL;
+	q->data = NULL;
+}
+
+int evq_push(evq_t *q, const void *evt)
+{
+	unsigned long pos = __atomic_load_n(&q->tail, __ATOMIC_RELAXED), seq;
+	long dif;
+	int i;
+
+	while (1)
+	{
+		i = pos & (q->len - 1);
+		seq = __atomic_load_n(&q->seq[i], __ATOMIC_ACQUIRE);
+		dif = (long)(seq - pos);
+		if (dif == 0)
+		{
+			// the slot is free, claim it, pos is reloaded on failure
+			if (__atomic_compare_exchange_n(&q->tail, &pos, pos + 1, 1,
+											__ATOMIC_RELAXED,
+											__ATOMIC_RELAXED))
+				break;
+		}
+		else if (dif < 0)
+		{
+			// not popped yet since the last lap
+			__atomic_fetch_add(&q->nfull, 1, __ATOMIC_RELAXED);
+			return -1;
+		}
+		else
+			pos = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+	}
+	memcpy(q->data + i * q->size, evt, q->size);
+	__atomic_store_n(&q->seq[i], pos + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+int evq_pop(evq_t *q, void *evt)
+{
+	unsigned long pos = q->head;
+	int i = pos & (q->len - 1);
+
+	// a slot claimed but not written yet is empty until it is
+	if (__atomic_load_n(&q->seq[i], __ATOMIC_ACQUIRE) != pos + 1)
+		return -1;
+	memcpy(evt, q->data + i * q->size, q->size);
+	__atomic_store_n(&q->seq[i], pos + q->len, __ATOMIC_RELEASE);
+	q->head = pos + 1;
+	return 0;
+}
+
+unsigned long evq_get_nfull(const evq_t *q)
+{
+	return __atomic_load_n(&q->nfull, __ATOMIC_RELAXED);
+}
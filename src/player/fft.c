@@ -0,0 +1,247 @@
+/**
+ * @file fft.c
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief persistent FFTW plans and wisdom cache
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * FFTW planners are not thread safe and may take a long time, so every
+ * plan is created here once, out of the real-time path. Plans are created
+ * on scratch aligned buffers and later executed with the new-array execute
+ * interface on any buffer allocated by this module.
+ *
+ * The planner and the wisdom are used under a mutex, as plans can be asked
+ * for by several threads. A plan is filled before the count of the plans
+ * covers it, so the transforms look plans up with no lock.
+ */
+#include "player/fft.h"
+
+#include <stdio.h>
+
+#include <errno.h>
+#include <error.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * @brief	a persistent plan and the size it was created for.
+ */
+typedef struct
+{
+	int size;		 /**< No. real samples. */
+	fftwf_plan r2c; /**< Real to complex plan. */
+	fftwf_plan c2r; /**< Complex to real plan. */
+} fft_plan_t;
+
+static fft_plan_t plans[FFT_MAX_PLANS]; /**< All created plans. */
+static int nplans = 0;					/**< No. created plans. */
+static pthread_mutex_t plan_mutex =
+	PTHREAD_MUTEX_INITIALIZER; /**< mutex for the planner and the plans. */
+
+static char wisdom_path[1024] = FFT_WISDOM_PATH; /**< Wisdom file path. */
+
+static fft_stats_t stats; /**< Planning and execution counters, updated
+				with relaxed atomics so no transform takes a lock. */
+
+/**
+ * @brief	Elapsed time in nanoseconds between two time variables.
+ */
+static long long elapsed_ns(struct timespec t1, struct timespec t2)
+{
+	return (t2.tv_sec - t1.tv_sec) * 1000000000LL + (t2.tv_nsec - t1.tv_nsec);
+}
+
+/**
+ * @brief	Look for the plan of a given size.
+ * @return	the plan or NULL if the size has not been planned.
+ */
+static fft_plan_t *fft_find(int size)
+{
+	int i, n = __atomic_load_n(&nplans, __ATOMIC_ACQUIRE);
+
+	for (i = 0; i < n; i++)
+	{
+		if (plans[i].size == size)
+			return &plans[i];
+	}
+	return NULL;
+}
+
+void fft_init(const char *wisdom)
+{
+	pthread_mutex_lock(&plan_mutex);
+	if (wisdom != NULL)
+	{
+		strncpy(wisdom_path, wisdom, sizeof(wisdom_path) - 1);
+		wisdom_path[sizeof(wisdom_path) - 1] = '\0';
+	}
+	// a missing or stale wisdom file only means slower planning
+	fftwf_import_wisdom_from_filename(wisdom_path);
+	pthread_mutex_unlock(&plan_mutex);
+}
+
+int fft_plan(int size)
+{
+	float *in;			 /**< Scratch input, planning could overwrite it. */
+	fftwf_complex *out; /**< Scratch output. */
+	fftwf_plan r2c, c2r;
+	struct timespec t1, t2;
+
+	if (size <= 0)
+		return -1;
+	if (fft_find(size) != NULL)
+		return 0;
+	pthread_mutex_lock(&plan_mutex);
+	// planned by another thread meanwhile
+	if (fft_find(size) != NULL)
+	{
+		pthread_mutex_unlock(&plan_mutex);
+		return 0;
+	}
+	if (nplans >= FFT_MAX_PLANS)
+	{
+		pthread_mutex_unlock(&plan_mutex);
+		error_at_line(0, 0, __FILE__, __LINE__,
+					  "too many fft sizes, max is %d", FFT_MAX_PLANS);
+		return -1;
+	}
+
+	in = fft_alloc_real(size);
+	out = fft_alloc_cpx(size / 2 + 1);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	r2c = fftwf_plan_dft_r2c_1d(size, in, out, FFT_PLAN_FLAGS);
+	c2r = fftwf_plan_dft_c2r_1d(size, out, in, FFT_PLAN_FLAGS);
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+	fft_free(in);
+	fft_free(out);
+	if (r2c == NULL || c2r == NULL)
+	{
+		if (r2c != NULL)
+			fftwf_destroy_plan(r2c);
+		if (c2r != NULL)
+			fftwf_destroy_plan(c2r);
+		pthread_mutex_unlock(&plan_mutex);
+		return -1;
+	}
+
+	plans[nplans].size = size;
+	plans[nplans].r2c = r2c;
+	plans[nplans].c2r = c2r;
+	__atomic_store_n(&nplans, nplans + 1, __ATOMIC_RELEASE);
+
+	__atomic_fetch_add(&stats.nplan, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&stats.plan_ns, elapsed_ns(t1, t2), __ATOMIC_RELAXED);
+
+	if (fftwf_export_wisdom_to_filename(wisdom_path) == 0)
+		error_at_line(0, 0, __FILE__, __LINE__,
+					  "cannot save fftw wisdom in %s", wisdom_path);
+	pthread_mutex_unlock(&plan_mutex);
+	return 0;
+}
+
+/**
+ * @brief	Look for the plan of a given size, exit if there is none.
+ */
+static fft_plan_t *fft_get(int size)
+{
+	fft_plan_t *p;
+
+	p = fft_find(size);
+	if (p == NULL)
+		error_at_line(-1, 0, __FILE__, __LINE__,
+					  "fft of size %d has not been planned", size);
+	return p;
+}
+
+/**
+ * @brief	Account a transform in the execution counters.
+ */
+static void fft_count(struct timespec t1, struct timespec t2)
+{
+	long long ns, max;
+
+	ns = elapsed_ns(t1, t2);
+	__atomic_fetch_add(&stats.nexec, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&stats.exec_ns, ns, __ATOMIC_RELAXED);
+	max = __atomic_load_n(&stats.exec_max_ns, __ATOMIC_RELAXED);
+	while (ns > max &&
+		   !__atomic_compare_exchange_n(&stats.exec_max_ns, &max, ns, 1,
+										__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+
+void fft_r2c(int size, float *in, fftwf_complex *out)
+{
+	fft_plan_t *p;
+	struct timespec t1, t2;
+
+	p = fft_get(size);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	fftwf_execute_dft_r2c(p->r2c, in, out);
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+	fft_count(t1, t2);
+}
+
+void fft_c2r(int size, fftwf_complex *in, float *out)
+{
+	fft_plan_t *p;
+	struct timespec t1, t2;
+
+	p = fft_get(size);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	fftwf_execute_dft_c2r(p->c2r, in, out);
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+	fft_count(t1, t2);
+}
+
+float *fft_alloc_real(int n)
+{
+	float *p;
+
+	p = fftwf_alloc_real(n);
+	if (p == NULL)
+		error_at_line(-1, ENOMEM, __FILE__, __LINE__, "fft buffer");
+	memset(p, 0, sizeof(float) * n);
+	return p;
+}
+
+fftwf_complex *fft_alloc_cpx(int n)
+{
+	fftwf_complex *p;
+
+	p = fftwf_alloc_complex(n);
+	if (p == NULL)
+		error_at_line(-1, ENOMEM, __FILE__, __LINE__, "fft buffer");
+	memset(p, 0, sizeof(fftwf_complex) * n);
+	return p;
+}
+
+void fft_free(void *p)
+{
+	fftwf_free(p);
+}
+
+void fft_get_stats(fft_stats_t *dst)
+{
+	dst->nplan = __atomic_load_n(&stats.nplan, __ATOMIC_RELAXED);
+	dst->plan_ns = __atomic_load_n(&stats.plan_ns, __ATOMIC_RELAXED);
+	dst->nexec = __atomic_load_n(&stats.nexec, __ATOMIC_RELAXED);
+	dst->exec_ns = __atomic_load_n(&stats.exec_ns, __ATOMIC_RELAXED);
+	dst->exec_max_ns = __atomic_load_n(&stats.exec_max_ns, __ATOMIC_RELAXED);
+}
+
+void fft_xtor()
+{
+	int i;
+
+	pthread_mutex_lock(&plan_mutex);
+	fftwf_export_wisdom_to_filename(wisdom_path);
+	for (i = 0; i < nplans; i++)
+	{
+		fftwf_destroy_plan(plans[i].r2c);
+		fftwf_destroy_plan(plans[i].c2r);
+	}
+	__atomic_store_n(&nplans, 0, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&plan_mutex);
+}
@@ -0,0 +1,312 @@
+/**
+ * @file fir.c
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief long FIR filters by uniformly partitioned overlap-save convolution
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * With partitions of B samples, transforms are of 2B samples: the input
+ * window holds the previous and the current block, and the last B samples
+ * of the circular convolution with a zero padded partition are the linear
+ * convolution. The spectra of the partitions are scaled by 1 / 2B, so the
+ * inverse transform needs no normalization.
+ *
+ * Spectra are stored an even no. terms apart, so each one is as aligned as
+ * the arrays the transforms were planned on, as new-array execution needs.
+ *
+ * The delay line holds spectra of the input only, so a new kernel applies to
+ * it as is: the block after the change is computed with both kernels and
+ * crossfaded, and no state is lost.
+ */
+#include "player/fir.h"
+
+#include <stdlib.h>
+
+#include <error.h>
+#include <string.h>
+
+#include "player/fft.h"
+
+/**
+ * @brief	Terms from a spectrum to the next, nbin rounded up to even.
+ */
+#define fir_stride(nbin) (((nbin) + 1) & ~1)
+
+/**
+ * @brief	State of a channel.
+ */
+typedef struct
+{
+	float *x;			/**< Input window, previous and current block. */
+	float *out;			/**< Output of the last block. */
+	fftwf_complex *fdl; /**< Delay line of the spectra of the inputs. */
+} fir_ch_t;
+
+struct fir_kernel
+{
+	int part;		  /**< Samples of a partition. */
+	int npart;		  /**< No. partitions. */
+	int ntaps;		  /**< Length of the impulse response. */
+	int stride;		  /**< Terms from a spectrum to the next. */
+	fftwf_complex *h; /**< Spectra of the partitions. */
+};
+
+struct fir
+{
+	int part;				  /**< Samples of a partition. */
+	int size;				  /**< Samples of a transform. */
+	int nbin;				  /**< Terms of a spectrum. */
+	int stride;				  /**< Terms from a spectrum to the next. */
+	int npart;				  /**< Length of the delay lines. */
+	int nch;				  /**< No. channels. */
+	int fill;				  /**< Samples of the current block. */
+	int head;				  /**< Slot of the newest input spectrum. */
+	fir_kernel_t *k;		  /**< Kernel in use. */
+	fir_kernel_t *fade;		  /**< Kernel faded out by the next block. */
+	fir_kernel_t *retired;	  /**< Kernel faded out, not used any more. */
+	fftwf_complex *acc;		  /**< Spectrum of the output. */
+	float *y;				  /**< Output window. */
+	float *y_fade;			  /**< Output window of the kernel faded out. */
+	fir_ch_t ch[FIR_MAX_NCH]; /**< State of each channel. */
+};
+
+fir_kernel_t *fir_kernel_new(const float taps[], int ntaps, int part)
+{
+	fir_kernel_t *k;
+	float *x;
+	int p, n, size = 2 * part, nbin = part + 1;
+
+	if (ntaps < 1 || ntaps > FIR_MAX_TAPS)
+	{
+		error_at_line(0, 0, __FILE__, __LINE__, "%d taps, max is %d", ntaps,
+					  FIR_MAX_TAPS);
+		return NULL;
+	}
+	if (part < FIR_MIN_PART || part > FIR_MAX_PART || (part & (part - 1)))
+	{
+		error_at_line(0, 0, __FILE__, __LINE__,
+					  "partition of %d, must be a power of 2 in [%d, %d]",
+					  part, FIR_MIN_PART, FIR_MAX_PART);
+		return NULL;
+	}
+	if (fft_plan(size) < 0)
+		return NULL;
+	k = malloc(sizeof(fir_kernel_t));
+	if (k == NULL)
+		return NULL;
+	k->part = part;
+	k->npart = (ntaps + part - 1) / part;
+	k->ntaps = ntaps;
+	k->stride = fir_stride(nbin);
+	k->h = fft_alloc_cpx(k->npart * k->stride);
+	// the second half of each partition stays zero
+	x = fft_alloc_real(size);
+	for (p = 0; p < k->npart; p++)
+	{
+		n = (ntaps - p * part < part) ? ntaps - p * part : part;
+		memset(x, 0, sizeof(float) * size);
+		for (int i = 0; i < n; i++)
+			x[i] = taps[p * part + i] / size;
+		fft_r2c(size, x, &k->h[p * k->stride]);
+	}
+	fft_free(x);
+	return k;
+}
+
+void fir_kernel_delete(fir_kernel_t *k)
+{
+	if (k == NULL)
+		return;
+	fft_free(k->h);
+	free(k);
+}
+
+fir_t *fir_new(const float taps[], int ntaps, int part, int nch)
+{
+	fir_kernel_t *k;
+	fir_t *f;
+
+	if (nch < 1 || nch > FIR_MAX_NCH)
+	{
+		error_at_line(0, 0, __FILE__, __LINE__, "%d channels, max is %d", nch,
+					  FIR_MAX_NCH);
+		return NULL;
+	}
+	k = fir_kernel_new(taps, ntaps, part);
+	if (k == NULL)
+		return NULL;
+	f = calloc(1, sizeof(fir_t));
+	if (f == NULL)
+	{
+		fir_kernel_delete(k);
+		return NULL;
+	}
+	f->part = part;
+	f->size = 2 * part;
+	f->nbin = part + 1;
+	f->stride = fir_stride(f->nbin);
+	f->npart = k->npart;
+	f->nch = nch;
+	f->k = k;
+	f->acc = fft_alloc_cpx(f->nbin);
+	f->y = fft_alloc_real(f->size);
+	f->y_fade = fft_alloc_real(f->size);
+	for (int c = 0; c < nch; c++)
+	{
+		f->ch[c].x = fft_alloc_real(f->size);
+		f->ch[c].out = fft_alloc_real(part);
+		f->ch[c].fdl = fft_alloc_cpx(f->npart * f->stride);
+	}
+	return f;
+}
+
+void fir_delete(fir_t *f)
+{
+	if (f == NULL)
+		return;
+	for (int c = 0; c < f->nch; c++)
+	{
+		fft_free(f->ch[c].x);
+		fft_free(f->ch[c].out);
+		fft_free(f->ch[c].fdl);
+	}
+	fir_kernel_delete(f->k);
+	fir_kernel_delete(f->fade);
+	fir_kernel_delete(f->retired);
+	fft_free(f->acc);
+	fft_free(f->y);
+	fft_free(f->y_fade);
+	free(f);
+}
+
+fir_kernel_t *fir_set_kernel(fir_t *f, fir_kernel_t *k)
+{
+	fir_kernel_t *old;
+
+	if (k->part != f->part || k->npart > f->npart)
+	{
+		error_at_line(0, 0, __FILE__, __LINE__,
+					  "kernel of %d partitions of %d, filter has %d of %d",
+					  k->npart, k->part, f->npart, f->part);
+		return k;
+	}
+	if (f->fade != NULL)
+	{ // the kernel in use was never heard, fade from the one before
+		old = f->k;
+	}
+	else
+	{
+		old = f->retired;
+		f->retired = NULL;
+		f->fade = f->k;
+	}
+	f->k = k;
+	return old;
+}
+
+void fir_reset(fir_t *f)
+{
+	for (int c = 0; c < f->nch; c++)
+	{
+		memset(f->ch[c].x, 0, sizeof(float) * f->size);
+		memset(f->ch[c].out, 0, sizeof(float) * f->part);
+		memset(f->ch[c].fdl, 0,
+			   sizeof(fftwf_complex) * f->npart * f->stride);
+	}
+	f->fill = 0;
+	f->head = 0;
+}
+
+/**
+ * @brief	Multiply a spectrum by a partition and add it to acc.
+ */
+static void fir_mac(float *restrict acc, const float *restrict x,
+					const float *restrict h, int nbin)
+{
+	for (int k = 0; k < 2 * nbin; k += 2)
+	{
+		acc[k] += x[k] * h[k] - x[k + 1] * h[k + 1];
+		acc[k + 1] += x[k] * h[k + 1] + x[k + 1] * h[k];
+	}
+}
+
+/**
+ * @brief	Convolve the delay line of a channel with a kernel.
+ * @param[out]	y	output window, the last part samples are valid.
+ */
+static void fir_conv(fir_t *f, const fir_kernel_t *k, const fir_ch_t *ch,
+					 float *y)
+{
+	int p, slot;
+
+	memset(f->acc, 0, sizeof(fftwf_complex) * f->nbin);
+	// the newest input with the first partition, and so on back
+	for (p = 0, slot = f->head; p < k->npart; p++)
+	{
+		fir_mac((float *)f->acc, (float *)&ch->fdl[slot * f->stride],
+				(float *)&k->h[p * f->stride], f->nbin);
+		slot = (slot > 0) ? slot - 1 : f->npart - 1;
+	}
+	fft_c2r(f->size, f->acc, y);
+}
+
+/**
+ * @brief	Filter the block just collected in each channel.
+ */
+static void fir_block(fir_t *f)
+{
+	float *y = f->y + f->part, *yf = f->y_fade + f->part;
+
+	f->head = (f->head + 1 < f->npart) ? f->head + 1 : 0;
+	for (int c = 0; c < f->nch; c++)
+	{
+		fir_ch_t *ch = &f->ch[c];
+
+		fft_r2c(f->size, ch->x, &ch->fdl[f->head * f->stride]);
+		memmove(ch->x, ch->x + f->part, sizeof(float) * f->part);
+		fir_conv(f, f->k, ch, f->y);
+		if (f->fade == NULL)
+		{
+			memcpy(ch->out, y, sizeof(float) * f->part);
+			continue;
+		}
+		fir_conv(f, f->fade, ch, f->y_fade);
+		for (int i = 0; i < f->part; i++)
+			ch->out[i] = yf[i] + (y[i] - yf[i]) * (i + 1) / f->part;
+	}
+	if (f->fade != NULL)
+	{
+		f->retired = f->fade;
+		f->fade = NULL;
+	}
+}
+
+void fir_process(fir_t *f, float *const buf[], unsigned int count)
+{
+	unsigned int off, n;
+
+	for (off = 0; off < count; off += n)
+	{
+		n = count - off;
+		if (n > (unsigned int)(f->part - f->fill))
+			n = f->part - f->fill;
+		for (int c = 0; c < f->nch; c++)
+		{
+			memcpy(f->ch[c].x + f->part + f->fill, buf[c] + off,
+				   sizeof(float) * n);
+			memcpy(buf[c] + off, f->ch[c].out + f->fill, sizeof(float) * n);
+		}
+		f->fill += n;
+		if (f->fill == f->part)
+		{
+			fir_block(f);
+			f->fill = 0;
+		}
+	}
+}
+
+int fir_latency(const fir_t *f) { return f->part; }
+
+int fir_ntaps(const fir_t *f) { return f->k->ntaps; }
+
+int fir_nch(const fir_t *f) { return f->nch; }
@@ -0,0 +1,98 @@
+/**
+ * @file lane.c
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief automation lane, values of a parameter along a track
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * Points are usually added in order, at the end, so an insertion moves
+ * few of them. Lookups are binary searches.
+ */
+#include "player/lane.h"
+
+#include <stdlib.h>
+
+#include <error.h>
+#include <limits.h>
+#include <string.h>
+
+int lane_init(lane_t *l, int cap)
+{
+	if (cap < 1)
+	{
+		error_at_line(0, 0, __FILE__, __LINE__, "lane of %d points", cap);
+		return -1;
+	}
+	l->frame = malloc(sizeof(long) * cap);
+	l->val = malloc(sizeof(float) * cap);
+	if (l->frame == NULL || l->val == NULL)
+	{
+		error_at_line(0, 0, __FILE__, __LINE__, "lane of %d points", cap);
+		free(l->frame);
+		free(l->val);
+		return -1;
+	}
+	l->len = 0;
+	l->cap = cap;
+	return 0;
+}
+
+void lane_destroy(lane_t *l)
+{
+	free(l->frame);
+	free(l->val);
+	l->frame = NULL;
+	l->val = NULL;
+	l->len = l->cap = 0;
+}
+
+int lane_add(lane_t *l, long frame, float val)
+{
+	int i = lane_find(l, frame);
+
+	if (frame < 0)
+		return -1;
+	if (i >= 0 && l->frame[i] == frame)
+	{
+		l->val[i] = val;
+		return 0;
+	}
+	if (l->len == l->cap)
+		return -1;
+	// after the last point before frame
+	i++;
+	memmove(&l->frame[i + 1], &l->frame[i], sizeof(long) * (l->len - i));
+	memmove(&l->val[i + 1], &l->val[i], sizeof(float) * (l->len - i));
+	l->frame[i] = frame;
+	l->val[i] = val;
+	l->len++;
+	return 0;
+}
+
+void lane_clear(lane_t *l) { l->len = 0; }
+
+int lane_find(const lane_t *l, long frame)
+{
+	int lo = 0, hi = l->len, mid;
+
+	// first point after frame
+	while (lo < hi)
+	{
+		mid = (lo + hi) / 2;
+		if (l->frame[mid] <= frame)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo - 1;
+}
+
+long lane_span(const lane_t *l, long frame, int dir)
+{
+	int i = lane_find(l, frame);
+
+	if (dir > 0)
+		return (i + 1 < l->len) ? l->frame[i + 1] - frame : LONG_MAX;
+	// going backward the point i stops counting past its frame
+	return (i >= 0) ? frame - l->frame[i] + 1 : LONG_MAX;
+}
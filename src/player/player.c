@@ -16,8 +16,10 @@
 #include <stdio.h>
 //
 #include <assert.h>
+#include <errno.h>
 #include <error.h>
 #include <libgen.h>
+#include <limits.h>
 #include <math.h>
 #include <string.h>
 //
@@ -25,37 +27,194 @@
 #include <fftw3.h>
 
 #include "defines.h"
+#include "player/cache.h"
+#include "player/convert.h"
 #include "player/equalizer.h"
+#include "player/evq.h"
+#include "player/fft.h"
+#include "player/lane.h"
+#include "player/seqlock.h"
+#include "player/source.h"
+#include "player/stft.h"
+#include "player/window.h"
 #include "ptask.h"
 
-#define modulus(cpx) (sqrt(((cpx)[0] * (cpx)[0]) + ((cpx)[1] * (cpx)[1])))
-#define phase(cpx) (atan2f((cpx)[1], (cpx)[0]))
-
 static Player_t p; /**< The player struct. */
 
-static int pos;				/**< Reproducing position. */
-static int filt_pos = 0;	/**< Filtering position. */
-static int v;				/**< Allegro voice associated to player. */
-static SAMPLE *orig_sample; /**< Original Sample. Needed either for return
-				to original state or to filter (equalize). */
-static SAMPLE *filt_sample; /**< Filtered Sample. This is the SAMPLE used 
-				for sound reproduction.*/
-
+static long pos;			/**< Reproducing position, in track frames. */
+static source_t src;		/**< Original track, read in chunks from file. */
+static size_t mem_budget = PLAYER_MEM_BUDGET; /**< Max bytes of the ring of
+				the original track. */
+/*
+ * The output is an Allegro stream fed with the filtered frames. Stream frames
+ * are counted from the last restart of the stream, the stream frame k being
+ * the track frame base + dir * k, so fast rewind is a stream of the track
+ * played backward. A jump scheduled at a frame splices the stream there:
+ * the frames filtered from then on follow filt_base, and base takes its
+ * value once the splice is heard.
+ */
+static AUDIOSTREAM *stream; /**< Output stream. */
+static long base;			/**< Track frame of the stream frame 0. */
+static int dir;				/**< 1 playing forward, -1 backward. */
+static long play_pos;		/**< Stream frames played. */
+static long filt_pos;		/**< Stream frames filtered. */
+static long filt_base;		/**< Track frame of the stream frame 0, for the
+				frames filtered from filt_pos on. */
+static struct
+{
+	long at;   /**< Stream frame of the splice. */
+	long base; /**< Base of the stream from there on. */
+} splice[PLAYER_MAX_SPLICE]; /**< Splices filtered but not heard yet. */
+static int nsplice;			/**< No. splices. */
+static long jump_at;		/**< Stream frame of the last scheduled jump. */
+static lane_t lanes[PLAYER_NLANE]; /**< Automation of the volume, the gains
+				of the filters and the jumps, by track frame. */
+static int lane_pt[PLAYER_NLANE]; /**< Point of each lane in effect, -1 for
+				none, -2 if it has to be looked up again. */
+static float lane_base[PLAYER_NLANE]; /**< Value of each lane before its
+				first point, the default or the last set at once. */
+static lane_t lane_stage[PLAYER_NLANE]; /**< Points handed over at once by
+				player_automate_lane(), swapped with the lane by the player. */
+static int stage_busy[PLAYER_NLANE]; /**< The staging lane is being filled or
+				not taken by the player yet. */
+static float vol_gain = 1; /**< Gain of the volume, applied when filtering. */
+static float vol_from = 1; /**< Gain the volume ramps from. */
+static long vol_ramp = EQ_RAMP_LEN; /**< Frames of the volume ramp done. */
+static long fed_pos;		/**< Stream frames fed to the output. */
+static float *filt_ring;	/**< Last filtered frames, a ring per channel,
+				the stream frame k in the slot k % filt_cap. */
+static long filt_cap;		/**< Capacity of filt_ring in frames. */
+static int nch_out;			/**< No. channels of the stream, at most 2. */
+static int bits_out;		/**< Bits per sample of the stream, 8 or 16. */
+static const convert_t *conv; /**< Conversion kernels of the output stream,
+				chosen at load time. */
+static const convert_ilv_t *ilv; /**< Interleave kernels of the track. */
+static const convert_ilv_t *ilv_out; /**< Interleave kernels of the
+				stream. */
+static float mix_left[PLAYER_MAX_NCH]; /**< Downmix weights of the left. */
+static float mix_right[PLAYER_MAX_NCH]; /**< Downmix weights of the right. */
+static long win_len = PLAYER_WINDOW_SIZE; /**< Frames of the analysis
+				window, longer at high rates. */
+static float *spect_buf; /**< Frames read for the spectograms: interleaved,
+				then a buffer per channel. */
+static float *spect_mix; /**< win_len frames of the signal of the
+				spectograms. */
+static stft_t orig_stft; /**< Spectra of the original track. */
+static stft_t filt_stft; /**< Spectra of the filtered track. */
+static char stft_ready = 0; /**< the spectra have been initialized. */
+static long lat; /**< Frames the equalizer delays the stream by. */
+static const window_t *win; /**< Window f. applied before the FFT. */
+static window_type_t win_type = WIN_BLACKMAN_HARRIS; /**< Window type. */
+static float win_beta;	/**< Shape of the window. */
+static int stft_size = PLAYER_WINDOW_SIZE; /**< Frames of the analysis
+				window, up to PLAYER_WINDOW_FREQ. */
+static int stft_hop = PLAYER_STFT_HOP; /**< Frames between two spectra, up
+				to PLAYER_WINDOW_FREQ. */
+static unsigned int stft_gen; /**< Changes of window, size or hop. */
+static pthread_mutex_t win_mutex =
+	PTHREAD_MUTEX_INITIALIZER; /**< mutex for the window selection. */
+
+// the output queues at least two stream buffers, refilled well within them
 static task_par_t tp = {
 	arg : 0,
-	period : 80,
-	deadline : 80,
+	wcet : 5000,
+	period : 20,
+	deadline : 20,
 	priority : 20,
 	dmiss : 0,
+	name : "PLAYER",
 }; /**< default task parameters. */
 
-static pthread_t tid; /**< player thread identifier. */
+static task_par_t atp = {
+	arg : 0,
+	wcet : 20000,
+	period : 80,
+	deadline : 80,
+	priority : 15,
+	dmiss : 0,
+	name : "ANALYSIS",
+}; /**< default analysis task parameters. */
+
+static pthread_t tid;			/**< player thread identifier. */
+static pthread_t atid;			/**< analysis thread identifier. */
+static char analysis_started = 0; /**< analysis thread has been created. */
+static pthread_t ctid;			/**< spectra cache thread identifier. */
+static char cache_started = 0;	/**< spectra cache thread has been created. */
+static volatile int cache_stop = 0; /**< the cache thread has to give up. */
+static char track_path[PATH_MAX]; /**< path of the track. */
+static cache_t *cache; /**< spectra of the whole original track. */
+static unsigned int cache_gen; /**< change of the analysis cached. */
+static pthread_mutex_t cache_mutex =
+	PTHREAD_MUTEX_INITIALIZER; /**< mutex for the cache. */
+
+/**
+ * @brief	Playhead snapshot, what the analysis needs from the player.
+ */
+typedef struct
+{
+	long pos;			  /**< Reproducing position. */
+	player_state_t state; /**< Player state. */
+	long k;				  /**< Stream frame played. */
+	long base;			  /**< Track frame of the stream frame 0. */
+	int dir;			  /**< Direction of the stream in the track. */
+	long lat;			  /**< Frames the stream is late on the track. */
+	long filt;			  /**< Stream frames filtered. */
+} playhead_t;
+
+static playhead_t playhead; /**< last playhead published by the player. */
+static pthread_mutex_t playhead_mutex =
+	PTHREAD_MUTEX_INITIALIZER; /**< mutex for the playhead snapshot. */
+
+static player_spect_t spect_sig = PLAYER_SPECT_MID; /**< signal of the
+							spectograms. */
+static int spect_ch;	/**< channel of the spectograms. */
+/**
+ * @brief	Spectograms published by the analysis.
+ */
+typedef struct
+{
+	float orig[PLAYER_MAX_BARS]; /**< original spectogram. */
+	float filt[PLAYER_MAX_BARS]; /**< filtered spectogram. */
+	int nbar;					 /**< bands of the spectograms. */
+	unsigned char hist[2][PLAYER_STFT_FRAMES][PLAYER_MAX_BARS];
+	/**< last spectograms, original and filtered, the spectogram i in the
+	 * slot i % PLAYER_STFT_FRAMES. */
+	int hist_nbar[PLAYER_STFT_FRAMES]; /**< bands of each slot. */
+	long count;						   /**< spectograms in the history
+										since the start. */
+} spect_pub_t;
+
+static spect_pub_t spect_pub[2]; /**< both copies of the spectograms. */
+static long spect_count; /**< spectograms published since the start. */
+static seqlock_t spect_seq = SEQLOCK_INITIALIZER; /**< publication of the
+				spectograms and their history by the analysis, the readers
+				never wait for it. */
+static bands_t *bands; /**< bands of the analysis, changed by it only. */
+static bands_t *bands_next; /**< bands not taken by the analysis yet. */
+static bands_t *bands_old;	/**< bands left by the analysis, freed by the
+							next player_set_bands(). */
+static bands_scale_t bands_scale = BANDS_LINEAR; /**< scale of the bands. */
+static int bands_req = PLAYER_BANDS_NBAR; /**< no. bands asked. */
+static pthread_mutex_t spect_mutex =
+	PTHREAD_MUTEX_INITIALIZER; /**< mutex for the signal and the bands of the
+							spectograms. */
+
+/**
+ * @brief	Event queued for the player.
+ */
+typedef struct
+{
+	player_event_t evt; /**< The event. */
+	long at;			/**< Track frame, PLAYER_NOW, LANE_CLEAR or LANE_SWAP. */
+} player_timed_t;
+
+#define LANE_CLEAR (-2) /**< The points of the lane of the event are removed. */
+#define LANE_SWAP (-3)	/**< The lane of the event is replaced by its staging
+				lane. */
 
-static player_event_t player_event; /**< event for dispatch. */
-static pthread_mutex_t player_mutex =
-	PTHREAD_MUTEX_INITIALIZER; /**< mutex to access player */
-static pthread_mutex_t player_event_mutex =
-	PTHREAD_MUTEX_INITIALIZER; /**< mutex for the event. */
+static evq_t player_evq; /**< events dispatched, drained by the player. */
+static unsigned long nreject; /**< events at a frame not scheduled, the
+				signal not automated or the lane full. */
 
 static char _player_exit = 0; /**< variable to notice the 
 	thread that has to exit. */
@@ -63,13 +222,50 @@ static pthread_mutex_t _player_exit_mutex = PTHREAD_MUTEX_INITIALIZER;
 /**< mutex for the _player_exit variable*/
 
 /**
- * @brief player thread routine
+ * @brief	Publish a float of the player, read by other threads with no lock.
+ *
+ * The scalars of the player are written by the player thread, or by a
+ * setter, and loaded atomically by the getters, so neither side waits.
+ */
+static void store_float(float *dst, float val)
+{
+	__atomic_store(dst, &val, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief	Load a float of the player published by store_float().
+ */
+static float load_float(const float *src)
+{
+	float val;
+
+	__atomic_load(src, &val, __ATOMIC_ACQUIRE);
+	return val;
+}
+
+/**
+ * @brief	Publish the state of the player.
+ */
+static void set_state(player_state_t state)
+{
+	__atomic_store_n(&p.state, state, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief player task body, a period
  * 
- * @param[in] arg  argument passed to the routine(actually nothing is passed)
- * @return void* pointer to the variable returned by the thread
- * 				(actually nothing)
+ * @param[in] arg  parameters of the task
+ * @return int 0 to go on, 1 once the player has exited
  */
-static void *player_run(void *arg);
+static int player_run(task_par_t *arg);
+
+/**
+ * @brief spectrum analysis task body, a period
+ *
+ * @param[in] arg  parameters of the task
+ * @return int 0 to go on, 1 when the player exits
+ */
+static int player_analysis_run(task_par_t *arg);
 
 /**
  * @brief player destructor
@@ -80,12 +276,14 @@ static void player_xtor();
 /*******************************************************************************
  * 				Player Events
  ******************************************************************************/
-static void player_filt();
 static void player_play();
 static void player_pause();
 static void player_stop();
 static void player_rewind();
+static void player_dispatch_body(player_event_t evt);
+static int player_queue(player_event_t evt, long at);
 static void player_forward();
+static void player_eq_layout(eq_preset_t preset);
 /******************************************************************************/
 
 /**
@@ -106,166 +304,248 @@ static void get_trackname(char name[], const char path[])
 }
 
 /**
- * @brief	Load an audio file given its path.
+ * @brief	Check that the player supports the format of the track.
  *
- * @param[in]	path	path of the audio file.
- * @param[out]	s	pointer to the pointer where the address of the SAMPLE
- * 			struct returned by allegro lib is saved.
+ * @param[in]	path	path of the audio file, for the error message.
  */
-static void algr_load_smpl(const char *path, SAMPLE **s)
+static void check_format(const char *path)
 {
 	char pass;		/**< Audio file controls result. */
 	char err[1024]; /**< Error string. */
 
 	pass = 1;
-	*s = load_sample(path);
-	if (!(*s))
-		error_at_line(-1, ENOENT, __FILE__, __LINE__, "%s", path);
-
-	if ((*s)->bits > PLAYER_MAX_SMPL_SIZE * 8)
+	err[0] = '\0';
+	if (src.bits > PLAYER_MAX_SMPL_SIZE * 8)
 	{
 		strcpy(err, "sample too big, ");
 		pass = 0;
 	}
-	if ((*s)->stereo >= PLAYER_MAX_NCH)
+	if (src.nch > PLAYER_MAX_NCH)
 	{
 		strcat(err, "too much channels, ");
 		pass = 0;
 	}
-	if ((*s)->freq > PLAYER_MAX_FREQ)
+	if (src.freq > PLAYER_MAX_FREQ)
 	{
 		strcat(err, "too much frequency per seconds");
 		pass = 0;
 	}
 	if (pass == 0)
 	{
-		destroy_sample(*s);
-		error_at_line(-1, 0, __FILE__, __LINE__, "%s", err);
+		source_close(&src);
+		error_at_line(-1, 0, __FILE__, __LINE__, "%s: %s", path, err);
 	}
 }
 
 /**
- * @brief	Transform an Allegro SAMPLE piece of data to a machine float 
- *		stream.
- * 
- * The sample data are always in unsigned format. This means that would have 
- * to XOR every sample value with 0x8000 to change the signedness. 
- * Unfortunately allegro supports only 8 and 16 bits depth wav.
- * @ref		https://liballeg.org/stabledocs/en/alleg001.html#SAMPLE
+ * @brief	Read original frames of the stream as floats.
  *
- * @param[in]	s	address of the Allegro SAMPLE struct.
- * @param[out]	buf	adress of the float stream.
- * @param[in]	off	offset by which start to convert.
- * @param[in]	count	no. data to convert.
- * @return			no. samples converted
+ * Frames of the stream played backward are read backward, frames out of the
+ * track are silence.
+ *
+ * @param[in]	ph	where the stream is in the track.
+ * @param[in]	k	first stream frame.
+ * @param[in]	count	no. frames.
+ * @param[out]	buf	count interleaved frames.
  */
-static int sample_to_float(const SAMPLE *s, float *buf, unsigned int off,
-						   unsigned int count)
+static void read_orig(const playhead_t *ph, long k, unsigned int count,
+					  float *buf)
 {
-	int j;		 /**< sample data index */
-	int16_t d16; /**< buff to get the original signed value for 16bit depth. */
-	int8_t d8;   /**< buff to get the original signed value for 8bit depth. */
+	float tmp, *a, *b;
 
-	for (j = 0; j < count && j < s->len - off; j++)
+	if (ph->dir > 0)
 	{
-		if (s->bits == 16)
-		{
-			d16 = le16toh(((uint16_t *)(s->data))[off + j]) ^ 0x8000;
-			buf[j] = (float)d16;
-		}
-		else if (s->bits == 8)
+		source_read(&src, ph->base + k, count, buf);
+		return;
+	}
+	source_read(&src, ph->base - k - count + 1, count, buf);
+	for (unsigned int i = 0; i < count / 2; i++)
+	{
+		a = &buf[i * src.nch];
+		b = &buf[(count - 1 - i) * src.nch];
+		for (int c = 0; c < src.nch; c++)
 		{
-			d8 = ((uint8_t *)(s->data))[off + j] ^ 0x80;
-			buf[j] = (float)d8;
+			tmp = a[c];
+			a[c] = b[c];
+			b[c] = tmp;
 		}
 	}
-	return j;
 }
 
 /**
- * @brief Transform a machine float stream to an Allegro SAMPLE piece of data
- * 
- * @param[in] buf address of the float stream.
- * @param[out] s address of the Allegro SAMPLE struct.
- * @param[in] off offset by which start to convert.
- * @param[in] count no. data to convert.
- * @return int no. data converted.
+ * @brief	Read filtered frames of a channel of the stream.
+ *
+ * Frames no more, or not yet, in the filtered ring are silence. The player
+ * publishes the frames filtered by a release store of filt_pos, after the
+ * block is whole. The block being filtered is never read, and the frames
+ * it overwrote while they were copied here, as told by filt_pos once
+ * copied, are silence too.
+ *
+ * @param[in]	ch	channel.
+ * @param[in]	k	first stream frame.
+ * @param[in]	count	no. frames.
+ * @param[out]	buf	count floats.
  */
-static int float_to_sample(const float *buf, SAMPLE *s, int off, int count)
+static void read_filt(int ch, long k, unsigned int count, float *buf)
 {
-	int j;		  /**< sample data index */
-	uint16_t d16; /**< buff to get the original signed value. */
+	const float *ring = filt_ring + ch * filt_cap;
+	long end = __atomic_load_n(&filt_pos, __ATOMIC_ACQUIRE);
+	long low = end - filt_cap + PLAYER_FILT_BLOCK;
+
+	for (unsigned int i = 0; i < count; i++)
+		buf[i] = (k + i >= 0 && k + i < end && k + i >= low)
+					 ? ring[(k + i) % filt_cap]
+					 : 0.0f;
+	// the copies are done before filt_pos is loaded again
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	low = __atomic_load_n(&filt_pos, __ATOMIC_RELAXED) - filt_cap +
+		  PLAYER_FILT_BLOCK;
+	for (unsigned int i = 0; i < count && k + i < low; i++)
+		buf[i] = 0.0f;
+}
 
-	for (j = 0; j < count && (off + j) < s->len; j++)
+/**
+ * @brief	Weighted sum of channels.
+ *
+ * @param[in]	ch	buffer of each channel.
+ * @param[in]	w	weight of each channel, channels weighting 0 are skipped.
+ * @param[in]	count	no. frames.
+ * @param[out]	dst	count floats.
+ */
+static void mix(const float *const ch[], const float w[], unsigned int count,
+				float *dst)
+{
+	memset(dst, 0, sizeof(float) * count);
+	for (int c = 0; c < src.nch; c++)
 	{
-		if (s->bits == 16)
-		{
-			d16 = (int16_t)(round(buf[j])) ^ 0x8000,
-			((uint16_t *)s->data)[off + j] = htole16(d16);
-		}
-		else if (s->bits == 8)
-		{
-			((uint8_t *)s->data)[off + j] =
-				((uint8_t)round(buf[j])) ^ 0x80;
-		}
+		if (w[c] == 0)
+			continue;
+		for (unsigned int i = 0; i < count; i++)
+			dst[i] += w[c] * ch[c][i];
 	}
-	return j;
 }
 
 /**
- * @brief 	Blackman-Harris: window function that provides a far better
- *		frequency isolation in the frequency domain.
+ * @brief	Weights of the channels in the signal of the spectograms.
  *
- * @param[in]	n	no. the sample in the window.
- * @return			the value computed.
+ * @param[in]	sig	signal.
+ * @param[in]	ch	channel, for PLAYER_SPECT_CHANNEL.
+ * @param[out]	w	weight of each channel.
  */
-static float blackman_harris(int n)
+static void spect_weights(player_spect_t sig, int ch, float w[])
 {
-	const float a0 = 0.35875f;
-	const float a1 = 0.48829f;
-	const float a2 = 0.14128f;
-	const float a3 = 0.01168f;
-	float wn;
-
-	wn = (float)(a0 - a1 * cos((2 * M_PI * n) / (PLAYER_WINDOW_SIZE - 1)) +
-				 a2 * cos((4 * M_PI * n) / (PLAYER_WINDOW_SIZE - 1)) -
-				 a3 * cos((6 * M_PI * n) / (PLAYER_WINDOW_SIZE - 1)));
-
-	return wn;
+	for (int c = 0; c < src.nch; c++)
+	{
+		if (sig == PLAYER_SPECT_CHANNEL)
+			w[c] = (c == ch) ? 1.0f : 0.0f;
+		else if (nch_out == 1) // left and right are the same
+			w[c] = (sig == PLAYER_SPECT_MID) ? 1.0f : 0.0f;
+		else if (sig == PLAYER_SPECT_MID)
+			w[c] = (mix_left[c] + mix_right[c]) / 2;
+		else
+			w[c] = (mix_left[c] - mix_right[c]) / 2;
+	}
 }
 
 /**
- * @brief	Compute the Fast Fourier Transrmation of a fixed size float 
- *		buffer. It means only real data in input.
- * @param[in]	input float buffer. Size: PLAYER_WINDOW_SIZE.
- * @param[out]	buffer composed by complex data. Size: PLAYER_WINDOW_SIZE / 2;
+ * @brief	Read the frames of the signal of the spectograms.
+ *
+ * Only the channels in the signal are read.
+ *
+ * @param[in]	ph	where the stream is in the track.
+ * @param[in]	filtered	read the filtered frames, not the original.
+ * @param[in]	k	first stream frame.
+ * @param[in]	count	no. frames, at most win_len.
+ * @param[out]	buf	count floats.
  */
-static void FFT(const float *in, fftwf_complex *out)
+static void read_spect(const playhead_t *ph, int filtered, long k,
+					   unsigned int count, float *buf)
 {
-	fftwf_plan dft_p; /**< Direct f.t. configuration structure. */
-	float inbuff[PLAYER_WINDOW_SIZE];
-	/**< Need a buffer, cause create plan destroy input data, */
+	float *frames = spect_buf; /**< original interleaved frames. */
+	float *ch[PLAYER_MAX_NCH], w[PLAYER_MAX_NCH];
+
+	pthread_mutex_lock(&spect_mutex);
+	spect_weights(spect_sig, spect_ch, w);
+	pthread_mutex_unlock(&spect_mutex);
+	for (int c = 0; c < src.nch; c++)
+		ch[c] = spect_buf + (src.nch + c) * win_len;
+	if (filtered)
+	{
+		for (int c = 0; c < src.nch; c++)
+			if (w[c] != 0)
+				read_filt(c, k, count, ch[c]);
+	}
+	else
+	{
+		read_orig(ph, k, count, frames);
+		ilv->split(frames, ch, src.nch, count);
+	}
+	mix((const float *const *)ch, w, count, buf);
+}
 
-	dft_p = fftwf_plan_dft_r2c_1d(PLAYER_WINDOW_SIZE, inbuff, out,
-								  FFTW_ESTIMATE);
-	memcpy(inbuff, in, sizeof(inbuff));
-	fftwf_execute(dft_p);
-	fftwf_destroy_plan(dft_p);
+/**
+ * @brief	Push to the spectra the frames played since the last call.
+ *
+ * Both spectra go on from where they stopped, the frame k of the stream in
+ * the analysis being the filtered frame k and the original frame k - lat,
+ * the one heard with it. Each frame is read and mixed once, as it is pushed.
+ * The window ends 3/4 of it after the playhead, as far as it is filtered.
+ * The analysis restarts a window before that when the stream restarts,
+ * when the playhead goes back, or when it is too far behind to catch up.
+ * The original frames are not pushed while its spectra are read from the
+ * cache.
+ *
+ * @param[in]	ph	playhead to analyse.
+ * @param[in]	orig	push the original frames too.
+ * @return	no. new spectra.
+ */
+static int update_stft(const playhead_t *ph, int orig)
+{
+	static long next;		 /**< Next stream frame to push. */
+	static long sbase = -1; /**< Track frame of the stream analysed. */
+	static int sdir;		 /**< Direction of the stream analysed. */
+	static int sorig;		 /**< Original frames pushed. */
+	long end, n;
+	int nframe = 0;
+
+	end = ph->k + 3 * filt_stft.size / 4;
+	if (end > ph->filt)
+		end = ph->filt;
+	if (ph->base != sbase || ph->dir != sdir || next > end ||
+		filt_stft.count == 0 || end - next > 2 * win_len || orig != sorig)
+	{
+		next = end - filt_stft.size;
+		stft_reset(&orig_stft, next);
+		stft_reset(&filt_stft, next);
+		sbase = ph->base;
+		sdir = ph->dir;
+		sorig = orig;
+	}
+	for (; next < end; next += n)
+	{
+		n = (end - next < win_len) ? end - next : win_len;
+		// frames that aren't there are read as zeros
+		read_spect(ph, 1, next, n, spect_mix);
+		nframe += stft_push(&filt_stft, spect_mix, n);
+		if (!orig)
+			continue;
+		read_spect(ph, 0, next - ph->lat, n, spect_mix);
+		stft_push(&orig_stft, spect_mix, n);
+	}
+	return nframe;
 }
 
 /**
- * @brief	Update the player spectogram according to the current playing
- *		position. 
+ * @brief	Scale a spectrum for the view.
  *
- * For a good spectogram the timedata Window is first passed through the black-
- * -man harris Window function, which better isolate frequency. After that com-
- * -pute the FFT and than magnitude (euclidean distance of the real and imagina-
- * -ry) parts for each term. In latter operation the maximum value among all 
- * bins is computed as well.
- * In order to provide a spectogram easy to visualize and understand the func-
+ * The spectrum is made of the magnitudes of the terms of the FFT of a
+ * window passed through the selected Window function (Blackman-Harris by
+ * default), which better isolate frequency, corrected by the coherent gain
+ * of the window so that levels don't change when the window does. In
+ * order to provide a spectogram easy to visualize and understand the func-
  * -tion normalizes the bins, that are actually random positive values.
- * Normalization comes with first dividing all bins for maximum value computed
- * before. Now bins are in the [0-1] range, but human ear hears using a loga-
+ * Normalization comes with first dividing all bins for the maximum value.
+ * Now bins are in the [0-1] range, but human ear hears using a loga-
  * -rithmic scale (deciBel scale). So bins are now passed throgh a logaritmig 
  * function, which brings the values between [-inf, 0]. 
  * Take the values we've got from the dB calculation above. Add dynamic range 
@@ -273,43 +553,29 @@ static void FFT(const float *in, fftwf_complex *out)
  * -infinity to 1. This operation is done to bring values to the original sample
  * bit depth scale. Finally clamping the lower end to 0 and multiplying by 100
  * the bins are in the [0-100] scale.
+ * Bins are averaged in bands first, so only a value per band is scaled.
  *
- * @param[in]	s
- * @param[out]	spect
- * @param[in]	pos
+ * @param[in]	bd	bands of the spectogram.
+ * @param[in]	mag	magnitudes of the bins.
+ * @param[out]	spect	bands published.
  */
-static void update_spectogram(const SAMPLE *s, float spect[])
+static void scale_spectogram(const bands_t *bd, const float mag[],
+							 float spect[])
 {
-	int i;   /**< Array index. */
-	int ret; /**< Returned values. */
-	float timedata[PLAYER_WINDOW_SIZE];
-	/**< Sample Timedata buff. */
-	fftwf_complex freqdata[PLAYER_WINDOW_SIZE_CPX];
-	/**< Frequency data buff. */
+	long i;  /**< Array index. */
 	static int max = 0;
 	/**< Maximum value step by step. */
+	int nbar = bands_nbar(bd);
 
-	i = (pos < PLAYER_WINDOW_SIZE / 4) ? PLAYER_WINDOW_SIZE / 4 : pos;
-
-	ret = sample_to_float((const SAMPLE *)s, timedata,
-						  i - PLAYER_WINDOW_SIZE / 4, PLAYER_WINDOW_SIZE);
-	// Zero pad in case there aren't enough time data
-	if (ret < PLAYER_WINDOW_SIZE)
-		memset(&timedata[ret], 0, PLAYER_WINDOW_SIZE - ret);
-	// Apply blackman harris window f. to better isolate frequency
-	for (i = 0; i < PLAYER_WINDOW_SIZE; i++)
-		timedata[i] *= blackman_harris(i);
-
-	FFT(timedata, freqdata);
-	// Magnitude, maximum value
-	for (i = 0; i < PLAYER_WINDOW_SIZE_CPX; i++)
+	bands_apply(bd, mag, spect);
+	// maximum value of the bands published only
+	for (i = 0; i < nbar; i++)
 	{
-		spect[i] = modulus(freqdata[i]);
 		if (spect[i] > max)
 			max = spect[i];
 	}
 	// Normalize values in a [0-100] range
-	for (i = 0; i < PLAYER_WINDOW_SIZE_CPX; i++)
+	for (i = 0; i < nbar; i++)
 	{
 		spect[i] /= max;
 		// Human ear hears using a logarithmic scale.
@@ -324,35 +590,517 @@ static void update_spectogram(const SAMPLE *s, float spect[])
 	}
 }
 
+/**
+ * @brief	Store a scaled spectogram in the history, a byte per band.
+ *
+ * @param[out]	dst	PLAYER_MAX_BARS bytes.
+ * @param[in]	spect	scaled spectogram.
+ * @param[in]	nbar	no. bands.
+ */
+static void hist_store(unsigned char dst[], const float spect[], int nbar)
+{
+	for (int i = 0; i < nbar; i++)
+		dst[i] = spect[i];
+}
+
+/**
+ * @brief	Publish the spectograms in both copies, by the analysis only.
+ *
+ * @param[in]	orig	original spectogram.
+ * @param[in]	filt	filtered spectogram.
+ * @param[in]	nbar	no. bands.
+ * @param[in]	hist	1 to add them to the history, 0 to make them the
+ *			current ones.
+ */
+static void spect_publish(const float orig[], const float filt[], int nbar,
+						  int hist)
+{
+	spect_pub_t *d;
+	int slot;
+
+	for (int k = 0; k < 2; k++)
+	{
+		d = &spect_pub[seqlock_write_begin(&spect_seq)];
+		if (hist)
+		{
+			slot = d->count % PLAYER_STFT_FRAMES;
+			hist_store(d->hist[0][slot], orig, nbar);
+			hist_store(d->hist[1][slot], filt, nbar);
+			d->hist_nbar[slot] = nbar;
+			d->count++;
+		}
+		else
+		{
+			memcpy(d->orig, orig, sizeof(d->orig));
+			memcpy(d->filt, filt, sizeof(d->filt));
+			d->nbar = nbar;
+		}
+		seqlock_write_end(&spect_seq);
+	}
+	if (hist)
+		__atomic_store_n(&spect_count, spect_count + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief	Restart the output stream from a track frame.
+ *
+ * The frames already queued are dropped, the new stream is stopped.
+ *
+ * @param[in]	at	track frame of the first stream frame.
+ * @param[in]	d	1 to play forward, -1 backward.
+ * @param[in]	freq	playback frequency of the voice.
+ */
+static void player_restart(long at, int d, int freq)
+{
+	if (stream != NULL)
+		stop_audio_stream(stream);
+	// the volume is applied when filtering
+	stream = play_audio_stream(PLAYER_STREAM_LEN(src.freq), bits_out,
+							   nch_out == 2, src.freq, 255, 128);
+	if (stream == NULL)
+		error_at_line(-1, 0, __FILE__, __LINE__, "no voices are available");
+	voice_stop(stream->voice);
+	voice_set_frequency(stream->voice, freq);
+	base = filt_base = at;
+	dir = d;
+	play_pos = fed_pos = 0;
+	__atomic_store_n(&filt_pos, 0, __ATOMIC_RELEASE);
+	nsplice = 0;
+	jump_at = -1;
+	// the automation in effect at the new position
+	for (int l = 0; l < PLAYER_NLANE; l++)
+		lane_pt[l] = -2;
+}
+
+/**
+ * @brief	Stream frames played, from the position of the voice.
+ *
+ * The voice loops over the ring of the stream, where the stream frame k is in
+ * the slot k % ring, and no more than a ring of frames is queued. So the frame
+ * played is the last frame fed that is in the slot of the voice.
+ *
+ * @return	no. stream frames played.
+ */
+static long stream_played()
+{
+	long ring = stream->samp->len, k;
+	int vpos = voice_get_position(stream->voice);
+
+	if (vpos < 0)
+		return play_pos;
+	k = fed_pos - (((fed_pos - vpos) % ring) + ring) % ring;
+	// before the first frame fed the voice plays silence
+	return (k > play_pos) ? k : play_pos;
+}
+
+/**
+ * @brief	Read in the ring the original frames needed from now on.
+ *
+ * These are the frames to filter, up to the stream frame to, and the ones
+ * the analysis needs around the playhead.
+ *
+ * @param[in]	to	stream frame to filter up to.
+ */
+static void player_prefetch(long to)
+{
+	long from = play_pos - lat - win_len;
+
+	if (to < play_pos + win_len)
+		to = play_pos + win_len;
+	// after a splice only the frames still to filter
+	if (nsplice > 0)
+		from = splice[nsplice - 1].at;
+	if (dir > 0)
+		source_prefetch(&src, filt_base + from, filt_base + to);
+	else
+		source_prefetch(&src, filt_base - to + 1, filt_base - from + 1);
+}
+
+/**
+ * @brief	Map a signal to its automation lane.
+ *
+ * @return	the lane, -1 if the signal cannot be automated.
+ */
+static int player_lane(player_signal_t sig)
+{
+	switch (sig)
+	{
+	case VOL_SIG:
+		return 0;
+	case JUMP_SIG:
+		return PLAYER_NLANE - 1;
+	default:
+		// a lane per band a layout can have
+		if (sig >= FILTLOW_SIG && sig <= FILT_LAST_SIG)
+			return 1 + sig - FILTLOW_SIG;
+		return -1;
+	}
+}
+
+/**
+ * @brief	Apply the automation in effect at the next frame filtered.
+ *
+ * A jump is done when the stream reaches its frame playing forward, by a
+ * splice, the other lanes set the value of their point in effect when it
+ * changes, or their base value before their first point.
+ *
+ * @param[in]	n	frames to filter.
+ * @return	frames to filter before the automation changes, up to n.
+ */
+static long player_automate(long n)
+{
+	long f = filt_base + dir * filt_pos, span;
+	lane_t *jl = &lanes[PLAYER_NLANE - 1];
+	int i;
+
+	i = lane_find(jl, f);
+	if (dir > 0 && i >= 0 && jl->frame[i] == f && jump_at != filt_pos &&
+		nsplice < PLAYER_MAX_SPLICE)
+	{
+		// the frames from here on are read from the target
+		jump_at = filt_pos;
+		f = jl->val[i] * src.freq;
+		filt_base = f - filt_pos;
+		splice[nsplice].at = filt_pos;
+		splice[nsplice++].base = filt_base;
+		source_seek(&src, f);
+		for (int l = 0; l < PLAYER_NLANE - 1; l++)
+			lane_pt[l] = -2;
+	}
+	if (dir > 0)
+	{
+		span = lane_span(jl, f, 1);
+		if (span < n)
+			n = span;
+	}
+	for (int l = 0; l < PLAYER_NLANE - 1; l++)
+	{
+		i = lane_find(&lanes[l], f);
+		// an empty lane leaves the value set at once
+		if (i != lane_pt[l] && (i >= 0 || lanes[l].len > 0))
+			player_dispatch_body((player_event_t){
+				(l == 0) ? VOL_SIG : FILTLOW_SIG + l - 1,
+				(i >= 0) ? lanes[l].val[i] : lane_base[l]});
+		lane_pt[l] = i;
+		span = lane_span(&lanes[l], f, dir);
+		if (span < n)
+			n = span;
+	}
+	return n;
+}
+
+/**
+ * @brief	Apply the volume to filtered frames.
+ *
+ * A change ramps linearly over EQ_RAMP_LEN frames, as the gains of the
+ * equalizer, so that it doesn't click.
+ *
+ * @param[inout]	ch	frames of each channel.
+ * @param[in]	n	no. frames.
+ */
+static void player_gain(float *const ch[], long n)
+{
+	long i = 0;
+	float g;
+
+	for (; i < n && vol_ramp < EQ_RAMP_LEN; i++)
+	{
+		vol_ramp++;
+		g = vol_from + (vol_gain - vol_from) * vol_ramp / EQ_RAMP_LEN;
+		for (int c = 0; c < src.nch; c++)
+			ch[c][i] *= g;
+	}
+	if (vol_gain != 1)
+		for (int c = 0; c < src.nch; c++)
+			for (long k = i; k < n; k++)
+				ch[c][k] *= vol_gain;
+}
+
+/**
+ * @brief	Filter the stream frames up to a given one.
+ *
+ * Each frame is filtered once, when it is needed to feed the output, so
+ * nothing is filtered ahead of the stream buffer being fed and a gain
+ * change is heard from the next one.
+ *
+ * @param[in]	to	stream frame to filter up to, excluded.
+ */
+static void player_filt(long to)
+{
+	static float frames[PLAYER_FILT_BLOCK * PLAYER_MAX_NCH];
+	/**< interleaved frames being filtered. */
+	playhead_t ph = {.dir = dir};
+	float *ch[PLAYER_MAX_NCH];
+	long n, slot;
+
+	player_prefetch(to);
+	while (filt_pos < to)
+	{
+		slot = filt_pos % filt_cap;
+		n = to - filt_pos;
+		if (n > PLAYER_FILT_BLOCK)
+			n = PLAYER_FILT_BLOCK;
+		if (n > filt_cap - slot)
+			n = filt_cap - slot;
+		// blocks end where the automation changes
+		n = player_automate(n);
+		if (nsplice > 0 && splice[nsplice - 1].at == filt_pos)
+			player_prefetch(to);
+		ph.base = filt_base;
+		read_orig(&ph, filt_pos, n, frames);
+		// channels are split in their rings and filtered there
+		for (int c = 0; c < src.nch; c++)
+			ch[c] = filt_ring + c * filt_cap + slot;
+		ilv->split(frames, ch, src.nch, n);
+		equalizer_equalize_ch(ch, n);
+		player_gain(ch, n);
+		// the block is whole before the analysis reads it
+		__atomic_store_n(&filt_pos, filt_pos + n, __ATOMIC_RELEASE);
+	}
+}
+
+/**
+ * @brief	Feed the output with all the buffers it asks for.
+ *
+ * Tracks of more than two channels are mixed down to stereo.
+ */
+static void player_feed()
+{
+	static float frames[PLAYER_FILT_BLOCK * 2]; /**< interleaved output. */
+	static float down[2][PLAYER_FILT_BLOCK];	/**< stereo downmix. */
+	const float *ch[PLAYER_MAX_NCH];
+	int fsize = nch_out * bits_out / 8;
+	uint8_t *buf;
+	long k, end, n, slot;
+
+	while ((buf = get_audio_stream_buffer(stream)) != NULL)
+	{
+		end = fed_pos + stream->len;
+		player_filt(end);
+		for (k = fed_pos; k < end; k += n)
+		{
+			slot = k % filt_cap;
+			n = end - k;
+			if (n > filt_cap - slot)
+				n = filt_cap - slot;
+			if (n > PLAYER_FILT_BLOCK)
+				n = PLAYER_FILT_BLOCK;
+			for (int c = 0; c < src.nch; c++)
+				ch[c] = filt_ring + c * filt_cap + slot;
+			if (src.nch > nch_out)
+			{
+				mix(ch, mix_left, n, down[0]);
+				mix(ch, mix_right, n, down[1]);
+				ch[0] = down[0];
+				ch[1] = down[1];
+			}
+			if (nch_out > 1)
+			{
+				ilv_out->merge(ch, frames, nch_out, n);
+				ch[0] = frames;
+			}
+			conv->from_float(ch[0], buf + (k - fed_pos) * fsize,
+							 n * nch_out);
+		}
+		free_audio_stream_buffer(stream);
+		fed_pos = end;
+	}
+}
+
 /**
  * @brief	initialize the player internal and external variable.
  * @param[in]	path	path of the input song.
  */
 void player_init(const char *path)
 {
-	algr_load_smpl(path, &orig_sample);
-	algr_load_smpl(path, &filt_sample);
+	long need; /**< frames needed around the playhead. */
+
+	if (source_open(&src, path, mem_budget) < 0)
+		error_at_line(-1, 0, __FILE__, __LINE__, "cannot open %s", path);
+	// the hints to the kernel are given by the analysis task
+	source_set_async(&src, 1);
+	check_format(path);
+	if (evq_init(&player_evq, PLAYER_EVQ_LEN, sizeof(player_timed_t)) < 0)
+		error_at_line(-1, 0, __FILE__, __LINE__, "event queue");
+	for (int l = 0; l < PLAYER_NLANE; l++)
+	{
+		if (lane_init(&lanes[l], PLAYER_LANE_LEN) < 0 ||
+			lane_init(&lane_stage[l], PLAYER_LANE_LEN) < 0)
+			error_at_line(-1, 0, __FILE__, __LINE__, "automation lanes");
+		lane_pt[l] = -1;
+	}
+	// the stream is an Allegro SAMPLE, unsigned whatever the file is, and
+	// wider samples are already in the 16 bits range once converted
+	bits_out = (src.bits == 8) ? 8 : 16;
+	conv = convert_select((bits_out == 8) ? CONVERT_U8 : CONVERT_U16);
+	// Allegro plays at most stereo
+	nch_out = (src.nch > 2) ? 2 : src.nch;
+	ilv = convert_ilv_select(src.nch);
+	ilv_out = convert_ilv_select(nch_out);
+	for (int c = 0; c < src.nch; c++)
+	{
+		mix_left[c] = (c % 2 == 0) ? 1.0f / ((src.nch + 1) / 2) : 0.0f;
+		mix_right[c] = (c % 2 == 1) ? 1.0f / (src.nch / 2) : 0.0f;
+	}
 
 	p.state = STOP;
 	p.time = pos = 0;
 	p.time_data = 0;
-	p.bits = filt_sample->bits;
+	p.bits = src.bits;
+	p.nch = src.nch;
+	p.spect = spect_sig;
+	p.spect_ch = spect_ch;
 	get_trackname(p.trackname, path);
-	p.duration = ((float)(filt_sample->len / filt_sample->freq));
+	snprintf(track_path, sizeof(track_path), "%s", path);
+	p.duration = ((float)(src.len / src.freq));
 	memset(p.filt_spect, 0, sizeof(p.filt_spect));
 	memset(p.orig_spect, 0, sizeof(p.orig_spect));
-	p.dynamic_range =
-		fabsf(20.0f * log10f(1.0f / (1 << filt_sample->bits)));
-	p.freq_spacing = ((float)filt_sample->freq) / PLAYER_WINDOW_SIZE;
+	memset(spect_pub, 0, sizeof(spect_pub));
+	playhead.pos = 0;
+	playhead.state = STOP;
+	// floats, the samples once converted, have no more than 24 bits
+	p.dynamic_range = 20.0f * log10f(2.0f) * ((src.bits > 24) ? 24 : src.bits);
+	// the window lasts the same at any rate, so bins are as spaced
+	for (win_len = PLAYER_WINDOW_SIZE;
+		 src.freq > PLAYER_WINDOW_FREQ * (win_len / PLAYER_WINDOW_SIZE);
+		 win_len *= 2)
+		;
+	p.freq_spacing = ((float)src.freq) / win_len;
 	p.volume = 100;
-	// initialize of Band EQ.
-	memset(p.eq_gain, 0, sizeof(p.eq_gain));
-	equalizer_init(filt_sample->freq);
-	// allocating the sample
-	v = allocate_voice(filt_sample);
-	if (v < 0)
-		error_at_line(-1, 0, __FILE__, __LINE__, "no voices are available");
-	voice_set_playmode(v, PLAYMODE_PLAY);
+	// the automation starts from the defaults
+	lane_base[0] = p.volume;
+	for (int l = 1; l < PLAYER_NLANE; l++)
+		lane_base[l] = 0;
+	equalizer_init(src.freq);
+	equalizer_set_nch(src.nch);
+	// initialize of Band EQ, the bands of the player at 0
+	player_eq_layout(EQ_PRESET_PLAYER);
+	// FFT plans are created once, the RT thread only executes them
+	fft_init(NULL);
+	if (fft_plan(win_len) < 0)
+		error_at_line(-1, 0, __FILE__, __LINE__, "cannot plan the fft");
+	// the window is as long at any rate
+	if (player_set_stft(stft_size, stft_hop) < 0)
+		error_at_line(-1, 0, __FILE__, __LINE__, "cannot build the window");
+	if (player_set_bands(bands_scale, bands_req) < 0)
+		error_at_line(-1, 0, __FILE__, __LINE__, "cannot build the bands");
+	spect_buf = malloc(sizeof(float) * win_len * src.nch * 2);
+	spect_mix = malloc(sizeof(float) * win_len);
+	if (spect_buf == NULL || spect_mix == NULL)
+		error_at_line(-1, errno, __FILE__, __LINE__, "spectogram buffer");
+	// the output stream and the rings around the playhead
+	player_restart(0, 1, src.freq);
+	need = stream->samp->len + stream->len + win_len;
+	if (src.cap < src.len && src.cap < need)
+		error_at_line(-1, 0, __FILE__, __LINE__,
+					  "memory budget too small, at least %ld bytes needed",
+					  need * src.fsize);
+	// and the block being filtered, that the analysis does not read
+	filt_cap = need + PLAYER_FILT_BLOCK;
+	filt_ring = malloc(sizeof(float) * filt_cap * src.nch);
+	if (filt_ring == NULL)
+		error_at_line(-1, errno, __FILE__, __LINE__, "filtered ring");
+}
+
+int player_set_mem_budget(size_t bytes)
+{
+	if (bytes == 0)
+		return -1;
+	mem_budget = bytes;
+	return 0;
+}
+
+void player_set_affinity(unsigned long cpus) { tp.cpus = cpus; }
+
+void player_set_overrun(task_overrun_t overrun) { tp.overrun = overrun; }
+
+int player_set_window(window_type_t type, float beta)
+{
+	const window_t *w;
+
+	// tables are built once and never released until exit
+	pthread_mutex_lock(&win_mutex);
+	w = window_get(type, stft_size * (win_len / PLAYER_WINDOW_SIZE), beta);
+	if (w != NULL)
+	{
+		win = w;
+		win_type = type;
+		win_beta = beta;
+		stft_gen++;
+	}
+	pthread_mutex_unlock(&win_mutex);
+	return (w != NULL) ? 0 : -1;
+}
+
+int player_set_stft(int size, int hop)
+{
+	const window_t *w;
+
+	if (size < 1 || size > PLAYER_WINDOW_SIZE || (size & (size - 1)) ||
+		hop < 1 || hop > size)
+		return -1;
+	pthread_mutex_lock(&win_mutex);
+	w = window_get(win_type, size * (win_len / PLAYER_WINDOW_SIZE), win_beta);
+	if (w != NULL)
+	{
+		win = w;
+		stft_size = size;
+		stft_hop = hop;
+		stft_gen++;
+	}
+	pthread_mutex_unlock(&win_mutex);
+	return (w != NULL) ? 0 : -1;
+}
+
+int player_set_bands(bands_scale_t scale, int nbar)
+{
+	bands_t *bd;
+	// bins past the window frequency are not published at higher rates
+	float top = (PLAYER_WINDOW_SIZE_CPX - 0.5f) * p.freq_spacing;
+	float fmax = (PLAYER_BANDS_FMAX < top) ? PLAYER_BANDS_FMAX : top;
+
+	if (nbar < 1 || nbar > PLAYER_MAX_BARS || p.freq_spacing <= 0)
+		return -1;
+	// the table is computed here, the analysis only swaps the pointer
+	if (scale == BANDS_LINEAR)
+		bd = bands_new(scale, nbar, PLAYER_WINDOW_SIZE_CPX, p.freq_spacing, 0,
+					   top);
+	else
+		bd = bands_new(scale, nbar, PLAYER_WINDOW_SIZE_CPX, p.freq_spacing,
+					   PLAYER_BANDS_FMIN, fmax);
+	if (bd == NULL)
+		return -1;
+	pthread_mutex_lock(&spect_mutex);
+	bands_delete(bands_old);
+	bands_delete(bands_next);
+	bands_old = NULL;
+	bands_next = bd;
+	bands_scale = scale;
+	bands_req = nbar;
+	pthread_mutex_unlock(&spect_mutex);
+	__atomic_store_n(&p.scale, scale, __ATOMIC_RELEASE);
+	return bands_nbar(bd);
+}
+
+int player_set_eq_mode(eq_mode_t mode)
+{
+	return equalizer_set_mode(mode);
+}
+
+int player_set_spect(player_spect_t spect, int ch)
+{
+	if (spect < PLAYER_SPECT_MID || spect > PLAYER_SPECT_CHANNEL ||
+		(spect == PLAYER_SPECT_CHANNEL && (ch < 0 || ch >= src.nch)))
+		return -1;
+	if (spect != PLAYER_SPECT_CHANNEL)
+		ch = 0;
+	pthread_mutex_lock(&spect_mutex);
+	spect_sig = spect;
+	spect_ch = ch;
+	pthread_mutex_unlock(&spect_mutex);
+	__atomic_store_n(&p.spect, spect, __ATOMIC_RELEASE);
+	__atomic_store_n(&p.spect_ch, ch, __ATOMIC_RELEASE);
+	return 0;
 }
 
 void player_volume(float val)
@@ -361,9 +1109,11 @@ void player_volume(float val)
 		val = 100;
 	if (val < 0)
 		val = 0;
-	// convert [0-100] scale to [0-255] scale
-	voice_set_volume(v, (int)(val * 2.55));
-	p.volume = (int)val;
+	// ramps from the gain in effect, heard from the frames not yet filtered
+	vol_from += (vol_gain - vol_from) * vol_ramp / EQ_RAMP_LEN;
+	vol_ramp = 0;
+	vol_gain = (int)val / 100.0f;
+	__atomic_store_n(&p.volume, (int)val, __ATOMIC_RELEASE);
 }
 
 void player_jump(float val)
@@ -373,23 +1123,69 @@ void player_jump(float val)
 	if (val < 0)
 		val = 0;
 	// convert time to position thanks to frequency
-	pos = val * filt_sample->freq;
-	p.time = val;
-	voice_set_position(v, pos);
+	pos = val * src.freq;
+	store_float(&p.time, val);
+	// queued frames are dropped, the stream goes on from the new position
+	source_seek(&src, pos);
+	player_restart(pos, dir, voice_get_frequency(stream->voice));
+	if (p.state != STOP && p.state != PAUSE)
+		voice_start(stream->voice);
 }
 
-void player_filtxxx(player_event_t evt)
+/**
+ * @brief	Publish the band layout of the equalizer, all gains to 0.
+ *
+ * The gains and frequencies are stored before the number of bands, so that
+ * a reader seeing the new layout sees its bands.
+ *
+ * @param[in]	preset	the preset of the layout.
+ */
+static void player_eq_layout(eq_preset_t preset)
 {
-	float ret;
-	ret = equalizer_set_gain(evt.sig - FILTLOW_SIG, evt.val);
-	if (ret == PLAYER_EQ_MAX_GAIN - 1)
+	eq_band_t band;
+	int n = equalizer_get_nband();
+
+	for (int i = 0; i < PLAYER_EQ_MAX_NFILT; i++)
 	{
-		error_at_line(-1, 0, __FILE__, __LINE__,
-					  "error in equalizer set gain(%d, %f)",
-					  evt.sig - FILTLOW_SIG, evt.val);
+		store_float(&p.eq_gain[i], 0);
+		store_float(&p.eq_freq[i],
+					(i < n && equalizer_get_band(i, &band) == 0) ? band.freq : 0);
+	}
+	__atomic_store_n(&p.preset, preset, __ATOMIC_RELEASE);
+	__atomic_store_n(&p.nband, n, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief	Function that manage the PRESET_SIG event.
+ *
+ * The bands change, all gains go to 0 and the points of the lanes of the
+ * gains are dropped, being set for bands no more there.
+ *
+ * @param[in]	evt	the event, whose value is the preset.
+ */
+static void player_preset(player_event_t evt)
+{
+	if (equalizer_set_preset((eq_preset_t)evt.val) < 0)
+		return;
+	for (int l = 1; l < PLAYER_NLANE - 1; l++)
+	{
+		lane_clear(&lanes[l]);
+		lane_base[l] = 0;
+		lane_pt[l] = -1;
 	}
-	p.eq_gain[evt.sig - FILTLOW_SIG] = ret;
-	filt_pos = pos;
+	player_eq_layout((eq_preset_t)evt.val);
+}
+
+void player_filtxxx(player_event_t evt)
+{
+	float set;
+
+	// a band the layout does not have is reported by the equalizer
+	if (equalizer_set_gain(evt.sig - FILTLOW_SIG, evt.val, &set) < 0)
+		return;
+	store_float(&p.eq_gain[evt.sig - FILTLOW_SIG], set);
+	// the equalizer ramps to the new gain from the next frame fed, heard
+	// after the stream buffers already queued, a few tens of ms
 }
 
 /**
@@ -425,38 +1221,18 @@ static void player_dispatch_body(player_event_t evt)
 	case JUMP_SIG:
 		player_jump(evt.val);
 		break;
-	case FILTLOW_SIG:
-	case FILTMED_SIG:
-	case FILTMEDHIG_SIG:
-	case FILTHIG_SIG:
-		player_filtxxx(evt);
+	case PRESET_SIG:
+		player_preset(evt);
 		break;
 	default:
-		printf("not a valid signal\n");
+		if (evt.sig >= FILTLOW_SIG && evt.sig <= FILT_LAST_SIG)
+			player_filtxxx(evt);
+		else
+			printf("not a valid signal\n");
 		break;
 	}
 }
 
-/**
- * @brief	Filter the data nexts to actual position
- */
-static void player_filt()
-{
-	int ret;
-	float timedata[PLAYER_MAX_FREQ / 2];
-	/**< half second window(in the worst case frequency) 
-			of time data*/
-
-	if (filt_pos < filt_sample->len)
-	{
-		ret = sample_to_float((const SAMPLE *)orig_sample,
-							  timedata, filt_pos, PLAYER_MAX_FREQ / 2);
-		ret = equalizer_equalize(timedata, ret);
-		float_to_sample(timedata, filt_sample, filt_pos, ret);
-		filt_pos += PLAYER_MAX_FREQ / 2;
-	}
-}
-
 /**
  * @brief	Function that manage the STOP_SIG event.
  *		
@@ -468,19 +1244,12 @@ static void player_stop()
 {
 	if (p.state == STOP)
 		return;
-	if (p.state != PAUSE)
-		voice_stop(v);
-	if (p.state == REWIND || p.state == FORWARD)
-	{
-		if (p.state == REWIND)
-			voice_set_playmode(v, PLAYMODE_FORWARD);
-		voice_set_frequency(v, filt_sample->freq);
-	}
-	voice_set_position(v, 0);
-	memset(p.filt_spect, 0, sizeof(p.filt_spect));
-	memset(p.orig_spect, 0, sizeof(p.orig_spect));
-	p.time = pos = 0;
-	p.state = STOP;
+	// a new stream from the start, stopped and at normal speed
+	player_restart(0, 1, src.freq);
+	// spectograms are cleared by the analysis thread
+	pos = 0;
+	store_float(&p.time, 0);
+	set_state(STOP);
 }
 
 /**
@@ -488,19 +1257,14 @@ static void player_stop()
  */
 static void player_play()
 {
-	if (p.state == STOP || p.state == PAUSE)
-		voice_start(v);
-	if (p.state == REWIND || p.state == FORWARD)
-	{
-		if (p.state == REWIND)
-		{
-			voice_set_playmode(v, PLAYMODE_FORWARD);
-			voice_set_position(v, pos);
-		}
-		// set frequency to the original freq.
-		voice_set_frequency(v, filt_sample->freq);
-	}
-	p.state = PLAY;
+	if (p.state == REWIND)
+		player_restart(pos, 1, src.freq);
+	// set frequency to the original freq.
+	if (p.state == FORWARD)
+		voice_set_frequency(stream->voice, src.freq);
+	if (p.state != PLAY && p.state != FORWARD)
+		voice_start(stream->voice);
+	set_state(PLAY);
 }
 
 /**
@@ -511,39 +1275,30 @@ static void player_pause()
 	if (p.state == STOP)
 		return;
 	if (p.state != PAUSE)
-		voice_stop(v);
-	if (p.state == REWIND || p.state == FORWARD)
-	{
-		voice_set_frequency(v, filt_sample->freq);
-		if (p.state == REWIND)
-		{
-			voice_set_playmode(v, PLAYMODE_FORWARD);
-			voice_set_position(v, pos);
-		}
-	}
-	p.state = PAUSE;
+		voice_stop(stream->voice);
+	if (p.state == REWIND)
+		player_restart(pos, 1, src.freq);
+	if (p.state == FORWARD)
+		voice_set_frequency(stream->voice, src.freq);
+	set_state(PAUSE);
 }
 
 /**
  * @brief	Function that manage the RWND_SIG event.
+ *
+ * The track is streamed backward from the playhead.
  */
 static void player_rewind()
 {
 	if (p.state == STOP)
 		return;
 	if (p.state != REWIND)
-	{
-		voice_set_playmode(v, PLAYMODE_BACKWARD);
-		voice_set_position(v, pos);
-		voice_set_frequency(v, (((float)filt_sample->freq) * 1.25));
-	}
+		player_restart(pos, -1, ((float)src.freq) * 1.25);
 	else
-	{
-		voice_set_frequency(v, 1.25 * voice_get_frequency(v));
-	}
-	if (p.state == PAUSE)
-		voice_start(v);
-	p.state = REWIND;
+		voice_set_frequency(stream->voice,
+							1.25 * voice_get_frequency(stream->voice));
+	voice_start(stream->voice);
+	set_state(REWIND);
 }
 
 /**
@@ -552,36 +1307,168 @@ static void player_rewind()
 static void player_forward()
 {
 	if (p.state == REWIND)
-	{
-		voice_set_playmode(v, PLAYMODE_FORWARD);
-		voice_set_position(v, pos);
-		voice_set_frequency(v, (((float)filt_sample->freq) * 1.25));
-	}
+		player_restart(pos, 1, ((float)src.freq) * 1.25);
 	else
-	{
-		voice_set_frequency(v, 1.25 * voice_get_frequency(v));
-	}
-	if (p.state == STOP || p.state == PAUSE)
-	{
-		voice_start(v);
-	}
-	p.state = FORWARD;
+		voice_set_frequency(stream->voice,
+							1.25 * voice_get_frequency(stream->voice));
+	if (p.state != PLAY && p.state != FORWARD)
+		voice_start(stream->voice);
+	set_state(FORWARD);
 }
 
 /**
  * @brief dispatch an event, external interface
  * 
- * This store the given event in the global event variable. 
- * When player thread will see event is not zero, it will 
- * really execute the dispatch behavior.
+ * This appends the given event to the queue of the player, with no lock.
+ * The player thread drains the queue at each period and really executes
+ * the dispatch behavior. When the queue is full the event is dropped,
+ * and the caller told so.
  * 
  * @param evt event to dispatch to the player
+ * @return int 0 on success, -1 if the queue is full
+ */
+int player_dispatch(player_event_t evt)
+{
+	return player_queue(evt, PLAYER_NOW);
+}
+
+int player_dispatch_at(player_event_t evt, long frame)
+{
+	return player_queue(evt, (frame < 0) ? PLAYER_NOW : frame);
+}
+
+int player_automate_lane(player_signal_t sig, const long frame[],
+						 const float val[], int n)
+{
+	int l = player_lane(sig), busy = 0;
+
+	if (l < 0 || n < 0 || n > PLAYER_LANE_LEN)
+		return -1;
+	for (int i = 0; i < n; i++)
+		if (frame[i] < 0)
+			return -1;
+	// a batch at a time, the player frees the staging lane once swapped
+	if (!__atomic_compare_exchange_n(&stage_busy[l], &busy, 1, 0,
+									 __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return -1;
+	lane_clear(&lane_stage[l]);
+	for (int i = 0; i < n; i++)
+		lane_add(&lane_stage[l], frame[i], val[i]);
+	// a single event, whatever the no. points
+	if (player_queue((player_event_t){sig, 0}, LANE_SWAP) < 0)
+	{
+		__atomic_store_n(&stage_busy[l], 0, __ATOMIC_RELEASE);
+		return -1;
+	}
+	return 0;
+}
+
+int player_clear_lane(player_signal_t sig)
+{
+	if (player_lane(sig) < 0)
+		return -1;
+	return player_queue((player_event_t){sig, 0}, LANE_CLEAR);
+}
+
+/**
+ * @brief	Queue an event for the player.
+ *
+ * The caller never waits: a real-time caller above the player would spin
+ * forever on its CPU. When the queue is full the event is dropped, and
+ * counted by the queue.
+ *
+ * @param[in]	at	track frame, PLAYER_NOW, LANE_CLEAR or LANE_SWAP.
+ * @return	0 on success, -1 if the queue is full.
  */
-void player_dispatch(player_event_t evt)
+static int player_queue(player_event_t evt, long at)
 {
-	pthread_mutex_lock(&player_event_mutex);
-	player_event = evt;
-	pthread_mutex_unlock(&player_event_mutex);
+	player_timed_t t = {evt, at};
+
+	return evq_push(&player_evq, &t);
+}
+
+/**
+ * @brief	Tell whether an event only sets a value, so that it can be
+ *		replaced by the next one of the same signal.
+ */
+static int player_event_sets(player_signal_t sig)
+{
+	return sig == VOL_SIG || sig == JUMP_SIG || sig == PRESET_SIG ||
+		   (sig >= FILTLOW_SIG && sig <= FILT_LAST_SIG);
+}
+
+/**
+ * @brief	Look up again the point in effect of a lane whose points changed.
+ *
+ * A lane left with no point sets at once the value before its points.
+ *
+ * @param[in]	l	the lane.
+ * @param[in]	sig	signal of the lane.
+ */
+static void lane_changed(int l, player_signal_t sig)
+{
+	if (lanes[l].len > 0)
+	{
+		lane_pt[l] = -2;
+		return;
+	}
+	if (lane_pt[l] >= 0 && l < PLAYER_NLANE - 1)
+		player_dispatch_body((player_event_t){sig, lane_base[l]});
+	lane_pt[l] = -1;
+}
+
+/**
+ * @brief	Dispatch the events queued since the last period.
+ *
+ * Consecutive events setting the same value, as those of a slider being
+ * dragged, are merged into the last one; the others are dispatched in
+ * order. Events with a frame go in the lane of their signal, to be applied
+ * when that frame is filtered. At most a queue of events is drained, those
+ * pushed meanwhile are dispatched the next period.
+ */
+static void player_drain()
+{
+	static player_timed_t t[PLAYER_EVQ_LEN]; /**< events drained. */
+	int n = 0, l;
+
+	while (n < PLAYER_EVQ_LEN && evq_pop(&player_evq, &t[n]) == 0)
+		n++;
+	for (int i = 0; i < n; i++)
+	{
+		l = player_lane(t[i].evt.sig);
+		if (t[i].at == LANE_CLEAR)
+		{
+			lane_clear(&lanes[l]);
+			lane_changed(l, t[i].evt.sig);
+		}
+		else if (t[i].at == LANE_SWAP)
+		{
+			lane_t swap = lanes[l];
+
+			// the points sorted by the caller, taken as they are
+			lanes[l] = lane_stage[l];
+			lane_stage[l] = swap;
+			__atomic_store_n(&stage_busy[l], 0, __ATOMIC_RELEASE);
+			lane_changed(l, t[i].evt.sig);
+		}
+		else if (t[i].at != PLAYER_NOW)
+		{
+			if (l < 0 || lane_add(&lanes[l], t[i].at, t[i].evt.val) < 0)
+				nreject++;
+			else
+				lane_pt[l] = -2;
+		}
+		else if (i + 1 < n && t[i + 1].at == PLAYER_NOW &&
+				 t[i + 1].evt.sig == t[i].evt.sig &&
+				 player_event_sets(t[i].evt.sig))
+			continue;
+		else if (t[i].evt.sig != EMPTY_SIG)
+		{
+			if (l >= 0 && l < PLAYER_NLANE - 1)
+				lane_base[l] = t[i].evt.val;
+			player_dispatch_body(t[i].evt);
+		}
+	}
 }
 
 /**
@@ -592,94 +1479,268 @@ void player_dispatch(player_event_t evt)
  */
 pthread_t *player_start(task_par_t *task_par)
 {
-	struct sched_param mypar;
-	pthread_attr_t attr;
-
 	if (task_par != NULL)
 	{
 		tp = *task_par;
 	}
 
-	pthread_attr_init(&attr);
-	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
-	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
-	mypar.sched_priority = tp.priority;
-	pthread_attr_setschedparam(&attr, &mypar);
-	pthread_create(&tid, &attr, player_run, &tp);
+	task_start(&tid, player_run, &tp);
 
 	return &tid;
 }
 
 /**
- * @brief player thread routine
- * 
- * First execute some update operations, and then check if for global event is
- * different from empty event. If not it calls the dipatch.
- * 
+ * @brief spectra cache thread routine
+ *
+ * Maps the spectra of the mid of the whole original track, computing them
+ * first if they were never computed with the same analysis. It runs at a
+ * normal priority, the spectra are used only once complete.
+ *
  * @param[in] arg  argument passed to the routine(actually nothing is passed)
  * @return void* pointer to the variable returned by the thread
  * 				(actually nothing)
  */
-static void *player_run(void *arg)
+static void *player_cache_run(void *arg)
 {
+	float w[PLAYER_MAX_NCH];
+	cache_key_t key = {.nfft = win_len, .nbin = PLAYER_WINDOW_SIZE_CPX,
+					   .bits = 8};
+	unsigned int gen;
+	cache_t *c;
+
+	pthread_mutex_lock(&win_mutex);
+	key.size = stft_size * (win_len / PLAYER_WINDOW_SIZE);
+	key.hop = stft_hop * (win_len / PLAYER_WINDOW_SIZE);
+	key.win = win_type;
+	key.beta = win_beta;
+	gen = stft_gen;
+	pthread_mutex_unlock(&win_mutex);
+	spect_weights(PLAYER_SPECT_MID, 0, w);
+	c = cache_open(track_path, &key);
+	if (c == NULL)
+		c = cache_build(track_path, &key, w, 0, &cache_stop);
+	pthread_mutex_lock(&cache_mutex);
+	cache = c;
+	cache_gen = gen;
+	pthread_mutex_unlock(&cache_mutex);
+	return NULL;
+}
 
-	player_event_t evt;
-	set_period(&tp);
-
-	while (1)
+/**
+ * @brief start the spectrum analysis thread
+ *
+ * @param task_par thread parameter with which start the analysis thread
+ * @return pthread_t* pointer to the analysis thread identificator
+ */
+pthread_t *player_analysis_start(task_par_t *task_par)
+{
+	if (task_par != NULL)
 	{
-		{ // exit
-			char local_player_exit;
+		atp = *task_par;
+	}
 
-			pthread_mutex_lock(&_player_exit_mutex);
-			local_player_exit = _player_exit;
-			pthread_mutex_unlock(&_player_exit_mutex);
-			if (local_player_exit)
-			{
-				player_xtor();
-				pthread_exit(NULL);
-			}
+	if (task_start(&atid, player_analysis_run, &atp) == 0)
+		analysis_started = 1;
+	if (pthread_create(&ctid, NULL, player_cache_run, NULL) == 0)
+		cache_started = 1;
+
+	return &atid;
+}
+
+/**
+ * @brief spectrum analysis thread routine
+ *
+ * Takes a snapshot of the playhead and pushes the frames played since the last
+ * period to both the spectra without holding the player mutex, then
+ * publishes the newest ones. The spectra are built again, out of the
+ * player mutex, when the window or the hop change. The filtered frames are
+ * read as published by the player, see read_filt().
+ *
+ * @param[in] arg  parameters of the task
+ * @return int 0 to go on, 1 when the player exits
+ */
+static int player_analysis_run(task_par_t *arg)
+{
+	static float orig[PLAYER_MAX_BARS]; /**< orig. spect. in progress. */
+	static float filt[PLAYER_MAX_BARS]; /**< filt. spect. in progress. */
+	playhead_t ph;							   /**< playhead snapshot. */
+	static int last_pos = -1;				   /**< last analysed position. */
+	static unsigned int gen = 0;			   /**< analysis built. */
+	static float mag[PLAYER_WINDOW_SIZE_CPX]; /**< orig. spect. cached. */
+	const window_t *w;
+	const cache_t *c;
+	int hop, nframe, nbar;
+	long end;
+
+	{ // exit
+		char local_player_exit;
+
+		pthread_mutex_lock(&_player_exit_mutex);
+		local_player_exit = _player_exit;
+		pthread_mutex_unlock(&_player_exit_mutex);
+		if (local_player_exit)
+			return 1;
+	}
+
+	pthread_mutex_lock(&playhead_mutex);
+	ph = playhead;
+	pthread_mutex_unlock(&playhead_mutex);
+
+	// the gains set by the player thread, the linear phase FIR is designed
+	// here, out of the audio path
+	equalizer_update();
+	// and the track is read ahead of the playhead
+	source_advise(&src);
+
+	// a new layout of the bands, the old one is freed by its setter
+	pthread_mutex_lock(&spect_mutex);
+	if (bands_next != NULL)
+	{
+		bands_old = bands;
+		bands = bands_next;
+		bands_next = NULL;
+	}
+	pthread_mutex_unlock(&spect_mutex);
+	nbar = bands_nbar(bands);
+
+	pthread_mutex_lock(&win_mutex);
+	w = win;
+	hop = stft_hop * (win_len / PLAYER_WINDOW_SIZE);
+	if (stft_ready && gen == stft_gen)
+		w = NULL;
+	gen = stft_gen;
+	pthread_mutex_unlock(&win_mutex);
+	if (w != NULL)
+	{
+		if (stft_ready)
+		{
+			stft_destroy(&orig_stft);
+			stft_destroy(&filt_stft);
 		}
+		if (stft_init(&orig_stft, win_len, w, hop, PLAYER_STFT_FRAMES) ||
+			stft_init(&filt_stft, win_len, w, hop, PLAYER_STFT_FRAMES))
+			error_at_line(-1, 0, __FILE__, __LINE__, "spectra");
+		stft_ready = 1;
+		last_pos = -1;
+	}
 
-		pthread_mutex_lock(&player_mutex);
-		if (p.state != STOP && p.state != PAUSE)
+	if (ph.state == STOP && last_pos != 0)
+	{
+		memset(orig, 0, sizeof(orig));
+		memset(filt, 0, sizeof(filt));
+		spect_publish(orig, filt, nbar, 0);
+		last_pos = 0;
+	}
+	else if (ph.state != STOP && ph.state != PAUSE && ph.pos != last_pos)
+	{
+		// the original is read from the cache once it is there
+		pthread_mutex_lock(&cache_mutex);
+		c = (cache_gen == gen) ? cache : NULL;
+		pthread_mutex_unlock(&cache_mutex);
+		pthread_mutex_lock(&spect_mutex);
+		if (spect_sig != PLAYER_SPECT_MID)
+			c = NULL;
+		pthread_mutex_unlock(&spect_mutex);
+		nframe = update_stft(&ph, c == NULL);
+		if (nframe > PLAYER_STFT_FRAMES)
+			nframe = PLAYER_STFT_FRAMES;
+		// each new spectrum goes in the history, the last is the current
+		for (long i = filt_stft.count - nframe; i < filt_stft.count; i++)
 		{
-			// allegro set position = -1 when the song reached the end.
-			if (voice_get_position(v) < 0)
-			{
-				player_stop();
-			}
+			scale_spectogram(bands, stft_frame(&filt_stft, i, &end), filt);
+			if (c == NULL)
+				scale_spectogram(bands, stft_frame(&orig_stft, i, NULL),
+								 orig);
+			else if (cache_read(c,
+								ph.base + ph.dir * (end - filt_stft.size / 2 -
+													ph.lat),
+								mag) == 0)
+				scale_spectogram(bands, mag, orig);
 			else
-			{
-				pos = voice_get_position(v);
-				p.time = (((float)pos) / ((float)filt_sample->freq));
-				// Online Filtering
-				player_filt();
-				// Spectogram update when reproducing
-				sample_to_float(filt_sample, &p.time_data, pos, 1);
-				update_spectogram(orig_sample, p.orig_spect);
-				update_spectogram(filt_sample, p.filt_spect);
-			}
+				memset(orig, 0, sizeof(orig));
+			spect_publish(orig, filt, nbar, 1);
 		}
-		pthread_mutex_unlock(&player_mutex);
-
-		pthread_mutex_lock(&player_event_mutex);
-		evt = player_event;
-		player_event.sig = EMPTY_SIG;
-		pthread_mutex_unlock(&player_event_mutex);
-		// event different from empty
-		if (evt.sig != EMPTY_SIG)
+
+		spect_publish(orig, filt, nbar, 0);
+		last_pos = ph.pos;
+	}
+	return 0;
+}
+
+/**
+ * @brief player thread routine
+ * 
+ * First execute some update operations, and then check if for global event is
+ * different from empty event. If not it calls the dipatch.
+ * 
+ * @param[in] arg  parameters of the task
+ * @return int 0 to go on, 1 once the player has exited
+ */
+static int player_run(task_par_t *arg)
+{
+	float time_data; /**< sample played, published in p. */
+
+	{ // exit
+		char local_player_exit;
+
+		pthread_mutex_lock(&_player_exit_mutex);
+		local_player_exit = _player_exit;
+		pthread_mutex_unlock(&_player_exit_mutex);
+		if (local_player_exit)
 		{
-			pthread_mutex_lock(&player_mutex);
-			player_dispatch_body(evt);
-			pthread_mutex_unlock(&player_mutex);
+			// the analysis reads the samples, wait for it before
+			// releasing them
+			if (analysis_started)
+				pthread_join(atid, NULL);
+			cache_stop = 1;
+			if (cache_started)
+				pthread_join(ctid, NULL);
+			player_xtor();
+			return 1;
 		}
+	}
 
-		if (deadline_miss(&tp))
-			printf("PLAYER MISS\n");
-		wait_for_period(&tp);
+	// every event dispatched before this period, applied to it
+	player_drain();
+	// the readers of p load it with no lock, nothing waits for them
+	if (p.state != STOP && p.state != PAUSE)
+	{
+		play_pos = stream_played();
+		lat = equalizer_get_latency();
+		// the splices heard
+		while (nsplice > 0 && play_pos - lat >= splice[0].at)
+		{
+			base = splice[0].base;
+			memmove(&splice[0], &splice[1], sizeof(splice[0]) * --nsplice);
+		}
+		// what is heard now left the track lat frames before
+		pos = base + dir * ((play_pos > lat) ? play_pos - lat : 0);
+		// the stream went past either end of the track
+		if (pos < 0 || pos >= src.len)
+		{
+			player_stop();
+		}
+		else
+		{
+			store_float(&p.time, ((float)pos) / ((float)src.freq));
+			// Online Filtering
+			player_feed();
+			read_filt(0, play_pos, 1, &time_data);
+			store_float(&p.time_data, time_data);
+		}
 	}
-	return NULL;
+
+	// only this thread writes pos and p.state
+	pthread_mutex_lock(&playhead_mutex);
+	playhead.pos = pos;
+	playhead.state = p.state;
+	playhead.k = play_pos;
+	playhead.base = base;
+	playhead.dir = dir;
+	playhead.lat = lat;
+	playhead.filt = filt_pos;
+	pthread_mutex_unlock(&playhead_mutex);
+	return 0;
 }
 
 /**
@@ -694,11 +1755,7 @@ void player_exit()
 
 player_state_t player_get_state()
 {
-	player_state_t s;
-	pthread_mutex_lock(&player_mutex);
-	s = p.state;
-	pthread_mutex_unlock(&player_mutex);
-	return s;
+	return __atomic_load_n(&p.state, __ATOMIC_ACQUIRE);
 }
 
 void player_get_trackname(char *dst)
@@ -709,11 +1766,7 @@ void player_get_trackname(char *dst)
 
 float player_get_time()
 {
-	float time;
-	pthread_mutex_lock(&player_mutex);
-	time = p.time;
-	pthread_mutex_unlock(&player_mutex);
-	return time;
+	return load_float(&p.time);
 };
 
 float player_get_duration()
@@ -724,11 +1777,7 @@ float player_get_duration()
 
 float player_get_time_data()
 {
-	float time_data;
-	pthread_mutex_lock(&player_mutex);
-	time_data = p.time_data;
-	pthread_mutex_unlock(&player_mutex);
-	return time_data;
+	return load_float(&p.time_data);
 };
 
 int player_get_bits()
@@ -739,18 +1788,91 @@ int player_get_bits()
 
 void player_get_orig_spect(float *dst)
 {
-	pthread_mutex_lock(&player_mutex);
-	memcpy(dst, p.orig_spect, sizeof(p.orig_spect));
-	pthread_mutex_unlock(&player_mutex);
+	unsigned int seq;
+	int i;
+
+	do
+	{
+		seq = seqlock_read_begin(&spect_seq, &i);
+		memcpy(dst, spect_pub[i].orig, sizeof(spect_pub[i].orig));
+	} while (seqlock_read_retry(&spect_seq, seq));
 };
 
 void player_get_filt_spect(float *dst)
 {
-	pthread_mutex_lock(&player_mutex);
-	memcpy(dst, p.filt_spect, sizeof(p.filt_spect));
-	pthread_mutex_unlock(&player_mutex);
+	unsigned int seq;
+	int i;
+
+	do
+	{
+		seq = seqlock_read_begin(&spect_seq, &i);
+		memcpy(dst, spect_pub[i].filt, sizeof(spect_pub[i].filt));
+	} while (seqlock_read_retry(&spect_seq, seq));
 };
 
+long player_get_spect_count()
+{
+	return __atomic_load_n(&spect_count, __ATOMIC_ACQUIRE);
+}
+
+int player_get_spect_frame(int filtered, long i, unsigned char dst[])
+{
+	unsigned int seq;
+	const spect_pub_t *s;
+	long count;
+	int ret, k;
+
+	do
+	{
+		seq = seqlock_read_begin(&spect_seq, &k);
+		s = &spect_pub[k];
+		count = __atomic_load_n(&s->count, __ATOMIC_RELAXED);
+		ret = -1;
+		if (i >= 0 && i < count && i >= count - PLAYER_STFT_FRAMES)
+		{
+			ret = s->hist_nbar[i % PLAYER_STFT_FRAMES];
+			memcpy(dst, s->hist[filtered != 0][i % PLAYER_STFT_FRAMES], ret);
+		}
+	} while (seqlock_read_retry(&spect_seq, seq));
+	return ret;
+}
+
+void player_get_contention(unsigned long *nread, unsigned long *nretry)
+{
+	seqlock_get_stats(&spect_seq, nread, nretry);
+}
+
+int player_get_overview(float t, unsigned char dst[])
+{
+	static float mag[PLAYER_WINDOW_SIZE_CPX];
+	static float bar[PLAYER_MAX_BARS];
+	int ret = -1, nbar;
+	float db;
+
+	pthread_mutex_lock(&cache_mutex);
+	if (cache != NULL)
+		ret = cache_read(cache, t * src.freq, mag);
+	pthread_mutex_unlock(&cache_mutex);
+	if (ret < 0)
+		return -1;
+	// the bands of the analysis are not freed while it is locked
+	pthread_mutex_lock(&spect_mutex);
+	nbar = (bands != NULL) ? bands_nbar(bands) : 0;
+	if (bands != NULL)
+		bands_apply(bands, mag, bar);
+	pthread_mutex_unlock(&spect_mutex);
+	if (nbar == 0)
+		return -1;
+	// levels below full scale in the [0-100] range, as the spectograms
+	for (int i = 0; i < nbar; i++)
+	{
+		db = 20.0f * log10f(bar[i] / CACHE_FULL_SCALE);
+		db = (db + p.dynamic_range) / p.dynamic_range;
+		dst[i] = (db < 0) ? 0 : (db > 1) ? 100 : (int)(db * 100);
+	}
+	return nbar;
+}
+
 float player_get_dynamic_range()
 {
 	// dynamic_range doesn't change
@@ -765,32 +1887,101 @@ float player_get_freq_spacing()
 
 unsigned int player_get_volume()
 {
-	unsigned int volume;
-	pthread_mutex_lock(&player_mutex);
-	volume = p.volume;
-	pthread_mutex_unlock(&player_mutex);
-	return volume;
+	return __atomic_load_n(&p.volume, __ATOMIC_ACQUIRE);
 };
 
 void player_get_eq_gain(float dst[])
 {
-	pthread_mutex_lock(&player_mutex);
-	memcpy(dst, p.eq_gain, sizeof(p.eq_gain));
-	pthread_mutex_unlock(&player_mutex);
+	for (int i = 0; i < PLAYER_EQ_MAX_NFILT; i++)
+		dst[i] = load_float(&p.eq_gain[i]);
+};
+
+int player_get_nband()
+{
+	return __atomic_load_n(&p.nband, __ATOMIC_ACQUIRE);
+};
+
+eq_preset_t player_get_preset()
+{
+	return __atomic_load_n(&p.preset, __ATOMIC_ACQUIRE);
 };
 
 void player_get_player(Player_t *dst)
 {
-	pthread_mutex_lock(&player_mutex);
-	memcpy(dst, &p, sizeof(Player_t));
-	pthread_mutex_unlock(&player_mutex);
+	unsigned int seq;
+	int i;
+
+	// fields set by player_init() don't change
+	memcpy(dst->trackname, p.trackname, sizeof(p.trackname));
+	dst->duration = p.duration;
+	dst->bits = p.bits;
+	dst->nch = p.nch;
+	dst->dynamic_range = p.dynamic_range;
+	dst->freq_spacing = p.freq_spacing;
+	dst->state = __atomic_load_n(&p.state, __ATOMIC_ACQUIRE);
+	dst->time = load_float(&p.time);
+	dst->time_data = load_float(&p.time_data);
+	dst->spect = __atomic_load_n(&p.spect, __ATOMIC_ACQUIRE);
+	dst->spect_ch = __atomic_load_n(&p.spect_ch, __ATOMIC_ACQUIRE);
+	dst->scale = __atomic_load_n(&p.scale, __ATOMIC_ACQUIRE);
+	dst->volume = __atomic_load_n(&p.volume, __ATOMIC_ACQUIRE);
+	dst->nband = player_get_nband();
+	dst->preset = player_get_preset();
+	for (i = 0; i < PLAYER_EQ_MAX_NFILT; i++)
+		dst->eq_freq[i] = load_float(&p.eq_freq[i]);
+	player_get_eq_gain(dst->eq_gain);
+	// both spectograms of the same analysis
+	do
+	{
+		seq = seqlock_read_begin(&spect_seq, &i);
+		memcpy(dst->orig_spect, spect_pub[i].orig, sizeof(dst->orig_spect));
+		memcpy(dst->filt_spect, spect_pub[i].filt, sizeof(dst->filt_spect));
+		dst->nbar = spect_pub[i].nbar;
+	} while (seqlock_read_retry(&spect_seq, seq));
 }
 
 void player_xtor()
 {
-	destroy_sample(filt_sample);
-	destroy_sample(orig_sample);
-	pthread_mutex_destroy(&player_mutex);
-	pthread_mutex_destroy(&player_event_mutex);
+	fft_stats_t st;
+	cache_stats_t cst;
+	unsigned long nread, nretry;
+
+	fft_get_stats(&st);
+	printf("FFT plan: %lu in %.3f ms, exec: %lu in %.3f ms (max %.3f ms)\n",
+		   st.nplan, st.plan_ns / 1e6, st.nexec, st.exec_ns / 1e6,
+		   st.exec_max_ns / 1e6);
+	cache_get_stats(&cst);
+	printf("Spectra cached: %lu tracks, %ld in %.3f s, mapped: %lu\n",
+		   cst.nbuild, cst.nframe, cst.build_s, cst.nopen);
+	seqlock_get_stats(&spect_seq, &nread, &nretry);
+	printf("Spectograms read: %lu, again: %lu\n", nread, nretry);
+	printf("Events dropped: %lu, not scheduled: %lu\n",
+		   evq_get_nfull(&player_evq), nreject);
+	if (stft_ready)
+	{
+		stft_destroy(&orig_stft);
+		stft_destroy(&filt_stft);
+	}
+	fft_xtor();
+	window_xtor();
+	stop_audio_stream(stream);
+	source_close(&src);
+	free(filt_ring);
+	free(spect_buf);
+	free(spect_mix);
+	cache_close(cache);
+	bands_delete(bands);
+	bands_delete(bands_next);
+	bands_delete(bands_old);
+	evq_destroy(&player_evq);
+	for (int l = 0; l < PLAYER_NLANE; l++)
+	{
+		lane_destroy(&lanes[l]);
+		lane_destroy(&lane_stage[l]);
+	}
+	pthread_mutex_destroy(&playhead_mutex);
+	pthread_mutex_destroy(&spect_mutex);
+	pthread_mutex_destroy(&win_mutex);
+	pthread_mutex_destroy(&cache_mutex);
 	pthread_mutex_destroy(&_player_exit_mutex);
 }
\ No newline at end of file
@@ -0,0 +1,576 @@
+/**
+ * @file render.c
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief headless rendering of equalized tracks to WAV files
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * A track goes through the same path as in the player: frames are converted
+ * to floats, split by channel, equalized and merged back, then converted to
+ * the format of the output. Workers of a batch are forked processes, sharing
+ * with the parent only an anonymous mapping with the index of the next track
+ * and the outcome of each one.
+ */
+#include "player/render.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <errno.h>
+#include <error.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "player/convert.h"
+#include "player/source.h"
+
+#define WAV_FORMAT_PCM 0x0001		 /**< Integer PCM format tag. */
+#define WAV_FORMAT_FLOAT 0x0003		 /**< IEEE float format tag. */
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE /**< Format tag of WAVEFORMATEXTENSIBLE. */
+#define WAV_HEADER 44				 /**< Bytes of a plain header. */
+#define WAV_HEADER_EXT 68			 /**< Bytes of an extensible header. */
+
+/**
+ * @brief	Batch shared by the workers.
+ */
+typedef struct
+{
+	int next;				/**< Index of the next track to render. */
+	render_stats_t st[];	/**< Outcome of each track. */
+} batch_t;
+
+static void put16(uint8_t *b, uint16_t v)
+{
+	b[0] = v;
+	b[1] = v >> 8;
+}
+
+static void put32(uint8_t *b, uint32_t v)
+{
+	put16(b, v);
+	put16(b + 2, v >> 16);
+}
+
+static double elapsed(const struct timespec *t1, const struct timespec *t2)
+{
+	return (t2->tv_sec - t1->tv_sec) + (t2->tv_nsec - t1->tv_nsec) / 1e9;
+}
+
+/**
+ * @brief	Write exactly count bytes at a file offset.
+ * @return	0 on success, -1 on error.
+ */
+static int write_at(int fd, const void *buf, size_t count, off_t off)
+{
+	ssize_t ret;
+
+	while (count > 0)
+	{
+		ret = pwrite(fd, buf, count, off);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0)
+			return -1;
+		buf = (const uint8_t *)buf + ret;
+		count -= ret;
+		off += ret;
+	}
+	return 0;
+}
+
+/**
+ * @brief	Build the header of a WAV file.
+ *
+ * More than two channels or more than 16 bits need the extensible header,
+ * that carries the format tag in its sub-format.
+ *
+ * @param[out]	h	header, at least WAV_HEADER_EXT bytes.
+ * @param[in]	conv	kernels of the sample format.
+ * @param[in]	nch	no. channels.
+ * @param[in]	freq	sampling frequency.
+ * @param[in]	len	no. frames.
+ * @return	size of the header.
+ */
+static int wav_header(uint8_t *h, const convert_t *conv, int nch, int freq,
+					  long len)
+{
+	static const uint8_t guid[14] = {0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80,
+									 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71};
+	int tag = (conv->fmt == CONVERT_F32) ? WAV_FORMAT_FLOAT : WAV_FORMAT_PCM;
+	int ext = (nch > 2 || conv->bits > 16);
+	int size = ext ? WAV_HEADER_EXT : WAV_HEADER;
+	uint32_t data = len * nch * (conv->bits / 8);
+
+	memcpy(h, "RIFF", 4);
+	// the data chunk is padded to an even size
+	put32(h + 4, size - 8 + data + (data & 1));
+	memcpy(h + 8, "WAVEfmt ", 8);
+	put32(h + 16, ext ? 40 : 16);
+	put16(h + 20, ext ? WAV_FORMAT_EXTENSIBLE : tag);
+	put16(h + 22, nch);
+	put32(h + 24, freq);
+	put32(h + 28, freq * nch * (conv->bits / 8));
+	put16(h + 32, nch * (conv->bits / 8));
+	put16(h + 34, conv->bits);
+	if (ext)
+	{
+		put16(h + 36, 22);
+		put16(h + 38, conv->bits);
+		put32(h + 40, 0); // no speaker assigned to the channels
+		put16(h + 44, tag);
+		memcpy(h + 46, guid, sizeof(guid));
+	}
+	memcpy(h + size - 8, "data", 4);
+	put32(h + size - 4, data);
+	return size;
+}
+
+/**
+ * @brief	Frames of a track to render.
+ */
+typedef struct
+{
+	long from, to; /**< Frames written, [from, to). */
+	long warm;	   /**< Frames equalized before from, not written. */
+	float *head;   /**< First RENDER_VERIFY frames written, interleaved,
+						NULL if not needed. */
+	float *tail;   /**< RENDER_VERIFY frames equalized after to, not
+						written, NULL if not needed. */
+} range_t;
+
+/**
+ * @brief	Equalize frames of a track and write them to a file.
+ *
+ * The equalizer must be set up, with a zero state. Blocks never straddle
+ * from or to, so that each block is written, kept or dropped as a whole.
+ *
+ * @param[in]	src	track.
+ * @param[in]	conv	kernels of the output format.
+ * @param[in]	fd	output file.
+ * @param[in]	data	offset of the frame 0 in the file.
+ * @param[inout]	r	frames to render.
+ * @return	0 on success, -1 on error.
+ */
+static int render_range(source_t *src, const convert_t *conv, int fd,
+						off_t data, const range_t *r)
+{
+	const convert_ilv_t *ilv = convert_ilv_select(src->nch);
+	int fsize = src->nch * (conv->bits / 8);
+	float *frames, *ch[EQ_MAX_NCH];
+	uint8_t *buf;
+	long pos, n, end, block;
+	int ret = 0;
+
+	frames = malloc(sizeof(float) * RENDER_BLOCK * src->nch * 2);
+	buf = malloc((size_t)RENDER_BLOCK * fsize);
+	if (frames == NULL || buf == NULL)
+	{
+		error_at_line(0, errno, __FILE__, __LINE__, "render buffers");
+		free(frames);
+		free(buf);
+		return -1;
+	}
+	for (int c = 0; c < src->nch; c++)
+		ch[c] = frames + (src->nch + c) * RENDER_BLOCK;
+	block = (src->cap < RENDER_BLOCK) ? src->cap : RENDER_BLOCK;
+	pos = (r->from - r->warm > 0) ? r->from - r->warm : 0;
+	end = (r->tail == NULL) ? r->to
+		  : (r->to + RENDER_VERIFY < src->len) ? r->to + RENDER_VERIFY
+											   : src->len;
+	for (; pos < end && ret == 0; pos += n)
+	{
+		n = (end - pos < block) ? end - pos : block;
+		if (pos < r->from && n > r->from - pos)
+			n = r->from - pos;
+		else if (pos < r->to && n > r->to - pos)
+			n = r->to - pos;
+		if (source_prefetch(src, pos, pos + n) < 0)
+		{
+			ret = -1;
+			break;
+		}
+		source_read(src, pos, n, frames);
+		ilv->split(frames, ch, src->nch, n);
+		equalizer_equalize_ch(ch, n);
+		ilv->merge((const float *const *)ch, frames, src->nch, n);
+		if (pos < r->from)
+			continue; // warm up
+		if (pos >= r->to)
+		{
+			memcpy(r->tail + (pos - r->to) * src->nch, frames,
+				   sizeof(float) * n * src->nch);
+			continue;
+		}
+		if (r->head != NULL && pos < r->from + RENDER_VERIFY)
+			memcpy(r->head + (pos - r->from) * src->nch, frames,
+				   sizeof(float) * src->nch *
+					   ((r->from + RENDER_VERIFY - pos < n)
+							? r->from + RENDER_VERIFY - pos
+							: n));
+		conv->from_float(frames, buf, n * src->nch);
+		ret = write_at(fd, buf, n * fsize, data + (off_t)pos * fsize);
+	}
+	free(frames);
+	free(buf);
+	return ret;
+}
+
+/**
+ * @brief	Chunk of a split render, shared with the parent.
+ */
+typedef struct
+{
+	int status;	 /**< 0 if rendered, -1 on error. */
+	long frames; /**< Frames equalized, warm up included. */
+	double busy; /**< Seconds taken. */
+} chunk_t;
+
+/**
+ * @brief	Render a track in chunks, a process each.
+ *
+ * The state of the bands is at most the peak of the output, through bands of
+ * at most EQ_FILT_MAX_GAIN: the warm up lets a wrong state fade well below
+ * RENDER_SPLIT_ERR, down to the rounding of the floats.
+ *
+ * @param[in]	src	track.
+ * @param[in]	conv	kernels of the output format.
+ * @param[in]	fd	output file.
+ * @param[in]	data	offset of the frame 0 in the file.
+ * @param[in]	nsplit	max no. chunks.
+ * @param[out]	st	outcome.
+ * @return	0 on success, -1 on error.
+ */
+static int render_split(source_t *src, const convert_t *conv, int fd,
+						off_t data, int nsplit, render_stats_t *st)
+{
+	long warm, len, nverify = (long)RENDER_VERIFY * src->nch;
+	float err = 0, peak = 1; // no less than a 16 bits LSB
+	struct timespec t1, t2;
+	double serial = 0;
+	chunk_t *chunk;
+	float *head, *tail;
+	size_t size;
+	range_t r;
+	pid_t pid;
+	int k, ret = 0;
+
+	warm = equalizer_settle(RENDER_SPLIT_ERR /
+							(16 * powf(10, EQ_FILT_MAX_GAIN / 20)));
+	// each chunk should cost at least four times its warm up
+	while (nsplit > 1 &&
+		   (warm < 0 || src->len / nsplit < 4 * (warm + RENDER_VERIFY)))
+		nsplit--;
+	st->nsplit = nsplit;
+	if (nsplit == 1)
+		return render_range(src, conv, fd, data,
+							&(range_t){.from = 0, .to = src->len});
+	len = (src->len + nsplit - 1) / nsplit;
+	size = nsplit * (sizeof(chunk_t) + 2 * nverify * sizeof(float));
+	chunk = mmap(NULL, size, PROT_READ | PROT_WRITE,
+				 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (chunk == MAP_FAILED)
+	{
+		error_at_line(0, errno, __FILE__, __LINE__, "%d chunks", nsplit);
+		return -1;
+	}
+	head = (float *)&chunk[nsplit];
+	tail = head + nsplit * nverify;
+	fflush(stdout);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	for (k = 0; k < nsplit; k++)
+	{
+		chunk[k].status = -1;
+		pid = fork();
+		if (pid == 0)
+		{
+			r.from = k * len;
+			r.to = (r.from + len < src->len) ? r.from + len : src->len;
+			r.warm = warm;
+			r.head = (k > 0) ? head + k * nverify : NULL;
+			r.tail = (k < nsplit - 1) ? tail + k * nverify : NULL;
+			chunk[k].status = render_range(src, conv, fd, data, &r);
+			clock_gettime(CLOCK_MONOTONIC, &t2);
+			chunk[k].busy = elapsed(&t1, &t2);
+			chunk[k].frames = ((r.tail != NULL) ? RENDER_VERIFY : 0) + r.to -
+							  ((r.from > warm) ? r.from - warm : 0);
+			_exit(EXIT_SUCCESS);
+		}
+		if (pid < 0)
+		{
+			error_at_line(0, errno, __FILE__, __LINE__, "chunk %d", k);
+			break;
+		}
+	}
+	while (wait(NULL) > 0 || errno == EINTR)
+		;
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+	for (k = 0; k < nsplit; k++)
+	{
+		if (chunk[k].status < 0)
+		{
+			ret = -1;
+			continue;
+		}
+		// time of the chunk at the same speed, without the warm up
+		serial += chunk[k].busy *
+				  ((k * len + len < src->len) ? len : src->len - k * len) /
+				  chunk[k].frames;
+	}
+	// the end of a chunk against the start of the next
+	for (k = 0; k + 1 < nsplit && ret == 0; k++)
+	{
+		long n = (src->len - (k + 1) * len < RENDER_VERIFY)
+					 ? src->len - (k + 1) * len
+					 : RENDER_VERIFY;
+
+		for (long i = 0; i < n * src->nch; i++)
+		{
+			err = fmaxf(err, fabsf(tail[k * nverify + i] -
+								   head[(k + 1) * nverify + i]));
+			peak = fmaxf(peak, fabsf(tail[k * nverify + i]));
+		}
+	}
+	err /= peak;
+	st->speedup = serial / elapsed(&t1, &t2);
+	st->err = err;
+	if (ret == 0 && err > RENDER_SPLIT_ERR)
+	{
+		error_at_line(0, 0, __FILE__, __LINE__,
+					  "stitching error %g of the peak, max is %g", err, RENDER_SPLIT_ERR);
+		ret = -1;
+	}
+	munmap(chunk, size);
+	return ret;
+}
+
+int render_file(const char *in, const char *out, const render_opts_t *opts,
+				render_stats_t *st)
+{
+	struct timespec t1, t2;
+	char tmp[PATH_MAX];
+	uint8_t hdr[WAV_HEADER_EXT];
+	const convert_t *conv;
+	render_stats_t tst;
+	source_t src;
+	off_t data, size;
+	int fd, ret;
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	if (st == NULL)
+		st = &tst;
+	memset(st, 0, sizeof(*st));
+	st->status = -1;
+	st->nsplit = 1;
+	if (source_open(&src, in, opts->budget) < 0)
+		return -1;
+	if (src.nch > EQ_MAX_NCH)
+	{
+		error_at_line(0, 0, __FILE__, __LINE__, "%s: %d channels, max is %d",
+					  in, src.nch, EQ_MAX_NCH);
+		source_close(&src);
+		return -1;
+	}
+	// Allegro samples are unsigned, WAV of 16 bits are signed
+	conv = convert_select((src.conv->fmt == CONVERT_U16) ? CONVERT_S16
+														 : src.conv->fmt);
+	snprintf(tmp, sizeof(tmp), "%s.part", out);
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+	{
+		error_at_line(0, errno, __FILE__, __LINE__, "%s", tmp);
+		source_close(&src);
+		return -1;
+	}
+	// gains set before the first sample are not ramped
+	equalizer_init(src.freq);
+	equalizer_set_nch(src.nch);
+	for (int i = 0; i < EQ_NFILT; i++)
+		equalizer_set_gain(i, opts->gain[i], NULL);
+	data = wav_header(hdr, conv, src.nch, src.freq, src.len);
+	// the file has its final size, with the pad byte, chunks fill it in
+	size = data + (off_t)src.len * src.nch * (conv->bits / 8);
+	ret = (write_at(fd, hdr, data, 0) < 0 || ftruncate(fd, size + (size & 1)) < 0)
+			  ? -1
+		  : (opts->nsplit > 1)
+			  ? render_split(&src, conv, fd, data, opts->nsplit, st)
+			  : render_range(&src, conv, fd, data,
+							 &(range_t){.from = 0, .to = src.len});
+	if (ret < 0)
+		error_at_line(0, 0, __FILE__, __LINE__, "%s: render failed", in);
+	if (close(fd) < 0 || (ret == 0 && rename(tmp, out) < 0))
+	{
+		error_at_line(0, errno, __FILE__, __LINE__, "%s", out);
+		ret = -1;
+	}
+	if (ret < 0)
+		unlink(tmp);
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+	if (ret == 0)
+	{
+		st->status = 0;
+		st->frames = src.len;
+		st->audio = (double)src.len / src.freq;
+		st->wall = elapsed(&t1, &t2);
+	}
+	source_close(&src);
+	return ret;
+}
+
+/**
+ * @brief	Path of the output of a track: its name, with a .wav extension.
+ */
+static void out_path(char *out, size_t size, const char *dir, const char *in)
+{
+	char name[PATH_MAX], *ext;
+
+	snprintf(name, sizeof(name), "%s", in);
+	ext = strrchr(basename(name), '.');
+	if (ext != NULL)
+		*ext = '\0';
+	snprintf(out, size, "%s/%s.wav", dir, basename(name));
+}
+
+/**
+ * @brief	Check that no two tracks of a batch have the same output.
+ *
+ * Tracks with the same name in different directories would write, and
+ * rename, the same file at once.
+ *
+ * @return	0 if all the outputs differ, -1 otherwise.
+ */
+static int out_check(const char *const in[], int n, const char *dir)
+{
+	char out[PATH_MAX], prev[PATH_MAX];
+
+	for (int i = 1; i < n; i++)
+	{
+		out_path(out, sizeof(out), dir, in[i]);
+		for (int j = 0; j < i; j++)
+		{
+			out_path(prev, sizeof(prev), dir, in[j]);
+			if (strcmp(out, prev) == 0)
+			{
+				error_at_line(0, 0, __FILE__, __LINE__,
+							  "%s and %s are both rendered to %s", in[j],
+							  in[i], out);
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief	Worker of a batch, renders tracks until none is left.
+ */
+static void render_worker(batch_t *b, const char *const in[], int n,
+						  const char *dir, const render_opts_t *opts)
+{
+	char out[PATH_MAX];
+	render_stats_t *st;
+	int i;
+
+	while ((i = __atomic_fetch_add(&b->next, 1, __ATOMIC_RELAXED)) < n)
+	{
+		st = &b->st[i];
+		out_path(out, sizeof(out), dir, in[i]);
+		if (render_file(in[i], out, opts, st) == 0 && st->nsplit > 1)
+			printf("%s: %.1f s in %.2f s, %.1fx real time, %d chunks, "
+				   "%.2fx speedup, stitching error %.2g\n",
+				   out, st->audio, st->wall, st->audio / st->wall, st->nsplit,
+				   st->speedup, st->err);
+		else if (st->status == 0)
+			printf("%s: %.1f s in %.2f s, %.1fx real time\n", out, st->audio,
+				   st->wall, st->audio / st->wall);
+		else
+			printf("%s: failed\n", in[i]);
+		// a line per write, not mixed with the other workers
+		fflush(stdout);
+	}
+}
+
+int render_batch(const char *const in[], int n, const char *dir,
+				 const render_opts_t *opts, int nworker, render_stats_t st[])
+{
+	size_t size = sizeof(batch_t) + n * sizeof(render_stats_t);
+	struct timespec t1, t2;
+	double audio = 0, wall;
+	int w, nfail = 0;
+	batch_t *b;
+	pid_t pid;
+
+	if (n <= 0)
+		return 0;
+	if (out_check(in, n, dir) < 0)
+		return -1;
+	if (mkdir(dir, 0755) < 0 && errno != EEXIST)
+	{
+		error_at_line(0, errno, __FILE__, __LINE__, "%s", dir);
+		return -1;
+	}
+	if (nworker <= 0)
+		nworker = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nworker > n)
+		nworker = n;
+	// the chunks of a track already take the CPUs
+	if (opts->nsplit > 1)
+		nworker = 1;
+	b = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+			 -1, 0);
+	if (b == MAP_FAILED)
+	{
+		error_at_line(0, errno, __FILE__, __LINE__, "batch of %d tracks", n);
+		return -1;
+	}
+	// a worker that dies leaves its track failed, the others go on
+	for (int i = 0; i < n; i++)
+		b->st[i].status = -1;
+	fflush(stdout);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	for (w = 0; w < nworker; w++)
+	{
+		pid = fork();
+		if (pid == 0)
+		{
+			render_worker(b, in, n, dir, opts);
+			_exit(EXIT_SUCCESS);
+		}
+		if (pid < 0)
+		{
+			error_at_line(0, errno, __FILE__, __LINE__, "worker %d", w);
+			break;
+		}
+	}
+	if (w == 0)
+	{
+		munmap(b, size);
+		return -1;
+	}
+	while (wait(NULL) > 0 || errno == EINTR)
+		;
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+	wall = elapsed(&t1, &t2);
+	for (int i = 0; i < n; i++)
+	{
+		if (b->st[i].status == 0)
+			audio += b->st[i].audio;
+		else
+			nfail++;
+	}
+	printf("%d tracks, %d failed, %.1f s in %.2f s with %d workers, "
+		   "%.1fx real time\n",
+		   n, nfail, audio, wall, w, audio / wall);
+	if (st != NULL)
+		memcpy(st, b->st, n * sizeof(render_stats_t));
+	munmap(b, size);
+	return nfail;
+}
@@ -0,0 +1,58 @@
+/**
+ * @file seqlock.c
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief publication of data by one writer to many readers, with no lock
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * The fences order the data written or copied, which is not atomic, with
+ * the sequence: a copy read while the writer writes it is thrown away.
+ */
+#include "player/seqlock.h"
+
+#include <stddef.h>
+
+int seqlock_write_begin(seqlock_t *s)
+{
+	unsigned int seq = s->seq + 1;
+
+	// the copy written last is whole before the readers move to it
+	__atomic_store_n(&s->seq, seq, __ATOMIC_RELEASE);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	return (seq & 1) ^ 1;
+}
+
+void seqlock_write_end(seqlock_t *s)
+{
+	(void)s; // kept for symmetry with seqlock_write_begin
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+unsigned int seqlock_read_begin(seqlock_t *s, int *copy)
+{
+	unsigned int seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+
+	*copy = seq & 1;
+	return seq;
+}
+
+int seqlock_read_retry(seqlock_t *s, unsigned int seq)
+{
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (__atomic_load_n(&s->seq, __ATOMIC_RELAXED) != seq)
+	{
+		__atomic_fetch_add(&s->nretry, 1, __ATOMIC_RELAXED);
+		return 1;
+	}
+	__atomic_fetch_add(&s->nread, 1, __ATOMIC_RELAXED);
+	return 0;
+}
+
+void seqlock_get_stats(const seqlock_t *s, unsigned long *nread,
+					   unsigned long *nretry)
+{
+	if (nread != NULL)
+		*nread = __atomic_load_n(&s->nread, __ATOMIC_RELAXED);
+	if (nretry != NULL)
+		*nretry = __atomic_load_n(&s->nretry, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,536 @@
+/**
+ * @file source.c
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief audio track mapped from file, or read in chunks into a bounded ring
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * The window is moved only by the thread that prefetches. Frames that are
+ * going to be overwritten are first dropped from [lo, hi) under the mutex,
+ * then the file is read without holding it, so readers never wait for I/O.
+ * The mutex inherits the priority of a reader waiting for it, so the player
+ * never waits for a preempted analysis.
+ * A mapping is read in place: the window only drives the hints given to the
+ * kernel, readahead ahead of the playhead and release behind it. They can
+ * block, so a real time reader leaves them, and the page faults ahead of
+ * the playhead, to another thread: see source_advise().
+ */
+#include "player/source.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <errno.h>
+#include <error.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <allegro.h>
+
+#define WAV_FORMAT_PCM 0x0001		 /**< Integer PCM format tag. */
+#define WAV_FORMAT_FLOAT 0x0003		 /**< IEEE float format tag. */
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE /**< Format tag of WAVEFORMATEXTENSIBLE. */
+
+/**
+ * @brief	Read exactly count bytes at a file offset.
+ * @return	0 on success, -1 on error or end of file.
+ */
+static int read_at(int fd, void *buf, size_t count, off_t off)
+{
+	ssize_t ret;
+
+	while (count > 0)
+	{
+		ret = pread(fd, buf, count, off);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return -1;
+		buf = (uint8_t *)buf + ret;
+		count -= ret;
+		off += ret;
+	}
+	return 0;
+}
+
+static uint16_t le16(const uint8_t *b) { return b[0] | (b[1] << 8); }
+
+static uint32_t le32(const uint8_t *b)
+{
+	return b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+/**
+ * @brief	Sample format of a WAV file.
+ * @return	the format, CONVERT_NFMT if it is not supported.
+ */
+static convert_fmt_t wav_format(int tag, int bits)
+{
+	if (tag == WAV_FORMAT_FLOAT)
+		return (bits == 32) ? CONVERT_F32 : CONVERT_NFMT;
+	switch (bits)
+	{
+	case 8: // only 8 bits WAV are unsigned
+		return CONVERT_U8;
+	case 16:
+		return CONVERT_S16;
+	case 24:
+		return CONVERT_S24;
+	case 32:
+		return CONVERT_S32;
+	default:
+		return CONVERT_NFMT;
+	}
+}
+
+/**
+ * @brief	Parse the RIFF header of a WAV file.
+ *
+ * Looks for the "fmt " and "data" chunks, skipping any other chunk.
+ *
+ * @param[inout]	s	track, fd must be open.
+ * @param[out]	fmt	sample format.
+ * @return	0 if it is a supported WAV, -1 otherwise.
+ */
+static int wav_parse(source_t *s, convert_fmt_t *fmt)
+{
+	uint8_t hdr[12], chunk[8], hfmt[24];
+	off_t off, size;
+	uint32_t csize;
+	int have_fmt = 0;
+
+	size = lseek(s->fd, 0, SEEK_END);
+	if (read_at(s->fd, hdr, sizeof(hdr), 0) < 0 ||
+		memcmp(hdr, "RIFF", 4) != 0 || memcmp(hdr + 8, "WAVE", 4) != 0)
+		return -1;
+	for (off = sizeof(hdr); off + 8 <= size; off += 8 + csize + (csize & 1))
+	{
+		if (read_at(s->fd, chunk, sizeof(chunk), off) < 0)
+			return -1;
+		csize = le32(chunk + 4);
+		if (memcmp(chunk, "fmt ", 4) == 0)
+		{
+			if (csize < 16 || read_at(s->fd, hfmt, 16, off + 8) < 0)
+				return -1;
+			// an extensible header carries the real tag in the sub-format
+			if (le16(hfmt) == WAV_FORMAT_EXTENSIBLE &&
+				(csize < 40 || read_at(s->fd, hfmt, 2, off + 8 + 24) < 0))
+				return -1;
+			if (le16(hfmt) != WAV_FORMAT_PCM && le16(hfmt) != WAV_FORMAT_FLOAT)
+				return -1;
+			s->nch = le16(hfmt + 2);
+			s->freq = le32(hfmt + 4);
+			s->bits = le16(hfmt + 14);
+			*fmt = wav_format(le16(hfmt), s->bits);
+			have_fmt = 1;
+		}
+		else if (memcmp(chunk, "data", 4) == 0 && have_fmt)
+		{
+			if (s->nch <= 0 || s->bits <= 0 || s->bits % 8 != 0)
+				return -1;
+			s->fsize = s->nch * s->bits / 8;
+			s->data = off + 8;
+			// a truncated file plays what is there
+			if (s->data + csize > size)
+				csize = size - s->data;
+			s->len = csize / s->fsize;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/**
+ * @brief	Load the whole track with Allegro.
+ * @return	0 on success, -1 on error.
+ */
+static int smpl_load(source_t *s, const char *path)
+{
+	SAMPLE *smpl = load_sample(path);
+
+	if (smpl == NULL)
+		return -1;
+	s->smpl = smpl;
+	s->bits = smpl->bits;
+	s->nch = smpl->stereo ? 2 : 1;
+	s->freq = smpl->freq;
+	s->len = smpl->len;
+	s->fsize = s->nch * s->bits / 8;
+	s->pcm = smpl->data;
+	s->cap = s->len;
+	s->lo = 0;
+	s->hi = s->len;
+	return 0;
+}
+
+/**
+ * @brief	Map the file, so that the PCM data are read in place.
+ * @return	0 on success, -1 if the file cannot be mapped.
+ */
+static int wav_map(source_t *s)
+{
+	void *map;
+
+	s->map_len = s->data + (size_t)s->len * s->fsize;
+	map = mmap(NULL, s->map_len, PROT_READ, MAP_SHARED, s->fd, 0);
+	if (map == MAP_FAILED)
+		return -1;
+	s->map = map;
+	s->pcm = s->map + s->data;
+	// the track is played from the start, the window drives the rest
+	madvise(s->map, s->map_len, MADV_SEQUENTIAL);
+	posix_fadvise(s->fd, s->data, 0, POSIX_FADV_SEQUENTIAL);
+	return 0;
+}
+
+
+int source_open(source_t *s, const char *path, size_t budget)
+{
+	convert_fmt_t fmt = CONVERT_NFMT; // none until parsed
+	pthread_mutexattr_t attr;
+
+	memset(s, 0, sizeof(*s));
+	// the player and the analysis read at different real time priorities
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+	pthread_mutex_init(&s->mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+	s->seek = -1;
+	s->fd = open(path, O_RDONLY);
+	if (s->fd < 0)
+	{
+		error_at_line(0, errno, __FILE__, __LINE__, "%s", path);
+		return -1;
+	}
+	if (wav_parse(s, &fmt) < 0)
+	{
+		close(s->fd);
+		s->fd = -1;
+		if (smpl_load(s, path) < 0)
+		{
+			error_at_line(0, 0, __FILE__, __LINE__,
+						  "%s: unsupported audio file", path);
+			return -1;
+		}
+		// Allegro samples are unsigned
+		fmt = (s->bits == 8) ? CONVERT_U8
+							 : (s->bits == 16) ? CONVERT_U16 : CONVERT_NFMT;
+	}
+	else
+	{
+		s->cap = budget / s->fsize;
+		if (s->cap > s->len)
+			s->cap = s->len;
+		if (s->cap <= 0)
+		{
+			error_at_line(0, 0, __FILE__, __LINE__,
+						  "memory budget of %zu bytes is too small", budget);
+			source_close(s);
+			return -1;
+		}
+		// e.g. a file on a filesystem that does not support mmap
+		if (wav_map(s) < 0)
+			s->ring = malloc(s->cap * s->fsize);
+		if (s->pcm == NULL && s->ring == NULL)
+		{
+			error_at_line(0, errno, __FILE__, __LINE__, "ring of %ld frames",
+						  s->cap);
+			source_close(s);
+			return -1;
+		}
+	}
+	s->conv = convert_select(fmt);
+	if (s->conv == NULL)
+	{
+		error_at_line(0, 0, __FILE__, __LINE__,
+					  "%s: samples of %d bits not supported", path, s->bits);
+		source_close(s);
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @brief	Bring the frames [from, to) of the file into the window.
+ *
+ * A ring reads them into their slots, a mapping is left to window_advise().
+ *
+ * @return	0 on success, -1 on error.
+ */
+static int window_fill(source_t *s, long from, long to)
+{
+	long slot, n;
+
+	if (s->map != NULL)
+		return 0;
+	while (from < to)
+	{
+		slot = from % s->cap;
+		n = to - from;
+		if (n > s->cap - slot)
+			n = s->cap - slot;
+		if (read_at(s->fd, s->ring + slot * s->fsize, n * s->fsize,
+					s->data + (off_t)from * s->fsize) < 0)
+		{
+			error_at_line(0, errno, __FILE__, __LINE__,
+						  "read of frames [%ld, %ld)", from, from + n);
+			return -1;
+		}
+		from += n;
+	}
+	return 0;
+}
+
+/**
+ * @brief	Release the pages of the frames [from, to) of a mapping.
+ *
+ * Only the pages all inside the range are released. They stay in the page
+ * cache, so they are read again with no I/O if the kernel has not evicted
+ * them yet.
+ */
+static void window_drop(source_t *s, long from, long to)
+{
+	long page = sysconf(_SC_PAGESIZE);
+	uintptr_t a, b;
+
+	if (s->map == NULL || from >= to)
+		return;
+	a = (uintptr_t)(s->pcm + from * s->fsize);
+	b = (uintptr_t)(s->pcm + to * s->fsize);
+	a = (a + page - 1) & ~(uintptr_t)(page - 1);
+	b &= ~(uintptr_t)(page - 1);
+	// pages locked as they fault, by mlockall, cannot be released locked
+	if (a < b)
+	{
+		munlock((void *)a, b - a);
+		madvise((void *)a, b - a, MADV_DONTNEED);
+	}
+}
+
+/**
+ * @brief	Ask the kernel to read ahead the frames [from, to) of a mapping.
+ *
+ * Read asynchronously, the pages are also touched, so that they are
+ * resident before the reader needs them.
+ */
+static void window_ahead(source_t *s, long from, long to)
+{
+	long page = sysconf(_SC_PAGESIZE);
+	uintptr_t a, b;
+
+	if (from >= to)
+		return;
+	posix_fadvise(s->fd, s->data + (off_t)from * s->fsize,
+				  (off_t)(to - from) * s->fsize, POSIX_FADV_WILLNEED);
+	if (!s->async)
+		return;
+	// the mapping starts on a page
+	a = (uintptr_t)(s->pcm + from * s->fsize) & ~(uintptr_t)(page - 1);
+	b = (uintptr_t)(s->pcm + to * s->fsize);
+	for (; a < b; a += page)
+		(void)*(volatile const uint8_t *)a;
+}
+
+/**
+ * @brief	Give the kernel the hints for the window of a mapping.
+ *
+ * The access advised follows the last seek or prefetch. The pages the
+ * window left are released, the ones it entered are read ahead, and the
+ * frames around a seek first.
+ */
+static void window_advise(source_t *s)
+{
+	long lo, hi, seek, chunk;
+	int random;
+
+	pthread_mutex_lock(&s->mutex);
+	lo = s->lo;
+	hi = s->hi;
+	random = s->random;
+	seek = s->seek;
+	s->seek = -1;
+	pthread_mutex_unlock(&s->mutex);
+	if (random != s->adv_random)
+	{
+		madvise(s->map, s->map_len, random ? MADV_RANDOM : MADV_SEQUENTIAL);
+		posix_fadvise(s->fd, s->data, 0,
+					  random ? POSIX_FADV_RANDOM : POSIX_FADV_SEQUENTIAL);
+		s->adv_random = random;
+	}
+	if (seek >= 0)
+	{ // the direction is not known yet
+		chunk = SOURCE_CHUNK / s->fsize;
+		window_ahead(s, (seek - chunk > 0) ? seek - chunk : 0,
+					 (seek + chunk < s->len) ? seek + chunk : s->len);
+	}
+	if (hi <= s->adv_lo || lo >= s->adv_hi)
+	{
+		window_drop(s, s->adv_lo, s->adv_hi);
+		window_ahead(s, lo, hi);
+	}
+	else
+	{
+		window_drop(s, s->adv_lo, lo);
+		window_drop(s, hi, s->adv_hi);
+		window_ahead(s, lo, s->adv_lo);
+		window_ahead(s, s->adv_hi, hi);
+	}
+	s->adv_lo = lo;
+	s->adv_hi = hi;
+}
+
+void source_set_async(source_t *s, int async)
+{
+	s->async = async;
+}
+
+void source_advise(source_t *s)
+{
+	if (s->map != NULL)
+		window_advise(s);
+}
+
+int source_prefetch(source_t *s, long from, long to)
+{
+	long lo, hi, nlo, nhi, chunk;
+	int ret = 0;
+
+	if (from < 0)
+		from = 0;
+	if (to > s->len)
+		to = s->len;
+	if (s->fd < 0 || from >= to)
+		return 0;
+	if (to - from > s->cap)
+	{
+		error_at_line(0, 0, __FILE__, __LINE__,
+					  "%ld frames needed, window has %ld", to - from, s->cap);
+		return -1;
+	}
+	if (s->random)
+	{ // playing again after a jump
+		pthread_mutex_lock(&s->mutex);
+		s->random = 0;
+		pthread_mutex_unlock(&s->mutex);
+	}
+	chunk = SOURCE_CHUNK / s->fsize;
+	// only this thread changes lo and hi
+	lo = s->lo;
+	hi = s->hi;
+	if (from >= hi || to <= lo)
+	{ // nothing useful in the window, e.g. after a jump
+		lo = hi = (from >= hi) ? from : to;
+	}
+	if (to > hi)
+	{
+		nhi = (to > hi + chunk) ? to : hi + chunk;
+		if (nhi > s->len)
+			nhi = s->len;
+		if (nhi > from + s->cap)
+			nhi = from + s->cap;
+		nlo = (lo > nhi - s->cap) ? lo : nhi - s->cap;
+		pthread_mutex_lock(&s->mutex);
+		s->lo = nlo;
+		s->hi = hi;
+		pthread_mutex_unlock(&s->mutex);
+		ret = window_fill(s, hi, nhi);
+		lo = nlo;
+		hi = (ret < 0) ? hi : nhi;
+		pthread_mutex_lock(&s->mutex);
+		s->hi = hi;
+		pthread_mutex_unlock(&s->mutex);
+	}
+	if (from < lo && ret == 0)
+	{
+		nlo = (from < lo - chunk) ? from : lo - chunk;
+		if (nlo < 0)
+			nlo = 0;
+		if (nlo < to - s->cap)
+			nlo = to - s->cap;
+		nhi = (hi < nlo + s->cap) ? hi : nlo + s->cap;
+		pthread_mutex_lock(&s->mutex);
+		s->lo = lo;
+		s->hi = nhi;
+		pthread_mutex_unlock(&s->mutex);
+		ret = window_fill(s, nlo, lo);
+		pthread_mutex_lock(&s->mutex);
+		s->lo = (ret < 0) ? lo : nlo;
+		pthread_mutex_unlock(&s->mutex);
+	}
+	if (s->map != NULL && !s->async)
+		window_advise(s);
+	return ret;
+}
+
+void source_seek(source_t *s, long frame)
+{
+	if (s->map == NULL)
+		return;
+	pthread_mutex_lock(&s->mutex);
+	s->random = 1;
+	s->seek = frame;
+	pthread_mutex_unlock(&s->mutex);
+	if (!s->async)
+		window_advise(s);
+}
+
+int source_read(source_t *s, long off, unsigned int count, float *buf)
+{
+	long from, to, slot, n;
+
+	if (s->pcm != NULL)
+	{ // every frame is there, no lock needed
+		from = (off > 0) ? off : 0;
+		to = (off + (long)count < s->len) ? off + (long)count : s->len;
+		if (from >= to)
+		{
+			memset(buf, 0, sizeof(float) * count * s->nch);
+			return 0;
+		}
+		memset(buf, 0, sizeof(float) * (from - off) * s->nch);
+		memset(buf + (to - off) * s->nch, 0,
+			   sizeof(float) * (off + count - to) * s->nch);
+		s->conv->to_float(s->pcm + from * s->fsize, buf + (from - off) * s->nch,
+						  (to - from) * s->nch);
+		return to - from;
+	}
+	pthread_mutex_lock(&s->mutex);
+	from = (off > s->lo) ? off : s->lo;
+	to = (off + (long)count < s->hi) ? off + (long)count : s->hi;
+	if (from >= to)
+	{
+		pthread_mutex_unlock(&s->mutex);
+		memset(buf, 0, sizeof(float) * count * s->nch);
+		return 0;
+	}
+	memset(buf, 0, sizeof(float) * (from - off) * s->nch);
+	memset(buf + (to - off) * s->nch, 0,
+		   sizeof(float) * (off + count - to) * s->nch);
+	for (long f = from; f < to; f += n)
+	{
+		slot = f % s->cap;
+		n = to - f;
+		if (n > s->cap - slot)
+			n = s->cap - slot;
+		s->conv->to_float(s->ring + slot * s->fsize, buf + (f - off) * s->nch,
+						  n * s->nch);
+	}
+	pthread_mutex_unlock(&s->mutex);
+	return to - from;
+}
+
+void source_close(source_t *s)
+{
+	if (s->smpl != NULL)
+		destroy_sample(s->smpl);
+	if (s->map != NULL)
+		munmap(s->map, s->map_len);
+	free(s->ring);
+	if (s->fd >= 0)
+		close(s->fd);
+	pthread_mutex_destroy(&s->mutex);
+	memset(s, 0, sizeof(*s));
+	s->fd = -1;
+}
@@ -0,0 +1,125 @@
+/**
+ * @file stft.c
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief streaming short time Fourier transform
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * The last window of samples is kept in a linear buffer: after each frame
+ * the samples still needed slide to its start, by the window less a hop.
+ */
+#include "player/stft.h"
+
+#include <stdlib.h>
+
+#include <error.h>
+#include <math.h>
+#include <string.h>
+
+#include "player/fft.h"
+
+int stft_init(stft_t *s, int nfft, const window_t *win, int hop, int nframe)
+{
+	if (win == NULL || win->size > nfft || hop < 1 || hop > win->size ||
+		nframe < 1)
+	{
+		error_at_line(0, 0, __FILE__, __LINE__,
+					  "stft of %d, window of %d, hop of %d, %d frames", nfft,
+					  (win != NULL) ? win->size : 0, hop, nframe);
+		return -1;
+	}
+	s->nfft = nfft;
+	s->size = win->size;
+	s->hop = hop;
+	s->nbin = nfft / 2 + 1;
+	s->win = win;
+	s->corr = 2.0f / (win->size * win->cg);
+	s->nframe = nframe;
+	s->in = malloc(sizeof(float) * s->size);
+	s->ring = malloc(sizeof(float) * nframe * s->nbin);
+	s->end = malloc(sizeof(long) * nframe);
+	if (s->in == NULL || s->ring == NULL || s->end == NULL)
+	{
+		error_at_line(0, 0, __FILE__, __LINE__, "stft of %d frames", nframe);
+		free(s->in);
+		free(s->ring);
+		free(s->end);
+		return -1;
+	}
+	// the padding stays zero, real to complex transforms keep their input
+	s->tmp = fft_alloc_real(nfft);
+	s->cpx = fft_alloc_cpx(s->nbin);
+	stft_reset(s, 0);
+	return 0;
+}
+
+void stft_destroy(stft_t *s)
+{
+	free(s->in);
+	free(s->ring);
+	free(s->end);
+	fft_free(s->tmp);
+	fft_free(s->cpx);
+}
+
+void stft_reset(stft_t *s, long pos)
+{
+	s->fill = 0;
+	s->pos = pos;
+	s->count = 0;
+}
+
+/**
+ * @brief	Transform the window of samples in the next slot of the ring.
+ */
+static void stft_frame_compute(stft_t *s)
+{
+	const float *restrict w = __builtin_assume_aligned(s->win->w,
+													   WINDOW_ALIGN);
+	float *mag = s->ring + (s->count % s->nframe) * s->nbin;
+
+	for (int i = 0; i < s->size; i++)
+		s->tmp[i] = s->in[i] * w[i];
+	fft_r2c(s->nfft, s->tmp, s->cpx);
+	for (int k = 0; k < s->nbin; k++)
+		mag[k] = sqrtf(s->cpx[k][0] * s->cpx[k][0] +
+					   s->cpx[k][1] * s->cpx[k][1]) *
+				 s->corr;
+	s->end[s->count % s->nframe] = s->pos;
+	s->count++;
+}
+
+int stft_push(stft_t *s, const float x[], int count)
+{
+	int n, nframe = 0;
+
+	while (count > 0)
+	{
+		n = s->size - s->fill;
+		if (n > count)
+			n = count;
+		memcpy(s->in + s->fill, x, sizeof(float) * n);
+		s->fill += n;
+		s->pos += n;
+		x += n;
+		count -= n;
+		if (s->fill == s->size)
+		{
+			stft_frame_compute(s);
+			nframe++;
+			memmove(s->in, s->in + s->hop,
+					sizeof(float) * (s->size - s->hop));
+			s->fill = s->size - s->hop;
+		}
+	}
+	return nframe;
+}
+
+const float *stft_frame(const stft_t *s, long i, long *end)
+{
+	if (i < 0 || i >= s->count || i < s->count - s->nframe)
+		return NULL;
+	if (end != NULL)
+		*end = s->end[i % s->nframe];
+	return s->ring + (i % s->nframe) * s->nbin;
+}
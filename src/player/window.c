@@ -0,0 +1,184 @@
+/**
+ * @file window.c
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief precomputed window functions for the spectrum analysis
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * All windows are the symmetric version (denominator size - 1), as the
+ * Blackman-Harris window originally computed by the player.
+ */
+#include "player/window.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <errno.h>
+#include <error.h>
+#include <math.h>
+#include <pthread.h>
+
+static window_t tables[WINDOW_MAX_TABLES]; /**< computed tables. */
+static int ntables = 0;					   /**< no. computed tables. */
+static pthread_mutex_t tables_mutex =
+	PTHREAD_MUTEX_INITIALIZER; /**< mutex for the tables. */
+
+/**
+ * @brief	Generalized cosine window.
+ * @param[in]	a	coefficients of the cosine terms.
+ * @param[in]	na	no. coefficients.
+ * @param[in]	n	no. of the sample in the window.
+ * @param[in]	size	no. samples of the window.
+ */
+static double cosine_sum(const double a[], int na, int n, int size)
+{
+	double wn;
+	int k;
+
+	wn = a[0];
+	for (k = 1; k < na; k++)
+	{
+		wn += ((k % 2) ? -1 : 1) * a[k] * cos(2 * M_PI * k * n / (size - 1));
+	}
+	return wn;
+}
+
+/**
+ * @brief	Modified Bessel function of the first kind, order 0.
+ *
+ * Power series, it converges quickly for the beta values used in audio.
+ */
+static double bessel_i0(double x)
+{
+	double sum, term;
+	int k;
+
+	sum = term = 1.0;
+	for (k = 1; k < 64 && term > sum * 1e-12; k++)
+	{
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+/**
+ * @brief	Value of a window function in a sample.
+ * @param[in]	type	window function.
+ * @param[in]	n	no. of the sample in the window.
+ * @param[in]	size	no. samples of the window.
+ * @param[in]	beta	Kaiser shape parameter.
+ */
+static double window_value(window_type_t type, int n, int size, double beta)
+{
+	static const double hann[] = {0.5, 0.5};
+	static const double hamming[] = {0.54, 0.46};
+	static const double bh[] = {0.35875, 0.48829, 0.14128, 0.01168};
+	static const double flattop[] = {0.21557895, 0.41663158, 0.277263158,
+									 0.083578947, 0.006947368};
+	double r;
+
+	switch (type)
+	{
+	case WIN_HANN:
+		return cosine_sum(hann, 2, n, size);
+	case WIN_HAMMING:
+		return cosine_sum(hamming, 2, n, size);
+	case WIN_BLACKMAN_HARRIS:
+		return cosine_sum(bh, 4, n, size);
+	case WIN_FLATTOP:
+		return cosine_sum(flattop, 5, n, size);
+	case WIN_KAISER:
+		r = 2.0 * n / (size - 1) - 1.0;
+		return bessel_i0(beta * sqrt(1.0 - r * r)) / bessel_i0(beta);
+	default:
+		return 1.0;
+	}
+}
+
+/**
+ * @brief	Compute the table and the corrections of a window.
+ * @return	0 on success, -1 on error.
+ */
+static int window_build(window_t *win, window_type_t type, int size,
+						float beta)
+{
+	double sum, sum2, wn;
+	int n;
+
+	if (posix_memalign((void **)&win->w, WINDOW_ALIGN,
+					   sizeof(float) * size) != 0)
+		return -1;
+
+	sum = sum2 = 0;
+	for (n = 0; n < size; n++)
+	{
+		wn = window_value(type, n, size, beta);
+		win->w[n] = (float)wn;
+		sum += wn;
+		sum2 += wn * wn;
+	}
+	win->type = type;
+	win->size = size;
+	win->beta = beta;
+	win->cg = sum / size;
+	win->enbw = size * sum2 / (sum * sum);
+	return 0;
+}
+
+const window_t *window_get(window_type_t type, int size, float beta)
+{
+	const window_t *win;
+	int i;
+
+	if (type < 0 || type >= WIN_NTYPE || size < 2)
+	{
+		error_at_line(0, 0, __FILE__, __LINE__,
+					  "invalid window type %d, size %d", type, size);
+		return NULL;
+	}
+	if (type != WIN_KAISER)
+		beta = 0;
+
+	win = NULL;
+	pthread_mutex_lock(&tables_mutex);
+	for (i = 0; i < ntables && win == NULL; i++)
+	{
+		if (tables[i].type == type && tables[i].size == size &&
+			tables[i].beta == beta)
+			win = &tables[i];
+	}
+	if (win == NULL && ntables < WINDOW_MAX_TABLES &&
+		window_build(&tables[ntables], type, size, beta) == 0)
+	{
+		win = &tables[ntables];
+		ntables++;
+	}
+	pthread_mutex_unlock(&tables_mutex);
+
+	if (win == NULL)
+		error_at_line(0, ENOMEM, __FILE__, __LINE__,
+					  "cannot build window %d of size %d", type, size);
+	return win;
+}
+
+void window_apply(const window_t *win, float buf[])
+{
+	const float *restrict w = __builtin_assume_aligned(win->w, WINDOW_ALIGN);
+	float *restrict b = buf;
+	int n;
+
+	for (n = 0; n < win->size; n++)
+		b[n] *= w[n];
+}
+
+void window_xtor()
+{
+	int i;
+
+	pthread_mutex_lock(&tables_mutex);
+	for (i = 0; i < ntables; i++)
+		free(tables[i].w);
+	ntables = 0;
+	pthread_mutex_unlock(&tables_mutex);
+}
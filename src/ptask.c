@@ -4,10 +4,43 @@
  * @date	28 May 2018
  * @brief support for periodic task implementation
  */
+#define _GNU_SOURCE // CPU sets
 #include "ptask.h"
 
+#include <stdio.h>
+
+#include <alloca.h>
+#include <errno.h>
+#include <error.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
 #include "defines.h"
 
+#define TASK_STACK_MARGIN (16 * 1024) /**< Stack bytes left untouched at
+				the low end, for the signal handlers. */
+
+/**
+ * @brief	Argument of sched_setattr(), with no wrapper in older C libraries.
+ */
+struct task_sched_attr
+{
+	uint32_t size;			 /**< Size of the structure. */
+	uint32_t sched_policy;	 /**< Policy. */
+	uint64_t sched_flags;	 /**< SCHED_FLAG_*. */
+	int32_t sched_nice;		 /**< Nice of SCHED_OTHER, SCHED_BATCH. */
+	uint32_t sched_priority; /**< Priority of SCHED_FIFO, SCHED_RR. */
+	uint64_t sched_runtime;	 /**< Runtime of SCHED_DEADLINE in ns. */
+	uint64_t sched_deadline; /**< Relative deadline in ns. */
+	uint64_t sched_period;	 /**< Period in ns. */
+};
+
+static task_sched_t task_sched = TASK_FIFO; /**< Policy by default. */
+static int task_dump_ms = 0; /**< Period of the print of the statistics. */
+
 /**
  * @brief	Copies a source time variable ts in a destination variable.
  * @param[out]	td	pointer to the destination time variable
@@ -55,6 +88,18 @@ static int time_cmp(struct timespec t1, struct timespec t2)
 	return 0;
 }
 
+/**
+ * @brief	Microseconds from a time to another.
+ * @param[in]	t1	a time variable.
+ * @param[in]	t2	an earlier time variable.
+ * @return	t1 - t2 in us.
+ */
+static long time_diff_us(struct timespec t1, struct timespec t2)
+{
+	return (t1.tv_sec - t2.tv_sec) * 1000000L +
+		   (t1.tv_nsec - t2.tv_nsec) / 1000;
+}
+
 /**
  * @brief	Set the period for a periodic task.
  *
@@ -107,7 +152,283 @@ int deadline_miss(task_par_t *tp)
  */
 void wait_for_period(task_par_t *tp)
 {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (time_cmp(now, tp->at) >= 0)
+	{
+		switch (tp->overrun)
+		{
+		case TASK_SKIP:
+			while (time_cmp(now, tp->at) >= 0)
+			{
+				time_add_ms(&(tp->at), tp->period);
+				time_add_ms(&(tp->dl), tp->period);
+				tp->skipped++;
+			}
+			break;
+		case TASK_REPHASE:
+			// activated now, at no sleep
+			time_copy(&(tp->at), now);
+			time_copy(&(tp->dl), now);
+			time_add_ms(&(tp->at), tp->period);
+			time_add_ms(&(tp->dl), tp->deadline);
+			return;
+		default:
+			break;
+		}
+	}
 	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &(tp->at), NULL);
 	time_add_ms(&(tp->at), tp->period);
 	time_add_ms(&(tp->dl), tp->period);
 }
+
+/**
+ * @brief	Touch the stack of the calling thread, but a margin.
+ *
+ * The stack is measured, so whatever the TLS and the frames above take,
+ * pages are touched one at a time from the current frame down to the
+ * margin, never past the guard page.
+ */
+static void task_prefault()
+{
+	pthread_attr_t attr;
+	volatile unsigned char *p;
+	uintptr_t low;
+	size_t size;
+	void *addr;
+	long page = sysconf(_SC_PAGESIZE);
+
+	if (pthread_getattr_np(pthread_self(), &attr) != 0)
+		return;
+	pthread_attr_getstack(&attr, &addr, &size);
+	pthread_attr_destroy(&attr);
+	low = (uintptr_t)addr + TASK_STACK_MARGIN + page;
+	// the stack grows down: each chunk is below the previous one
+	do
+	{
+		p = alloca(page);
+		p[0] = 0;
+	} while ((uintptr_t)p > low);
+}
+
+/**
+ * @brief	Move the calling thread under SCHED_DEADLINE.
+ * @param[in]	tp	task_par structure of the calling thread.
+ * @return	0 on success, -1 on error, errno set.
+ */
+static int task_deadline(task_par_t *tp)
+{
+	struct task_sched_attr attr = {
+		.size = sizeof(attr),
+		.sched_policy = SCHED_DEADLINE,
+		.sched_runtime = tp->wcet * 1000ULL,
+		.sched_deadline = tp->deadline * 1000000ULL,
+		.sched_period = tp->period * 1000000ULL,
+	};
+
+	if (tp->wcet <= 0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	return syscall(SYS_sched_setattr, 0, &attr, 0);
+}
+
+/**
+ * @brief	Bucket of a time.
+ */
+static int hist_bucket(long us)
+{
+	int e;
+
+	if (us < TASK_HIST_SUB)
+		return (us < 0) ? 0 : us;
+	// 2^e <= us, the 3 bits below the leading one
+	e = 63 - __builtin_clzl(us);
+	if (e > 24)
+		return TASK_HIST_LEN - 1;
+	return (e - 2) * TASK_HIST_SUB + ((us >> (e - 3)) & (TASK_HIST_SUB - 1));
+}
+
+/**
+ * @brief	Lowest time of a bucket.
+ */
+static long hist_low(int i)
+{
+	int e = i / TASK_HIST_SUB + 2;
+
+	if (i < TASK_HIST_SUB)
+		return i;
+	return (long)(TASK_HIST_SUB + i % TASK_HIST_SUB) << (e - 3);
+}
+
+void task_hist_add(task_hist_t *h, long us)
+{
+	int i = hist_bucket(us);
+
+	if (us < 0)
+		us = 0;
+	// a writer only, the readers load each value on its own
+	if (h->count == 0 || us < h->min)
+		__atomic_store_n(&h->min, us, __ATOMIC_RELAXED);
+	if (us > h->max)
+		__atomic_store_n(&h->max, us, __ATOMIC_RELAXED);
+	__atomic_store_n(&h->bucket[i], h->bucket[i] + 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&h->count, h->count + 1, __ATOMIC_RELAXED);
+}
+
+void task_hist_summary(const task_hist_t *h, task_summary_t *s)
+{
+	static const double q[3] = {0.5, 0.99, 0.999};
+	long *p[3] = {&s->p50, &s->p99, &s->p999};
+	unsigned long bucket[TASK_HIST_LEN], n = 0, sum = 0;
+	int i = 0;
+
+	s->min = __atomic_load_n(&h->min, __ATOMIC_RELAXED);
+	s->max = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+	// the percentiles of the buckets copied, whatever added meanwhile
+	for (int k = 0; k < TASK_HIST_LEN; k++)
+	{
+		bucket[k] = __atomic_load_n(&h->bucket[k], __ATOMIC_RELAXED);
+		n += bucket[k];
+	}
+	s->count = n;
+	for (int j = 0; j < 3; j++)
+	{
+		while (i < TASK_HIST_LEN && sum + bucket[i] < q[j] * n)
+			sum += bucket[i++];
+		// the top of the bucket, or the longest time in the last one
+		*p[j] = (i < TASK_HIST_LEN - 1) ? hist_low(i + 1) - 1 : s->max;
+		if (*p[j] > s->max)
+			*p[j] = s->max;
+	}
+	if (n == 0)
+		s->min = s->p50 = s->p99 = s->p999 = s->max = 0;
+}
+
+void task_dump(const task_par_t *tp, FILE *f)
+{
+	const char *what[3] = {"jitter", "response", "exec"};
+	const task_hist_t *h[3] = {&tp->jitter, &tp->response, &tp->exec};
+	const char *name = (tp->name) ? tp->name : "task";
+	task_summary_t s;
+
+	for (int i = 0; i < 3; i++)
+	{
+		task_hist_summary(h[i], &s);
+		fprintf(f,
+				"%s %s: %lu, min %ld, p50 %ld, p99 %ld, p99.9 %ld, max %ld "
+				"us\n",
+				name, what[i], s.count, s.min, s.p50, s.p99, s.p999, s.max);
+	}
+	fprintf(f, "%s wcet: %ld us, misses: %d, skipped: %ld\n", name, tp->wcet,
+			tp->dmiss, tp->skipped);
+}
+
+void task_set_dump(int ms) { task_dump_ms = (ms > 0) ? ms : 0; }
+
+/**
+ * @brief	Thread routine of a task.
+ *
+ * The release of the activation running is at - period, whatever the
+ * overrun policy.
+ *
+ * @param[in]	arg	pointer to the task_par structure of the task.
+ */
+static void *task_run(void *arg)
+{
+	task_par_t *tp = arg;
+	struct timespec start, end, cpu0, cpu1;
+	long n = 0, exec, ndump;
+	int stop;
+
+	if (tp->sched == TASK_DEADLINE && task_deadline(tp) != 0)
+	{
+		error_at_line(0, errno, __FILE__, __LINE__, "%s under SCHED_FIFO",
+					  (tp->name) ? tp->name : "task");
+		tp->sched = TASK_FIFO;
+	}
+	task_prefault();
+	set_period(tp);
+	ndump = (task_dump_ms > tp->period) ? task_dump_ms / tp->period : 1;
+	while (1)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu0);
+		stop = tp->body(tp);
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu1);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		exec = time_diff_us(cpu1, cpu0);
+		task_hist_add(&tp->jitter,
+					  time_diff_us(start, tp->at) + tp->period * 1000L);
+		task_hist_add(&tp->response,
+					  time_diff_us(end, tp->at) + tp->period * 1000L);
+		task_hist_add(&tp->exec, exec);
+		if (stop)
+			break;
+
+		if (deadline_miss(tp) && tp->name != NULL)
+			printf("%s MISS\n", tp->name);
+		if (task_dump_ms > 0 && ++n % ndump == 0)
+			task_dump(tp, stdout);
+		wait_for_period(tp);
+	}
+	if (tp->name != NULL)
+		task_dump(tp, stdout);
+	return NULL;
+}
+
+void task_set_sched(task_sched_t sched) { task_sched = sched; }
+
+int task_start(pthread_t *tid, int (*body)(task_par_t *tp), task_par_t *tp)
+{
+	struct sched_param mypar;
+	pthread_attr_t attr;
+	cpu_set_t cpus;
+	long page = sysconf(_SC_PAGESIZE);
+	int ret;
+
+	tp->body = body;
+	if (tp->sched == TASK_SCHED_DEFAULT)
+		tp->sched = task_sched;
+	// whole pages, enough for the margin left untouched
+	if (tp->stack == 0)
+		tp->stack = TASK_STACK;
+	if (tp->stack < (size_t)PTHREAD_STACK_MIN + TASK_STACK_MARGIN)
+		tp->stack = (size_t)PTHREAD_STACK_MIN + TASK_STACK_MARGIN;
+	tp->stack = (tp->stack + page - 1) / page * page;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, tp->stack);
+	if (tp->cpus != 0)
+	{
+		CPU_ZERO(&cpus);
+		for (unsigned int i = 0; i < sizeof(tp->cpus) * 8 && i < CPU_SETSIZE;
+			 i++)
+			if (tp->cpus & (1UL << i))
+				CPU_SET(i, &cpus);
+		pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+	}
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+	mypar.sched_priority = tp->priority;
+	pthread_attr_setschedparam(&attr, &mypar);
+	ret = pthread_create(tid, &attr, task_run, tp);
+	if (ret == EPERM)
+	{
+		error_at_line(0, ret, __FILE__, __LINE__,
+					  "%s at normal priority", (tp->name) ? tp->name : "task");
+		pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+		ret = pthread_create(tid, &attr, task_run, tp);
+	}
+	pthread_attr_destroy(&attr);
+	if (ret != 0)
+	{
+		error_at_line(0, ret, __FILE__, __LINE__, "cannot start %s",
+					  (tp->name) ? tp->name : "task");
+		return -1;
+	}
+	return 0;
+}
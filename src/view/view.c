@@ -8,6 +8,7 @@
 #include "view/view.h"
 
 #include <stdio.h>
+#include <string.h>
 
 #include <assert.h>
 
@@ -23,18 +24,57 @@ static pthread_t tid;
 
 static task_par_t tp = {
 	arg : 0,
+	wcet : 30000,
 	period : 80,
 	deadline : 80,
 	priority : 20,
 	dmiss : 0,
+	name : "VIEW",
 };
 static char _view_exit = 0;
 static pthread_mutex_t _view_exit_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-static void *view_run(void *arg);
+static int view_run(task_par_t *arg);
 
 static const int ZOOM_TO_BAR[6] = {210, 170, 140, 100, 70, 30};
-/**< Zoom to bar table. */
+/**< Zoom to bar table, the first is the no. bands asked to the player, that
+	 each panel groups in as many bars as its zoom shows. */
+
+static const char *const EQ_PRESET_NAME[EQ_NPRESET] = {
+	"Player", "ISO 10", "ISO 31"}; /**< Label of each preset of the EQ. */
+
+/**
+ * @brief	Center frequency of a group of bands of the equalizer.
+ *
+ * The bands of the layout are split among the EQLZP_NBAR bars, in order:
+ * the bar b sets those from b * nband / EQLZP_NBAR on.
+ *
+ * @param[in]	p	the player.
+ * @param[in]	b	the bar.
+ * @return	the frequency of the middle band of the group, 0 if empty.
+ */
+static float eq_group_freq(const Player_t *p, int b)
+{
+	int lo = b * p->nband / EQLZP_NBAR, hi = (b + 1) * p->nband / EQLZP_NBAR;
+
+	return (lo < hi) ? p->eq_freq[(lo + hi - 1) / 2] : 0;
+}
+
+/**
+ * @brief	Label of a frequency, as short as the bars are spaced.
+ *
+ * @param[out]	dst	the label.
+ * @param[in]	freq	the frequency, nothing for 0.
+ */
+static void eq_freq_str(char *dst, float freq)
+{
+	if (freq <= 0)
+		strcpy(dst, "");
+	else if (freq < 1000)
+		sprintf(dst, "%.3gHz", freq);
+	else
+		sprintf(dst, "%.2gKHz", freq / 1000);
+}
 
 /**
  * @brief	Structure for frequency spectogram panel
@@ -45,6 +85,9 @@ struct fspect_panel_t
 	unsigned char zoom; /**< Actual zoom of the panel.
 							 It changes the no. bar shown. */
 	unsigned int id;
+	BITMAP *map; /**< Color map, a column per spectogram, used as a ring. */
+	int col;	 /**< Column of the map after the newest. */
+	long next;	 /**< Next spectogram of the player to draw. */
 };
 
 struct fspect_panel_t filt_spect_panel; /**< filtered frequency spectrum 
@@ -54,6 +97,12 @@ struct fspect_panel_t orig_spect_panel; /**< original(not equalized) frequency
 
 static Player_t old_p, actual_p; /**< Previous player state. */
 
+static char spect_map = 0; /**< spectograms as color maps, not bars. */
+static int map_lut[101];   /**< Color of each spectogram value. */
+static BITMAP *overview;   /**< Spectra of the whole song under the position
+								bar, a column per pixel, NULL until the
+								player has them. */
+
 /*******************************************************************************
  *				TIME DATA PANEL
  ******************************************************************************/
@@ -66,16 +115,17 @@ static void timedata_panel_update()
 {
 	Node *n;
 	BITMAP *buf;
-	int x, y;
+	int x, y, bits;
 	static int old_y = 0;
 
 	n = &nodes[TIME_PANEL][0];
 	buf = create_bitmap(n->w / 2 - n->w / 30, n->h - 2);
 
 	x = n->x + n->w / 2;
-	// depend on actual_p.time data
+	// depend on actual_p.time data, wider samples are scaled to 16 bits
+	bits = (actual_p.bits > 16) ? 16 : actual_p.bits;
 	y = (n->y + n->h / 2) -
-		actual_p.time_data * (n->h / 2) / ((1 << (actual_p.bits - 1)) - 1);
+		actual_p.time_data * (n->h / 2) / ((1 << (bits - 1)) - 1);
 
 	scare_mouse();
 	blit(screen, buf, n->x + n->w / 30, n->y + 1, 0, 0, buf->w, buf->h);
@@ -126,60 +176,26 @@ static int fspect_panel_init(struct fspect_panel_t *panel)
 	return 0;
 }
 
-/**
- * @brief	Compute the average value of a buffer.
- * @param[in]	v	buffer of float falues.
- * @param[in]	size	size of the buffer.
- * @ret			average float value.
- */
-static float avg(float *v, unsigned int size)
-{
-	int i;
-	float val;
-
-	val = 0;
-	for (i = 0; i < size; i++)
-	{
-		val += v[i];
-	}
-
-	return val / ((float)size);
-}
-
 /**
  * @brief	Draw a spectogram view bar with respect to the player spectogram
  *
- * Draw a bar of the spectogram depending on the player spectogram values corres
- * -ponding to that bar. Indeed, each spectogram view bar represent more than a
- * player spectogram value, since view bars are lesser.
+ * Draw a bar of the spectogram as high as the level of the player bands
+ * it groups.
  *
  * @param[in]	i	No bar to draw.
+ * @param[in]	val	level of the bar, in the [0-100] range.
  */
 
 static void fspect_bar_update(struct fspect_panel_t *panel, unsigned int i,
-							  float spect[])
+							  float val)
 {
 	int height; /**< New bar update. */
 	int delta;  /**< Difference between old height and new height of the bar. */
 	int col;	/**< Color with which to draw. */
-	int nbar;   /**< No. bar actually showed in the spect.. Depends on zoom. */
 	Node *n;	/**< Pointer to the right Spect. Bar. */
 
-	nbar = ZOOM_TO_BAR[panel->zoom];
-	assert(i < nbar);
-	// the last bar can overflow the player spectogram.
-	if (i < nbar)
-	{
-		height =
-			avg(&(spect[i * (PLAYER_WINDOW_SIZE_CPX / nbar)]),
-				PLAYER_WINDOW_SIZE_CPX / nbar);
-	}
-	else
-	{
-		height =
-			avg(&(spect[i * (PLAYER_WINDOW_SIZE_CPX / nbar)]),
-				PLAYER_WINDOW_SIZE_CPX % nbar);
-	}
+	assert(i < ZOOM_TO_BAR[panel->zoom]);
+	height = val;
 	// since height is in the [0-100] range we can obtain easily the new
 	// height by multiplying for Panel Height
 	n = &nodes[panel->id][0];
@@ -202,9 +218,151 @@ static void fspect_bar_update(struct fspect_panel_t *panel, unsigned int i,
 	n->h = height;
 }
 
+/**
+ * @brief	Redraw the bars of the spectogram that changed.
+ *
+ * The player bands the spectograms in the ZOOM_TO_BAR[0] bands of the
+ * widest zoom, whatever the zoom of each panel: a bar is the mean level of
+ * the bands under it, so the panels can be zoomed apart.
+ *
+ * @param[inout]	old	bars drawn, updated.
+ * @param[in]	actual	spectogram to draw.
+ * @param[in]	nbar	no. bands of the spectogram to draw.
+ */
+static void fspect_bars_update(struct fspect_panel_t *panel, float old[],
+							   const float actual[], int nbar)
+{
+	int i;		  /**< Array index for spectogram. */
+	int nbv;	  /**< No. bars of the View (Spectogram). */
+	int from, to; /**< Bands of the player under a bar. */
+	float val;	  /**< Level of a bar. */
+
+	// until the player takes the layout the bands are more or less
+	nbv = ZOOM_TO_BAR[panel->zoom];
+	if (nbar < nbv)
+		nbv = nbar;
+	for (i = 0; i < nbv; i++)
+	{
+		from = i * nbar / nbv;
+		to = (i + 1) * nbar / nbv;
+		val = 0;
+		for (int k = from; k < to; k++)
+			val += actual[k];
+		val /= to - from;
+		if (old[i] != val)
+		{
+			fspect_bar_update(panel, i, val);
+			old[i] = val;
+		}
+	}
+}
+
+/**
+ * @brief	Build the color table of the maps, from black to white through
+ *		blue, red and yellow.
+ */
+static void fspect_map_lut()
+{
+	static const int stop[5][3] = {
+		{0, 0, 0}, {0, 0, 160}, {200, 0, 0}, {255, 220, 0}, {255, 255, 255}};
+	int s, v;
+	float t;
+
+	for (v = 0; v <= 100; v++)
+	{
+		s = (v < 100) ? v / 25 : 3;
+		t = (v - s * 25) / 25.0f;
+		map_lut[v] = makecol(stop[s][0] + t * (stop[s + 1][0] - stop[s][0]),
+							 stop[s][1] + t * (stop[s + 1][1] - stop[s][1]),
+							 stop[s][2] + t * (stop[s + 1][2] - stop[s][2]));
+	}
+}
+
+/**
+ * @brief	Create the color map of a spectogram panel, black.
+ *
+ * The player bands the spectograms on a log scale in as many bands as rows,
+ * the first row from the bottom being the lowest band.
+ */
+static void fspect_map_init(struct fspect_panel_t *panel)
+{
+	Node *frame = &nodes[panel->id][0];
+
+	panel->map = create_bitmap(frame->w - 2, frame->h - 2);
+	clear_to_color(panel->map, BLACK);
+	panel->col = 0;
+	panel->next = player_get_spect_count();
+	player_set_bands(BANDS_LOG, (panel->map->h < PLAYER_MAX_BARS)
+									? panel->map->h
+									: PLAYER_MAX_BARS);
+}
+
+/**
+ * @brief	Draw a spectogram in the column after the newest of the map.
+ *
+ * Each pixel is the band of its row, stretched when the spectogram has
+ * fewer bands than rows.
+ *
+ * @param[in]	spect	player spectogram, a byte per band.
+ * @param[in]	nbar	no. bands.
+ */
+static void fspect_map_column(struct fspect_panel_t *panel,
+							  const unsigned char spect[], int nbar)
+{
+	BITMAP *m = panel->map;
+	int r, v;
+
+	for (r = 0; r < m->h; r++)
+	{
+		v = spect[r * nbar / m->h];
+		_putpixel32(m, panel->col, m->h - 1 - r, map_lut[(v > 100) ? 100 : v]);
+	}
+	panel->col = (panel->col + 1) % m->w;
+}
+
+/**
+ * @brief	Scroll the color map by the spectograms computed since the last
+ *		update.
+ *
+ * Only the new columns are drawn in the map, which is a ring of columns:
+ * the screen is updated by two blits, the oldest columns then the newest,
+ * so the cost does not depend on how many spectograms are kept. When the
+ * view lags behind, the spectograms that would scroll out are skipped.
+ *
+ * @param[in]	filtered	map of the equalized song, not the original.
+ */
+static void fspect_map_update(struct fspect_panel_t *panel, int filtered)
+{
+	static unsigned char spect[PLAYER_MAX_BARS];
+	Node *n = &nodes[panel->id][0];
+	BITMAP *m = panel->map;
+	long count = player_get_spect_count();
+	char drawn = 0;
+	int nbar;
+
+	if (panel->next < count - m->w)
+		panel->next = count - m->w;
+	for (; panel->next < count; panel->next++)
+	{
+		nbar = player_get_spect_frame(filtered, panel->next, spect);
+		if (nbar <= 0)
+			continue;
+		fspect_map_column(panel, spect, nbar);
+		drawn = 1;
+	}
+	if (!drawn)
+		return;
+	scare_mouse();
+	blit(m, screen, panel->col, 0, n->x + 1, n->y + 1, m->w - panel->col,
+		 m->h);
+	blit(m, screen, 0, 0, n->x + 1 + m->w - panel->col, n->y + 1, panel->col,
+		 m->h);
+	unscare_mouse();
+}
+
 int fspect_panel_zoomin(struct fspect_panel_t *panel)
 {
-	if (panel->zoom <= MAXZOOM)
+	if (panel->zoom < MAXZOOM)
 	{
 		panel->zoom++;
 		fspect_panel_init(panel);
@@ -226,6 +384,71 @@ int fspect_panel_zoomout(struct fspect_panel_t *panel)
 	return -1;
 }
 
+/*******************************************************************************
+ *			POSITION PANEL
+ ******************************************************************************/
+/**
+ * @brief	Draw the position bar with its set bar at a pixel.
+ *
+ * Over the overview, when there is one, the set bar is moved by drawing
+ * the overview again instead of clearing it.
+ *
+ * @param[in]	pix	x coordinate of the set bar.
+ */
+static void pos_bar_draw(int pix)
+{
+	Node *bar = &nodes[POS_PANEL][POSP_BAR];
+	Node *n = &nodes[POS_PANEL][POSP_SETB];
+
+	if (overview == NULL)
+	{
+		g_stretch(n, pix, n->y, n->w, n->h);
+		return;
+	}
+	scare_mouse();
+	blit(overview, screen, 0, 0, bar->x, bar->y, overview->w, overview->h);
+	unscare_mouse();
+	n->x = pix;
+	g_draw(n);
+}
+
+/**
+ * @brief	Draw the spectra of the whole song in the position bar.
+ *
+ * The player computes them in background the first time a song is played,
+ * until then nothing is drawn and this is tried again at the next period.
+ * Each column is the spectogram at its time in the song, stretched as in
+ * the color maps.
+ */
+static void overview_draw()
+{
+	static unsigned char spect[PLAYER_MAX_BARS];
+	Node *bar = &nodes[POS_PANEL][POSP_BAR];
+	BITMAP *m;
+	int x, r, v, nbar;
+
+	if (overview != NULL || actual_p.duration <= 0)
+		return;
+	// rectfill draws the bar one pixel wider and higher than its size
+	m = create_bitmap(bar->w + 1, bar->h + 1);
+	for (x = 0; x < m->w; x++)
+	{
+		nbar = player_get_overview(actual_p.duration * x / m->w, spect);
+		if (nbar <= 0)
+		{
+			destroy_bitmap(m);
+			return;
+		}
+		for (r = 0; r < m->h; r++)
+		{
+			v = spect[r * nbar / m->h];
+			_putpixel32(m, x, m->h - 1 - r, map_lut[(v > 100) ? 100 : v]);
+		}
+	}
+	overview = m;
+	pos_bar_draw(nodes[POS_PANEL][POSP_SETB].x);
+}
+
 /*******************************************************************************
  *			TITLE PANEL
  ******************************************************************************/
@@ -385,12 +608,26 @@ void view_init()
 	// init the fspect panel
 	filt_spect_panel.zoom = 4;
 	filt_spect_panel.id = FILT_SP_PANEL;
-	fspect_panel_init(&filt_spect_panel);
 	orig_spect_panel.zoom = 4;
 	orig_spect_panel.id = ORIG_SP_PANEL;
-	fspect_panel_init(&orig_spect_panel);
+	// the overview is a color map too
+	fspect_map_lut();
+	if (spect_map)
+	{
+		fspect_map_init(&filt_spect_panel);
+		fspect_map_init(&orig_spect_panel);
+	}
+	else
+	{
+		// one layout for both, each panel groups the bands by its zoom
+		player_set_bands(BANDS_LINEAR, ZOOM_TO_BAR[0]);
+		fspect_panel_init(&filt_spect_panel);
+		fspect_panel_init(&orig_spect_panel);
+	}
 
 	player_get_player(&old_p);
+	// the labels of the equalizer drawn from the layout
+	old_p.nband = 0;
 
 	nodes[CTRL_PANEL][STOP_BTN].fg = RED;
 	g_draw(&nodes[CTRL_PANEL][STOP_BTN]);
@@ -405,12 +642,9 @@ void view_init()
  */
 static void view_run_body()
 {
-	int i, j;  /**< Array indexes for spectogram. */
-	int nbv;   /**< No. bars of the View (Spectogram). */
-	int spv;   /**< player Spectogram bar Per View bar. */
-	char next; /**< A boolean variable for jump to next spect bar update. */
 	int pix;   /**< Pixel variable. */
 	Node *n;   /**< Pointer to a graphic object. */
+	int relayout; /**< The layout of the equalizer changed. */
 
 	// PLAYER STATE
 	if (old_p.state != actual_p.state)
@@ -426,9 +660,7 @@ static void view_run_body()
 		n = &nodes[POS_PANEL][POSP_BAR];
 		// position set bar update
 		pix = n->w * actual_p.time / actual_p.duration + n->x;
-		n = &nodes[POS_PANEL][POSP_SETB];
-		// HERE
-		g_stretch(n, pix, n->y, n->w, n->h);
+		pos_bar_draw(pix);
 		// time text update
 		n = &nodes[POS_PANEL][POSP_TIME];
 		sprintf(((text *)(n->dp))->str, "%02d:%02d",
@@ -436,45 +668,25 @@ static void view_run_body()
 		g_draw(n);
 		old_p.time = actual_p.time;
 	}
+	// SONG OVERVIEW
+	overview_draw();
 	// PLAYER TIMEDATA
 	if (actual_p.state != STOP && actual_p.state != PAUSE)
 	{
 		timedata_panel_update();
 	}
 	// PLAYER SPECTOGRAM
-	nbv = ZOOM_TO_BAR[filt_spect_panel.zoom];
-	spv = PLAYER_WINDOW_SIZE_CPX / nbv;
-	for (i = 0; i < nbv; i++)
+	if (spect_map)
 	{
-		next = 0;
-		for (j = i * spv; (j < (i + 1) * spv) && (next == 0); j++)
-		{
-			if (old_p.filt_spect[j] != actual_p.filt_spect[j])
-			{
-				fspect_bar_update(&filt_spect_panel, i,
-								  actual_p.filt_spect);
-				memcpy(&old_p.filt_spect[j], &actual_p.filt_spect[j],
-					   sizeof(float) * (spv - (j % spv)));
-				next = 1;
-			}
-		}
+		fspect_map_update(&filt_spect_panel, 1);
+		fspect_map_update(&orig_spect_panel, 0);
 	}
-	nbv = ZOOM_TO_BAR[orig_spect_panel.zoom];
-	spv = PLAYER_WINDOW_SIZE_CPX / nbv;
-	for (i = 0; i < nbv; i++)
+	else
 	{
-		next = 0;
-		for (j = i * spv; (j < (i + 1) * spv) && (next == 0); j++)
-		{
-			if (old_p.orig_spect[j] != actual_p.orig_spect[j])
-			{
-				fspect_bar_update(&orig_spect_panel, i,
-								  actual_p.orig_spect);
-				memcpy(&old_p.orig_spect[j], &actual_p.orig_spect[j],
-					   sizeof(float) * (spv - (j % spv)));
-				next = 1;
-			}
-		}
+		fspect_bars_update(&filt_spect_panel, old_p.filt_spect,
+						   actual_p.filt_spect, actual_p.nbar);
+		fspect_bars_update(&orig_spect_panel, old_p.orig_spect,
+						   actual_p.orig_spect, actual_p.nbar);
 	}
 	// PLAYER VOLUME
 	if (old_p.volume != actual_p.volume)
@@ -491,26 +703,47 @@ static void view_run_body()
 
 		old_p.volume = actual_p.volume;
 	}
-	// PLAYER EQUALIZ
-	for (int i = 0; i < PLAYER_EQ_NFILT; i++)
+	// EQ LAYOUT, the labels of the preset and of the groups of bands
+	relayout = old_p.nband != actual_p.nband ||
+			   old_p.preset != actual_p.preset;
+	if (relayout)
 	{
-		if (old_p.eq_gain[i] != actual_p.eq_gain[i])
+		n = &nodes[EQULZ_PANEL][EQ_PRESET_LBL];
+		g_clear(n);
+		strcpy(((text *)(n->dp))->str, EQ_PRESET_NAME[actual_p.preset]);
+		g_draw(n);
+		for (int b = 0; b < EQLZP_NBAR; b++)
+		{
+			n = &nodes[EQULZ_PANEL][LFRQ_LBL + b];
+			g_clear(n);
+			eq_freq_str(((text *)(n->dp))->str,
+						eq_group_freq(&actual_p, b));
+			g_draw(n);
+		}
+		old_p.nband = actual_p.nband;
+		old_p.preset = actual_p.preset;
+	}
+	// PLAYER EQUALIZ, a bar per group, all its bands set together
+	for (int b = 0; b < EQLZP_NBAR; b++)
+	{
+		int i = b * actual_p.nband / EQLZP_NBAR;
+
+		if (relayout || old_p.eq_gain[i] != actual_p.eq_gain[i])
 		{
 			// EQ SET BAR
-			n = &nodes[EQULZ_PANEL][LFRQ_BAR + i];
+			n = &nodes[EQULZ_PANEL][LFRQ_BAR + b];
 			pix = -(n->h * actual_p.eq_gain[i]) / (PLAYER_EQ_MAX_GAIN * 2) +
 				  n->y + n->h / 2;
-			n = &nodes[EQULZ_PANEL][LFRQ_SBAR + i];
+			n = &nodes[EQULZ_PANEL][LFRQ_SBAR + b];
 			g_stretch(n, n->x, pix, n->w, n->h);
 			//EQ GAIN LABEL
-			n = &nodes[EQULZ_PANEL][LFRQ_GAIN_LBL + i];
+			n = &nodes[EQULZ_PANEL][LFRQ_GAIN_LBL + b];
 			sprintf(((text *)(n->dp))->str, "%3d dB",
 					(int)actual_p.eq_gain[i]);
 			g_draw(n);
-
-			old_p.eq_gain[i] = actual_p.eq_gain[i];
 		}
 	}
+	memcpy(old_p.eq_gain, actual_p.eq_gain, sizeof(old_p.eq_gain));
 }
 
 /**
@@ -527,10 +760,19 @@ static void view_xtor()
 			g_destroy(&(nodes[i][j]));
 		}
 	}
+	if (spect_map)
+	{
+		destroy_bitmap(filt_spect_panel.map);
+		destroy_bitmap(orig_spect_panel.map);
+	}
+	if (overview != NULL)
+		destroy_bitmap(overview);
 
 	pthread_mutex_destroy(&_view_exit_mutex);
 }
 
+void view_set_spect_map(int on) { spect_map = (on != 0); }
+
 /**
  * @brief start the view thread
  * 
@@ -539,56 +781,37 @@ static void view_xtor()
  */
 pthread_t *view_start(task_par_t *task_par)
 {
-	struct sched_param mypar;
-	pthread_attr_t attr;
-
 	if (task_par != NULL)
 		tp = *task_par;
 
-	pthread_attr_init(&attr);
-	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
-	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
-	mypar.sched_priority = tp.priority;
-	pthread_attr_setschedparam(&attr, &mypar);
-	pthread_create(&tid, &attr, view_run, &tp);
+	task_start(&tid, view_run, &tp);
 
 	return &tid;
 }
 
 /**
- * @brief view thread routine
+ * @brief view task body, a period
  * 
- * @param[in] arg  argument passed to the routine(actually is not used)
- * @return void* pointer to the variable returned by the thread
- * 				(actually nothing)
+ * @param[in] arg  parameters of the task
+ * @return int 0 to go on, 1 once the view has exited
  */
-static void *view_run(void *arg)
+static int view_run(task_par_t *arg)
 {
 	char local_view_exit;
-	set_period(&tp);
 
-	while (1)
+	// manage exit
+	pthread_mutex_lock(&_view_exit_mutex);
+	local_view_exit = _view_exit;
+	pthread_mutex_unlock(&_view_exit_mutex);
+	if (local_view_exit == 1)
 	{
-		// manage exit
-		pthread_mutex_lock(&_view_exit_mutex);
-		local_view_exit = _view_exit;
-		pthread_mutex_unlock(&_view_exit_mutex);
-		if (local_view_exit == 1)
-		{
-			view_xtor();
-			pthread_exit(NULL);
-		}
-
-		player_get_player(&actual_p);
-		view_run_body();
-
-		if (deadline_miss(&tp))
-		{
-			printf("VIEW MISS");
-		}
-		wait_for_period(&tp);
+		view_xtor();
+		return 1;
 	}
-	return NULL;
+
+	player_get_player(&actual_p);
+	view_run_body();
+	return 0;
 }
 
 /**
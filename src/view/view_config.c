@@ -58,6 +58,8 @@ static text eq_gain_lbl[5] = {
 	{right, "100"},
 };
 
+static text eq_preset_lbl = {left, "Player"};
+
 static Node eqlz_nodes[EQLZP_NNOD] = {
 	// FRAME AND SEPARATORS
 	{FRAME, EQLZP_X, EQLZP_Y, EQLZP_W, EQLZP_H, WHITE, BLACK, 0, NULL},
@@ -68,11 +70,11 @@ static Node eqlz_nodes[EQLZP_NNOD] = {
 	{BAR, EQLZP_X + EQLZP_W * 0.13, EQLZP_Y + 0.1 * EQLZP_H, EQLZP_W * 0.04,
 	 EQLZP_H * 0.5, WHITE, BLACK, FILTLOW_SIG, NULL},
 	{BAR, EQLZP_X + EQLZP_W * 0.30, EQLZP_Y + 0.1 * EQLZP_H, EQLZP_W * 0.04,
-	 EQLZP_H * 0.5, WHITE, BLACK, FILTMED_SIG, NULL},
+	 EQLZP_H * 0.5, WHITE, BLACK, FILTLOW_SIG + 1, NULL},
 	{BAR, EQLZP_X + EQLZP_W * 0.47, EQLZP_Y + 0.1 * EQLZP_H, EQLZP_W * 0.04,
-	 EQLZP_H * 0.5, WHITE, BLACK, FILTMEDHIG_SIG, NULL},
+	 EQLZP_H * 0.5, WHITE, BLACK, FILTLOW_SIG + 2, NULL},
 	{BAR, EQLZP_X + EQLZP_W * 0.64, EQLZP_Y + 0.1 * EQLZP_H, EQLZP_W * 0.04,
-	 EQLZP_H * 0.5, WHITE, BLACK, FILTHIG_SIG, NULL},
+	 EQLZP_H * 0.5, WHITE, BLACK, FILTLOW_SIG + 3, NULL},
 	{BAR, EQLZP_X + EQLZP_W * 0.89, EQLZP_Y + 0.1 * EQLZP_H, EQLZP_W * 0.04,
 	 EQLZP_H * 0.5, WHITE, BLACK, VOL_SIG, NULL},
 	// SET BARS
@@ -108,6 +110,9 @@ static Node eqlz_nodes[EQLZP_NNOD] = {
 	 EQLZP_H * 0.38, WHITE, BLACK, 0, (void *)&eq_gain_lbl[3]},
 	{TEXT, EQLZP_X + EQLZP_W * 0.88, EQLZP_Y + EQLZP_H * 0.35, EQLZP_W * 0.20,
 	 EQLZP_H * 0.38, WHITE, BLACK, 0, (void *)&eq_gain_lbl[4]},
+	// PRESET, a click selects the next one
+	{TEXT, EQLZP_X + EQLZP_W * 0.01, EQLZP_Y + EQLZP_H * 0.1, EQLZP_W * 0.10,
+	 EQLZP_H * 0.5, WHITE, BLACK, PRESET_SIG, (void *)&eq_preset_lbl},
 };
 
 /*******************************************************************************
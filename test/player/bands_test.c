@@ -0,0 +1,106 @@
+/**
+ * @file bands_test.c
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief unit test of the aggregation of bins in bands
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ */
+#include <math.h>
+
+#include <criterion/criterion.h>
+
+#include "player/bands.h"
+
+#define TEST_NBIN 4097
+#define TEST_SPACING (48000.0f / 8192)
+
+static float bin[TEST_NBIN], bar[BANDS_MAX];
+
+TestSuite(bands);
+
+Test(bands, args)
+{
+	cr_expect_null(bands_new(BANDS_LINEAR, 0, TEST_NBIN, TEST_SPACING, 0, 1e3));
+	cr_expect_null(
+		bands_new(BANDS_LINEAR, BANDS_MAX + 1, TEST_NBIN, TEST_SPACING, 0, 1e3));
+	cr_expect_null(bands_new(BANDS_LOG, 10, TEST_NBIN, TEST_SPACING, 0, 1e3),
+				   "log of 0");
+	cr_expect_null(bands_new(BANDS_MEL, 10, TEST_NBIN, TEST_SPACING, 1e3, 1e2));
+}
+
+Test(bands, linear)
+{
+	int nbar = 64, spb = 64;
+	bands_t *b;
+
+	// bands of 64 bins, the bins on the edges are halved
+	b = bands_new(BANDS_LINEAR, nbar, TEST_NBIN, TEST_SPACING, 0,
+				  nbar * spb * TEST_SPACING);
+	cr_assert_not_null(b);
+	cr_expect_eq(bands_nbar(b), nbar);
+	for (int k = 0; k < TEST_NBIN; k++)
+		bin[k] = k;
+	bands_apply(b, bin, bar);
+	for (int i = 0; i < nbar; i++)
+		cr_expect_float_eq(bar[i], i * spb + spb / 2.0f, 1e-2f,
+						   "band %d", i);
+	bands_delete(b);
+}
+
+Test(bands, flat)
+{
+	const bands_scale_t scale[] = {BANDS_LINEAR, BANDS_THIRD_OCTAVE, BANDS_LOG,
+								   BANDS_MEL};
+	bands_t *b;
+
+	for (int k = 0; k < TEST_NBIN; k++)
+		bin[k] = 3;
+	// whatever the scale, a flat spectrum gives flat bands
+	for (int s = 0; s < 4; s++)
+	{
+		b = bands_new(scale[s], 200, TEST_NBIN, TEST_SPACING, 20, 20000);
+		cr_assert_not_null(b);
+		bands_apply(b, bin, bar);
+		for (int i = 0; i < bands_nbar(b); i++)
+		{
+			cr_expect_float_eq(bar[i], 3.0f, 1e-4f, "scale %d, band %d: %f", s,
+							   i, bar[i]);
+			if (i > 0)
+				cr_expect_gt(bands_freq(b, i), bands_freq(b, i - 1));
+		}
+		bands_delete(b);
+	}
+}
+
+Test(bands, third_octave)
+{
+	bands_t *b;
+
+	b = bands_new(BANDS_THIRD_OCTAVE, BANDS_MAX, TEST_NBIN, TEST_SPACING, 20,
+				  20000);
+	cr_assert_not_null(b);
+	// 20 Hz to 20 kHz, the standard 31 bands
+	cr_expect_eq(bands_nbar(b), 31);
+	cr_expect_float_eq(bands_freq(b, 17), 1000.0f, 1e-2f);
+	bands_delete(b);
+}
+
+Test(bands, tone)
+{
+	bands_t *b;
+	int k = 1000 / TEST_SPACING, peak = 0;
+
+	b = bands_new(BANDS_LOG, 100, TEST_NBIN, TEST_SPACING, 20, 20000);
+	cr_assert_not_null(b);
+	for (int i = 0; i < TEST_NBIN; i++)
+		bin[i] = (i == k);
+	bands_apply(b, bin, bar);
+	for (int i = 1; i < bands_nbar(b); i++)
+		if (bar[i] > bar[peak])
+			peak = i;
+	// the band of the bin, around 1 kHz, 7% wide
+	cr_expect_float_eq(bands_freq(b, peak), k * TEST_SPACING,
+					   0.05f * k * TEST_SPACING);
+	bands_delete(b);
+}
@@ -0,0 +1,131 @@
+/**
+ * @file cache_test.c
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief unit test of the spectra cache
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <criterion/criterion.h>
+
+#include "player/cache.h"
+#include "player/fft.h"
+#include "player/window.h"
+
+#include "wav.h"
+
+#define TEST_DIR "/tmp/cache_test"
+#define TEST_NFRAMES 48000
+#define TEST_FREQ 48000
+#define TEST_NFFT 1024
+
+static const cache_key_t key = {.nfft = TEST_NFFT,
+								.size = TEST_NFFT,
+								.hop = TEST_NFFT / 4,
+								.nbin = TEST_NFFT / 2 + 1,
+								.win = WIN_HANN,
+								.bits = 16};
+static const float mid[2] = {0.5f, 0.5f};
+
+/**
+ * @brief sample of a channel, a half scale tone on the bin 32
+ */
+static float tone(long i, int c)
+{
+	return 16384.0f * sinf(2 * M_PI * 32 * i / TEST_NFFT) * (c == 0);
+}
+
+static void init()
+{
+	cr_assert_eq(system("rm -rf " TEST_DIR " && mkdir " TEST_DIR), 0);
+	// the cache files are in the working directory
+	cr_assert_eq(chdir(TEST_DIR), 0);
+	wav_write(TEST_DIR "/a.wav", TEST_NFRAMES, 2, TEST_FREQ, 16, tone, 0);
+	fft_init(TEST_DIR "/fftw.wisdom");
+	cr_assert_eq(fft_plan(TEST_NFFT), 0);
+}
+
+TestSuite(cache, .init = init);
+
+Test(cache, build)
+{
+	static float mag[TEST_NFFT / 2 + 1], ref[TEST_NFFT / 2 + 1];
+	cache_key_t other = key;
+	cache_stats_t st0, st;
+	cache_t *c;
+
+	cache_get_stats(&st0);
+	cr_expect_null(cache_open(TEST_DIR "/a.wav", &key), "not built yet");
+	c = cache_build(TEST_DIR "/a.wav", &key, mid, 3, NULL);
+	cr_assert_not_null(c);
+	cr_expect_eq(cache_nframe(c), TEST_NFRAMES / key.hop + 1);
+	cache_get_stats(&st);
+	cr_expect_eq(st.nbuild - st0.nbuild, 1);
+	cr_expect_eq(st.nframe - st0.nframe, cache_nframe(c));
+	cr_expect_eq(st.nopen, st0.nopen, "a miss is not counted");
+	cr_expect_eq(cache_read(c, -1, mag), -1);
+	cr_expect_eq(cache_read(c, TEST_NFRAMES, mag), -1);
+	// a tone of a quarter of full scale, in the middle of the track
+	cr_assert_eq(cache_read(c, TEST_NFRAMES / 2, ref), 0);
+	cr_expect_float_eq(20 * log10f(ref[32] / CACHE_FULL_SCALE),
+					   20 * log10f(0.25f), 0.1f);
+	cr_expect_lt(ref[100], ref[32] * 1e-3f);
+	cache_close(c);
+
+	// mapped the next time, the same spectra
+	c = cache_open(TEST_DIR "/a.wav", &key);
+	cr_assert_not_null(c);
+	cache_get_stats(&st);
+	cr_expect_eq(st.nopen - st0.nopen, 1);
+	cr_assert_eq(cache_read(c, TEST_NFRAMES / 2, mag), 0);
+	for (int k = 0; k < TEST_NFFT / 2 + 1; k++)
+		cr_assert_eq(mag[k], ref[k], "bin %d", k);
+	cache_close(c);
+
+	// another analysis is another file
+	other.hop = TEST_NFFT / 2;
+	cr_expect_null(cache_open(TEST_DIR "/a.wav", &other));
+	other = key;
+	other.bits = 8;
+	cr_expect_null(cache_open(TEST_DIR "/a.wav", &other));
+	c = cache_build(TEST_DIR "/a.wav", &other, mid, 0, NULL);
+	cr_assert_not_null(c);
+	cr_assert_eq(cache_read(c, TEST_NFRAMES / 2, mag), 0);
+	// 8 bits are steps of 120 / 255 dB
+	cr_expect_float_eq(20 * log10f(mag[32] / ref[32]), 0.0f, 0.25f);
+	cache_close(c);
+}
+
+Test(cache, stop)
+{
+	volatile int stop = 1;
+	cache_key_t other = key;
+
+	other.size = TEST_NFFT / 2;
+	cr_expect_null(cache_build(TEST_DIR "/a.wav", &other, mid, 2, &stop));
+	cr_expect_null(cache_open(TEST_DIR "/a.wav", &other), "nothing written");
+	cr_expect_eq(system("ls " CACHE_DIR " | grep -qv 'spc$'"), 1 << 8,
+				 "no partial file left");
+}
+
+Test(cache, hash)
+{
+	uint64_t h1, h2;
+
+	cr_assert_eq(cache_hash(TEST_DIR "/a.wav", &h1), 0);
+	cr_assert_eq(system("cp " TEST_DIR "/a.wav " TEST_DIR "/b.wav && "
+						"printf x >> " TEST_DIR "/b.wav"),
+				 0);
+	cr_assert_eq(cache_hash(TEST_DIR "/b.wav", &h2), 0);
+	cr_expect_neq(h1, h2);
+	cr_expect_eq(cache_hash(TEST_DIR "/none.wav", &h2), -1);
+	cr_expect_null(cache_open(TEST_DIR "/b.wav", &key));
+}
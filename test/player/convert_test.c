@@ -0,0 +1,277 @@
+/**
+ * @file convert_test.c
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief unit test and benchmark of the sample conversion kernels
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+#include <criterion/criterion.h>
+
+#include "player/convert.h"
+
+#define TEST_NSAMPLES (65536 + 13) /**< not a multiple of any vector size. */
+#define BENCH_NSAMPLES (1 << 20)
+#define BENCH_ROUNDS 50
+
+static const convert_fmt_t formats[] = {CONVERT_U8,  CONVERT_U16, CONVERT_S16,
+										CONVERT_S24, CONVERT_S32, CONVERT_F32};
+#define NFORMATS (sizeof(formats) / sizeof(formats[0]))
+
+/**
+ * @brief fill a buffer with every possible 16 bit value, then random bytes
+ */
+static void fill_samples(uint8_t *buf, size_t size)
+{
+	srand(42);
+	for (size_t i = 0; i < size; i++)
+		buf[i] = (i < 65536 * 2) ? ((i / 2) >> ((i % 2) * 8)) & 0xff : rand();
+}
+
+/**
+ * @brief fill a buffer with values hard to round: ties, out of range, NaN
+ */
+static void fill_floats(float *buf, size_t size, float range)
+{
+	static const float special[] = {0.5f, -0.5f, 1.5f, -1.5f, 2.5f, -2.5f,
+									0.49999997f, -0.49999997f, 1e10f, -1e10f,
+									3e9f, -3e9f, INFINITY, -INFINITY, NAN,
+									-0.0f, 127.5f, -128.5f, 32767.5f,
+									-32768.5f, 32768.0f, -32769.0f,
+									0.5f / 256, -1.5f / 256, 32767.998f,
+									-32768.002f, 0.5f / 65536, 2.5f / 65536};
+	size_t nspecial = sizeof(special) / sizeof(special[0]);
+
+	srand(42);
+	for (size_t i = 0; i < size; i++)
+	{
+		if (i < nspecial)
+			buf[i] = special[i];
+		else
+			buf[i] = (((float)rand() / RAND_MAX) * 2.2f - 1.1f) * range;
+	}
+}
+
+TestSuite(convert);
+
+Test(convert, select)
+{
+	cr_expect_not_null(convert_select(CONVERT_U8));
+	cr_expect_not_null(convert_select(CONVERT_U16));
+	cr_expect_not_null(convert_select(CONVERT_S16));
+	cr_expect_not_null(convert_select(CONVERT_S24));
+	cr_expect_not_null(convert_select(CONVERT_S32));
+	cr_expect_not_null(convert_select(CONVERT_F32));
+	cr_expect_null(convert_select(CONVERT_NFMT), "not a format");
+	cr_expect_not_null(convert_get(CONVERT_S16, CONVERT_SCALAR));
+}
+
+Test(convert, signed)
+{
+	// little endian 0x7fff, 0x8000, 0xffff, 0x0000
+	static const uint8_t s[] = {0xff, 0x7f, 0x00, 0x80, 0xff, 0xff, 0, 0};
+	float u16[4], s16[4];
+
+	convert_select(CONVERT_U16)->to_float(s, u16, 4);
+	convert_select(CONVERT_S16)->to_float(s, s16, 4);
+	cr_expect_float_eq(u16[0], -1.0f, 0.0f);
+	cr_expect_float_eq(u16[1], 0.0f, 0.0f);
+	cr_expect_float_eq(s16[0], 32767.0f, 0.0f);
+	cr_expect_float_eq(s16[1], -32768.0f, 0.0f);
+	cr_expect_float_eq(s16[2], -1.0f, 0.0f);
+	cr_expect_float_eq(s16[3], 0.0f, 0.0f);
+}
+
+Test(convert, high_res)
+{
+	// little endian 24 bits 0x7fffff, 0x800000, 0xffffff, 0x000100
+	static const uint8_t s24[] = {0xff, 0xff, 0x7f, 0, 0, 0x80,
+								  0xff, 0xff, 0xff, 0, 0x01, 0};
+	// little endian 32 bits 0x7fffffff, 0x80000000, 0xffffffff, 0x00010000
+	static const uint8_t s32[] = {0xff, 0xff, 0xff, 0x7f, 0, 0, 0, 0x80,
+								  0xff, 0xff, 0xff, 0xff, 0, 0, 0x01, 0};
+	static const float f32[] = {1.0f, -1.0f, 0.25f, -1.5f};
+	float f[8];
+	uint8_t back[16];
+
+	for (int isa = CONVERT_SCALAR; isa < CONVERT_NISA; isa++)
+	{
+		const convert_t *k24 = convert_get(CONVERT_S24, isa),
+						*k32 = convert_get(CONVERT_S32, isa),
+						*kf = convert_get(CONVERT_F32, isa);
+
+		if (k24 == NULL)
+			continue;
+		k24->to_float(s24, f, 4);
+		cr_expect_float_eq(f[0], 32767.99609375f, 0.0f, "%s", k24->name);
+		cr_expect_float_eq(f[1], -32768.0f, 0.0f, "%s", k24->name);
+		cr_expect_float_eq(f[2], -1.0f / 256, 0.0f, "%s", k24->name);
+		cr_expect_float_eq(f[3], 1.0f, 0.0f, "%s", k24->name);
+		k32->to_float(s32, f, 4);
+		cr_expect_float_eq(f[0], 32768.0f, 0.0f, "%s", k32->name);
+		cr_expect_float_eq(f[1], -32768.0f, 0.0f, "%s", k32->name);
+		cr_expect_float_eq(f[3], 1.0f, 0.0f, "%s", k32->name);
+		// the greatest value is rounded up, it saturates back
+		k32->from_float(f, back, 4);
+		cr_expect_arr_eq(back, s32, 8, "%s", k32->name);
+		kf->to_float(f32, f, 4);
+		cr_expect_float_eq(f[0], 32768.0f, 0.0f, "%s", kf->name);
+		cr_expect_float_eq(f[1], -32768.0f, 0.0f, "%s", kf->name);
+		cr_expect_float_eq(f[2], 8192.0f, 0.0f, "%s", kf->name);
+		cr_expect_float_eq(f[3], -49152.0f, 0.0f, "%s", kf->name);
+		kf->from_float(f, back, 4);
+		cr_expect_arr_eq(back, f32, 16, "%s round trip", kf->name);
+	}
+}
+
+Test(convert, bit_exact)
+{
+	static uint8_t samples[TEST_NSAMPLES * 4];
+	static float ref_f[TEST_NSAMPLES], got_f[TEST_NSAMPLES];
+	static uint8_t ref_s[TEST_NSAMPLES * 4], got_s[TEST_NSAMPLES * 4];
+	static float floats[TEST_NSAMPLES];
+
+	fill_samples(samples, sizeof(samples));
+	for (unsigned int f = 0; f < NFORMATS; f++)
+	{
+		const convert_t *ref = convert_get(formats[f], CONVERT_SCALAR);
+		size_t ssize = TEST_NSAMPLES * ref->bits / 8;
+
+		fill_floats(floats, TEST_NSAMPLES, (ref->bits == 8) ? 128 : 32768);
+		ref->to_float(samples, ref_f, TEST_NSAMPLES);
+		ref->from_float(floats, ref_s, TEST_NSAMPLES);
+		for (int isa = CONVERT_SSE2; isa < CONVERT_NISA; isa++)
+		{
+			const convert_t *k = convert_get(formats[f], isa);
+
+			if (k == NULL)
+				continue;
+			// every length up to 40 exercises the scalar tails
+			for (unsigned int n = 0; n < 40; n++)
+			{
+				memset(got_f, 0, sizeof(got_f));
+				k->to_float(samples, got_f, n);
+				cr_assert_arr_eq(got_f, ref_f, n * sizeof(float),
+								 "%s to float, %u samples", k->name, n);
+			}
+			k->to_float(samples, got_f, TEST_NSAMPLES);
+			cr_assert_arr_eq(got_f, ref_f, sizeof(got_f),
+							 "%s to float", k->name);
+			k->from_float(floats, got_s, TEST_NSAMPLES);
+			cr_assert_arr_eq(got_s, ref_s, ssize, "%s from float", k->name);
+		}
+	}
+}
+
+Test(convert, round_trip)
+{
+	static uint8_t samples[TEST_NSAMPLES * 4], back[TEST_NSAMPLES * 4];
+	static float buf[TEST_NSAMPLES];
+
+	fill_samples(samples, sizeof(samples));
+	for (unsigned int f = 0; f < NFORMATS; f++)
+	{
+		const convert_t *k = convert_select(formats[f]);
+
+		// floats have 24 bits of precision, random bytes are not all floats
+		if (formats[f] == CONVERT_S32 || formats[f] == CONVERT_F32)
+			continue;
+		k->to_float(samples, buf, TEST_NSAMPLES);
+		k->from_float(buf, back, TEST_NSAMPLES);
+		cr_assert_arr_eq(back, samples, TEST_NSAMPLES * k->bits / 8,
+						 "%s round trip", k->name);
+	}
+}
+
+Test(convert, benchmark)
+{
+	static uint8_t samples[BENCH_NSAMPLES * 4];
+	static float buf[BENCH_NSAMPLES];
+	struct timespec t1, t2;
+	double sec;
+
+	fill_samples(samples, sizeof(samples));
+	for (unsigned int f = 0; f < NFORMATS; f++)
+	{
+		for (int isa = CONVERT_SCALAR; isa < CONVERT_NISA; isa++)
+		{
+			const convert_t *k = convert_get(formats[f], isa);
+
+			if (k == NULL)
+				continue;
+			clock_gettime(CLOCK_MONOTONIC, &t1);
+			for (int r = 0; r < BENCH_ROUNDS; r++)
+				k->to_float(samples, buf, BENCH_NSAMPLES);
+			clock_gettime(CLOCK_MONOTONIC, &t2);
+			sec = (t2.tv_sec - t1.tv_sec) + (t2.tv_nsec - t1.tv_nsec) / 1e9;
+			printf("%-12s to float:   %8.1f Msamples/s\n", k->name,
+				   BENCH_ROUNDS * (double)BENCH_NSAMPLES / sec / 1e6);
+
+			clock_gettime(CLOCK_MONOTONIC, &t1);
+			for (int r = 0; r < BENCH_ROUNDS; r++)
+				k->from_float(buf, samples, BENCH_NSAMPLES);
+			clock_gettime(CLOCK_MONOTONIC, &t2);
+			sec = (t2.tv_sec - t1.tv_sec) + (t2.tv_nsec - t1.tv_nsec) / 1e9;
+			printf("%-12s from float: %8.1f Msamples/s\n", k->name,
+				   BENCH_ROUNDS * (double)BENCH_NSAMPLES / sec / 1e6);
+		}
+	}
+}
+
+Test(convert, interleave)
+{
+	static float frames[TEST_NSAMPLES], back[TEST_NSAMPLES];
+	static float ref[CONVERT_MAX_NCH][TEST_NSAMPLES];
+	static float got[CONVERT_MAX_NCH][TEST_NSAMPLES];
+	float *ref_ch[CONVERT_MAX_NCH], *got_ch[CONVERT_MAX_NCH];
+	unsigned int count;
+
+	fill_floats(frames, TEST_NSAMPLES, 32768);
+	for (int c = 0; c < CONVERT_MAX_NCH; c++)
+	{
+		ref_ch[c] = ref[c];
+		got_ch[c] = got[c];
+	}
+	cr_expect_null(convert_ilv_select(0));
+	cr_expect_null(convert_ilv_select(CONVERT_MAX_NCH + 1));
+	for (int nch = 1; nch <= CONVERT_MAX_NCH; nch++)
+	{
+		const convert_ilv_t *s = convert_ilv_get(nch, CONVERT_SCALAR);
+
+		count = TEST_NSAMPLES / nch;
+		s->split(frames, ref_ch, nch, count);
+		for (unsigned int j = 0; j < count; j++)
+			for (int c = 0; c < nch; c++)
+				cr_assert_eq(memcmp(&ref[c][j], &frames[j * nch + c], 4), 0);
+		for (int isa = CONVERT_SCALAR; isa < CONVERT_NISA; isa++)
+		{
+			const convert_ilv_t *k = convert_ilv_get(nch, isa);
+
+			if (k == NULL)
+				continue;
+			// every length up to 40 exercises the scalar tails
+			for (unsigned int n = 0; n < 40; n++)
+			{
+				k->split(frames, got_ch, nch, n);
+				for (int c = 0; c < nch; c++)
+					cr_assert_arr_eq(got[c], ref[c], n * sizeof(float),
+									 "%s split, %d channels, %u frames",
+									 k->name, nch, n);
+			}
+			k->split(frames, got_ch, nch, count);
+			memset(back, 0, sizeof(back));
+			k->merge((const float *const *)got_ch, back, nch, count);
+			cr_assert_arr_eq(back, frames, count * nch * sizeof(float),
+							 "%s round trip, %d channels", k->name, nch);
+		}
+	}
+}
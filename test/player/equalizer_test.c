@@ -14,6 +14,7 @@
 #include <math.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <time.h>
 
 #include <criterion/criterion.h>
 
@@ -136,7 +137,7 @@ TestSuite(unit);
 
 Test(unit, equalizer_set_gain)
 {
-	// int equalizer_set_gain(int filt, float gain)
+	// int equalizer_set_gain(int filt, float gain, float *set)
 	typedef struct
 	{
 		int filt;
@@ -147,6 +148,7 @@ Test(unit, equalizer_set_gain)
 		char *name;
 		args args;
 		float wants;
+		int ret;
 	} testcase;
 	testcase testcases[] = {
 		{
@@ -155,7 +157,8 @@ Test(unit, equalizer_set_gain)
 				.filt = -1,
 				.gain = 0.0,
 			},
-			.wants = -EQ_FILT_MAX_GAIN - 1,
+			.wants = 0.0,
+			.ret = -1,
 		},
 		{
 			.name = "filt out of bound EQ_NFILT",
@@ -163,7 +166,8 @@ Test(unit, equalizer_set_gain)
 				.filt = EQ_NFILT,
 				.gain = 0.0,
 			},
-			.wants = -EQ_FILT_MAX_GAIN - 1,
+			.wants = 0.0,
+			.ret = -1,
 		},
 		{
 			.name = "gain out of bound EQ_FILT_MAX_GAIN + 1",
@@ -229,7 +233,9 @@ Test(unit, equalizer_set_gain)
 	int i = 0;
 	while (strcmp(t->name, "") != 0)
 	{
-		float got = equalizer_set_gain(t->args.filt, t->args.gain);
+		float got = 0.0;
+		int ret = equalizer_set_gain(t->args.filt, t->args.gain, &got);
+		cr_expect_eq(ret, t->ret, "%s: returned %d", t->name, ret);
 		cr_expect_float_eq(got, t->wants, 0.0,
 						   "%s: equalizer_set_gain(%d, %f);"
 						   "\texpected: %f got:%f",
@@ -301,7 +307,7 @@ Test(signal, equalize_modify)
 
 	for (int i = 0; i < EQ_NFILT; i++)
 	{
-		equalizer_set_gain(i, EQ_FILT_MAX_GAIN);
+		equalizer_set_gain(i, EQ_FILT_MAX_GAIN, NULL);
 	}
 	for (int i = 0; i < EQ_NFILT; i++)
 	{
@@ -337,16 +343,16 @@ Test(signal, band_isolation)
 		signal_new(1, 10000, 44100, 100),
 	};
 
-	equalizer_init(44100);
-
 	for (int i = 0; i < EQ_NFILT; i++)
 	{
+		// each signal is a new stream, gain changes within a stream ramp
+		equalizer_init(44100);
 		for (int j = 0; j < EQ_NFILT; j++)
 		{
 			if (i == j)
-				equalizer_set_gain(j, 0);
+				equalizer_set_gain(j, 0, NULL);
 			else
-				equalizer_set_gain(j, EQ_FILT_MAX_GAIN);
+				equalizer_set_gain(j, EQ_FILT_MAX_GAIN, NULL);
 		}
 		equalizer_equalize((*amplified_signals[i]).data,
 						   (*amplified_signals[i]).size);
@@ -416,9 +422,9 @@ Test(signal, band_gain)
 		for (int j = 0; j < EQ_NFILT; j++)
 		{
 			if (i == j)
-				equalizer_set_gain(j, EQ_FILT_MAX_GAIN);
+				equalizer_set_gain(j, EQ_FILT_MAX_GAIN, NULL);
 			else
-				equalizer_set_gain(j, 0);
+				equalizer_set_gain(j, 0, NULL);
 		}
 		equalizer_equalize((*amplified_signals[i]).data,
 						   (*amplified_signals[i]).size);
@@ -427,9 +433,9 @@ Test(signal, band_gain)
 		for (int j = 0; j < EQ_NFILT; j++)
 		{
 			if (i == j)
-				equalizer_set_gain(j, 0);
+				equalizer_set_gain(j, 0, NULL);
 			else
-				equalizer_set_gain(j, EQ_FILT_MAX_GAIN);
+				equalizer_set_gain(j, EQ_FILT_MAX_GAIN, NULL);
 		}
 		equalizer_equalize((*isolated_signals[i]).data,
 						   (*isolated_signals[i]).size);
@@ -451,4 +457,471 @@ Test(signal, band_gain)
 		signal_delete(amplified_signals[i]);
 		signal_delete(isolated_signals[i]);
 	}
-}
\ No newline at end of file
+}
+/**
+ * @brief reference peakingEQ filter, in double precision and direct form I,
+ * as the equalizer filtered before the biquad cascade.
+ */
+typedef struct
+{
+	double b0, b1, b2, a1, a2;
+	double xmem1, xmem2, ymem1, ymem2;
+} ref_filter_t;
+
+static void ref_filter_init(ref_filter_t *f, double freq, double sampling_freq,
+							double gain)
+{
+	double A, w0, a, a0;
+
+	A = pow(10, gain / 40);
+	w0 = 2 * M_PI * freq / sampling_freq;
+	a = sin(w0) * sinh(log(2.0) / 2 * EQ_FILT_BW * w0 / sin(w0));
+	a0 = 1 + a / A;
+	f->b0 = (1 + a * A) / a0;
+	f->b1 = -2 * cos(w0) / a0;
+	f->b2 = (1 - a * A) / a0;
+	f->a1 = -2 * cos(w0) / a0;
+	f->a2 = (1 - a / A) / a0;
+	f->xmem1 = f->xmem2 = f->ymem1 = f->ymem2 = 0;
+}
+
+static void ref_filter_filtb(ref_filter_t *f, float buf[], unsigned int count)
+{
+	double y;
+
+	for (unsigned int j = 0; j < count; j++)
+	{
+		y = f->b0 * buf[j] + f->b1 * f->xmem1 + f->b2 * f->xmem2 -
+			f->a1 * f->ymem1 - f->a2 * f->ymem2;
+		f->xmem2 = f->xmem1;
+		f->xmem1 = buf[j];
+		f->ymem2 = f->ymem1;
+		f->ymem1 = y;
+		buf[j] = y;
+	}
+}
+
+/**
+ * @brief white noise in the 16 bit range
+ */
+static signal_t *noise_new(float amplitude, float sampling_freq,
+						   float duration)
+{
+	signal_t *signal = signal_new(0, 0, sampling_freq, duration);
+
+	srand(42);
+	for (int i = 0; i < (*signal).size; i++)
+		(*signal).data[i] = amplitude * (2.0f * rand() / RAND_MAX - 1.0f);
+	return signal;
+}
+
+static const float reference_gains[EQ_NFILT] = {12.0f, -6.0f,
+												EQ_FILT_MAX_GAIN,
+												-EQ_FILT_MAX_GAIN};
+
+Test(signal, cascade_reference)
+{
+	ref_filter_t ref[EQ_NFILT];
+	signal_t *expected = noise_new(16384, 44100, 1000);
+	signal_t *got = signal_clone(expected);
+	float max_err = 0, peak = 0;
+
+	equalizer_init(44100);
+	for (int i = 0; i < EQ_NFILT; i++)
+	{
+		equalizer_set_gain(i, reference_gains[i], NULL);
+		ref_filter_init(&ref[i], equalizer_freq[i], 44100, reference_gains[i]);
+		ref_filter_filtb(&ref[i], (*expected).data, (*expected).size);
+	}
+	equalizer_equalize((*got).data, (*got).size);
+	for (int k = 0; k < (*got).size; k++)
+	{
+		float err = fabsf((*got).data[k] - (*expected).data[k]);
+		if (err > max_err)
+			max_err = err;
+		if (fabsf((*expected).data[k]) > peak)
+			peak = fabsf((*expected).data[k]);
+	}
+	// single precision, error must stay 80 dB below the peak
+	cr_assert_lt(max_err, peak * 1e-4f,
+				 "cascade differs from reference: %f, peak %f", max_err, peak);
+	signal_delete(expected);
+	signal_delete(got);
+}
+
+Test(signal, cascade_chunks)
+{
+	// filtering in chunks of any size must give exactly the same output
+	const unsigned int chunks[] = {1, 2, 3, 4, 5, 7, 64, 1000, 4093};
+	signal_t *whole = noise_new(16384, 44100, 200);
+	signal_t *chunked = signal_clone(whole);
+	unsigned int off = 0, c = 0, n;
+
+	equalizer_init(44100);
+	for (int i = 0; i < EQ_NFILT; i++)
+		equalizer_set_gain(i, reference_gains[i], NULL);
+	equalizer_equalize((*whole).data, (*whole).size);
+
+	equalizer_init(44100);
+	for (int i = 0; i < EQ_NFILT; i++)
+		equalizer_set_gain(i, reference_gains[i], NULL);
+	while (off < (*chunked).size)
+	{
+		n = chunks[c++ % (sizeof(chunks) / sizeof(chunks[0]))];
+		if (n > (*chunked).size - off)
+			n = (*chunked).size - off;
+		equalizer_equalize(&(*chunked).data[off], n);
+		off += n;
+	}
+	cr_assert_arr_eq((*chunked).data, (*whole).data,
+					 (*whole).size * sizeof(float),
+					 "chunked equalization differs");
+	signal_delete(whole);
+	signal_delete(chunked);
+}
+
+Test(signal, benchmark)
+{
+	const int rounds = 20;
+	ref_filter_t ref[EQ_NFILT];
+	signal_t *s = noise_new(16384, 44100, 10000);
+	signal_t *right = signal_clone(s);
+	float *const ch[2] = {(*s).data, (*right).data};
+	struct timespec t1, t2;
+	double ref_sec, sec;
+
+	for (int i = 0; i < EQ_NFILT; i++)
+		ref_filter_init(&ref[i], equalizer_freq[i], 44100, reference_gains[i]);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	for (int r = 0; r < rounds; r++)
+		for (int i = 0; i < EQ_NFILT; i++)
+			ref_filter_filtb(&ref[i], (*s).data, (*s).size);
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+	ref_sec = (t2.tv_sec - t1.tv_sec) + (t2.tv_nsec - t1.tv_nsec) / 1e9;
+
+	equalizer_init(44100);
+	for (int i = 0; i < EQ_NFILT; i++)
+		equalizer_set_gain(i, reference_gains[i], NULL);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	for (int r = 0; r < rounds; r++)
+		equalizer_equalize((*s).data, (*s).size);
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+	sec = (t2.tv_sec - t1.tv_sec) + (t2.tv_nsec - t1.tv_nsec) / 1e9;
+
+	printf("equalizer reference: %8.1f Msamples/s\n",
+		   rounds * (double)(*s).size / ref_sec / 1e6);
+	printf("equalizer cascade:   %8.1f Msamples/s (x%.1f)\n",
+		   rounds * (double)(*s).size / sec / 1e6, ref_sec / sec);
+
+	// a stereo track, as played: the reference filters each channel
+	equalizer_set_nch(2);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	for (int r = 0; r < rounds; r++)
+		equalizer_equalize_ch(ch, (*s).size);
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+	sec = (t2.tv_sec - t1.tv_sec) + (t2.tv_nsec - t1.tv_nsec) / 1e9;
+	printf("equalizer stereo:    %8.1f Msamples/s (x%.1f)\n",
+		   2 * rounds * (double)(*s).size / sec / 1e6, 2 * ref_sec / sec);
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+	// where the SIMD cascade is built
+	cr_expect_geq(2 * ref_sec / sec, 4, "stereo cascade only x%.1f faster",
+				  2 * ref_sec / sec);
+#endif
+	equalizer_set_nch(1);
+	signal_delete(right);
+	signal_delete(s);
+}
+
+/**
+ * @brief gain in dB of the equalizer on a sine, after the transient
+ */
+static float sine_gain(float freq, int sampling_freq)
+{
+	signal_t *s = signal_new(1000, freq, sampling_freq, 500);
+	float peak = 0;
+
+	equalizer_equalize((*s).data, (*s).size);
+	for (int k = (*s).size / 2; k < (*s).size; k++)
+		if (fabsf((*s).data[k]) > peak)
+			peak = fabsf((*s).data[k]);
+	signal_delete(s);
+	return 20 * log10f(peak / 1000);
+}
+
+Test(unit, equalizer_layout)
+{
+	eq_band_t band = {.type = EQ_PEAK, .freq = 1000, .q = 1, .gain = 0};
+	eq_band_t bands[EQ_MAX_NFILT + 1];
+	float gain;
+
+	equalizer_init(44100);
+	cr_expect_eq(equalizer_get_nband(), EQ_NFILT);
+	cr_expect_eq(equalizer_set_preset(EQ_PRESET_ISO10), 10);
+	cr_expect_eq(equalizer_set_preset(EQ_PRESET_ISO31), 31);
+	cr_expect_eq(equalizer_get_nband(), 31);
+	cr_expect_eq(equalizer_set_gain(30, 3.0f, &gain), 0);
+	cr_expect_float_eq(gain, 3.0f, 0.0);
+	cr_expect_eq(equalizer_set_gain(31, 3.0f, NULL), -1);
+
+	band.q = 0;
+	cr_expect_eq(equalizer_set_band(0, &band), -1, "Q must be positive");
+	band.q = 1;
+	band.type = EQ_NTYPE;
+	cr_expect_eq(equalizer_set_band(0, &band), -1, "invalid type");
+	band.type = EQ_NOTCH;
+	cr_expect_eq(equalizer_set_band(31, &band), -1, "out of bound");
+	cr_expect_eq(equalizer_set_band(0, &band), 0);
+	cr_expect_eq(equalizer_get_band(0, &bands[0]), 0);
+	cr_expect_eq(bands[0].type, EQ_NOTCH);
+
+	for (int i = 0; i <= EQ_MAX_NFILT; i++)
+		bands[i] = band;
+	cr_expect_eq(equalizer_set_layout(bands, EQ_MAX_NFILT + 1), -1);
+	cr_expect_eq(equalizer_set_layout(bands, 2), 0);
+	cr_expect_eq(equalizer_get_nband(), 2);
+}
+
+Test(signal, band_types)
+{
+	typedef struct
+	{
+		char *name;
+		eq_band_t band;
+		float freq;
+		float wants; /**< dB */
+		float tol;	 /**< dB */
+	} testcase;
+	testcase testcases[] = {
+		{"peak center", {EQ_PEAK, 1000, 2, 12}, 1000, 12, 0.2f},
+		{"peak far", {EQ_PEAK, 1000, 2, 12}, 10000, 0, 0.2f},
+		{"low shelf below", {EQ_LOW_SHELF, 500, M_SQRT1_2, -9}, 50, -9, 0.2f},
+		{"low shelf above", {EQ_LOW_SHELF, 500, M_SQRT1_2, -9}, 8000, 0, 0.2f},
+		{"high shelf above", {EQ_HIGH_SHELF, 2000, M_SQRT1_2, 6}, 15000, 6,
+		 0.2f},
+		{"high shelf below", {EQ_HIGH_SHELF, 2000, M_SQRT1_2, 6}, 100, 0,
+		 0.2f},
+		{"low pass corner", {EQ_LOW_PASS, 1000, M_SQRT1_2, 0}, 1000, -3, 0.2f},
+		{"low pass stop", {EQ_LOW_PASS, 1000, M_SQRT1_2, 0}, 10000, -43, 2},
+		{"high pass corner", {EQ_HIGH_PASS, 1000, M_SQRT1_2, 0}, 1000, -3,
+		 0.2f},
+		{"high pass stop", {EQ_HIGH_PASS, 1000, M_SQRT1_2, 0}, 100, -40, 2},
+		{"notch center", {EQ_NOTCH, 1000, 1, 0}, 1000, -60, 20},
+		{"flat above nyquist", {EQ_PEAK, 30000, 1, 12}, 1000, 0, 0.01f},
+	};
+
+	for (unsigned int i = 0; i < sizeof(testcases) / sizeof(testcases[0]); i++)
+	{
+		testcase *t = &testcases[i];
+		float got;
+
+		equalizer_init(44100);
+		cr_assert_eq(equalizer_set_layout(&t->band, 1), 0, "%s", t->name);
+		got = sine_gain(t->freq, 44100);
+		cr_expect(fabsf(got - t->wants) <= t->tol,
+				  "%s: expected %f dB got %f dB", t->name, t->wants, got);
+	}
+}
+
+Test(signal, iso31_band)
+{
+	equalizer_init(44100);
+	equalizer_set_preset(EQ_PRESET_ISO31);
+	equalizer_set_gain(17, 12.0f, NULL); // 1 kHz
+	cr_expect(fabsf(sine_gain(1000, 44100) - 12) < 0.2f);
+	equalizer_init(44100);
+	equalizer_set_preset(EQ_PRESET_ISO31);
+	equalizer_set_gain(17, 12.0f, NULL);
+	// two 1/3 octaves apart, the band must be almost flat
+	cr_expect(sine_gain(1600, 44100) < 3.0f);
+}
+
+Test(signal, benchmark_iso31)
+{
+	const int rounds = 5;
+	signal_t *s = noise_new(16384, 44100, 10000);
+	struct timespec t1, t2;
+	double sec;
+
+	equalizer_init(44100);
+	equalizer_set_preset(EQ_PRESET_ISO31);
+	for (int i = 0; i < 31; i++)
+		equalizer_set_gain(i, (i % 2) ? 6.0f : -6.0f, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	for (int r = 0; r < rounds; r++)
+		equalizer_equalize((*s).data, (*s).size);
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+	sec = (t2.tv_sec - t1.tv_sec) + (t2.tv_nsec - t1.tv_nsec) / 1e9;
+	printf("equalizer iso31:     %8.1f Msamples/s (%.0fx realtime)\n",
+		   rounds * (double)(*s).size / sec / 1e6,
+		   rounds * 10.0 / sec);
+	signal_delete(s);
+}
+
+/**
+ * @brief biggest difference between consecutive samples
+ */
+static float max_step(const float *data, int from, int to)
+{
+	float step = 0;
+
+	for (int k = from + 1; k < to; k++)
+		if (fabsf(data[k] - data[k - 1]) > step)
+			step = fabsf(data[k] - data[k - 1]);
+	return step;
+}
+
+Test(signal, gain_ramp)
+{
+	// a 250 Hz sine through the low band, boosted halfway
+	signal_t *s = signal_new(1000, 250, 44100, 400);
+	int half = (*s).size / 2;
+	float amplitude, bound, got;
+
+	equalizer_init(44100);
+	equalizer_equalize((*s).data, half);
+	equalizer_set_gain(0, EQ_FILT_MAX_GAIN, NULL);
+	equalizer_equalize(&(*s).data[half], (*s).size - half);
+	// no sample can move more than a sine of the final amplitude does
+	amplitude = 1000 * powf(10, EQ_FILT_MAX_GAIN / 20);
+	bound = amplitude * 2 * M_PI * 250 / 44100;
+	got = max_step((*s).data, half - 1, half + EQ_RAMP_LEN);
+	cr_expect_leq(got, bound * 1.01f, "click at the gain change: %f, max %f",
+				  got, bound);
+	// and the boost is complete soon after the ramp
+	got = 0;
+	for (int k = (*s).size - 44100 / 250; k < (*s).size; k++)
+		if (fabsf((*s).data[k]) > got)
+			got = fabsf((*s).data[k]);
+	cr_expect(fabsf(20 * log10f(got / 1000) - EQ_FILT_MAX_GAIN) < 0.2f,
+			  "gain after ramp %f dB", 20 * log10f(got / 1000));
+	signal_delete(s);
+}
+
+Test(signal, ramp_chunks)
+{
+	// a ramp must not depend on how the stream is split
+	const unsigned int chunks[] = {1, 5, 31, 33, 64, 1000};
+	signal_t *whole = noise_new(16384, 44100, 200);
+	signal_t *chunked = signal_clone(whole);
+	unsigned int change = 3000, off = 0, c = 0, n;
+
+	equalizer_init(44100);
+	equalizer_equalize((*whole).data, change);
+	for (int i = 0; i < EQ_NFILT; i++)
+		equalizer_set_gain(i, reference_gains[i], NULL);
+	equalizer_equalize(&(*whole).data[change], (*whole).size - change);
+
+	equalizer_init(44100);
+	while (off < (*chunked).size)
+	{
+		if (off == change)
+			for (int i = 0; i < EQ_NFILT; i++)
+				equalizer_set_gain(i, reference_gains[i], NULL);
+		n = chunks[c++ % (sizeof(chunks) / sizeof(chunks[0]))];
+		if (off < change && n > change - off)
+			n = change - off;
+		if (n > (*chunked).size - off)
+			n = (*chunked).size - off;
+		equalizer_equalize(&(*chunked).data[off], n);
+		off += n;
+	}
+	cr_assert_arr_eq((*chunked).data, (*whole).data,
+					 (*whole).size * sizeof(float),
+					 "chunked ramp differs");
+	signal_delete(whole);
+	signal_delete(chunked);
+}
+
+Test(signal, channels)
+{
+	// each channel must be filtered as if it was alone
+	signal_t *mono[3], *multi[3];
+	float *buf[3];
+
+	for (int ch = 0; ch < 3; ch++)
+	{
+		mono[ch] = noise_new(16384 >> ch, 44100, 200);
+		multi[ch] = signal_clone(mono[ch]);
+		buf[ch] = (*multi[ch]).data;
+	}
+	for (int ch = 0; ch < 3; ch++)
+	{
+		equalizer_init(44100);
+		for (int i = 0; i < EQ_NFILT; i++)
+			equalizer_set_gain(i, reference_gains[i], NULL);
+		equalizer_equalize((*mono[ch]).data, (*mono[ch]).size);
+	}
+	equalizer_init(44100);
+	cr_assert_eq(equalizer_set_nch(3), 0);
+	for (int i = 0; i < EQ_NFILT; i++)
+		equalizer_set_gain(i, reference_gains[i], NULL);
+	cr_expect_eq(equalizer_equalize(buf[0], 16), -1, "not a mono equalizer");
+	// blocks of any size, even shorter than the pipeline
+	for (int off = 0, n = 0; off < (*mono[0]).size; off += n)
+	{
+		n = (off < 1000) ? 1000 : 3;
+		if (n > (*mono[0]).size - off)
+			n = (*mono[0]).size - off;
+		equalizer_equalize_ch(buf, n);
+		for (int ch = 0; ch < 3; ch++)
+			buf[ch] += n;
+	}
+	for (int ch = 0; ch < 3; ch++)
+	{
+		cr_assert_arr_eq((*multi[ch]).data, (*mono[ch]).data,
+						 (*mono[ch]).size * sizeof(float),
+						 "channel %d differs", ch);
+		signal_delete(mono[ch]);
+		signal_delete(multi[ch]);
+	}
+	cr_expect_eq(equalizer_set_nch(EQ_MAX_NCH + 1), -1);
+}
+
+Test(signal, benchmark_stereo)
+{
+	const int rounds = 20;
+	signal_t *l = noise_new(16384, 44100, 10000), *r = signal_clone(l);
+	float *buf[2] = {(*l).data, (*r).data};
+	struct timespec t1, t2;
+	double mono, stereo;
+
+	equalizer_init(44100);
+	for (int i = 0; i < EQ_NFILT; i++)
+		equalizer_set_gain(i, reference_gains[i], NULL);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	for (int j = 0; j < rounds; j++)
+		equalizer_equalize((*l).data, (*l).size);
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+	mono = (t2.tv_sec - t1.tv_sec) + (t2.tv_nsec - t1.tv_nsec) / 1e9;
+
+	equalizer_set_nch(2);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	for (int j = 0; j < rounds; j++)
+		equalizer_equalize_ch(buf, (*l).size);
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+	stereo = (t2.tv_sec - t1.tv_sec) + (t2.tv_nsec - t1.tv_nsec) / 1e9;
+	printf("equalizer stereo:    %8.1f Mframes/s (x%.2f the time of mono)\n",
+		   rounds * (double)(*l).size / stereo / 1e6, stereo / mono);
+	signal_delete(l);
+	signal_delete(r);
+}
+
+Test(signal, settle)
+{
+	static float buf[1 << 16];
+	long n;
+
+	equalizer_init(44100);
+	for (int i = 0; i < EQ_NFILT; i++)
+		equalizer_set_gain(i, reference_gains[i], NULL);
+	n = equalizer_settle(1e-4f);
+	cr_assert_gt(n, 0);
+	cr_assert_lt(n, 1 << 16);
+	cr_expect_eq(equalizer_settle(1.0f), 0);
+	cr_expect_eq(equalizer_settle(0.0f), -1);
+	// the impulse response has faded after n samples
+	buf[0] = 1.0f;
+	equalizer_equalize(buf, 1 << 16);
+	for (long i = n; i < 1 << 16; i++)
+		cr_assert_lt(fabsf(buf[i]), 1e-4f * EQ_NFILT * 10, "sample %ld", i);
+}
@@ -0,0 +1,102 @@
+/**
+ * @file evq_test.c
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief unit test of the queue of events
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ */
+#include <pthread.h>
+#include <sched.h>
+
+#include <criterion/criterion.h>
+
+#include "player/evq.h"
+
+#define TEST_LEN 16
+#define TEST_NPROD 4
+#define TEST_NEVT 50000
+
+typedef struct
+{
+	int prod;
+	float val;
+} test_evt_t;
+
+static evq_t q;
+
+TestSuite(evq);
+
+Test(evq, args)
+{
+	cr_expect_eq(evq_init(&q, 0, sizeof(test_evt_t)), -1);
+	cr_expect_eq(evq_init(&q, 12, sizeof(test_evt_t)), -1);
+	cr_expect_eq(evq_init(&q, 16, 0), -1);
+}
+
+Test(evq, fifo)
+{
+	test_evt_t e;
+
+	cr_assert_eq(evq_init(&q, TEST_LEN, sizeof(test_evt_t)), 0);
+	cr_expect_eq(evq_pop(&q, &e), -1);
+	// a few laps of the ring
+	for (int lap = 0; lap < 3; lap++)
+	{
+		for (int i = 0; i < TEST_LEN; i++)
+		{
+			e = (test_evt_t){lap, i};
+			cr_assert_eq(evq_push(&q, &e), 0);
+		}
+		e = (test_evt_t){-1, -1};
+		cr_expect_eq(evq_push(&q, &e), -1, "full");
+		for (int i = 0; i < TEST_LEN; i++)
+		{
+			cr_assert_eq(evq_pop(&q, &e), 0);
+			cr_expect_eq(e.prod, lap);
+			cr_expect_eq(e.val, i);
+		}
+		cr_expect_eq(evq_pop(&q, &e), -1, "empty");
+	}
+	cr_expect_eq(evq_get_nfull(&q), 3);
+	evq_destroy(&q);
+}
+
+static void *producer(void *arg)
+{
+	test_evt_t e = {*(int *)arg, 0};
+
+	for (int i = 0; i < TEST_NEVT; i++)
+	{
+		e.val = i;
+		while (evq_push(&q, &e) < 0)
+			sched_yield();
+	}
+	return NULL;
+}
+
+Test(evq, producers)
+{
+	pthread_t t[TEST_NPROD];
+	int id[TEST_NPROD], next[TEST_NPROD] = {0}, n = 0;
+	test_evt_t e;
+
+	cr_assert_eq(evq_init(&q, TEST_LEN, sizeof(test_evt_t)), 0);
+	for (int j = 0; j < TEST_NPROD; j++)
+	{
+		id[j] = j;
+		cr_assert_eq(pthread_create(&t[j], NULL, producer, &id[j]), 0);
+	}
+	// all the events, in order for each producer
+	while (n < TEST_NPROD * TEST_NEVT)
+	{
+		if (evq_pop(&q, &e) < 0)
+			continue;
+		cr_assert_eq(e.val, next[e.prod]++, "producer %d", e.prod);
+		n++;
+	}
+	for (int j = 0; j < TEST_NPROD; j++)
+		pthread_join(t[j], NULL);
+	cr_expect_eq(evq_pop(&q, &e), -1);
+	evq_destroy(&q);
+}
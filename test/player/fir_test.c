@@ -0,0 +1,286 @@
+/**
+ * @file fir_test.c
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief unit test of the partitioned FFT convolution
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <math.h>
+#include <time.h>
+
+#include <criterion/criterion.h>
+
+#include "player/equalizer.h"
+#include "player/fft.h"
+#include "player/fir.h"
+
+#define TEST_FREQ 48000
+#define TEST_NTAPS 3000
+#define TEST_LEN (1 << 16)
+
+static float taps[1 << 14], in[TEST_FREQ], out[TEST_FREQ], ref[TEST_FREQ];
+
+/**
+ * @brief uniform noise in [-1, 1), the same at every run
+ */
+static void noise(float *x, int n, unsigned int seed)
+{
+	srand(seed);
+	for (int i = 0; i < n; i++)
+		x[i] = 2.0f * rand() / RAND_MAX - 1.0f;
+}
+
+/**
+ * @brief direct form FIR, the reference
+ */
+static void direct(const float *h, int ntaps, const float *x, float *y, int n)
+{
+	for (int i = 0; i < n; i++)
+	{
+		float acc = 0;
+
+		for (int k = 0; k < ntaps && k <= i; k++)
+			acc += h[k] * x[i - k];
+		y[i] = acc;
+	}
+}
+
+static double elapsed(struct timespec t1, struct timespec t2)
+{
+	return (t2.tv_sec - t1.tv_sec) + (t2.tv_nsec - t1.tv_nsec) / 1e9;
+}
+
+static void init() { fft_init("/tmp/fir_test.wisdom"); }
+
+TestSuite(fir, .init = init);
+
+Test(fir, args)
+{
+	cr_expect_null(fir_new(taps, 0, 256, 1));
+	cr_expect_null(fir_new(taps, 100, 100, 1), "not a power of 2");
+	cr_expect_null(fir_new(taps, 100, FIR_MIN_PART / 2, 1));
+	cr_expect_null(fir_new(taps, 100, 256, FIR_MAX_NCH + 1));
+}
+
+Test(fir, impulse)
+{
+	float *buf[1] = {out};
+	fir_t *f;
+
+	noise(taps, TEST_NTAPS, 1);
+	f = fir_new(taps, TEST_NTAPS, 256, 1);
+	cr_assert_not_null(f);
+	cr_expect_eq(fir_latency(f), 256);
+	cr_expect_eq(fir_ntaps(f), TEST_NTAPS);
+	for (int i = 0; i < TEST_FREQ; i++)
+		out[i] = (i == 0);
+	fir_process(f, buf, TEST_FREQ);
+	// the impulse response, a partition late
+	for (int i = 0; i < TEST_FREQ; i++)
+		cr_assert_float_eq(out[i],
+						   (i >= 256 && i - 256 < TEST_NTAPS) ? taps[i - 256]
+															  : 0.0f,
+						   1e-5f, "sample %d", i);
+	fir_delete(f);
+}
+
+Test(fir, direct)
+{
+	const unsigned int blocks[] = {1, 100, 511, 512, 4000};
+	float x[2][TEST_LEN / 8], *buf[2] = {x[0], x[1]};
+	int len = TEST_LEN / 8, part = 512;
+	fir_t *f;
+
+	noise(taps, TEST_NTAPS, 2);
+	noise(in, len, 3);
+	direct(taps, TEST_NTAPS, in, ref, len);
+	// blocks of any size, the second channel is the first negated
+	f = fir_new(taps, TEST_NTAPS, part, 2);
+	cr_assert_not_null(f);
+	for (int i = 0, b = 0, n; i < len; i += n, b++)
+	{
+		n = blocks[b % 5];
+		if (n > (unsigned int)(len - i))
+			n = len - i;
+		for (int j = 0; j < n; j++)
+		{
+			x[0][j] = in[i + j];
+			x[1][j] = -in[i + j];
+		}
+		fir_process(f, buf, n);
+		for (int j = 0; j < n; j++)
+		{
+			out[i + j] = x[0][j];
+			cr_assert_eq(x[1][j], -x[0][j]);
+		}
+	}
+	for (int i = part; i < len; i++)
+		cr_assert_float_eq(out[i], ref[i - part], 1e-3f, "sample %d", i);
+	fir_reset(f);
+	buf[0] = out;
+	out[0] = 1;
+	fir_process(f, buf, 1);
+	cr_expect_eq(out[0], 0.0f, "zero state");
+	fir_delete(f);
+}
+
+Test(fir, equalizer_mode)
+{
+	float x[4096], *buf[1] = {x};
+
+	equalizer_init(TEST_FREQ);
+	cr_expect_eq(equalizer_set_mode(EQ_MODE_FIR), -1, "no FIR yet");
+	taps[0] = 0.5f;
+	cr_assert_eq(equalizer_set_fir(taps, 1, 64), 0);
+	cr_assert_eq(equalizer_set_mode(EQ_MODE_FIR), 0);
+	cr_expect_eq(equalizer_get_mode(), EQ_MODE_FIR);
+	cr_expect_eq(equalizer_get_latency(), 64);
+	cr_expect_eq(equalizer_settle(0.5f), -1);
+	noise(in, 4096, 4);
+	for (int i = 0; i < 4096; i++)
+		x[i] = in[i];
+	cr_assert_eq(equalizer_equalize_ch(buf, 4096), 4096);
+	for (int i = 64; i < 4096; i++)
+		cr_assert_float_eq(x[i], 0.5f * in[i - 64], 1e-6f, "sample %d", i);
+	// back to the flat bands
+	cr_assert_eq(equalizer_set_mode(EQ_MODE_BANDS), 0);
+	cr_expect_eq(equalizer_get_latency(), 0);
+	for (int i = 0; i < 4096; i++)
+		x[i] = in[i];
+	equalizer_equalize_ch(buf, 4096);
+	for (int i = 0; i < 4096; i++)
+		cr_assert_float_eq(x[i], in[i], 1e-5f, "sample %d", i);
+}
+
+Test(fir, benchmark)
+{
+	const int ntaps[] = {1024, 4096, 16384}, parts[] = {64, 256, 1024};
+	float *buf[1] = {out};
+	struct timespec t1, t2;
+	double t;
+	fir_t *f;
+
+	noise(in, TEST_FREQ, 5);
+	for (int i = 0; i < 3; i++)
+	{
+		noise(taps, ntaps[i], 6);
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		direct(taps, ntaps[i], in, ref, TEST_FREQ);
+		clock_gettime(CLOCK_MONOTONIC, &t2);
+		t = elapsed(t1, t2);
+		printf("fir %5d taps, direct:         %8.2f Msamples/s, %6.1fx real "
+			   "time\n",
+			   ntaps[i], TEST_FREQ / t / 1e6, 1 / t);
+		for (int j = 0; j < 3; j++)
+		{
+			f = fir_new(taps, ntaps[i], parts[j], 1);
+			cr_assert_not_null(f);
+			for (int k = 0; k < TEST_FREQ; k++)
+				out[k] = in[k];
+			// blocks of the player, 10 ms
+			clock_gettime(CLOCK_MONOTONIC, &t1);
+			for (int k = 0; k < TEST_FREQ; k += TEST_FREQ / 100)
+			{
+				buf[0] = out + k;
+				fir_process(f, buf, TEST_FREQ / 100);
+			}
+			clock_gettime(CLOCK_MONOTONIC, &t2);
+			t = elapsed(t1, t2);
+			printf("fir %5d taps, partition %4d: %8.2f Msamples/s, %6.1fx "
+				   "real time, %.1f ms late\n",
+				   ntaps[i], parts[j], TEST_FREQ / t / 1e6, 1 / t,
+				   1e3 * parts[j] / TEST_FREQ);
+			fir_delete(f);
+		}
+	}
+}
+
+Test(fir, linear_phase)
+{
+	static float x[16384], y[16384], tone[16384];
+	float *buf[1] = {x};
+	double ebands = 0, elin = 0;
+	int lat = EQ_LIN_SIZE / 2 - 1 + EQ_LIN_PART;
+
+	equalizer_init(44100);
+	equalizer_set_gain(0, -12, NULL);
+	cr_assert_eq(equalizer_set_mode(EQ_MODE_LINEAR), 0);
+	cr_expect_eq(equalizer_get_latency(), lat);
+	for (int i = 0; i < 16384; i++)
+		x[i] = (i == 0);
+	equalizer_equalize_ch(buf, 16384);
+	// symmetric around the latency
+	for (int m = 1; m < EQ_LIN_SIZE / 2 - 1; m++)
+		cr_assert_float_eq(x[lat + m], x[lat - m], 1e-5f, "%d from the center",
+						   m);
+	cr_expect_gt(x[lat], 0.5f);
+
+	// as loud as the bands at the center of the band
+	for (int i = 0; i < 16384; i++)
+		tone[i] = sinf(2 * M_PI * 250 * i / 44100);
+	equalizer_init(44100);
+	equalizer_set_gain(0, -12, NULL);
+	for (int i = 0; i < 16384; i++)
+		y[i] = tone[i];
+	buf[0] = y;
+	equalizer_equalize_ch(buf, 16384);
+	cr_assert_eq(equalizer_set_mode(EQ_MODE_LINEAR), 0);
+	for (int i = 0; i < 16384; i++)
+		x[i] = tone[i];
+	buf[0] = x;
+	equalizer_equalize_ch(buf, 16384);
+	for (int i = 8192; i < 16384; i++)
+	{
+		ebands += y[i] * y[i];
+		elin += x[i] * x[i];
+	}
+	cr_expect_float_eq(10 * log10(elin / ebands), 0.0, 0.5, "%f dB",
+					   10 * log10(elin / ebands));
+
+	// back flat, the kernel is a delay, the state is kept
+	equalizer_set_gain(0, 0, NULL);
+	cr_assert_eq(equalizer_update(), 1);
+	cr_expect_eq(equalizer_update(), 0, "designed once");
+	for (int i = 0; i < 16384; i++)
+		x[i] = tone[i];
+	equalizer_equalize_ch(buf, 16384);
+	for (int i = lat + EQ_LIN_PART; i < 16384; i++)
+		cr_assert_float_eq(x[i], tone[i - lat], 1e-4f, "sample %d", i);
+}
+
+Test(fir, benchmark_linear)
+{
+	const int len = 10 * 44100, block = 441;
+	float *x = malloc(sizeof(float) * len), *buf[1];
+	struct timespec t1, t2;
+	double t, design;
+
+	cr_assert_not_null(x);
+	noise(x, len, 7);
+	equalizer_init(44100);
+	cr_assert_eq(equalizer_set_mode(EQ_MODE_LINEAR), 0);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	equalizer_set_gain(0, 6, NULL);
+	equalizer_set_gain(1, -3, NULL);
+	equalizer_update();
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+	design = elapsed(t1, t2);
+	// 10 ms blocks, as the player
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	for (int i = 0; i + block <= len; i += block)
+	{
+		buf[0] = x + i;
+		equalizer_equalize_ch(buf, block);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+	t = elapsed(t1, t2);
+	printf("linear phase: %.2f%% of a core at 44.1 kHz mono, %.1f ms late, "
+		   "%.2f ms to design a gain change\n",
+		   100 * t / 10, 1e3 * equalizer_get_latency() / 44100, 1e3 * design);
+	cr_expect_lt(t / 10, 0.05, "under 5%% of a core");
+	free(x);
+}
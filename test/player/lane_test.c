@@ -0,0 +1,71 @@
+/**
+ * @file lane_test.c
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief unit test of the automation lanes
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ */
+#include <limits.h>
+
+#include <criterion/criterion.h>
+
+#include "player/lane.h"
+
+static lane_t l;
+
+TestSuite(lane);
+
+Test(lane, add)
+{
+	cr_expect_eq(lane_init(&l, 0), -1);
+	cr_assert_eq(lane_init(&l, 4), 0);
+	cr_expect_eq(lane_add(&l, -1, 0), -1);
+	// out of order, sorted by frame
+	cr_expect_eq(lane_add(&l, 300, 3), 0);
+	cr_expect_eq(lane_add(&l, 100, 1), 0);
+	cr_expect_eq(lane_add(&l, 200, 2), 0);
+	cr_expect_eq(lane_add(&l, 100, 10), 0, "replaced");
+	cr_assert_eq(l.len, 3);
+	for (int i = 0; i < l.len; i++)
+		cr_expect_eq(l.frame[i], 100 * (i + 1));
+	cr_expect_eq(l.val[0], 10);
+	cr_expect_eq(lane_add(&l, 0, 0), 0);
+	cr_expect_eq(lane_add(&l, 400, 4), -1, "full");
+	cr_expect_eq(lane_add(&l, 200, 20), 0, "replaced when full");
+	lane_clear(&l);
+	cr_expect_eq(lane_find(&l, 1000), -1);
+	lane_destroy(&l);
+}
+
+Test(lane, find)
+{
+	cr_assert_eq(lane_init(&l, 8), 0);
+	lane_add(&l, 100, 1);
+	lane_add(&l, 200, 2);
+	cr_expect_eq(lane_find(&l, 0), -1);
+	cr_expect_eq(lane_find(&l, 99), -1);
+	cr_expect_eq(lane_find(&l, 100), 0);
+	cr_expect_eq(lane_find(&l, 199), 0);
+	cr_expect_eq(lane_find(&l, 200), 1);
+	cr_expect_eq(lane_find(&l, LONG_MAX), 1);
+	lane_destroy(&l);
+}
+
+Test(lane, span)
+{
+	cr_assert_eq(lane_init(&l, 8), 0);
+	cr_expect_eq(lane_span(&l, 0, 1), LONG_MAX);
+	cr_expect_eq(lane_span(&l, 0, -1), LONG_MAX);
+	lane_add(&l, 100, 1);
+	lane_add(&l, 200, 2);
+	// forward, up to the next point
+	cr_expect_eq(lane_span(&l, 0, 1), 100);
+	cr_expect_eq(lane_span(&l, 150, 1), 50);
+	cr_expect_eq(lane_span(&l, 200, 1), LONG_MAX);
+	// backward, down to the point in effect
+	cr_expect_eq(lane_span(&l, 250, -1), 51);
+	cr_expect_eq(lane_span(&l, 200, -1), 1);
+	cr_expect_eq(lane_span(&l, 50, -1), LONG_MAX);
+	lane_destroy(&l);
+}
@@ -181,3 +181,121 @@ Test(transitions, stop_state)
 
 	player_exit();
 }
+
+Test(transitions, burst)
+{
+	float gain[PLAYER_EQ_MAX_NFILT];
+
+	player_init(TEST_AUDIO_FILES_DIR TEST_FILE);
+	player_start(NULL);
+
+	// events dispatched at once are all applied, in order
+	player_dispatch((player_event_t){PLAY_SIG, 0});
+	player_dispatch((player_event_t){PAUSE_SIG, 0});
+	player_dispatch((player_event_t){PLAY_SIG, 0});
+	// a slider dragged, only the last value counts
+	for (int i = 0; i <= 10; i++)
+		player_dispatch((player_event_t){VOL_SIG, 100 - 5 * i});
+	player_dispatch((player_event_t){FILTLOW_SIG, -6});
+	player_dispatch((player_event_t){FILTMED_SIG, 3});
+	sleep(1);
+	cr_expect_eq(player_get_state(), PLAY);
+	cr_expect_eq(player_get_volume(), 50);
+	player_get_eq_gain(gain);
+	cr_expect_float_eq(gain[0], -6, 0.5);
+	cr_expect_float_eq(gain[1], 3, 0.5);
+
+	player_dispatch(reset_event);
+	sleep(1);
+	player_exit();
+}
+
+Test(transitions, automation)
+{
+	const long frame[3] = {0, 1, 2};
+	const float val[3] = {-6, 6, 3};
+	float gain[PLAYER_EQ_MAX_NFILT];
+
+	player_init(TEST_AUDIO_FILES_DIR TEST_FILE);
+	player_start(NULL);
+
+	cr_expect_eq(player_automate_lane(PLAY_SIG, frame, val, 3), -1);
+	cr_expect_eq(player_automate_lane(FILTHIG_SIG, frame, val, 3), 0);
+	player_dispatch_at((player_event_t){VOL_SIG, 30}, 0);
+	player_dispatch((player_event_t){PLAY_SIG, 0});
+	sleep(1);
+	// the points in effect once their frames are played
+	cr_expect_eq(player_get_volume(), 30);
+	player_get_eq_gain(gain);
+	cr_expect_float_eq(gain[3], 3, 0.5);
+
+	// before the first point of a lane, the value set at once
+	player_dispatch((player_event_t){FILTLOW_SIG, -3});
+	player_dispatch_at((player_event_t){FILTLOW_SIG, 6}, 10000);
+	sleep(1);
+	player_get_eq_gain(gain);
+	cr_expect_float_eq(gain[0], 6, 0.5);
+	player_dispatch((player_event_t){RWND_SIG, 0});
+	sleep(2);
+	player_get_eq_gain(gain);
+	cr_expect_float_eq(gain[0], -3, 0.5, "back before the point");
+	player_clear_lane(FILTHIG_SIG);
+	sleep(1);
+	player_get_eq_gain(gain);
+	cr_expect_float_eq(gain[3], 0, 0.5, "the default once cleared");
+
+	player_dispatch(reset_event);
+	sleep(1);
+	player_exit();
+}
+
+Test(transitions, preset)
+{
+	float gain[PLAYER_EQ_MAX_NFILT];
+
+	player_init(TEST_AUDIO_FILES_DIR TEST_FILE);
+	player_start(NULL);
+
+	cr_expect_eq(player_get_nband(), EQ_NFILT);
+	player_dispatch((player_event_t){FILTLOW_SIG, -6});
+	player_dispatch((player_event_t){PRESET_SIG, EQ_PRESET_ISO10});
+	sleep(1);
+	// the bands of the preset, all at 0
+	cr_expect_eq(player_get_preset(), EQ_PRESET_ISO10);
+	cr_expect_eq(player_get_nband(), 10);
+	player_get_eq_gain(gain);
+	cr_expect_float_eq(gain[0], 0, 0.5);
+	// a band past the layout is ignored
+	player_dispatch((player_event_t){FILTLOW_SIG + 9, 6});
+	player_dispatch((player_event_t){FILTLOW_SIG + 10, 6});
+	sleep(1);
+	player_get_eq_gain(gain);
+	cr_expect_float_eq(gain[9], 6, 0.5);
+	cr_expect_float_eq(gain[10], 0, 0.5);
+
+	player_dispatch((player_event_t){PRESET_SIG, EQ_PRESET_PLAYER});
+	player_dispatch(reset_event);
+	sleep(1);
+	player_exit();
+}
+
+Test(transitions, full)
+{
+	player_init(TEST_AUDIO_FILES_DIR TEST_FILE);
+
+	// nothing drains the queue before the player starts
+	for (int i = 0; i < PLAYER_EVQ_LEN; i++)
+		cr_expect_eq(player_dispatch((player_event_t){VOL_SIG, i % 100}), 0);
+	cr_expect_eq(player_dispatch((player_event_t){VOL_SIG, 50}), -1,
+				 "the event is not queued");
+	player_start(NULL);
+	sleep(1);
+	// dispatched again once drained
+	cr_expect_eq(player_dispatch((player_event_t){VOL_SIG, 50}), 0);
+	sleep(1);
+	cr_expect_eq(player_get_volume(), 50);
+
+	player_dispatch(reset_event);
+	sleep(1);
+	player_exit();
+}
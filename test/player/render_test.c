@@ -0,0 +1,182 @@
+/**
+ * @file render_test.c
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief unit test of the headless render
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <criterion/criterion.h>
+
+#include "player/render.h"
+#include "player/source.h"
+
+#include "wav.h"
+
+#define TEST_DIR "/tmp/render_test"
+#define TEST_NFRAMES 100000
+#define TEST_FREQ 48000
+
+/**
+ * @brief sample of a channel, a different tone on each channel
+ */
+static float tone(long i, int c)
+{
+	return 20000.0f * sinf(2 * M_PI * 250 * (c + 1) * i / TEST_FREQ);
+}
+
+static void init()
+{
+	cr_assert_eq(system("rm -rf " TEST_DIR " && mkdir " TEST_DIR), 0);
+	wav_write(TEST_DIR "/a.wav", TEST_NFRAMES, 2, TEST_FREQ, 16, tone, 0);
+	wav_write(TEST_DIR "/b.wav", TEST_NFRAMES, 6, TEST_FREQ, 24, tone, 0);
+	wav_write(TEST_DIR "/c.wav", TEST_NFRAMES, 1, TEST_FREQ, 16, tone, 0);
+}
+
+static void fini() { cr_assert_eq(system("rm -rf " TEST_DIR), 0); }
+
+TestSuite(render, .init = init, .fini = fini);
+
+Test(render, flat)
+{
+	render_opts_t opts = {.budget = RENDER_MEM_BUDGET};
+	static float in[TEST_NFRAMES * 6], out[TEST_NFRAMES * 6];
+	const char *files[] = {TEST_DIR "/a.wav", TEST_DIR "/b.wav"};
+	source_t a, b;
+	render_stats_t st;
+
+	for (int f = 0; f < 2; f++)
+	{
+		cr_assert_eq(render_file(files[f], TEST_DIR "/out.wav", &opts, &st),
+					 0);
+		cr_expect_eq(st.status, 0);
+		cr_expect_eq(st.frames, TEST_NFRAMES);
+		cr_expect_float_eq(st.audio, (double)TEST_NFRAMES / TEST_FREQ, 1e-9);
+		cr_assert_eq(source_open(&a, files[f], 1 << 20), 0);
+		cr_assert_eq(source_open(&b, TEST_DIR "/out.wav", 1 << 20), 0);
+		cr_expect_eq(b.conv->fmt, a.conv->fmt, "same format");
+		cr_expect_eq(b.nch, a.nch);
+		cr_expect_eq(b.freq, a.freq);
+		cr_assert_eq(b.len, a.len);
+		source_read(&a, 0, TEST_NFRAMES, in);
+		source_read(&b, 0, TEST_NFRAMES, out);
+		// flat bands let the track through, but for rounding
+		for (long i = 0; i < TEST_NFRAMES * a.nch; i++)
+			cr_assert_float_eq(out[i], in[i], 1.0f, "%s sample %ld",
+							   files[f], i);
+		source_close(&a);
+		source_close(&b);
+	}
+	cr_expect_eq(access(TEST_DIR "/out.wav.part", F_OK), -1, "renamed");
+}
+
+Test(render, gain)
+{
+	render_opts_t opts = {.budget = RENDER_MEM_BUDGET,
+						  .gain = {-EQ_FILT_MAX_GAIN, 0, 0, 0}};
+	static float in[TEST_NFRAMES], out[TEST_NFRAMES];
+	double ein = 0, eout = 0;
+	source_t a, b;
+
+	// the 250 Hz tone is at the center of the first band
+	cr_assert_eq(render_file(TEST_DIR "/c.wav", TEST_DIR "/out.wav", &opts,
+							 NULL),
+				 0);
+	cr_assert_eq(source_open(&a, TEST_DIR "/c.wav", 1 << 20), 0);
+	cr_assert_eq(source_open(&b, TEST_DIR "/out.wav", 1 << 20), 0);
+	source_read(&a, 0, TEST_NFRAMES, in);
+	source_read(&b, 0, TEST_NFRAMES, out);
+	for (long i = TEST_NFRAMES / 2; i < TEST_NFRAMES; i++)
+	{
+		ein += in[i] * in[i];
+		eout += out[i] * out[i];
+	}
+	cr_expect_lt(10 * log10(eout / ein), -15.0, "%f dB",
+				 10 * log10(eout / ein));
+	source_close(&a);
+	source_close(&b);
+}
+
+Test(render, split)
+{
+	render_opts_t opts = {.budget = RENDER_MEM_BUDGET,
+						  .gain = {EQ_FILT_MAX_GAIN, -6, 3, -EQ_FILT_MAX_GAIN}};
+	static float whole[TEST_NFRAMES * 6], split[TEST_NFRAMES * 6];
+	float peak = 0;
+	render_stats_t st;
+	source_t a, b;
+
+	cr_assert_eq(render_file(TEST_DIR "/b.wav", TEST_DIR "/whole.wav", &opts,
+							 &st),
+				 0);
+	cr_expect_eq(st.nsplit, 1);
+	opts.nsplit = 4;
+	cr_assert_eq(render_file(TEST_DIR "/b.wav", TEST_DIR "/split.wav", &opts,
+							 &st),
+				 0);
+	// the warm up can leave fewer chunks
+	cr_expect(st.nsplit > 1 && st.nsplit <= 4, "%d chunks", st.nsplit);
+	cr_expect_leq(st.err, RENDER_SPLIT_ERR);
+	cr_expect_gt(st.speedup, 0.0);
+	cr_assert_eq(source_open(&a, TEST_DIR "/whole.wav", 1 << 20), 0);
+	cr_assert_eq(source_open(&b, TEST_DIR "/split.wav", 1 << 20), 0);
+	cr_assert_eq(b.len, a.len);
+	source_read(&a, 0, TEST_NFRAMES, whole);
+	source_read(&b, 0, TEST_NFRAMES, split);
+	for (long i = 0; i < TEST_NFRAMES * a.nch; i++)
+		peak = fmaxf(peak, fabsf(whole[i]));
+	// 24 bits samples keep 8 bits of fraction
+	for (long i = 0; i < TEST_NFRAMES * a.nch; i++)
+		cr_assert_float_eq(split[i], whole[i],
+						   RENDER_SPLIT_ERR * peak + 1.0f / 256, "sample %ld",
+						   i);
+	source_close(&a);
+	source_close(&b);
+	// too short to be worth four chunks
+	opts.nsplit = 4000;
+	cr_assert_eq(render_file(TEST_DIR "/c.wav", TEST_DIR "/out.wav", &opts,
+							 &st),
+				 0);
+	cr_expect_lt(st.nsplit, 4000);
+}
+
+Test(render, batch)
+{
+	render_opts_t opts = {.budget = RENDER_MEM_BUDGET};
+	const char *files[] = {TEST_DIR "/a.wav", TEST_DIR "/missing.wav",
+						   TEST_DIR "/b.wav", TEST_DIR "/c.wav"};
+	render_stats_t st[4];
+
+	cr_expect_eq(render_batch(files, 4, TEST_DIR "/out", &opts, 2, st), 1,
+				 "one track missing");
+	cr_expect_eq(st[0].status, 0);
+	cr_expect_eq(st[1].status, -1);
+	cr_expect_eq(st[2].status, 0);
+	cr_expect_eq(st[3].status, 0);
+	cr_expect_eq(st[2].frames, TEST_NFRAMES);
+	cr_expect_eq(access(TEST_DIR "/out/a.wav", F_OK), 0);
+	cr_expect_eq(access(TEST_DIR "/out/b.wav", F_OK), 0);
+	cr_expect_eq(access(TEST_DIR "/out/c.wav", F_OK), 0);
+	cr_expect_eq(access(TEST_DIR "/out/missing.wav", F_OK), -1);
+}
+
+Test(render, batch_same_name)
+{
+	render_opts_t opts = {.budget = RENDER_MEM_BUDGET};
+	const char *files[] = {TEST_DIR "/a.wav", TEST_DIR "/c.wav",
+						   TEST_DIR "/sub/a.wav"};
+
+	cr_assert_eq(system("mkdir " TEST_DIR "/sub && cp " TEST_DIR
+						"/b.wav " TEST_DIR "/sub/a.wav"),
+				 0);
+	cr_expect_eq(render_batch(files, 3, TEST_DIR "/dup", &opts, 2, NULL), -1,
+				 "a.wav twice");
+	cr_expect_eq(access(TEST_DIR "/dup", F_OK), -1, "nothing rendered");
+}
@@ -0,0 +1,121 @@
+/**
+ * @file seqlock_test.c
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief unit test of the publication with no lock
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ */
+#include <pthread.h>
+
+#include <criterion/criterion.h>
+
+#include "player/seqlock.h"
+
+#define TEST_LEN 1024
+#define TEST_NWRITE 20000
+#define TEST_NREADER 3
+
+static seqlock_t lock = SEQLOCK_INITIALIZER;
+static int data[2][TEST_LEN];
+static volatile int done;
+
+TestSuite(seqlock);
+
+Test(seqlock, retry)
+{
+	seqlock_t s = SEQLOCK_INITIALIZER;
+	unsigned long nread, nretry;
+	unsigned int seq;
+	int i, j;
+
+	seq = seqlock_read_begin(&s, &i);
+	cr_expect_eq(seqlock_read_retry(&s, seq), 0);
+	// the copy read is written during the copy
+	seq = seqlock_read_begin(&s, &i);
+	cr_expect_eq(seqlock_write_begin(&s), i);
+	seqlock_write_end(&s);
+	cr_expect_eq(seqlock_read_retry(&s, seq), 1);
+	cr_expect_neq(seqlock_read_begin(&s, &j), seq);
+	cr_expect_neq(j, i);
+	seqlock_get_stats(&s, &nread, &nretry);
+	cr_expect_eq(nread, 1);
+	cr_expect_eq(nretry, 1);
+}
+
+Test(seqlock, preempted)
+{
+	seqlock_t s = SEQLOCK_INITIALIZER;
+	unsigned int seq;
+	int i, j;
+
+	// the writer stops in the middle of a copy, the readers go on
+	i = seqlock_write_begin(&s);
+	seq = seqlock_read_begin(&s, &j);
+	cr_expect_neq(i, j);
+	cr_expect_eq(seqlock_read_retry(&s, seq), 0);
+	seqlock_write_end(&s);
+	cr_expect_neq(seqlock_write_begin(&s), i);
+}
+
+static void *writer(void *arg)
+{
+	for (int k = 1; k <= TEST_NWRITE; k++)
+		for (int n = 0; n < 2; n++)
+		{
+			int *d = data[seqlock_write_begin(&lock)];
+
+			for (int i = 0; i < TEST_LEN; i++)
+				__atomic_store_n(&d[i], k, __ATOMIC_RELAXED);
+			seqlock_write_end(&lock);
+		}
+	done = 1;
+	return NULL;
+}
+
+static void *reader(void *arg)
+{
+	static int copy[TEST_NREADER][TEST_LEN];
+	int *c = copy[*(int *)arg];
+	long torn = 0;
+	unsigned int seq;
+	int j;
+
+	while (!done)
+	{
+		do
+		{
+			seq = seqlock_read_begin(&lock, &j);
+			for (int i = 0; i < TEST_LEN; i++)
+				c[i] = __atomic_load_n(&data[j][i], __ATOMIC_RELAXED);
+		} while (seqlock_read_retry(&lock, seq));
+		for (int i = 1; i < TEST_LEN; i++)
+			torn += (c[i] != c[0]);
+	}
+	return (void *)torn;
+}
+
+Test(seqlock, torn)
+{
+	pthread_t w, r[TEST_NREADER];
+	int id[TEST_NREADER];
+	unsigned long nread;
+	void *torn;
+
+	for (int j = 0; j < TEST_NREADER; j++)
+	{
+		id[j] = j;
+		cr_assert_eq(pthread_create(&r[j], NULL, reader, &id[j]), 0);
+	}
+	cr_assert_eq(pthread_create(&w, NULL, writer, NULL), 0);
+	pthread_join(w, NULL);
+	for (int j = 0; j < TEST_NREADER; j++)
+	{
+		pthread_join(r[j], &torn);
+		cr_expect_eq((long)torn, 0, "reader %d", j);
+	}
+	seqlock_get_stats(&lock, &nread, NULL);
+	cr_expect_gt(nread, 0);
+	cr_expect_eq(data[0][0], TEST_NWRITE);
+	cr_expect_eq(data[1][0], TEST_NWRITE);
+}
@@ -0,0 +1,181 @@
+/**
+ * @file source_test.c
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief unit test of the streamed audio track
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string.h>
+#include <unistd.h>
+
+#include <criterion/criterion.h>
+
+#include "player/source.h"
+
+#include "wav.h"
+
+#define TEST_WAV "/tmp/source_test.wav"
+#define TEST_NFRAMES 100000
+
+/**
+ * @brief frame i of the test track, a ramp covering every 16 bit value
+ */
+static int16_t frame(long i) { return (int16_t)(i * 7 - 32768); }
+
+/**
+ * @brief the frames of the test track, as WAV samples
+ */
+static float sample(long i, int c) { return frame(i); }
+
+/**
+ * @brief check that the frames [off, off + count) read as expected
+ */
+static int check(source_t *s, long off, unsigned int count)
+{
+	static float buf[TEST_NFRAMES];
+
+	if (source_read(s, off, count, buf) != (int)count)
+		return 0;
+	for (unsigned int i = 0; i < count; i++)
+		if (buf[i] != frame(off + i))
+			return 0;
+	return 1;
+}
+
+static void init()
+{
+	// an extra chunk before the data
+	wav_write(TEST_WAV, TEST_NFRAMES, 1, 44100, 16, sample, 1);
+}
+
+static void fini() { unlink(TEST_WAV); }
+
+TestSuite(source, .init = init, .fini = fini);
+
+Test(source, open)
+{
+	source_t s;
+
+	cr_assert_eq(source_open(&s, TEST_WAV, 1 << 20), 0);
+	cr_expect_eq(s.bits, 16);
+	cr_expect_eq(s.nch, 1);
+	cr_expect_eq(s.freq, 44100);
+	cr_expect_eq(s.len, TEST_NFRAMES);
+	cr_expect_eq(s.cap, TEST_NFRAMES, "window never bigger than the track");
+	cr_expect_eq(s.hi - s.lo, 0, "nothing is read at open");
+	cr_expect_not_null(s.map, "a WAV is mapped");
+	cr_expect_eq(s.pcm, s.map + s.data, "PCM data read in place");
+	cr_expect_eq(s.conv->fmt, CONVERT_S16);
+	source_close(&s);
+	cr_expect_eq(source_open(&s, "/nonexistent.wav", 1 << 20), -1);
+}
+
+Test(source, bounded)
+{
+	const long cap = 10000;
+	source_t s;
+	float buf[16];
+
+	cr_assert_eq(source_open(&s, TEST_WAV, cap * 2), 0);
+	cr_assert_eq(s.cap, cap);
+	// forward through the whole track
+	for (long pos = 0; pos + 3000 <= TEST_NFRAMES; pos += 2500)
+	{
+		cr_assert_eq(source_prefetch(&s, pos, pos + 3000), 0);
+		cr_assert(check(&s, pos, 3000), "forward at %ld", pos);
+		cr_assert_leq(s.hi - s.lo, cap);
+	}
+	// backward
+	for (long pos = TEST_NFRAMES - 3000; pos >= 0; pos -= 2500)
+	{
+		cr_assert_eq(source_prefetch(&s, pos, pos + 3000), 0);
+		cr_assert(check(&s, pos, 3000), "backward at %ld", pos);
+		cr_assert_leq(s.hi - s.lo, cap);
+	}
+	// jump
+	source_seek(&s, 77777);
+	cr_expect(s.random);
+	cr_assert_eq(source_prefetch(&s, 77777, 80000), 0);
+	cr_expect_not(s.random, "sequential again once playing");
+	cr_assert(check(&s, 77777, 80000 - 77777));
+	cr_expect_eq(source_prefetch(&s, 0, cap + 1), -1, "more than the window");
+	// out of the track is silence
+	cr_expect_eq(source_prefetch(&s, TEST_NFRAMES - 8, TEST_NFRAMES + 8), 0);
+	cr_expect_eq(source_read(&s, TEST_NFRAMES - 8, 16, buf), 8);
+	cr_expect_eq(buf[7], frame(TEST_NFRAMES - 1));
+	cr_expect_eq(buf[8], 0);
+	source_close(&s);
+}
+
+Test(source, async)
+{
+	source_t s;
+
+	cr_assert_eq(source_open(&s, TEST_WAV, 10000 * 2), 0);
+	source_set_async(&s, 1);
+	cr_assert_eq(source_prefetch(&s, 0, 3000), 0);
+	cr_expect_eq(s.adv_hi, 0, "no hint from the thread that prefetches");
+	cr_assert(check(&s, 0, 3000), "read before the hints");
+	source_advise(&s);
+	cr_expect_eq(s.adv_lo, s.lo);
+	cr_expect_eq(s.adv_hi, s.hi);
+	source_seek(&s, 77777);
+	cr_expect_eq(s.seek, 77777);
+	cr_expect_not(s.adv_random);
+	source_advise(&s);
+	cr_expect_eq(s.seek, -1, "the seek advised once");
+	cr_expect(s.adv_random);
+	cr_assert_eq(source_prefetch(&s, 77777, 80000), 0);
+	source_advise(&s);
+	cr_expect_not(s.adv_random, "sequential again once playing");
+	cr_expect_eq(s.adv_hi, s.hi);
+	cr_assert(check(&s, 77777, 80000 - 77777));
+	source_close(&s);
+}
+
+Test(source, high_res)
+{
+	// 2 stereo frames of each format, full scale is 32768 once converted
+	static const uint8_t s24[] = {0, 0, 0x80, 0xff, 0xff, 0x7f,
+								  0, 0x01, 0, 0xff, 0xff, 0xff};
+	static const float f32[] = {-1.0f, 0.5f, 0.25f, 0.0f};
+	source_t s;
+	float buf[4];
+
+	wav_write_raw(TEST_WAV ".24", WAV_TAG_PCM, 2, 96000, 24, s24,
+				  sizeof(s24));
+	cr_assert_eq(source_open(&s, TEST_WAV ".24", 1 << 20), 0);
+	unlink(TEST_WAV ".24");
+	cr_expect_eq(s.conv->fmt, CONVERT_S24);
+	cr_expect_eq(s.freq, 96000);
+	cr_expect_eq(s.len, 2);
+	cr_expect_eq(source_read(&s, 0, 2, buf), 2);
+	cr_expect_float_eq(buf[0], -32768.0f, 0.0f);
+	cr_expect_float_eq(buf[1], 32767.99609375f, 0.0f);
+	cr_expect_float_eq(buf[2], 1.0f, 0.0f);
+	cr_expect_float_eq(buf[3], -1.0f / 256, 0.0f);
+	source_close(&s);
+
+	wav_write_raw(TEST_WAV ".f32", WAV_TAG_FLOAT, 2, 192000, 32, f32,
+				  sizeof(f32));
+	cr_assert_eq(source_open(&s, TEST_WAV ".f32", 1 << 20), 0);
+	unlink(TEST_WAV ".f32");
+	cr_expect_eq(s.conv->fmt, CONVERT_F32);
+	cr_expect_eq(s.freq, 192000);
+	cr_expect_eq(source_read(&s, 0, 2, buf), 2);
+	cr_expect_float_eq(buf[0], -32768.0f, 0.0f);
+	cr_expect_float_eq(buf[1], 16384.0f, 0.0f);
+	cr_expect_float_eq(buf[2], 8192.0f, 0.0f);
+	source_close(&s);
+
+	// 64 bits floats are not supported
+	wav_write_raw(TEST_WAV ".f64", WAV_TAG_FLOAT, 1, 48000, 64, f32,
+				  sizeof(f32));
+	cr_expect_eq(source_open(&s, TEST_WAV ".f64", 1 << 20), -1);
+	unlink(TEST_WAV ".f64");
+}
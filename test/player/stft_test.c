@@ -0,0 +1,104 @@
+/**
+ * @file stft_test.c
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief unit test of the streaming STFT
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ */
+#include <math.h>
+
+#include <criterion/criterion.h>
+
+#include "player/fft.h"
+#include "player/stft.h"
+#include "player/window.h"
+
+#define TEST_NFFT 1024
+#define TEST_LEN (16 * TEST_NFFT)
+
+static float x[TEST_LEN];
+
+static void init()
+{
+	fft_init("/tmp/stft_test.wisdom");
+	cr_assert_eq(fft_plan(TEST_NFFT), 0);
+	for (int i = 0; i < TEST_LEN; i++)
+		x[i] = sinf(2 * M_PI * 0.05f * i) + 0.25f * cosf(2 * M_PI * 0.31f * i);
+}
+
+TestSuite(stft, .init = init);
+
+Test(stft, args)
+{
+	const window_t *w = window_get(WIN_HANN, TEST_NFFT, 0);
+	stft_t s;
+
+	cr_expect_eq(stft_init(&s, TEST_NFFT / 2, w, 256, 8), -1, "window too long");
+	cr_expect_eq(stft_init(&s, TEST_NFFT, w, 0, 8), -1);
+	cr_expect_eq(stft_init(&s, TEST_NFFT, w, TEST_NFFT + 1, 8), -1);
+	cr_expect_eq(stft_init(&s, TEST_NFFT, w, 256, 0), -1);
+}
+
+Test(stft, frames)
+{
+	const int blocks[] = {1, 100, 333, 1024, 3000};
+	const window_t *w = window_get(WIN_HANN, TEST_NFFT / 2, 0);
+	int hop = 128, n, nframe = 0;
+	long end;
+	stft_t s;
+
+	cr_assert_eq(stft_init(&s, TEST_NFFT, w, hop, 16), 0);
+	stft_reset(&s, 1000);
+	for (int i = 0, b = 0; i < TEST_LEN; i += n, b++)
+	{
+		n = blocks[b % 5];
+		if (n > TEST_LEN - i)
+			n = TEST_LEN - i;
+		nframe += stft_push(&s, x + i, n);
+	}
+	// a frame once the window is full, then one every hop
+	cr_expect_eq(nframe, (TEST_LEN - TEST_NFFT / 2) / hop + 1);
+	cr_expect_eq(s.count, nframe);
+	cr_expect_null(stft_frame(&s, nframe, NULL));
+	cr_expect_null(stft_frame(&s, nframe - 17, NULL), "out of the ring");
+	for (long i = nframe - 16; i < nframe; i++)
+	{
+		cr_assert_not_null(stft_frame(&s, i, &end));
+		cr_expect_eq(end, 1000 + TEST_NFFT / 2 + i * hop);
+	}
+	stft_destroy(&s);
+}
+
+Test(stft, direct)
+{
+	static float tmp[TEST_NFFT];
+	static fftwf_complex *cpx;
+	const window_t *w = window_get(WIN_BLACKMAN_HARRIS, TEST_NFFT, 0);
+	const float *mag;
+	float corr = 2.0f / (TEST_NFFT * w->cg), ref;
+	long end;
+	stft_t s;
+
+	cr_assert_eq(stft_init(&s, TEST_NFFT, w, TEST_NFFT / 4, 64), 0);
+	stft_push(&s, x, TEST_LEN);
+	cpx = fft_alloc_cpx(TEST_NFFT / 2 + 1);
+	for (long i = s.count - 8; i < s.count; i++)
+	{
+		mag = stft_frame(&s, i, &end);
+		// the window ending there, transformed at once
+		for (int j = 0; j < TEST_NFFT; j++)
+			tmp[j] = x[end - TEST_NFFT + j];
+		window_apply(w, tmp);
+		fft_r2c(TEST_NFFT, tmp, cpx);
+		for (int k = 0; k < TEST_NFFT / 2 + 1; k++)
+		{
+			ref = sqrtf(cpx[k][0] * cpx[k][0] + cpx[k][1] * cpx[k][1]) * corr;
+			cr_assert_float_eq(mag[k], ref, 1e-4f, "frame %ld, bin %d", i, k);
+		}
+	}
+	// a sine of amplitude 1 peaks at 1, whatever the window
+	cr_expect_float_eq(mag[(int)(0.05f * TEST_NFFT + 0.5f)], 1.0f, 0.1f);
+	fft_free(cpx);
+	stft_destroy(&s);
+}
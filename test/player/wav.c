@@ -0,0 +1,85 @@
+/**
+ * @file wav.c
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief WAV files written by the unit tests
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ */
+#include "wav.h"
+
+#include <stdio.h>
+
+#include <math.h>
+
+#include <criterion/criterion.h>
+
+/**
+ * @brief write the RIFF and fmt chunks
+ *
+ * @param extra bytes of the chunks between fmt and data
+ */
+static void wav_header(FILE *f, uint16_t tag, uint16_t nch, uint32_t freq,
+					   uint16_t bits, uint32_t size, uint32_t extra)
+{
+	uint32_t u32;
+	uint16_t u16;
+
+	fwrite("RIFF", 1, 4, f);
+	u32 = 4 + 8 + 16 + extra + 8 + size;
+	fwrite(&u32, 4, 1, f);
+	fwrite("WAVEfmt ", 1, 8, f);
+	u32 = 16;
+	fwrite(&u32, 4, 1, f);
+	fwrite(&tag, 2, 1, f);
+	fwrite(&nch, 2, 1, f);
+	fwrite(&freq, 4, 1, f);
+	u32 = freq * nch * bits / 8;
+	fwrite(&u32, 4, 1, f);
+	u16 = nch * bits / 8;
+	fwrite(&u16, 2, 1, f);
+	fwrite(&bits, 2, 1, f);
+}
+
+void wav_write(const char *path, long nframes, int nch, int freq, int bits,
+			   wav_sample_t sample, int list)
+{
+	FILE *f = fopen(path, "wb");
+	uint32_t u32, size = nframes * nch * bits / 8;
+	int32_t s;
+
+	cr_assert_not_null(f, "%s", path);
+	cr_assert(bits == 16 || bits == 24, "%d bits", bits);
+	wav_header(f, WAV_TAG_PCM, nch, freq, bits, size, list ? 4 + 8 : 0);
+	if (list)
+	{
+		fwrite("LIST", 1, 4, f);
+		u32 = 3; // odd sized, padded
+		fwrite(&u32, 4, 1, f);
+		fwrite("ab\0\0", 1, 4, f);
+	}
+	fwrite("data", 1, 4, f);
+	fwrite(&size, 4, 1, f);
+	for (long i = 0; i < nframes; i++)
+		for (int c = 0; c < nch; c++)
+		{
+			// little endian, the low bytes of s
+			s = lrintf(sample(i, c) * ((bits == 24) ? 256 : 1));
+			fwrite(&s, bits / 8, 1, f);
+		}
+	fclose(f);
+}
+
+void wav_write_raw(const char *path, uint16_t tag, uint16_t nch,
+				   uint32_t freq, uint16_t bits, const void *data,
+				   uint32_t size)
+{
+	FILE *f = fopen(path, "wb");
+
+	cr_assert_not_null(f, "%s", path);
+	wav_header(f, tag, nch, freq, bits, size, 0);
+	fwrite("data", 1, 4, f);
+	fwrite(&size, 4, 1, f);
+	fwrite(data, 1, size, f);
+	fclose(f);
+}
@@ -0,0 +1,52 @@
+/**
+ * @file wav.h
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief WAV files written by the unit tests
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ */
+#ifndef TEST_WAV_H_
+#define TEST_WAV_H_
+
+#include <stdint.h>
+
+#define WAV_TAG_PCM 1   /**< Integer PCM format tag. */
+#define WAV_TAG_FLOAT 3 /**< IEEE float format tag. */
+
+/**
+ * @brief sample of a channel of a frame, on the 16 bits scale
+ */
+typedef float (*wav_sample_t)(long i, int c);
+
+/**
+ * @brief write an integer PCM WAV, the test fails if it cannot
+ *
+ * @param path the file
+ * @param nframes no. frames
+ * @param nch no. channels
+ * @param freq sampling frequency
+ * @param bits 16 or 24, 24 bits samples are scaled up from 16 bits
+ * @param sample sample of each channel of each frame
+ * @param list write an odd sized LIST chunk before the data, that readers
+ * must skip with its padding
+ */
+void wav_write(const char *path, long nframes, int nch, int freq, int bits,
+			   wav_sample_t sample, int list);
+
+/**
+ * @brief write a WAV of any format, with the data given
+ *
+ * @param path the file
+ * @param tag format tag
+ * @param nch no. channels
+ * @param freq sampling frequency
+ * @param bits bits of a sample
+ * @param data the frames
+ * @param size bytes of data
+ */
+void wav_write_raw(const char *path, uint16_t tag, uint16_t nch,
+				   uint32_t freq, uint16_t bits, const void *data,
+				   uint32_t size);
+
+#endif // TEST_WAV_H_
@@ -0,0 +1,101 @@
+/**
+ * @file window_test.c
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief unit test window
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <math.h>
+
+#include <criterion/criterion.h>
+
+#include "player/window.h"
+
+#define TEST_WINDOW_SIZE 8192
+
+TestSuite(window);
+
+Test(window, corrections)
+{
+	// int window_get(window_type_t type, int size, float beta)
+	typedef struct
+	{
+		char *name;
+		window_type_t type;
+		float beta;
+		float cg;	/**< expected coherent gain. */
+		float enbw; /**< expected equivalent noise bandwidth. */
+	} testcase;
+	testcase testcases[] = {
+		{.name = "hann", .type = WIN_HANN, .cg = 0.5f, .enbw = 1.5f},
+		{.name = "hamming", .type = WIN_HAMMING, .cg = 0.54f, .enbw = 1.363f},
+		{.name = "blackman-harris", .type = WIN_BLACKMAN_HARRIS,
+		 .cg = 0.35875f, .enbw = 2.004f},
+		{.name = "flat-top", .type = WIN_FLATTOP, .cg = 0.2156f,
+		 .enbw = 3.770f},
+		{.name = "kaiser beta 0 is rectangular", .type = WIN_KAISER,
+		 .beta = 0.0f, .cg = 1.0f, .enbw = 1.0f},
+		{.name = ""}};
+
+	for (testcase *t = testcases; t->name[0] != '\0'; t++)
+	{
+		const window_t *w = window_get(t->type, TEST_WINDOW_SIZE, t->beta);
+		cr_assert_not_null(w, "%s: window_get", t->name);
+		cr_expect_float_eq(w->cg, t->cg, 1e-3, "%s: coherent gain %f",
+						   t->name, w->cg);
+		cr_expect_float_eq(w->enbw, t->enbw, 1e-2, "%s: enbw %f",
+						   t->name, w->enbw);
+		cr_expect_eq(((uintptr_t)w->w) % WINDOW_ALIGN, 0,
+					 "%s: table not aligned", t->name);
+	}
+	window_xtor();
+}
+
+Test(window, cached)
+{
+	const window_t *w1, *w2, *w3;
+
+	w1 = window_get(WIN_KAISER, TEST_WINDOW_SIZE, 8.6f);
+	w2 = window_get(WIN_KAISER, TEST_WINDOW_SIZE, 8.6f);
+	w3 = window_get(WIN_KAISER, TEST_WINDOW_SIZE, 4.0f);
+	cr_expect_eq(w1, w2, "same window must be computed once");
+	cr_expect_neq(w1, w3, "different beta must give different tables");
+	// symmetric and peaking in the middle
+	cr_expect_float_eq(w1->w[0], w1->w[TEST_WINDOW_SIZE - 1], 1e-6);
+	cr_expect_float_eq(w1->w[TEST_WINDOW_SIZE / 2], 1.0f, 1e-3);
+	window_xtor();
+}
+
+Test(window, sine_amplitude)
+{
+	// a bin centered sinusoid must read the same amplitude whatever the
+	// window, once corrected by the coherent gain.
+	static float buf[TEST_WINDOW_SIZE];
+	window_type_t types[] = {WIN_HANN, WIN_HAMMING, WIN_BLACKMAN_HARRIS,
+							 WIN_FLATTOP};
+	int bin = 512;
+
+	for (int k = 0; k < 4; k++)
+	{
+		const window_t *w = window_get(types[k], TEST_WINDOW_SIZE, 0);
+		double re = 0, im = 0, amp;
+
+		for (int n = 0; n < TEST_WINDOW_SIZE; n++)
+			buf[n] = 1000.0f * sinf(2 * M_PI * bin * n / TEST_WINDOW_SIZE);
+		window_apply(w, buf);
+		for (int n = 0; n < TEST_WINDOW_SIZE; n++)
+		{
+			re += buf[n] * cos(2 * M_PI * bin * n / TEST_WINDOW_SIZE);
+			im -= buf[n] * sin(2 * M_PI * bin * n / TEST_WINDOW_SIZE);
+		}
+		amp = sqrt(re * re + im * im) * 2.0 / (TEST_WINDOW_SIZE * w->cg);
+		cr_expect_float_eq(amp, 1000.0, 5.0, "window %d: amplitude %f",
+						   types[k], amp);
+	}
+	window_xtor();
+}
@@ -0,0 +1,169 @@
+/**
+ * @file ptask.c
+ * @author Stefano Fiori (fioristefano.90@gmail.com)
+ * @brief unit test of the periodic tasks
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <criterion/criterion.h>
+
+#include "ptask.h"
+
+#define TEST_PERIOD 10 /**< ms. */
+#define TEST_NACT 6
+#define TEST_LONG 2 /**< Activation overrunning. */
+
+static struct timespec start[TEST_NACT]; /**< Start of each activation. */
+static int nact;
+static int policy; /**< Policy of the last task. */
+
+TestSuite(ptask);
+
+/**
+ * @brief activation overrunning 4 periods and a half
+ */
+static int body(task_par_t *tp)
+{
+	clock_gettime(CLOCK_MONOTONIC, &start[nact]);
+	policy = sched_getscheduler(0);
+	if (nact == TEST_LONG)
+		usleep(TEST_PERIOD * 4500);
+	return ++nact == TEST_NACT;
+}
+
+/**
+ * @brief ms from the start of an activation to the start of the next one
+ */
+static double gap(int i)
+{
+	return (start[i + 1].tv_sec - start[i].tv_sec) * 1e3 +
+		   (start[i + 1].tv_nsec - start[i].tv_nsec) / 1e6;
+}
+
+static void run(task_par_t *tp)
+{
+	pthread_t tid;
+
+	nact = 0;
+	cr_assert_eq(task_start(&tid, body, tp), 0);
+	pthread_join(tid, NULL);
+	cr_assert_eq(nact, TEST_NACT);
+}
+
+Test(ptask, start)
+{
+	task_par_t tp = {.period = TEST_PERIOD, .deadline = TEST_PERIOD,
+					 .priority = 1, .cpus = 1};
+
+	run(&tp);
+	cr_expect_geq(tp.stack, TASK_STACK);
+	cr_expect_eq(tp.stack % sysconf(_SC_PAGESIZE), 0);
+	cr_expect_geq(tp.dmiss, 1, "the long activation");
+	cr_expect_geq(gap(0), TEST_PERIOD * 0.8);
+	// a time for each activation, the long one sleeping, not running
+	cr_expect_eq(tp.jitter.count, TEST_NACT);
+	cr_expect_eq(tp.response.count, TEST_NACT);
+	cr_expect_eq(tp.exec.count, TEST_NACT);
+	cr_expect_geq(tp.response.max, TEST_PERIOD * 4200);
+	cr_expect_lt(tp.exec.max, TEST_PERIOD * 1000);
+	cr_expect_eq(tp.wcet, 0, "as configured");
+}
+
+Test(ptask, hist)
+{
+	task_hist_t h = {0};
+	task_summary_t s;
+
+	task_hist_summary(&h, &s);
+	cr_expect_eq(s.count, 0);
+	cr_expect_eq(s.max, 0);
+	for (long us = 1; us <= 1000; us++)
+		task_hist_add(&h, us);
+	task_hist_add(&h, -5);
+	task_hist_add(&h, 100000000);
+	task_hist_summary(&h, &s);
+	cr_expect_eq(s.count, 1002);
+	cr_expect_eq(s.min, 0);
+	cr_expect_eq(s.max, 100000000);
+	// within a bucket, rounded up
+	cr_expect_geq(s.p50, 500);
+	cr_expect_leq(s.p50, 500 * 1.125);
+	cr_expect_geq(s.p99, 990);
+	cr_expect_leq(s.p99, 1000 * 1.125);
+	cr_expect_geq(s.p999, 1000);
+	cr_expect_leq(s.p999, 1000 * 1.125);
+	// below TASK_HIST_SUB, exact
+	h = (task_hist_t){0};
+	for (int i = 0; i < 10; i++)
+		task_hist_add(&h, 3);
+	task_hist_summary(&h, &s);
+	cr_expect_eq(s.p50, 3);
+	cr_expect_eq(s.p999, 3);
+}
+
+Test(ptask, skip)
+{
+	task_par_t tp = {.period = TEST_PERIOD, .deadline = TEST_PERIOD,
+					 .priority = 1, .overrun = TASK_SKIP};
+
+	run(&tp);
+	// the activations due while the long one ran, then at the same phase
+	cr_expect_geq(tp.skipped, 3);
+	cr_expect_geq(gap(TEST_LONG), TEST_PERIOD * 5 - 1);
+	cr_expect_geq(gap(TEST_LONG + 1), TEST_PERIOD * 0.8);
+}
+
+Test(ptask, catch_up)
+{
+	task_par_t tp = {.period = TEST_PERIOD, .deadline = TEST_PERIOD,
+					 .priority = 1, .overrun = TASK_CATCH_UP};
+
+	run(&tp);
+	cr_expect_eq(tp.skipped, 0);
+	// back to back
+	cr_expect_lt(gap(TEST_LONG + 1), TEST_PERIOD * 0.5);
+}
+
+Test(ptask, rephase)
+{
+	task_par_t tp = {.period = TEST_PERIOD, .deadline = TEST_PERIOD,
+					 .priority = 1, .overrun = TASK_REPHASE};
+
+	run(&tp);
+	cr_expect_eq(tp.skipped, 0);
+	// at once, then a period apart
+	cr_expect_lt(gap(TEST_LONG), TEST_PERIOD * 5 - 1);
+	cr_expect_geq(gap(TEST_LONG + 1), TEST_PERIOD * 0.8);
+}
+
+Test(ptask, deadline)
+{
+	task_par_t tp = {.period = TEST_PERIOD, .deadline = TEST_PERIOD,
+					 .priority = 1, .wcet = TEST_PERIOD * 100,
+					 .sched = TASK_DEADLINE};
+	task_par_t none = tp;
+
+	// admitted where permitted, else under SCHED_FIFO or a normal policy
+	run(&tp);
+	if (tp.sched == TASK_DEADLINE)
+		cr_expect_eq(policy, SCHED_DEADLINE);
+	else
+		cr_expect_neq(policy, SCHED_DEADLINE);
+	// no runtime to reserve
+	none.wcet = 0;
+	run(&none);
+	cr_expect_eq(none.sched, TASK_FIFO);
+	cr_expect_neq(policy, SCHED_DEADLINE);
+	// the policy by default
+	task_set_sched(TASK_DEADLINE);
+	none.sched = TASK_SCHED_DEFAULT;
+	run(&none);
+	task_set_sched(TASK_FIFO);
+	cr_expect_eq(none.sched, TASK_FIFO, "not admitted, no wcet");
+}